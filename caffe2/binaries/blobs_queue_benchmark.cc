@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput of BlobsQueue with concurrent producers and consumers, moving
+// records of one blob as reader nets feeding trainer nets would.
+
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "caffe2/core/workspace.h"
+#include "caffe2/queue/blobs_queue.h"
+
+using namespace caffe2;
+
+namespace {
+
+const int kRecords = 1 << 16;
+const int kCapacity = 64;
+
+} // namespace
+
+// Arguments are the number of producers and of consumers
+static void BM_BlobsQueueThroughput(benchmark::State& state) {
+  const int numProducers = state.range(0);
+  const int numConsumers = state.range(1);
+  Workspace ws;
+  auto queue = std::make_shared<BlobsQueue>(
+      &ws, "benchmark_queue", kCapacity, 1, false);
+  while (state.KeepRunning()) {
+    std::vector<std::thread> threads;
+    for (int p = 0; p < numProducers; ++p) {
+      const int records = kRecords / numProducers +
+          (p < kRecords % numProducers ? 1 : 0);
+      threads.emplace_back([&queue, records]() {
+        Blob blob;
+        const std::vector<Blob*> blobs{&blob};
+        for (int i = 0; i < records; ++i) {
+          *blob.GetMutable<int>() = i;
+          CHECK(queue->blockingWrite(blobs));
+        }
+      });
+    }
+    for (int c = 0; c < numConsumers; ++c) {
+      const int records = kRecords / numConsumers +
+          (c < kRecords % numConsumers ? 1 : 0);
+      threads.emplace_back([&queue, records]() {
+        Blob blob;
+        const std::vector<Blob*> blobs{&blob};
+        for (int i = 0; i < records; ++i) {
+          CHECK(queue->blockingRead(blobs));
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kRecords);
+}
+BENCHMARK(BM_BlobsQueueThroughput)
+    ->Args({1, 1})
+    ->Args({2, 2})
+    ->Args({4, 4})
+    ->Args({8, 8})
+    ->Args({16, 16})
+    ->Args({32, 32})
+    ->Args({1, 8})
+    ->Args({8, 1})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Uncontended cost of a write followed by a read
+static void BM_BlobsQueueWriteRead(benchmark::State& state) {
+  Workspace ws;
+  auto queue = std::make_shared<BlobsQueue>(
+      &ws, "benchmark_queue", kCapacity, 1, false);
+  Blob blob;
+  const std::vector<Blob*> blobs{&blob};
+  while (state.KeepRunning()) {
+    CHECK(queue->blockingWrite(blobs));
+    CHECK(queue->blockingRead(blobs));
+  }
+}
+BENCHMARK(BM_BlobsQueueWriteRead);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Overhead of CPU allocations and of creating and running CPU nets, built
+// without CUDA unlike core_overhead_benchmark.
+
+#include "benchmark/benchmark.h"
+
+#include "caffe2/core/caching_allocator.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+
+using namespace caffe2;
+
+namespace {
+class DummyEmptyOp : public Operator<CPUContext> {
+ public:
+  DummyEmptyOp(const OperatorDef& def, Workspace* ws)
+      : Operator<CPUContext>(def, ws) {}
+
+  bool RunOnDevice() final { return true; }
+};
+
+REGISTER_CPU_OPERATOR(DummyEmpty, DummyEmptyOp);
+OPERATOR_SCHEMA(DummyEmpty);
+
+// A chain of `num_ops` DummyEmpty operators
+NetDef DummyNetDef(int num_ops, const string& type) {
+  NetDef def;
+  def.set_name("dummy");
+  def.set_type(type);
+  for (int i = 0; i < num_ops; ++i) {
+    auto* op = def.add_op();
+    op->set_type("DummyEmpty");
+    op->add_input("blob_" + caffe2::to_string(i));
+    op->add_output("blob_" + caffe2::to_string(i + 1));
+    auto* arg = op->add_arg();
+    arg->set_name("unused");
+    arg->set_i(i);
+  }
+  return def;
+}
+}  // namespace
+
+static void BM_NetCreationCPU(benchmark::State& state, const string& type) {
+  Workspace ws;
+  ws.CreateBlob("blob_0");
+  const auto def = DummyNetDef(state.range(0), type);
+  std::unique_ptr<NetBase> net;
+  while (state.KeepRunning()) {
+    net = CreateNet(def, &ws);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_CAPTURE(BM_NetCreationCPU, simple, string("simple"))
+    ->Range(1, 256);
+BENCHMARK_CAPTURE(BM_NetCreationCPU, dag, string("dag"))->Range(1, 256);
+BENCHMARK_CAPTURE(BM_NetCreationCPU, async_scheduling,
+                  string("async_scheduling"))
+    ->Range(1, 256);
+
+// Workspace::RunNetOnce without and with the net cache
+static void BM_RunNetOnceCPU(benchmark::State& state) {
+  const auto saved_cache_size = FLAGS_caffe2_net_cache_size;
+  FLAGS_caffe2_net_cache_size = state.range(1);
+  Workspace ws;
+  ws.CreateBlob("blob_0");
+  const auto def = DummyNetDef(state.range(0), "simple");
+  while (state.KeepRunning()) {
+    CHECK(ws.RunNetOnce(def));
+  }
+  FLAGS_caffe2_net_cache_size = saved_cache_size;
+}
+BENCHMARK(BM_RunNetOnceCPU)->RangeMultiplier(4)->Ranges({{1, 256}, {0, 1}});
+
+static void BM_RunNetCPU(benchmark::State& state) {
+  Workspace ws;
+  ws.CreateBlob("blob_0");
+  auto* net = ws.CreateNet(DummyNetDef(state.range(0), "simple"));
+  while (state.KeepRunning()) {
+    CHECK(net->Run());
+  }
+}
+BENCHMARK(BM_RunNetCPU)->RangeMultiplier(4)->Range(1, 256);
+
+// Before/after comparison of the default and caching CPU allocators, across
+// allocation sizes and numbers of concurrent threads.
+template <class Allocator>
+static void BM_AllocDeallocCPU(benchmark::State& state) {
+  static Allocator allocator;
+  const size_t nbytes = state.range(0);
+  while (state.KeepRunning()) {
+    auto ptr_and_deleter = allocator.New(nbytes);
+    ptr_and_deleter.second(ptr_and_deleter.first);
+  }
+}
+BENCHMARK_TEMPLATE(BM_AllocDeallocCPU, DefaultCPUAllocator)
+    ->RangeMultiplier(16)
+    ->Range(1, 1 << 20)
+    ->ThreadRange(1, 16);
+BENCHMARK_TEMPLATE(BM_AllocDeallocCPU, CachingCPUAllocator)
+    ->RangeMultiplier(16)
+    ->Range(1, 1 << 20)
+    ->ThreadRange(1, 16);
+
+BENCHMARK_MAIN();
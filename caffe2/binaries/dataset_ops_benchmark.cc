@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput of ReadNextBatch and ReadRandomBatch over an in-memory dataset
+// with a nested sparse feature schema:
+//
+//   label                  float         one per record
+//   dense                  float[64]     one per record
+//   id_list:lengths        int32         one per record
+//   id_list:values         int64         ~20 per record
+//   event:lengths          int32         one per record
+//   event:type             int32         ~4 per record
+//   event:features:lengths int32         ~4 per record
+//   event:features:ids     int64         ~40 per record
+//   event:features:scores  float         ~40 per record
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/parallel_for.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/thread_pool.h"
+
+using namespace caffe2;
+
+namespace {
+
+const int kNumRecords = 1 << 16;
+const int kDenseSize = 64;
+
+const std::vector<std::string> kFields{
+    "label",
+    "dense",
+    "id_list:lengths",
+    "id_list:values",
+    "event:lengths",
+    "event:type",
+    "event:features:lengths",
+    "event:features:ids",
+    "event:features:scores",
+};
+
+template <typename T>
+void FillField(
+    Workspace* ws,
+    const std::string& name,
+    std::vector<TIndex> dims,
+    const std::function<T(TIndex)>& value) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  auto* data = tensor->mutable_data<T>();
+  for (TIndex i = 0; i < tensor->size(); ++i) {
+    data[i] = value(i);
+  }
+}
+
+// Lengths uniformly drawn in [0, 2 * average].
+std::vector<int> RandomLengths(int num, int average, std::mt19937* gen) {
+  std::uniform_int_distribution<int> dist(0, 2 * average);
+  std::vector<int> lengths(num);
+  for (auto& length : lengths) {
+    length = dist(*gen);
+  }
+  return lengths;
+}
+
+void FillLengths(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<int>& lengths) {
+  FillField<int>(ws, name, {TIndex(lengths.size())}, [&lengths](TIndex i) {
+    return lengths[i];
+  });
+}
+
+TIndex Sum(const std::vector<int>& lengths) {
+  return std::accumulate(lengths.begin(), lengths.end(), TIndex(0));
+}
+
+void CreateDataset(Workspace* ws) {
+  std::mt19937 gen(0);
+  FillField<float>(ws, "label", {kNumRecords}, [](TIndex i) { return i; });
+  FillField<float>(
+      ws, "dense", {kNumRecords, kDenseSize}, [](TIndex i) { return i; });
+
+  const auto idListLengths = RandomLengths(kNumRecords, 20, &gen);
+  FillLengths(ws, "id_list:lengths", idListLengths);
+  FillField<int64_t>(
+      ws, "id_list:values", {Sum(idListLengths)}, [](TIndex i) { return i; });
+
+  const auto eventLengths = RandomLengths(kNumRecords, 4, &gen);
+  const auto numEvents = Sum(eventLengths);
+  FillLengths(ws, "event:lengths", eventLengths);
+  FillField<int>(ws, "event:type", {numEvents}, [](TIndex i) { return i; });
+  const auto featureLengths = RandomLengths(numEvents, 10, &gen);
+  const auto numFeatures = Sum(featureLengths);
+  FillLengths(ws, "event:features:lengths", featureLengths);
+  FillField<int64_t>(
+      ws, "event:features:ids", {numFeatures}, [](TIndex i) { return i; });
+  FillField<float>(
+      ws, "event:features:scores", {numFeatures}, [](TIndex i) { return i; });
+
+  CHECK(ws->RunOperatorOnce(CreateOperatorDef(
+      "CreateTreeCursor",
+      "",
+      std::vector<string>{},
+      std::vector<string>{"cursor"},
+      std::vector<Argument>{MakeArgument("fields", kFields)})));
+  std::vector<string> inputs{"cursor"};
+  inputs.insert(inputs.end(), kFields.begin(), kFields.end());
+  CHECK(ws->RunOperatorOnce(CreateOperatorDef(
+      "ComputeOffset", "", inputs, std::vector<string>{"offsets"})));
+
+  std::vector<int64_t> shuffled(kNumRecords);
+  std::iota(shuffled.begin(), shuffled.end(), 0);
+  std::shuffle(shuffled.begin(), shuffled.end(), gen);
+  FillField<int64_t>(ws, "shuffled", {kNumRecords}, [&shuffled](TIndex i) {
+    return shuffled[i];
+  });
+}
+
+std::vector<string> Outputs() {
+  std::vector<string> outputs;
+  for (const auto& field : kFields) {
+    outputs.push_back(field + "_batch");
+  }
+  return outputs;
+}
+
+// Runs the reading operator until the end of the dataset, with the given
+// number of intra-op threads.
+void RunReader(
+    benchmark::State& state,
+    const std::string& type,
+    const std::vector<string>& extraInputs) {
+  const int batchSize = state.range(0);
+  const int numThreads = state.range(1);
+  Workspace ws;
+  CreateDataset(&ws);
+
+  std::vector<string> inputs{"cursor"};
+  inputs.insert(inputs.end(), extraInputs.begin(), extraInputs.end());
+  inputs.insert(inputs.end(), kFields.begin(), kFields.end());
+  auto op = CreateOperator(
+      CreateOperatorDef(
+          type,
+          "",
+          inputs,
+          Outputs(),
+          std::vector<Argument>{MakeArgument("batch_size", batchSize)}),
+      &ws);
+  auto reset = CreateOperator(
+      CreateOperatorDef(
+          "ResetCursor", "", std::vector<string>{"cursor"}, {}),
+      &ws);
+
+  auto pool = std::make_shared<TaskThreadPool>(numThreads);
+  const auto parallelFor = PoolParallelFor(pool, numThreads);
+  IntraOpParallelismGuard guard(&parallelFor, numThreads);
+  const int numBatches = (kNumRecords + batchSize - 1) / batchSize;
+  while (state.KeepRunning()) {
+    CHECK(reset->Run());
+    for (int i = 0; i < numBatches; ++i) {
+      CHECK(op->Run());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumRecords);
+}
+
+} // namespace
+
+// Arguments are the batch size and the number of intra-op threads
+static void BM_ReadNextBatch(benchmark::State& state) {
+  RunReader(state, "ReadNextBatch", {});
+}
+BENCHMARK(BM_ReadNextBatch)
+    ->Args({128, 1})
+    ->Args({1024, 1})
+    ->Args({1024, 4})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ReadRandomBatch(benchmark::State& state) {
+  RunReader(state, "ReadRandomBatch", {"shuffled", "offsets"});
+}
+BENCHMARK(BM_ReadRandomBatch)
+    ->Args({128, 1})
+    ->Args({1024, 1})
+    ->Args({1024, 4})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
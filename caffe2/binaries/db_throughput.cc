@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cstdio>
 #include <thread>
 #include <vector>
@@ -30,6 +31,13 @@ CAFFE2_DEFINE_int(repeat, 10, "The number to repeat the throughput test.");
 CAFFE2_DEFINE_bool(use_reader, false, "If true, use the reader interface.");
 CAFFE2_DEFINE_int(num_read_threads, 1,
                    "The number of concurrent reading threads.");
+CAFFE2_DEFINE_int(read_batch_size, 1,
+                   "With the reader, the number of items read at once with "
+                   "ReadMany(). 1 uses Read().");
+CAFFE2_DEFINE_int(num_cursors, 1,
+                   "With the reader, the number of cursors it is split into. "
+                   "Each thread reads from its own cursor when there are as "
+                   "many cursors as threads.");
 
 using caffe2::db::Cursor;
 using caffe2::db::DB;
@@ -60,10 +68,23 @@ void TestThroughputWithDB() {
 
 void TestThroughputWithReaderWorker(const DBReader* reader, int thread_id) {
   string key, value;
+  std::vector<string> keys, values;
+  const int batch_size = caffe2::FLAGS_read_batch_size;
+  const int cursor_id = thread_id % reader->NumCursors();
   for (int iter_id = 0; iter_id < caffe2::FLAGS_repeat; ++iter_id) {
     caffe2::Timer timer;
-    for (int i = 0; i < caffe2::FLAGS_report_interval; ++i) {
-      reader->Read(&key, &value);
+    if (batch_size == 1) {
+      for (int i = 0; i < caffe2::FLAGS_report_interval; ++i) {
+        reader->Read(&key, &value, cursor_id);
+      }
+    } else {
+      for (int i = 0; i < caffe2::FLAGS_report_interval; i += batch_size) {
+        reader->ReadMany(
+            std::min(batch_size, caffe2::FLAGS_report_interval - i),
+            &keys,
+            &values,
+            cursor_id);
+      }
     }
     double elapsed_seconds = timer.Seconds();
     printf("Thread %03d iteration %03d, took %4.5f seconds, "
@@ -76,8 +97,10 @@ void TestThroughputWithReaderWorker(const DBReader* reader, int thread_id) {
 void TestThroughputWithReader() {
   caffe2::db::DBReader reader(
       caffe2::FLAGS_input_db_type, caffe2::FLAGS_input_db);
+  reader.SetNumCursors(caffe2::FLAGS_num_cursors);
   std::vector<std::unique_ptr<std::thread>> reading_threads(
       caffe2::FLAGS_num_read_threads);
+  caffe2::Timer timer;
   for (int i = 0; i < reading_threads.size(); ++i) {
     reading_threads[i].reset(new std::thread(
         TestThroughputWithReaderWorker, &reader, i));
@@ -85,6 +108,14 @@ void TestThroughputWithReader() {
   for (int i = 0; i < reading_threads.size(); ++i) {
     reading_threads[i]->join();
   }
+  double elapsed_seconds = timer.Seconds();
+  printf("%d threads with %d cursors read %d items at once, overall "
+         "throughput %f items/sec.\n",
+         caffe2::FLAGS_num_read_threads, caffe2::FLAGS_num_cursors,
+         caffe2::FLAGS_read_batch_size,
+         static_cast<double>(caffe2::FLAGS_num_read_threads) *
+             caffe2::FLAGS_repeat * caffe2::FLAGS_report_interval /
+             elapsed_seconds);
 }
 
 int main(int argc, char** argv) {
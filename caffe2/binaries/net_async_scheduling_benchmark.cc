@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the CPU time the async_scheduling executor burns while it waits
+// on operators whose async part takes a long time to finish (e.g. remote
+// calls), with and without event callbacks.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/timer.h"
+
+CAFFE2_DEFINE_int(width, 4, "Number of operators in each layer of the DAG.");
+CAFFE2_DEFINE_int(depth, 8, "Number of layers of the DAG.");
+CAFFE2_DEFINE_int(
+    async_latency_us,
+    2000,
+    "Time it takes for each operator's async part to finish.");
+CAFFE2_DEFINE_int(iter, 20, "The number of runs per mode.");
+
+CAFFE2_DECLARE_bool(caffe2_net_async_event_callbacks);
+
+namespace caffe2 {
+namespace {
+
+// Finishes events at given points in time from a single sleeping thread.
+class EventTimer {
+ public:
+  EventTimer() : thread_(&EventTimer::loop, this) {}
+
+  ~EventTimer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  void finishAfter(Event* event, std::chrono::microseconds delay) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_.emplace(std::chrono::steady_clock::now() + delay, event);
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  void loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+      if (pending_.empty()) {
+        cv_.wait(lock);
+        continue;
+      }
+      auto next = pending_.begin();
+      if (cv_.wait_until(lock, next->first) == std::cv_status::no_timeout) {
+        continue;
+      }
+      next = pending_.begin();
+      Event* event = next->second;
+      pending_.erase(next);
+      // RunAsync records the event only after RunOnDevice returns
+      if (!event->IsScheduled()) {
+        pending_.emplace(
+            std::chrono::steady_clock::now() + std::chrono::microseconds(10),
+            event);
+        continue;
+      }
+      lock.unlock();
+      event->SetFinished();
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::multimap<std::chrono::steady_clock::time_point, Event*> pending_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+EventTimer& GetEventTimer() {
+  static EventTimer timer;
+  return timer;
+}
+
+// CPU operator whose async part takes async_latency_us to finish, without
+// using any CPU.
+class AsyncSleepOp final : public Operator<CPUContext> {
+ public:
+  AsyncSleepOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws) {}
+
+  bool RunOnDevice() override {
+    GetEventTimer().finishAfter(
+        &event(), std::chrono::microseconds(FLAGS_async_latency_us));
+    return true;
+  }
+
+  bool HasAsyncPart() const override {
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(AsyncSleep, AsyncSleepOp);
+OPERATOR_SCHEMA(AsyncSleep).NumInputs(0, INT_MAX).NumOutputs(1);
+
+// Every operator depends on all the operators of the previous layer, so that
+// each one is its own chain and has to wait for its parents' async parts.
+NetDef CreateIdleHeavyNet() {
+  NetDef net_def;
+  net_def.set_name("idle_heavy");
+  net_def.set_type("async_scheduling");
+  for (int layer = 0; layer < FLAGS_depth; ++layer) {
+    for (int i = 0; i < FLAGS_width; ++i) {
+      auto* op = net_def.add_op();
+      op->set_type("AsyncSleep");
+      if (layer > 0) {
+        for (int j = 0; j < FLAGS_width; ++j) {
+          op->add_input(MakeString("blob_", layer - 1, "_", j));
+        }
+      }
+      op->add_output(MakeString("blob_", layer, "_", i));
+    }
+  }
+  return net_def;
+}
+
+void RunBenchmark(bool use_callbacks) {
+  FLAGS_caffe2_net_async_event_callbacks = use_callbacks;
+  Workspace ws;
+  auto net = CreateNet(CreateIdleHeavyNet(), &ws);
+  CAFFE_ENFORCE(net->Run(), "Warm up run failed");
+
+  Timer timer;
+  auto cpu_start = std::clock();
+  for (int i = 0; i < FLAGS_iter; ++i) {
+    CAFFE_ENFORCE(net->Run());
+  }
+  double cpu_seconds = double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+  double wall_seconds = timer.Seconds();
+  printf(
+      "%-10s: %4.3f ms/iter, %4.3f ms CPU/iter, %.2f cores busy.\n",
+      use_callbacks ? "callbacks" : "polling",
+      wall_seconds * 1000 / FLAGS_iter,
+      cpu_seconds * 1000 / FLAGS_iter,
+      cpu_seconds / wall_seconds);
+}
+
+} // namespace
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  caffe2::RunBenchmark(false);
+  caffe2::RunBenchmark(true);
+  return 0;
+}
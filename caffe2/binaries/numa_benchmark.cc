@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the cost of running operators on one NUMA node with their memory
+// on another one: for every pair of nodes, the memory bandwidth of threads
+// bound to the first node reading memory placed on the second, and the
+// latency of a stack of FC layers run on the first node by a predictor
+// whose parameters live on the second.
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/numa.h"
+#include "caffe2/core/predictor.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/utils/thread_pool.h"
+
+CAFFE2_DEFINE_int(buffer_mb, 256, "Size of the buffer read per node pair.");
+CAFFE2_DEFINE_int(threads, 4, "Number of threads per node.");
+CAFFE2_DEFINE_int(dim, 1024, "Size of the square FC layers.");
+CAFFE2_DEFINE_int(depth, 8, "Number of FC layers.");
+CAFFE2_DEFINE_int(batch_size, 1, "Number of rows of the FC inputs.");
+CAFFE2_DEFINE_int(iter, 20, "The number of runs per node pair.");
+
+CAFFE2_DECLARE_bool(caffe2_cpu_numa_enabled);
+
+namespace caffe2 {
+namespace {
+
+// Reads a buffer placed on `memory_node` from FLAGS_threads threads bound to
+// `cpu_node`, returns the bandwidth in GB/s
+double MeasureBandwidth(int cpu_node, int memory_node) {
+  const size_t size = size_t(FLAGS_buffer_mb) << 20;
+  TensorCPU buffer(std::vector<TIndex>{TIndex(size / sizeof(float))});
+  auto* data = buffer.mutable_data<float>();
+  NUMAMove(data, buffer.nbytes(), memory_node);
+  CPUContext context;
+  math::Set<float, CPUContext>(buffer.size(), 1, data, &context);
+
+  TaskThreadPool pool(FLAGS_threads, cpu_node, true);
+  const auto slice = buffer.size() / FLAGS_threads;
+  std::vector<float> sums(FLAGS_threads);
+  std::mutex mutex;
+  std::condition_variable cv;
+  int done = 0;
+  Timer timer;
+  for (int iter = 0; iter < FLAGS_iter; ++iter) {
+    for (int t = 0; t < FLAGS_threads; ++t) {
+      pool.run([&, t]() {
+        float sum = 0;
+        for (auto i = t * slice; i < (t + 1) * slice; ++i) {
+          sum += data[i];
+        }
+        sums[t] += sum;
+        std::lock_guard<std::mutex> lock(mutex);
+        ++done;
+        cv.notify_one();
+      });
+    }
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&]() { return done == FLAGS_iter * FLAGS_threads; });
+  return double(size) * FLAGS_iter / timer.Seconds() / 1e9;
+}
+
+// FC stack computed on `cpu_node`, with its parameters on `memory_node`
+void CreateFCStack(
+    int cpu_node,
+    int memory_node,
+    NetDef* init_net,
+    NetDef* run_net) {
+  init_net->set_name("init");
+  run_net->set_name("fc_stack");
+  run_net->set_type("async_scheduling");
+  run_net->mutable_device_option()->set_numa_node_id(memory_node);
+  run_net->add_external_input("data");
+  std::string input = "data";
+  for (int i = 0; i < FLAGS_depth; ++i) {
+    auto w = MakeString("W", i);
+    auto b = MakeString("b", i);
+    for (const auto& param : {w, b}) {
+      auto* fill = init_net->add_op();
+      fill->set_type("ConstantFill");
+      fill->add_output(param);
+      auto* shape = fill->add_arg();
+      shape->set_name("shape");
+      shape->add_ints(FLAGS_dim);
+      if (param == w) {
+        shape->add_ints(FLAGS_dim);
+      }
+      auto* value = fill->add_arg();
+      value->set_name("value");
+      value->set_f(1.0 / FLAGS_dim);
+      run_net->add_external_input(param);
+    }
+    auto* fc = run_net->add_op();
+    fc->set_type("FC");
+    fc->add_input(input);
+    fc->add_input(w);
+    fc->add_input(b);
+    input = MakeString("fc", i);
+    fc->add_output(input);
+    fc->mutable_device_option()->set_numa_node_id(cpu_node);
+  }
+  run_net->add_external_output(input);
+}
+
+// Milliseconds per run of the FC stack
+double MeasureFCStack(int cpu_node, int memory_node) {
+  NetDef init_net, run_net;
+  CreateFCStack(cpu_node, memory_node, &init_net, &run_net);
+  Predictor predictor(init_net, run_net);
+  TensorCPU data(std::vector<TIndex>{FLAGS_batch_size, FLAGS_dim});
+  CPUContext context;
+  math::Set<float, CPUContext>(
+      data.size(), 1, data.mutable_data<float>(), &context);
+  Predictor::TensorVector outputs;
+  CAFFE_ENFORCE(predictor.run({&data}, &outputs), "Warm up run failed");
+
+  Timer timer;
+  for (int i = 0; i < FLAGS_iter; ++i) {
+    CAFFE_ENFORCE(predictor.run({&data}, &outputs));
+  }
+  return timer.MilliSeconds() / FLAGS_iter;
+}
+
+void RunBenchmark() {
+  FLAGS_caffe2_cpu_numa_enabled = true;
+  CAFFE_ENFORCE(IsNUMAEnabled(), "NUMA is not available");
+  const auto num_nodes = GetNumNUMANodes();
+  printf("%d NUMA nodes, %d threads per node\n", num_nodes, FLAGS_threads);
+  for (int cpu_node = 0; cpu_node < num_nodes; ++cpu_node) {
+    for (int memory_node = 0; memory_node < num_nodes; ++memory_node) {
+      printf(
+          "CPU node %d, memory node %d (%s): %6.2f GB/s, FC stack "
+          "%8.3f ms/iter\n",
+          cpu_node,
+          memory_node,
+          cpu_node == memory_node ? "local " : "remote",
+          MeasureBandwidth(cpu_node, memory_node),
+          MeasureFCStack(cpu_node, memory_node));
+    }
+  }
+}
+
+} // namespace
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  caffe2::RunBenchmark();
+  return 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput and latency percentiles of a PredictorPool serving a small MLP
+// from a growing number of threads.
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "caffe2/core/predictor_pool.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/utils/math.h"
+
+using namespace caffe2;
+
+namespace {
+
+const int kRequests = 200;
+const int kDepth = 3;
+
+// Stack of `depth` FC layers of size `dim`, with small weights so that
+// the activations stay bounded.
+void fcStack(int depth, int dim, NetDef* init_net, NetDef* run_net) {
+  init_net->set_name("init");
+  run_net->set_name("predict");
+  run_net->add_external_input("data");
+  std::string input = "data";
+  for (int i = 0; i < depth; ++i) {
+    auto w = MakeString("W", i);
+    auto b = MakeString("b", i);
+    for (const auto& param : {w, b}) {
+      auto* fill = init_net->add_op();
+      fill->set_type("ConstantFill");
+      fill->add_output(param);
+      auto* shape = fill->add_arg();
+      shape->set_name("shape");
+      shape->add_ints(dim);
+      if (param == w) {
+        shape->add_ints(dim);
+      }
+      auto* value = fill->add_arg();
+      value->set_name("value");
+      value->set_f(1.0 / dim);
+      run_net->add_external_input(param);
+    }
+    auto* fc = run_net->add_op();
+    fc->set_type("FC");
+    fc->add_input(input);
+    fc->add_input(w);
+    fc->add_input(b);
+    input = MakeString("fc", i);
+    fc->add_output(input);
+  }
+  run_net->add_external_output(input);
+}
+
+} // namespace
+
+// Arguments are the size of the FC layers and the number of client threads,
+// which is also the maximum number of instances of the pool. Every thread
+// sends kRequests requests per iteration.
+static void BM_PredictorPoolThroughput(benchmark::State& state) {
+  const int dim = state.range(0);
+  const int numThreads = state.range(1);
+  NetDef init_net, run_net;
+  fcStack(kDepth, dim, &init_net, &run_net);
+  PredictorPool pool(init_net, run_net, numThreads);
+
+  std::vector<std::vector<float>> latencies(numThreads);
+  while (state.KeepRunning()) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t) {
+      threads.emplace_back([&pool, &latencies, dim, t]() {
+        TensorCPU data(std::vector<TIndex>{1, dim});
+        CPUContext ctx;
+        math::Set<float, CPUContext>(
+            data.size(), 1.0, data.mutable_data<float>(), &ctx);
+        PredictorPool::OutputVector output;
+        for (int i = 0; i < kRequests; ++i) {
+          Timer timer;
+          CAFFE_ENFORCE(pool.run({&data}, &output));
+          latencies[t].push_back(timer.MilliSeconds());
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * numThreads * kRequests);
+
+  std::vector<float> all;
+  for (const auto& l : latencies) {
+    all.insert(all.end(), l.begin(), l.end());
+  }
+  std::sort(all.begin(), all.end());
+  state.counters["p50_ms"] = all[all.size() / 2];
+  state.counters["p99_ms"] = all[all.size() * 99 / 100];
+  state.counters["instances"] = pool.num_instances();
+}
+BENCHMARK(BM_PredictorPoolThroughput)
+    ->Args({256, 1})
+    ->Args({256, 2})
+    ->Args({256, 4})
+    ->Args({256, 8})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
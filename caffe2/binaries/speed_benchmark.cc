@@ -14,11 +14,17 @@
  * limitations under the License.
  */
 
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
 #include <string>
 
 #include "caffe2/core/init.h"
 #include "caffe2/core/logging.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/core/timer.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/utils/proto_utils.h"
 #include "caffe2/utils/string_utils.h"
@@ -67,6 +73,24 @@ CAFFE2_DEFINE_bool(
     false,
     "Whether to benchmark individual operators.");
 
+CAFFE2_DEFINE_bool(
+    roofline,
+    false,
+    "Whether to run each operator individually and report its achieved "
+    "GFLOP/s and GB/s, using the cost inference functions of the operator "
+    "schemas.");
+CAFFE2_DEFINE_string(
+    report_json,
+    "",
+    "With roofline, the file to write the per operator and per operator "
+    "type report to, as JSON.");
+CAFFE2_DEFINE_double(
+    peak_gflops,
+    0,
+    "Peak GFLOP/s of the machine. With peak_gbps, classifies the operators "
+    "as compute or memory bound and reports their fraction of the roofline.");
+CAFFE2_DEFINE_double(peak_gbps, 0, "Peak memory bandwidth in GB/s.");
+
 CAFFE2_DEFINE_bool(force_engine, false, "Force engine field for all operators");
 CAFFE2_DEFINE_string(engine, "", "Forced engine field value");
 CAFFE2_DEFINE_bool(force_algo, false, "Force algo arg for all operators");
@@ -76,6 +100,199 @@ using std::string;
 using std::unique_ptr;
 using std::vector;
 
+namespace {
+
+// Measured time and inferred cost per iteration of an operator, or of all the
+// operators of a type.
+struct RooflineStats {
+  int count = 0;
+  double millis = 0;
+  uint64_t flops = 0;
+  uint64_t bytes = 0;
+  bool costed = false;
+
+  void add(const RooflineStats& other) {
+    count += other.count;
+    millis += other.millis;
+    flops += other.flops;
+    bytes += other.bytes;
+    costed = costed || other.costed;
+  }
+  double gflopsPerSec() const {
+    return millis > 0 ? 1e-6 * flops / millis : 0;
+  }
+  double gbytesPerSec() const {
+    return millis > 0 ? 1e-6 * bytes / millis : 0;
+  }
+  // FLOPs per byte moved
+  double intensity() const {
+    return bytes > 0 ? static_cast<double>(flops) / bytes : 0;
+  }
+  // Whether the operators are bound by the memory bandwidth rather than by
+  // the compute throughput, at their arithmetic intensity
+  bool memoryBound() const {
+    return intensity() * caffe2::FLAGS_peak_gbps < caffe2::FLAGS_peak_gflops;
+  }
+  // Fraction of the attainable throughput, 0 without peaks
+  double roofFraction() const {
+    if (caffe2::FLAGS_peak_gflops <= 0 || caffe2::FLAGS_peak_gbps <= 0) {
+      return 0;
+    }
+    return memoryBound() ? gbytesPerSec() / caffe2::FLAGS_peak_gbps
+                         : gflopsPerSec() / caffe2::FLAGS_peak_gflops;
+  }
+};
+
+string JsonString(const string& s) {
+  std::ostringstream os;
+  os << '"';
+  for (const char c : s) {
+    if (c == '"' || c == '\\') {
+      os << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      os << buf;
+    } else {
+      os << c;
+    }
+  }
+  os << '"';
+  return os.str();
+}
+
+void WriteJsonStats(std::ostream& os, const RooflineStats& stats) {
+  os << "\"count\": " << stats.count
+     << ", \"ms_per_iter\": " << stats.millis;
+  if (stats.costed) {
+    os << ", \"flops\": " << stats.flops << ", \"bytes\": " << stats.bytes
+       << ", \"gflops_per_sec\": " << stats.gflopsPerSec()
+       << ", \"gbytes_per_sec\": " << stats.gbytesPerSec()
+       << ", \"intensity\": " << stats.intensity();
+    if (stats.roofFraction() > 0) {
+      os << ", \"bound\": \"" << (stats.memoryBound() ? "memory" : "compute")
+         << "\", \"roof_fraction\": " << stats.roofFraction();
+    }
+  }
+}
+
+string FormatStats(const RooflineStats& stats) {
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(4) << stats.millis << " ms/iter";
+  if (stats.costed) {
+    os << std::setprecision(2) << ", " << stats.gflopsPerSec() << " GFLOP/s, "
+       << stats.gbytesPerSec() << " GB/s, " << stats.intensity()
+       << " FLOP/byte";
+    if (stats.roofFraction() > 0) {
+      os << ", " << (stats.memoryBound() ? "memory" : "compute")
+         << " bound at " << 100 * stats.roofFraction() << "% of roofline";
+    }
+  }
+  return os.str();
+}
+
+// Runs the operators of the net one by one, `iter` times, and reports their
+// achieved throughput from the costs inferred for their input shapes.
+void RunRoofline(caffe2::NetBase* net, int iter) {
+  CAFFE_ENFORCE_GT(iter, 0, "Roofline needs at least one iteration.");
+  const auto ops = net->GetOperators();
+  vector<RooflineStats> op_stats(ops.size());
+  for (int idx = 0; idx < ops.size(); ++idx) {
+    const auto& def = ops[idx]->debug_def();
+    op_stats[idx].count = 1;
+    const auto* schema = caffe2::OpSchemaRegistry::Schema(def.type());
+    if (!schema || !schema->HasCostInferenceFunction()) {
+      continue;
+    }
+    try {
+      const auto cost =
+          schema->InferCost(def, ops[idx]->InputTensorShapes());
+      op_stats[idx].flops = cost.flops;
+      op_stats[idx].bytes = cost.bytes_moved;
+      op_stats[idx].costed = true;
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "Cost inference failed for " << def.type() << ": "
+                   << e.what();
+    }
+  }
+
+  caffe2::Timer timer;
+  for (int i = 0; i < iter; ++i) {
+    for (auto* op : ops) {
+      op->ResetEvent();
+    }
+    for (int idx = 0; idx < ops.size(); ++idx) {
+      timer.Start();
+      CAFFE_ENFORCE(
+          ops[idx]->Run(),
+          "Operator ",
+          idx,
+          " (",
+          ops[idx]->debug_def().type(),
+          ") has failed.");
+      op_stats[idx].millis += timer.MilliSeconds();
+    }
+  }
+  // Reported per iteration, as the costs
+  for (auto& stats : op_stats) {
+    stats.millis /= iter;
+  }
+
+  // Sorted by name, so that reports of different builds line up
+  std::map<string, RooflineStats> type_stats;
+  RooflineStats total;
+  for (int idx = 0; idx < ops.size(); ++idx) {
+    const auto& def = ops[idx]->debug_def();
+    const string name = def.name().size()
+        ? def.name()
+        : (def.output_size() ? def.output(0) : "NO_OUTPUT");
+    LOG(INFO) << "Operator #" << idx << " (" << name << ", " << def.type()
+              << ") " << FormatStats(op_stats[idx]);
+    type_stats[def.type()].add(op_stats[idx]);
+    total.add(op_stats[idx]);
+  }
+  LOG(INFO) << "Per operator type:";
+  for (const auto& kv : type_stats) {
+    LOG(INFO) << kv.first << " x" << kv.second.count << ": "
+              << FormatStats(kv.second);
+  }
+  LOG(INFO) << "Total: " << FormatStats(total);
+
+  if (caffe2::FLAGS_report_json.empty()) {
+    return;
+  }
+  std::ofstream os(caffe2::FLAGS_report_json);
+  CAFFE_ENFORCE(os, "Cannot open ", caffe2::FLAGS_report_json);
+  os << "{\n  \"net\": " << JsonString(net->Name())
+     << ",\n  \"iterations\": " << iter
+     << ",\n  \"peak_gflops\": " << caffe2::FLAGS_peak_gflops
+     << ",\n  \"peak_gbps\": " << caffe2::FLAGS_peak_gbps
+     << ",\n  \"operators\": [";
+  for (int idx = 0; idx < ops.size(); ++idx) {
+    const auto& def = ops[idx]->debug_def();
+    os << (idx ? ",\n" : "\n") << "    {\"index\": " << idx
+       << ", \"name\": " << JsonString(def.name())
+       << ", \"type\": " << JsonString(def.type()) << ", \"output\": "
+       << JsonString(def.output_size() ? def.output(0) : "") << ", ";
+    WriteJsonStats(os, op_stats[idx]);
+    os << "}";
+  }
+  os << "\n  ],\n  \"operator_types\": {";
+  bool first = true;
+  for (const auto& kv : type_stats) {
+    os << (first ? "\n" : ",\n") << "    " << JsonString(kv.first) << ": {";
+    WriteJsonStats(os, kv.second);
+    os << "}";
+    first = false;
+  }
+  os << "\n  },\n  \"total\": {";
+  WriteJsonStats(os, total);
+  os << "}\n}\n";
+  LOG(INFO) << "Wrote the roofline report to " << caffe2::FLAGS_report_json;
+}
+
+} // namespace
+
 int main(int argc, char** argv) {
   caffe2::GlobalInit(&argc, &argv);
   unique_ptr<caffe2::Workspace> workspace(new caffe2::Workspace());
@@ -145,6 +362,9 @@ int main(int argc, char** argv) {
   CHECK_NOTNULL(net);
   net->TEST_Benchmark(
       caffe2::FLAGS_warmup, caffe2::FLAGS_iter, caffe2::FLAGS_run_individual);
+  if (caffe2::FLAGS_roofline) {
+    RunRoofline(net, caffe2::FLAGS_iter);
+  }
 
   string output_prefix = caffe2::FLAGS_output_folder.size()
       ? caffe2::FLAGS_output_folder + "/"
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cost of recording stats, meant to stay in the tens of nanoseconds so that
+// they can be used on hot paths.
+
+#include "benchmark/benchmark.h"
+
+#include "caffe2/core/stats.h"
+
+using namespace caffe2;
+
+namespace {
+
+struct BenchmarkStats {
+  CAFFE_STAT_CTOR(BenchmarkStats);
+  CAFFE_EXPORTED_STAT(counter);
+  CAFFE_AVG_EXPORTED_STAT(average);
+  CAFFE_HISTOGRAM_EXPORTED_STAT(histogram);
+};
+
+BenchmarkStats& stats() {
+  static BenchmarkStats stats("stats_benchmark");
+  return stats;
+}
+
+} // namespace
+
+static void BM_ExportedStat(benchmark::State& state) {
+  auto& s = stats();
+  int64_t value = 0;
+  while (state.KeepRunning()) {
+    CAFFE_EVENT(s, counter, ++value);
+  }
+}
+BENCHMARK(BM_ExportedStat)->ThreadRange(1, 8);
+
+static void BM_AvgExportedStat(benchmark::State& state) {
+  auto& s = stats();
+  int64_t value = 0;
+  while (state.KeepRunning()) {
+    CAFFE_EVENT(s, average, ++value);
+  }
+}
+BENCHMARK(BM_AvgExportedStat)->ThreadRange(1, 8);
+
+// Values spread over many buckets, as latencies would be
+static void BM_HistogramExportedStat(benchmark::State& state) {
+  auto& s = stats();
+  uint64_t value = 1;
+  while (state.KeepRunning()) {
+    value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+    CAFFE_EVENT(s, histogram, value >> 40);
+  }
+}
+BENCHMARK(BM_HistogramExportedStat)->ThreadRange(1, 8);
+
+static void BM_HistogramDuration(benchmark::State& state) {
+  auto& s = stats();
+  while (state.KeepRunning()) {
+    CAFFE_DURATION(s, histogram) {
+      benchmark::ClobberMemory();
+    }
+  }
+}
+BENCHMARK(BM_HistogramDuration);
+
+static void BM_HistogramPublish(benchmark::State& state) {
+  StatRegistry registry;
+  for (int i = 0; i < state.range(0); ++i) {
+    auto* histogram = registry.addHistogram(std::to_string(i));
+    for (int64_t v = 1; v < 1000000; v *= 3) {
+      histogram->record(v);
+    }
+  }
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(registry.publish());
+  }
+}
+BENCHMARK(BM_HistogramPublish)->Range(1, 64);
+
+BENCHMARK_MAIN();
@@ -20,6 +20,7 @@
 #include <unordered_map>
 
 #include "caffe2/core/logging.h"
+#include "caffe2/core/numa.h"
 
 CAFFE2_DECLARE_bool(caffe2_report_cpu_memory_usage);
 CAFFE2_DECLARE_bool(caffe2_cpu_allocator_do_zero_fill);
@@ -29,6 +30,10 @@ namespace caffe2 {
 // Use 32-byte alignment should be enough for computation up to AVX512.
 constexpr size_t gCaffe2Alignment = 32;
 
+// Allocations of at least that many bytes are placed on the NUMA node of the
+// allocating thread when NUMA is enabled.
+constexpr size_t gCaffe2NUMAMoveMinBytes = 1 << 20;
+
 using MemoryDeleter = void (*)(void*);
 
 // A helper function that is basically doing nothing.
@@ -66,7 +71,21 @@ struct DefaultCPUAllocator final : CPUAllocator {
 #elif defined(_MSC_VER)
     data = _aligned_malloc(nbytes, gCaffe2Alignment);
 #else
-    CAFFE_ENFORCE_EQ(posix_memalign(&data, gCaffe2Alignment, nbytes), 0);
+    // Large allocations get whole pages when NUMA is enabled, so that placing
+    // them does not move other allocations sharing their pages along.
+    const size_t page_size =
+        nbytes >= gCaffe2NUMAMoveMinBytes ? GetNUMAPageSize() : 0;
+    if (page_size > 0) {
+      const size_t size = (nbytes + page_size - 1) / page_size * page_size;
+      CAFFE_ENFORCE_EQ(posix_memalign(&data, page_size, size), 0);
+      CAFFE_ENFORCE(data);
+      // Place the memory on the NUMA node of the allocating thread before it
+      // is first touched, even if malloc recycles pages touched elsewhere.
+      // This is best effort: the memory stays where it is if it fails.
+      TryNUMAMove(data, size, GetCurrentNUMANode());
+    } else {
+      CAFFE_ENFORCE_EQ(posix_memalign(&data, gCaffe2Alignment, nbytes), 0);
+    }
 #endif
     CAFFE_ENFORCE(data);
     if (FLAGS_caffe2_cpu_allocator_do_zero_fill) {
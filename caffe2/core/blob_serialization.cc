@@ -16,8 +16,19 @@
 
 #include "caffe2/core/blob_serialization.h"
 
+#include <cerrno>
+#include <cstring>
+#include <fstream>
 #include <sstream>
 #include <mutex>
+#include <unordered_set>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "caffe2/core/blob.h"
 #include "caffe2/utils/proto_utils.h"
@@ -32,6 +43,11 @@ CAFFE2_DEFINE_int(
     16,
     "Maximal number of threads that can be used for tensor serialization");
 
+CAFFE2_DEFINE_int(
+    caffe2_max_tensor_deserializer_threads,
+    16,
+    "Maximal number of threads that can be used for tensor deserialization");
+
 CAFFE2_DEFINE_bool(
     caffe2_serialize_fp16_as_bytes,
     false,
@@ -143,6 +159,242 @@ void Blob::Deserialize(const BlobProto& blob_proto) {
   }
 }
 
+namespace {
+
+// Whether `blob` is stored raw in model containers
+bool isRawTensor(const Blob& blob) {
+  if (!blob.IsType<TensorCPU>()) {
+    return false;
+  }
+  const auto& tensor = blob.Get<TensorCPU>();
+  switch (TypeMetaToDataType(tensor.meta())) {
+    case TensorProto_DataType_STRING:
+    case TensorProto_DataType_UNDEFINED:
+      return false;
+    default:
+      return tensor.size() == 0 || tensor.raw_data();
+  }
+}
+
+// Private mapping of a whole file, unmapped when the last tensor aliasing it
+// is gone
+class MappedFile {
+ public:
+  explicit MappedFile(const string& filename) {
+#ifndef _MSC_VER
+    int fd = open(filename.c_str(), O_RDONLY);
+    CAFFE_ENFORCE(fd >= 0, "Cannot open ", filename, ": ", strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      CAFFE_THROW("Cannot stat ", filename, ": ", strerror(errno));
+    }
+    size_ = st.st_size;
+    if (size_ < kModelContainerHeaderSize) {
+      close(fd);
+      CAFFE_THROW(filename, " is not a model container: too small");
+    }
+    // Writable so that the tensors aliasing it can be modified, but private
+    // so that the file is not
+    data_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    CAFFE_ENFORCE(
+        data_ != MAP_FAILED, "Cannot map ", filename, ": ", strerror(errno));
+#else
+    CAFFE_THROW("Model containers are not supported on this platform");
+#endif
+  }
+
+  ~MappedFile() {
+#ifndef _MSC_VER
+    munmap(data_, size_);
+#endif
+  }
+
+  char* data() const {
+    return static_cast<char*>(data_);
+  }
+  int64_t size() const {
+    return size_;
+  }
+
+ private:
+  void* data_ = nullptr;
+  int64_t size_ = 0;
+
+  DISABLE_COPY_AND_ASSIGN(MappedFile);
+};
+
+} // namespace
+
+void SaveModelContainer(
+    const string& filename,
+    const vector<string>& names,
+    const vector<const Blob*>& blobs) {
+  CAFFE_ENFORCE_EQ(names.size(), blobs.size());
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  CAFFE_ENFORCE(out, "Cannot open ", filename, " for writing");
+
+  int64_t offset = 0;
+  // Appends `size` bytes at the next multiple of `alignment`, returning
+  // their offset
+  auto append = [&](const void* data, int64_t size, int64_t alignment) {
+    const int64_t padding = (alignment - offset % alignment) % alignment;
+    const std::string zeros(padding, '\0');
+    out.write(zeros.data(), padding);
+    offset += padding;
+    out.write(static_cast<const char*>(data), size);
+    const auto begin = offset;
+    offset += size;
+    return begin;
+  };
+  const std::string header(kModelContainerHeaderSize, '\0');
+  append(header.data(), header.size(), 1);
+
+  ModelContainerProto index;
+  index.set_alignment(kModelContainerAlignment);
+  std::unordered_set<string> seen;
+  for (int i = 0; i < blobs.size(); ++i) {
+    CAFFE_ENFORCE(seen.insert(names[i]).second, "Duplicated blob ", names[i]);
+    auto* entry = index.add_entries();
+    entry->set_name(names[i]);
+    if (isRawTensor(*blobs[i])) {
+      const auto& tensor = blobs[i]->Get<TensorCPU>();
+      auto* proto = entry->mutable_tensor();
+      for (const auto dim : tensor.dims()) {
+        proto->add_dims(dim);
+      }
+      proto->set_data_type(TypeMetaToDataType(tensor.meta()));
+      entry->set_offset(append(
+          tensor.raw_data(), tensor.nbytes(), kModelContainerAlignment));
+      entry->set_size(tensor.nbytes());
+    } else {
+      const auto data = blobs[i]->Serialize(names[i]);
+      entry->set_offset(append(data.data(), data.size(), 1));
+      entry->set_size(data.size());
+    }
+  }
+
+  const auto data = index.SerializeAsString();
+  const int64_t index_offset = append(data.data(), data.size(), 1);
+  const int64_t index_size = data.size();
+  out.seekp(0);
+  out.write(kModelContainerMagic, kModelContainerMagicSize);
+  out.write(reinterpret_cast<const char*>(&index_offset), sizeof(int64_t));
+  out.write(reinterpret_cast<const char*>(&index_size), sizeof(int64_t));
+  out.close();
+  CAFFE_ENFORCE(!out.fail(), "Failed to write ", filename);
+}
+
+int LoadModelContainer(
+    const string& filename,
+    std::function<Blob*(const string&)> getBlob) {
+  auto file = std::make_shared<MappedFile>(filename);
+  const char* data = file->data();
+  CAFFE_ENFORCE(
+      memcmp(data, kModelContainerMagic, kModelContainerMagicSize) == 0,
+      filename,
+      " is not a model container");
+  int64_t index_offset, index_size;
+  memcpy(&index_offset, data + kModelContainerMagicSize, sizeof(int64_t));
+  memcpy(
+      &index_size,
+      data + kModelContainerMagicSize + sizeof(int64_t),
+      sizeof(int64_t));
+  auto enforceInFile = [&](int64_t offset, int64_t size) {
+    CAFFE_ENFORCE(
+        offset >= kModelContainerHeaderSize && size >= 0 &&
+            offset + size <= file->size(),
+        "Model container ",
+        filename,
+        " is truncated or corrupted");
+  };
+  enforceInFile(index_offset, index_size);
+  ModelContainerProto index;
+  CAFFE_ENFORCE(
+      index.ParseFromArray(data + index_offset, index_size),
+      "Cannot parse the index of model container ",
+      filename);
+
+  int loaded = 0;
+  std::vector<std::pair<const ModelContainerProto::Entry*, Blob*>> pending;
+  for (const auto& entry : index.entries()) {
+    Blob* blob = getBlob(entry.name());
+    if (!blob) {
+      continue;
+    }
+    enforceInFile(entry.offset(), entry.size());
+    ++loaded;
+    if (!entry.has_tensor()) {
+      pending.emplace_back(&entry, blob);
+      continue;
+    }
+
+    VLOG(2) << "Mapping blob " << entry.name();
+    blob->Reset();
+    auto* tensor = blob->GetMutable<TensorCPU>();
+    std::vector<TIndex> dims(
+        entry.tensor().dims().begin(), entry.tensor().dims().end());
+    tensor->Resize(dims);
+    const auto& meta = DataTypeToTypeMeta(entry.tensor().data_type());
+    CAFFE_ENFORCE_EQ(
+        tensor->size() * meta.itemsize(),
+        entry.size(),
+        "Size mismatch for blob ",
+        entry.name());
+    if (entry.size() == 0) {
+      tensor->raw_mutable_data(meta);
+      continue;
+    }
+    // The tensor keeps the file mapped
+    tensor->ShareExternalPointer(
+        file->data() + entry.offset(), meta, entry.size(), [file](void*) {});
+  }
+
+  auto deserialize = [&](size_t i) {
+    const auto& entry = *pending[i].first;
+    VLOG(2) << "Deserializing blob " << entry.name();
+    BlobProto proto;
+    CAFFE_ENFORCE(
+        proto.ParseFromArray(data + entry.offset(), entry.size()),
+        "Cannot parse blob ",
+        entry.name());
+    if (proto.has_tensor()) {
+      proto.mutable_tensor()->mutable_device_detail()->set_device_type(CPU);
+    }
+    pending[i].second->Reset();
+    pending[i].second->Deserialize(proto);
+  };
+#ifndef __ANDROID__
+  const int num_threads = std::min<int>(
+      FLAGS_caffe2_max_tensor_deserializer_threads, pending.size());
+  if (num_threads > 1) {
+    SimpleQueue<size_t> queue;
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < num_threads; ++i) {
+      futures.emplace_back(std::async(std::launch::async, [&]() {
+        size_t next;
+        while (queue.Pop(&next)) {
+          deserialize(next);
+        }
+      }));
+    }
+    for (size_t i = 0; i < pending.size(); ++i) {
+      queue.Push(i);
+    }
+    queue.NoMoreJobs();
+    for (auto& future : futures) {
+      future.get();
+    }
+    return loaded;
+  }
+#endif
+  for (size_t i = 0; i < pending.size(); ++i) {
+    deserialize(i);
+  }
+  return loaded;
+}
+
 namespace {
 // Serialize TensorCPU.
 REGISTER_BLOB_SERIALIZER(
@@ -31,6 +31,7 @@
 
 CAFFE2_DECLARE_int(caffe2_tensor_chunk_size);
 CAFFE2_DECLARE_int(caffe2_max_tensor_serializer_threads);
+CAFFE2_DECLARE_int(caffe2_max_tensor_deserializer_threads);
 CAFFE2_DECLARE_bool(caffe2_serialize_fp16_as_bytes);
 
 namespace caffe2 {
@@ -119,8 +120,50 @@ class TensorDeserializer : public BlobDeserializerBase {
  public:
   void Deserialize(const BlobProto& proto, Blob* blob) override;
   void Deserialize(const TensorProto& proto, Tensor<Context>* tensor);
+  // Deserializes the data of `proto` into `tensor`, which must already have
+  // the dims of `proto` and be allocated with its data type. The tensor
+  // itself is not modified, so the chunks of a tensor can be deserialized
+  // concurrently, except for the UNDEFINED data type whose items determine
+  // the type of the tensor.
+  void DeserializeChunk(const TensorProto& proto, Tensor<Context>* tensor);
 };
 
+/**
+ * Model containers store a set of blobs in a single file so that loading them
+ * takes time proportional to their metadata rather than to their data.
+ *
+ * CPU tensors of fixed-size types are stored raw, each aligned to
+ * kModelContainerAlignment, and are loaded by aliasing a private memory
+ * mapping of the file: their pages are shared through the page cache by all
+ * the processes loading the same file, and are only copied if written to.
+ * The other blobs are stored as serialized BlobProtos, and are deserialized
+ * in parallel.
+ *
+ * The file starts with a header made of kModelContainerMagic followed by the
+ * offset and size of the index, a ModelContainerProto stored after the blobs.
+ * Offsets and sizes are int64 in native byte order, like raw tensor data, so
+ * containers are not portable across byte orders.
+ */
+constexpr auto kModelContainerMagic = "C2MODEL1";
+constexpr size_t kModelContainerMagicSize = 8;
+constexpr int64_t kModelContainerHeaderSize =
+    kModelContainerMagicSize + 2 * sizeof(int64_t);
+constexpr int64_t kModelContainerAlignment = 4096;
+
+// Writes `blobs` to the model container `filename` under the given names.
+void SaveModelContainer(
+    const string& filename,
+    const vector<string>& names,
+    const vector<const Blob*>& blobs);
+
+// Loads the blobs of the model container `filename`. `getBlob` is called on
+// the name of each blob of the container, in order, and returns the blob to
+// load it into or nullptr to skip it. Tensors are loaded on CPU.
+// Returns the number of loaded blobs.
+int LoadModelContainer(
+    const string& filename,
+    std::function<Blob*(const string&)> getBlob);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementations
 ////////////////////////////////////////////////////////////////////////////////
@@ -442,15 +485,22 @@ template <class Context>
 void TensorDeserializer<Context>::Deserialize(
     const TensorProto& proto,
     Tensor<Context>* tensor) {
-  // We create a local context for deserializing. Since Caffe2 contexts are
-  // usually lightweighted, this should not involve too much overhead.
-  Context context(proto.device_detail());
-  context.SwitchToDevice(0);
   vector<TIndex> dims;
   for (const TIndex d : proto.dims()) {
     dims.push_back(d);
   }
   tensor->Resize(dims);
+  DeserializeChunk(proto, tensor);
+}
+
+template <class Context>
+void TensorDeserializer<Context>::DeserializeChunk(
+    const TensorProto& proto,
+    Tensor<Context>* tensor) {
+  // We create a local context for deserializing. Since Caffe2 contexts are
+  // usually lightweighted, this should not involve too much overhead.
+  Context context(proto.device_detail());
+  context.SwitchToDevice(0);
 
   int64_t chunkBegin = 0;
   auto chunkEnd = tensor->size();
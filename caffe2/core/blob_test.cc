@@ -36,6 +36,7 @@
 
 CAFFE2_DEFINE_int64(caffe2_test_big_tensor_size, 100000000, "");
 CAFFE2_DECLARE_int(caffe2_tensor_chunk_size);
+CAFFE2_DECLARE_int(caffe2_max_tensor_deserializer_threads);
 CAFFE2_DECLARE_bool(caffe2_serialize_fp16_as_bytes);
 
 namespace caffe2 {
@@ -1014,6 +1015,183 @@ TEST(CustomChunkSize, BigTensorSerialization) {
   EXPECT_EQ(counter, 1);
 }
 
+TEST(ParallelLoad, ChunkedTensors) {
+  const int kNumBlobs = 4;
+  const int kSize = 1000;
+  string db_source = (string)std::tmpnam(nullptr);
+  StringMap data;
+  for (int b = 0; b < kNumBlobs; ++b) {
+    Blob blob;
+    auto* tensor = blob.GetMutable<TensorCPU>();
+    tensor->Resize(kSize / 10, 10);
+    for (int i = 0; i < kSize; ++i) {
+      tensor->mutable_data<int>()[i] = b * kSize + i;
+    }
+    std::mutex mutex;
+    blob.Serialize(
+        MakeString("blob", b),
+        [&](const std::string& key, const std::string& value) {
+          std::lock_guard<std::mutex> guard(mutex);
+          data.emplace_back(key, value);
+        },
+        7 /* chunk_size */);
+  }
+  // Interleaves the chunks of the blobs
+  std::random_shuffle(data.begin(), data.end());
+
+  vector<string> outputs;
+  for (int b = 0; b < kNumBlobs; ++b) {
+    outputs.push_back(MakeString("blob", b));
+  }
+  auto load = [&](const StringMap& records, Workspace* ws) {
+    VectorDB::registerData(db_source, StringMap(records));
+    return ws->RunOperatorOnce(CreateOperatorDef(
+        "Load",
+        "",
+        vector<string>{},
+        outputs,
+        vector<Argument>{MakeArgument<string>("db_type", "vector_db"),
+                         MakeArgument<string>("db", db_source),
+                         MakeArgument<bool>("absolute_path", true)}));
+  };
+  const int threads = FLAGS_caffe2_max_tensor_deserializer_threads;
+  for (int num_threads : {1, 8}) {
+    FLAGS_caffe2_max_tensor_deserializer_threads = num_threads;
+    Workspace ws;
+    ASSERT_TRUE(load(data, &ws));
+    for (int b = 0; b < kNumBlobs; ++b) {
+      const auto& tensor = ws.GetBlob(outputs[b])->Get<TensorCPU>();
+      EXPECT_EQ(tensor.dims(), vector<TIndex>({kSize / 10, 10}));
+      for (int i = 0; i < kSize; ++i) {
+        EXPECT_EQ(tensor.data<int>()[i], b * kSize + i);
+      }
+    }
+    // Missing its last chunk
+    StringMap incomplete(data.begin(), data.end() - 1);
+    EXPECT_THROW(load(incomplete, &ws), EnforceNotMet);
+  }
+  FLAGS_caffe2_max_tensor_deserializer_threads = threads;
+}
+
+TEST(ModelContainer, SaveAndLoad) {
+  string filename = (string)std::tmpnam(nullptr);
+  {
+    Workspace ws;
+    auto* weights = ws.CreateBlob("weights")->GetMutable<TensorCPU>();
+    weights->Resize(3, 1000);
+    for (int i = 0; i < weights->size(); ++i) {
+      weights->mutable_data<float>()[i] = i;
+    }
+    auto* ids = ws.CreateBlob("ids")->GetMutable<TensorCPU>();
+    ids->Resize(5);
+    for (int i = 0; i < ids->size(); ++i) {
+      ids->mutable_data<int64_t>()[i] = i * 1000000000000LL;
+    }
+    auto* empty = ws.CreateBlob("empty")->GetMutable<TensorCPU>();
+    empty->Resize(0, 4);
+    empty->mutable_data<float>();
+    auto* strings = ws.CreateBlob("strings")->GetMutable<TensorCPU>();
+    strings->Resize(2);
+    strings->mutable_data<string>()[0] = "foo";
+    strings->mutable_data<string>()[1] = "bar";
+    vector<string> names{"weights", "ids", "empty", "strings"};
+    for (int i = 0; i < 8; ++i) {
+      names.push_back(MakeString("string", i));
+      *ws.CreateBlob(names.back())->GetMutable<string>() = names.back();
+    }
+    vector<const Blob*> blobs;
+    for (const auto& name : names) {
+      blobs.push_back(ws.GetBlob(name));
+    }
+    SaveModelContainer(filename, names, blobs);
+  }
+
+  Workspace ws;
+  auto getBlob = [&](const string& name) {
+    return name == "skipped" ? nullptr : ws.CreateBlob(name);
+  };
+  EXPECT_EQ(LoadModelContainer(filename, getBlob), 12);
+  auto* weights = ws.GetBlob("weights")->GetMutable<TensorCPU>();
+  EXPECT_EQ(weights->dims(), vector<TIndex>({3, 1000}));
+  // Aliases the page-aligned data in the file
+  EXPECT_EQ(
+      reinterpret_cast<uintptr_t>(weights->raw_data()) %
+          kModelContainerAlignment,
+      0);
+  for (int i = 0; i < weights->size(); ++i) {
+    EXPECT_EQ(weights->data<float>()[i], i);
+  }
+  const auto& ids = ws.GetBlob("ids")->Get<TensorCPU>();
+  EXPECT_EQ(ids.data<int64_t>()[4], 4000000000000LL);
+  const auto& empty = ws.GetBlob("empty")->Get<TensorCPU>();
+  EXPECT_EQ(empty.dims(), vector<TIndex>({0, 4}));
+  EXPECT_TRUE(empty.IsType<float>());
+  const auto& strings = ws.GetBlob("strings")->Get<TensorCPU>();
+  EXPECT_EQ(strings.data<string>()[1], "bar");
+  for (int i = 0; i < 8; ++i) {
+    auto name = MakeString("string", i);
+    EXPECT_EQ(ws.GetBlob(name)->Get<string>(), name);
+  }
+
+  // Writes are private to the loaded tensor
+  weights->mutable_data<float>()[0] = -1;
+  Workspace other;
+  LoadModelContainer(
+      filename, [&](const string& name) { return other.CreateBlob(name); });
+  EXPECT_EQ(other.GetBlob("weights")->Get<TensorCPU>().data<float>()[0], 0);
+  std::remove(filename.c_str());
+  // The mapping outlives the file
+  EXPECT_EQ(weights->data<float>()[1], 1);
+}
+
+TEST(ModelContainer, LoadOperator) {
+  string filename = (string)std::tmpnam(nullptr);
+  Workspace ws;
+  for (const string name : {"a", "b"}) {
+    auto* tensor = ws.CreateBlob(name)->GetMutable<TensorCPU>();
+    tensor->Resize(2);
+    tensor->mutable_data<int>()[0] = name[0];
+  }
+  Argument db_arg = MakeArgument<string>("db", filename);
+  Argument absolute_path_arg = MakeArgument<bool>("absolute_path", true);
+  ASSERT_TRUE(ws.RunOperatorOnce(CreateOperatorDef(
+      "SaveModelContainer",
+      "",
+      vector<string>{"a", "b"},
+      vector<string>{},
+      vector<Argument>{db_arg, absolute_path_arg})));
+
+  Workspace loaded;
+  ASSERT_TRUE(loaded.RunOperatorOnce(CreateOperatorDef(
+      "LoadModelContainer",
+      "",
+      vector<string>{},
+      vector<string>{"b"},
+      vector<Argument>{db_arg, absolute_path_arg})));
+  EXPECT_FALSE(loaded.HasBlob("a"));
+  EXPECT_EQ(loaded.GetBlob("b")->Get<TensorCPU>().data<int>()[0], 'b');
+
+  EXPECT_THROW(
+      loaded.RunOperatorOnce(CreateOperatorDef(
+          "LoadModelContainer",
+          "",
+          vector<string>{},
+          vector<string>{"b", "c"},
+          vector<Argument>{db_arg, absolute_path_arg})),
+      EnforceNotMet);
+
+  std::ofstream(filename, std::ios::trunc) << "not a model container";
+  EXPECT_THROW(
+      loaded.RunOperatorOnce(CreateOperatorDef(
+          "LoadModelContainer",
+          "",
+          vector<string>{},
+          vector<string>{"b"},
+          vector<Argument>{db_arg, absolute_path_arg})),
+      EnforceNotMet);
+  std::remove(filename.c_str());
+}
+
 TEST(QTensor, QTensorSizingTest) {
   vector<int> dims(3);
   dims[0] = 2;
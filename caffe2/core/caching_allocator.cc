@@ -0,0 +1,371 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/caching_allocator.h"
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/stats.h"
+
+CAFFE2_DEFINE_bool(
+    caffe2_cpu_allocator_caching,
+    false,
+    "If set, install the caching CPU allocator during caffe2 init.");
+CAFFE2_DEFINE_int64(
+    caffe2_caching_cpu_allocator_max_block_bytes,
+    64 << 20,
+    "Allocations larger than this bypass the caching CPU allocator.");
+CAFFE2_DEFINE_int64(
+    caffe2_caching_cpu_allocator_max_cached_bytes,
+    256 << 20,
+    "Cap on the bytes held by the global pool of the caching CPU allocator. "
+    "The largest cached blocks are released when the cap is exceeded.");
+CAFFE2_DEFINE_int64(
+    caffe2_caching_cpu_allocator_thread_cache_bytes,
+    4 << 20,
+    "Cap on the bytes held by each thread's free lists in the caching CPU "
+    "allocator. Blocks freed beyond that go to the global pool.");
+
+namespace caffe2 {
+
+namespace {
+
+// Every block starts with a header that records its size class, so that the
+// (context-free) deleter knows where to put the block back. The header takes
+// a full alignment unit so that the returned pointer stays aligned.
+constexpr size_t kHeaderBytes = gCaffe2Alignment;
+constexpr int kMinShift = 6;
+constexpr int kClassesPerPowerOfTwo = 4;
+constexpr int32_t kUncached = -1;
+
+struct BlockHeader {
+  int32_t size_class;
+  size_t nbytes;
+};
+static_assert(
+    sizeof(BlockHeader) <= kHeaderBytes,
+    "BlockHeader must fit in the alignment padding.");
+
+int FloorLog2(size_t n) {
+  int r = 0;
+  while (n >>= 1) {
+    ++r;
+  }
+  return r;
+}
+
+// Size classes are 64 bytes, then four evenly spaced classes per power of two
+// above that: 80, 96, 112, 128, 160, 192, 224, 256, 320, ...
+int SizeClassOf(size_t total) {
+  if (total <= (size_t(1) << kMinShift)) {
+    return 0;
+  }
+  const int shift = FloorLog2(total - 1);
+  const size_t base = size_t(1) << shift;
+  const size_t step = base / kClassesPerPowerOfTwo;
+  const int index = static_cast<int>((total - base + step - 1) / step);
+  return (shift - kMinShift) * kClassesPerPowerOfTwo + index;
+}
+
+size_t SizeClassBytes(int size_class) {
+  if (size_class == 0) {
+    return size_t(1) << kMinShift;
+  }
+  const int shift = (size_class - 1) / kClassesPerPowerOfTwo + kMinShift;
+  const int index = (size_class - 1) % kClassesPerPowerOfTwo + 1;
+  const size_t base = size_t(1) << shift;
+  return base + index * (base / kClassesPerPowerOfTwo);
+}
+
+void* AlignedAlloc(size_t nbytes) {
+  void* data = nullptr;
+#ifdef __ANDROID__
+  data = memalign(gCaffe2Alignment, nbytes);
+#elif defined(_MSC_VER)
+  data = _aligned_malloc(nbytes, gCaffe2Alignment);
+#else
+  CAFFE_ENFORCE_EQ(posix_memalign(&data, gCaffe2Alignment, nbytes), 0);
+#endif
+  CAFFE_ENFORCE(data);
+  return data;
+}
+
+void AlignedFree(void* data) {
+#ifdef _MSC_VER
+  _aligned_free(data);
+#else
+  free(data);
+#endif
+}
+
+struct CachingAllocatorStats {
+  CAFFE_STAT_CTOR(CachingAllocatorStats);
+  CAFFE_EXPORTED_STAT(hits);
+  CAFFE_EXPORTED_STAT(misses);
+  CAFFE_EXPORTED_STAT(oversize);
+  CAFFE_EXPORTED_STAT(cached_bytes);
+  CAFFE_EXPORTED_STAT(trimmed_bytes);
+  CAFFE_EXPORTED_STAT(fragmentation_bytes);
+};
+
+class GlobalPool {
+ public:
+  // Intentionally leaked: blocks may be freed by static or thread-local
+  // destructors that run after a function-local static would be gone.
+  static GlobalPool& get() {
+    static GlobalPool* pool = new GlobalPool();
+    return *pool;
+  }
+
+  int numClasses() const {
+    return num_classes_;
+  }
+
+  CachingAllocatorStats& stats() {
+    return stats_;
+  }
+
+  void* pop(int size_class) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& list = free_lists_[size_class];
+    if (list.empty()) {
+      return nullptr;
+    }
+    void* block = list.back();
+    list.pop_back();
+    releaseAccounting(SizeClassBytes(size_class));
+    return block;
+  }
+
+  void push(int size_class, void* block) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    free_lists_[size_class].push_back(block);
+    const size_t nbytes = SizeClassBytes(size_class);
+    cached_bytes_ += nbytes;
+    CAFFE_EVENT(stats_, cached_bytes, nbytes);
+    trimLocked(FLAGS_caffe2_caching_cpu_allocator_max_cached_bytes);
+  }
+
+  // Moves every block of the given free lists into the pool.
+  void absorb(std::vector<std::vector<void*>>& lists) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (size_t c = 0; c < lists.size(); ++c) {
+      const size_t nbytes = SizeClassBytes(c) * lists[c].size();
+      free_lists_[c].insert(
+          free_lists_[c].end(), lists[c].begin(), lists[c].end());
+      lists[c].clear();
+      cached_bytes_ += nbytes;
+      CAFFE_EVENT(stats_, cached_bytes, nbytes);
+    }
+    trimLocked(FLAGS_caffe2_caching_cpu_allocator_max_cached_bytes);
+  }
+
+  void trim(size_t cap) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    trimLocked(cap);
+  }
+
+  size_t cachedBytes() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return cached_bytes_;
+  }
+
+ private:
+  GlobalPool()
+      : num_classes_(
+            SizeClassOf(
+                FLAGS_caffe2_caching_cpu_allocator_max_block_bytes +
+                kHeaderBytes) +
+            1),
+        free_lists_(num_classes_),
+        stats_("caching_cpu_allocator") {}
+
+  void releaseAccounting(size_t nbytes) {
+    cached_bytes_ -= nbytes;
+    CAFFE_EVENT(stats_, cached_bytes, -static_cast<int64_t>(nbytes));
+  }
+
+  // Releases the largest blocks first: they are the least likely to be
+  // reused and free up the most memory per system call.
+  void trimLocked(size_t cap) {
+    for (int c = num_classes_ - 1; c >= 0 && cached_bytes_ > cap; --c) {
+      auto& list = free_lists_[c];
+      const size_t nbytes = SizeClassBytes(c);
+      while (!list.empty() && cached_bytes_ > cap) {
+        AlignedFree(list.back());
+        list.pop_back();
+        releaseAccounting(nbytes);
+        CAFFE_EVENT(stats_, trimmed_bytes, nbytes);
+      }
+    }
+  }
+
+  const int num_classes_;
+  std::mutex mutex_;
+  std::vector<std::vector<void*>> free_lists_;
+  size_t cached_bytes_{0};
+  CachingAllocatorStats stats_;
+};
+
+struct ThreadCache {
+  explicit ThreadCache(int num_classes) : free_lists(num_classes) {}
+  std::vector<std::vector<void*>> free_lists;
+  size_t cached_bytes{0};
+};
+
+// The cache itself is reached through a trivially destructible pointer, so
+// that frees issued by other thread-local destructors after the cache has
+// been flushed fall through to the global pool instead of touching a
+// destroyed object.
+thread_local ThreadCache* t_cache = nullptr;
+thread_local bool t_cache_destroyed = false;
+
+struct ThreadCacheHolder {
+  std::unique_ptr<ThreadCache> cache;
+  ~ThreadCacheHolder() {
+    if (cache) {
+      GlobalPool::get().absorb(cache->free_lists);
+    }
+    t_cache = nullptr;
+    t_cache_destroyed = true;
+  }
+};
+thread_local ThreadCacheHolder t_cache_holder;
+
+ThreadCache* LocalCache() {
+  if (t_cache || t_cache_destroyed) {
+    return t_cache;
+  }
+  t_cache_holder.cache.reset(new ThreadCache(GlobalPool::get().numClasses()));
+  t_cache = t_cache_holder.cache.get();
+  return t_cache;
+}
+
+} // namespace
+
+std::pair<void*, MemoryDeleter> CachingCPUAllocator::New(size_t nbytes) {
+  auto& pool = GlobalPool::get();
+  const size_t total = nbytes + kHeaderBytes;
+  int size_class = kUncached;
+  void* block = nullptr;
+  if (nbytes <=
+      static_cast<size_t>(FLAGS_caffe2_caching_cpu_allocator_max_block_bytes)) {
+    size_class = SizeClassOf(total);
+  }
+  if (size_class == kUncached || size_class >= pool.numClasses()) {
+    size_class = kUncached;
+    block = AlignedAlloc(total);
+    CAFFE_EVENT(pool.stats(), oversize);
+  } else {
+    const size_t block_bytes = SizeClassBytes(size_class);
+    ThreadCache* cache = LocalCache();
+    if (cache && !cache->free_lists[size_class].empty()) {
+      block = cache->free_lists[size_class].back();
+      cache->free_lists[size_class].pop_back();
+      cache->cached_bytes -= block_bytes;
+    } else {
+      block = pool.pop(size_class);
+    }
+    if (block) {
+      CAFFE_EVENT(pool.stats(), hits);
+    } else {
+      block = AlignedAlloc(block_bytes);
+      CAFFE_EVENT(pool.stats(), misses);
+    }
+    CAFFE_EVENT(pool.stats(), fragmentation_bytes, block_bytes - total);
+  }
+  auto* header = static_cast<BlockHeader*>(block);
+  header->size_class = size_class;
+  header->nbytes = nbytes;
+  void* data = static_cast<char*>(block) + kHeaderBytes;
+  if (FLAGS_caffe2_cpu_allocator_do_zero_fill) {
+    memset(data, 0, nbytes);
+  }
+  return {data, Delete};
+}
+
+void CachingCPUAllocator::Delete(void* data) {
+  if (!data) {
+    return;
+  }
+  void* block = static_cast<char*>(data) - kHeaderBytes;
+  const auto* header = static_cast<const BlockHeader*>(block);
+  const int size_class = header->size_class;
+  if (size_class == kUncached) {
+    AlignedFree(block);
+    return;
+  }
+  auto& pool = GlobalPool::get();
+  const size_t block_bytes = SizeClassBytes(size_class);
+  CAFFE_EVENT(
+      pool.stats(),
+      fragmentation_bytes,
+      -static_cast<int64_t>(block_bytes - header->nbytes - kHeaderBytes));
+  ThreadCache* cache = LocalCache();
+  if (cache &&
+      cache->cached_bytes + block_bytes <=
+          static_cast<size_t>(
+              FLAGS_caffe2_caching_cpu_allocator_thread_cache_bytes)) {
+    cache->free_lists[size_class].push_back(block);
+    cache->cached_bytes += block_bytes;
+    return;
+  }
+  pool.push(size_class, block);
+}
+
+void CachingCPUAllocator::Trim() {
+  auto& pool = GlobalPool::get();
+  ThreadCache* cache = LocalCache();
+  if (cache) {
+    pool.absorb(cache->free_lists);
+    cache->cached_bytes = 0;
+  }
+  pool.trim(0);
+}
+
+size_t CachingCPUAllocator::CachedBytes() {
+  return GlobalPool::get().cachedBytes();
+}
+
+size_t CachingCPUAllocator::RoundedSize(size_t nbytes) {
+  if (nbytes >
+      static_cast<size_t>(FLAGS_caffe2_caching_cpu_allocator_max_block_bytes)) {
+    return 0;
+  }
+  const int size_class = SizeClassOf(nbytes + kHeaderBytes);
+  if (size_class >= GlobalPool::get().numClasses()) {
+    return 0;
+  }
+  return SizeClassBytes(size_class);
+}
+
+bool Caffe2UseCachingCPUAllocator(int*, char***) {
+  if (FLAGS_caffe2_cpu_allocator_caching) {
+    VLOG(1) << "Caffe2: setting CPUAllocator to CachingCPUAllocator.";
+    SetCPUAllocator(new CachingCPUAllocator());
+  }
+  return true;
+}
+REGISTER_CAFFE2_INIT_FUNCTION(
+    Caffe2UseCachingCPUAllocator,
+    &Caffe2UseCachingCPUAllocator,
+    "Install the caching CPU allocator if requested.");
+
+} // namespace caffe2
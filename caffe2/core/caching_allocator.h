@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_CORE_CACHING_ALLOCATOR_H_
+#define CAFFE2_CORE_CACHING_ALLOCATOR_H_
+
+#include "caffe2/core/allocator.h"
+#include "caffe2/core/flags.h"
+
+CAFFE2_DECLARE_bool(caffe2_cpu_allocator_caching);
+CAFFE2_DECLARE_int64(caffe2_caching_cpu_allocator_max_block_bytes);
+CAFFE2_DECLARE_int64(caffe2_caching_cpu_allocator_max_cached_bytes);
+CAFFE2_DECLARE_int64(caffe2_caching_cpu_allocator_thread_cache_bytes);
+
+namespace caffe2 {
+
+/**
+ * @brief A CPUAllocator that recycles freed blocks instead of returning them
+ * to the system allocator.
+ *
+ * Requests are rounded up to one of a set of size classes (four classes per
+ * power of two, starting at 64 bytes). Freed blocks go to a small per-thread
+ * free list first, and overflow into a global pool shared by all threads.
+ * Whenever the global pool holds more than
+ * FLAGS_caffe2_caching_cpu_allocator_max_cached_bytes, the largest cached
+ * blocks are released until it is back under the cap. Requests larger than
+ * FLAGS_caffe2_caching_cpu_allocator_max_block_bytes bypass the cache.
+ *
+ * The cache state is process-wide, so blocks handed out by one instance can
+ * safely outlive it. The following counters are exported through the
+ * StatRegistry under the "caching_cpu_allocator" group:
+ *   hits, misses, oversize      - allocation outcomes;
+ *   cached_bytes                - bytes held by the global pool;
+ *   trimmed_bytes               - bytes released because of the cap;
+ *   fragmentation_bytes         - bytes lost to size-class rounding in
+ *                                 blocks that are currently in use.
+ *
+ * Install it with SetCPUAllocator(new CachingCPUAllocator()), or by passing
+ * --caffe2_cpu_allocator_caching to GlobalInit.
+ */
+struct CachingCPUAllocator final : CPUAllocator {
+  CachingCPUAllocator() {}
+  ~CachingCPUAllocator() override {}
+  std::pair<void*, MemoryDeleter> New(size_t nbytes) override;
+  MemoryDeleter GetDeleter() override {
+    return Delete;
+  }
+
+  static void Delete(void* data);
+
+  // Releases every block held by the global pool and by the calling thread's
+  // free lists back to the system.
+  static void Trim();
+
+  // Number of bytes currently held by the global pool. Blocks sitting in
+  // per-thread free lists are not included.
+  static size_t CachedBytes();
+
+  // Number of bytes actually reserved for a request of nbytes, or 0 if the
+  // request bypasses the cache.
+  static size_t RoundedSize(size_t nbytes);
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_CORE_CACHING_ALLOCATOR_H_
@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/caching_allocator.h"
+#include "caffe2/core/stats.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+namespace {
+
+int64_t GetStat(const std::string& name) {
+  return toMap(StatRegistry::get().publish())["caching_cpu_allocator/" + name];
+}
+
+TEST(CachingCPUAllocatorTest, RoundsToSizeClasses) {
+  // Every block carries a 32-byte header.
+  EXPECT_EQ(CachingCPUAllocator::RoundedSize(1), 64);
+  EXPECT_EQ(CachingCPUAllocator::RoundedSize(32), 64);
+  EXPECT_EQ(CachingCPUAllocator::RoundedSize(33), 80);
+  EXPECT_EQ(CachingCPUAllocator::RoundedSize(96), 128);
+  EXPECT_EQ(CachingCPUAllocator::RoundedSize(97), 160);
+  EXPECT_EQ(CachingCPUAllocator::RoundedSize(1000), 1280);
+  for (size_t n = 1; n < (1 << 16); n += 7) {
+    size_t rounded = CachingCPUAllocator::RoundedSize(n);
+    EXPECT_GE(rounded, n + gCaffe2Alignment);
+    // At most 25% of the block is lost to rounding above the first classes.
+    if (n > 64) {
+      EXPECT_LE(rounded, (n + gCaffe2Alignment) * 5 / 4 + 1);
+    }
+  }
+  EXPECT_EQ(
+      CachingCPUAllocator::RoundedSize(
+          FLAGS_caffe2_caching_cpu_allocator_max_block_bytes + 1),
+      0);
+}
+
+TEST(CachingCPUAllocatorTest, ReusesFreedBlocks) {
+  CachingCPUAllocator allocator;
+  CachingCPUAllocator::Trim();
+  int64_t hits = GetStat("hits");
+  int64_t misses = GetStat("misses");
+  auto first = allocator.New(1000);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(first.first) % gCaffe2Alignment, 0);
+  first.second(first.first);
+  // A request in the same size class gets the same block back.
+  auto second = allocator.New(1010);
+  EXPECT_EQ(first.first, second.first);
+  second.second(second.first);
+  EXPECT_EQ(GetStat("misses") - misses, 1);
+  EXPECT_EQ(GetStat("hits") - hits, 1);
+}
+
+TEST(CachingCPUAllocatorTest, ZeroFillsReusedBlocks) {
+  CachingCPUAllocator allocator;
+  auto block = allocator.New(256);
+  memset(block.first, 0xff, 256);
+  block.second(block.first);
+  block = allocator.New(256);
+  for (int i = 0; i < 256; ++i) {
+    EXPECT_EQ(static_cast<char*>(block.first)[i], 0);
+  }
+  block.second(block.first);
+}
+
+TEST(CachingCPUAllocatorTest, OversizeBypassesCache) {
+  CachingCPUAllocator allocator;
+  int64_t oversize = GetStat("oversize");
+  auto block =
+      allocator.New(FLAGS_caffe2_caching_cpu_allocator_max_block_bytes + 1);
+  block.second(block.first);
+  EXPECT_EQ(GetStat("oversize") - oversize, 1);
+}
+
+TEST(CachingCPUAllocatorTest, TrimsGlobalPoolToCap) {
+  auto old_cap = FLAGS_caffe2_caching_cpu_allocator_max_cached_bytes;
+  auto old_thread_cap = FLAGS_caffe2_caching_cpu_allocator_thread_cache_bytes;
+  // Send everything to the global pool so that the cap applies right away.
+  FLAGS_caffe2_caching_cpu_allocator_thread_cache_bytes = 0;
+  FLAGS_caffe2_caching_cpu_allocator_max_cached_bytes = 1 << 16;
+  CachingCPUAllocator::Trim();
+
+  CachingCPUAllocator allocator;
+  std::vector<void*> blocks;
+  for (int i = 0; i < 64; ++i) {
+    blocks.push_back(allocator.New(4000).first);
+  }
+  int64_t trimmed = GetStat("trimmed_bytes");
+  for (void* ptr : blocks) {
+    CachingCPUAllocator::Delete(ptr);
+  }
+  EXPECT_LE(CachingCPUAllocator::CachedBytes(), 1 << 16);
+  EXPECT_GT(CachingCPUAllocator::CachedBytes(), 0);
+  EXPECT_GT(GetStat("trimmed_bytes") - trimmed, 0);
+
+  CachingCPUAllocator::Trim();
+  EXPECT_EQ(CachingCPUAllocator::CachedBytes(), 0);
+  FLAGS_caffe2_caching_cpu_allocator_max_cached_bytes = old_cap;
+  FLAGS_caffe2_caching_cpu_allocator_thread_cache_bytes = old_thread_cap;
+}
+
+TEST(CachingCPUAllocatorTest, CrossThreadFree) {
+  CachingCPUAllocator allocator;
+  std::vector<void*> blocks(1024);
+  std::thread producer([&]() {
+    for (auto& ptr : blocks) {
+      ptr = allocator.New(512).first;
+    }
+  });
+  producer.join();
+  std::vector<std::thread> consumers;
+  for (int t = 0; t < 4; ++t) {
+    consumers.emplace_back([&, t]() {
+      for (size_t i = t; i < blocks.size(); i += 4) {
+        CachingCPUAllocator::Delete(blocks[i]);
+      }
+      // Exiting threads hand their free lists back to the global pool.
+    });
+  }
+  for (auto& thread : consumers) {
+    thread.join();
+  }
+  EXPECT_GT(CachingCPUAllocator::CachedBytes(), 0);
+  CachingCPUAllocator::Trim();
+}
+
+} // namespace
+} // namespace caffe2
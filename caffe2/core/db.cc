@@ -93,6 +93,13 @@ class MiniDBCursor : public Cursor {
     return string(value_.data(), value_len_);
   }
 
+  ValueView value_view() override {
+    CAFFE_ENFORCE(valid_, "Cursor is at invalid location!");
+    return ValueView{value_.data(), static_cast<size_t>(value_len_)};
+  }
+
+  bool SupportsValueView() override { return true; }
+
   bool Valid() override { return valid_; }
 
  private:
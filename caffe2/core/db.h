@@ -17,6 +17,7 @@
 #ifndef CAFFE2_CORE_DB_H_
 #define CAFFE2_CORE_DB_H_
 
+#include <atomic>
 #include <mutex>
 
 #include "caffe2/core/blob_serialization.h"
@@ -32,6 +33,18 @@ namespace db {
  */
 enum Mode { READ, WRITE, NEW };
 
+/**
+ * A non-owning view of a value in the database, see Cursor::value_view().
+ */
+struct ValueView {
+  const char* data;
+  size_t size;
+
+  string ToString() const {
+    return string(data, size);
+  }
+};
+
 /**
  * An abstract class for the cursor of the database while reading.
  */
@@ -62,12 +75,37 @@ class Cursor {
    * Returns the current value.
    */
   virtual string value() = 0;
+  /**
+   * Returns a view of the current value, valid until the cursor moves. Dbs
+   * that can expose their own storage, like the pages of lmdb, return it
+   * without any copy, and SupportsValueView() returns true. By default, the
+   * value is copied into a buffer of the cursor.
+   */
+  virtual ValueView value_view() {
+    value_buffer_ = value();
+    return ValueView{value_buffer_.data(), value_buffer_.size()};
+  }
+  virtual bool SupportsValueView() { return false; }
+  /**
+   * For dbs whose values are serialized TensorProtos, like columndb, decodes
+   * the field-th TensorProto of the current value directly into a tensor,
+   * without building the TensorProtos. Returns false when the db cannot, and
+   * the value has to be parsed instead. NumFields() is then the number of
+   * TensorProtos in the values, and -1 for dbs that do not support it.
+   */
+  virtual bool ReadField(int /* field */, TensorCPU* /* tensor */) {
+    return false;
+  }
+  virtual int NumFields() { return -1; }
   /**
    * Returns whether the current location is valid - for example, if we have
    * reached the end of the database, return false.
    */
   virtual bool Valid() = 0;
 
+ private:
+  string value_buffer_;
+
   DISABLE_COPY_AND_ASSIGN(Cursor);
 };
 
@@ -174,21 +212,17 @@ class DBReader {
   explicit DBReader(const DBReaderProto& proto) {
     Open(proto.db_type(), proto.source());
     if (proto.has_key()) {
-      CAFFE_ENFORCE(cursor_->SupportsSeek(),
+      CAFFE_ENFORCE(cursors_[0]->cursor->SupportsSeek(),
           "Encountering a proto that needs seeking but the db type "
           "does not support it.");
-      cursor_->Seek(proto.key());
+      cursors_[0]->cursor->Seek(proto.key());
     }
-    num_shards_ = 1;
-    shard_id_ = 0;
   }
 
   explicit DBReader(std::unique_ptr<DB> db)
       : db_type_("<memory-type>"),
-        source_("<memory-source>"),
-        db_(std::move(db)) {
-    CAFFE_ENFORCE(db_.get(), "Passed null db");
-    cursor_ = db_->NewCursor();
+        source_("<memory-source>") {
+    Open(std::move(db));
   }
 
   void Open(
@@ -198,7 +232,7 @@ class DBReader {
       const int32_t shard_id = 0) {
     // Note(jiayq): resetting is needed when we re-open e.g. leveldb where no
     // concurrent access is allowed.
-    cursor_.reset();
+    cursors_.clear();
     db_.reset();
     db_type_ = db_type;
     source_ = source;
@@ -211,7 +245,7 @@ class DBReader {
       unique_ptr<DB>&& db,
       const int32_t num_shards = 1,
       const int32_t shard_id = 0) {
-    cursor_.reset();
+    cursors_.clear();
     db_.reset();
     db_ = std::move(db);
     CAFFE_ENFORCE(db_.get(), "Passed null db");
@@ -230,38 +264,145 @@ class DBReader {
    * the db. This function can be used to enable multiple input ops to read
    * the same db.
    *
+   * If the reader has several cursors (see SetNumCursors()), successive reads
+   * take them in turn.
+   *
    * Note(jiayq): we loosen the definition of a const function here a little
    * bit: the state of the cursor is actually changed. However, this allows
    * us to pass in a DBReader to an Operator without the need of a duplicated
    * output blob.
    */
   void Read(string* key, string* value) const {
-    CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
-    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
-    *key = cursor_->key();
-    *value = cursor_->value();
-
-    // In sharded mode, each read skips num_shards_ records
-    for (int s = 0; s < num_shards_; s++) {
-      cursor_->Next();
-      if (!cursor_->Valid()) {
-        MoveToBeginning();
-        break;
-      }
+    Read(key, value, NextCursorId());
+  }
+
+  /**
+   * Same as above, but reads from the given cursor.
+   */
+  void Read(string* key, string* value, int cursor_id) const {
+    ReaderCursor& reader_cursor = GetCursor(cursor_id);
+    std::unique_lock<std::mutex> mutex_lock(reader_cursor.mutex);
+    ReadAndAdvance(&reader_cursor, key, value);
+  }
+
+  /**
+   * Reads the next n sets of key and value, taking the lock once for all of
+   * them. Thread safe. The n records come from a single cursor, so they are
+   * consecutive records of the reader when it has only one.
+   */
+  void ReadMany(int n, vector<string>* keys, vector<string>* values) const {
+    ReadMany(n, keys, values, NextCursorId());
+  }
+
+  /**
+   * Same as above, but reads from the given cursor.
+   */
+  void ReadMany(
+      int n,
+      vector<string>* keys,
+      vector<string>* values,
+      int cursor_id) const {
+    CAFFE_ENFORCE_GE(n, 0);
+    keys->resize(n);
+    values->resize(n);
+    ReaderCursor& reader_cursor = GetCursor(cursor_id);
+    std::unique_lock<std::mutex> mutex_lock(reader_cursor.mutex);
+    for (int i = 0; i < n; ++i) {
+      ReadAndAdvance(&reader_cursor, &(*keys)[i], &(*values)[i]);
+    }
+  }
+
+  /**
+   * Reads the next n records like ReadMany(), but without copying their
+   * values out: f(i, value) is called on the i-th record with a view of its
+   * value, which is only valid during the call. Thread safe. f runs under the
+   * lock of the cursor, so it should be short, like parsing the value.
+   */
+  template <typename F>
+  void VisitMany(int n, F f) const {
+    VisitMany(n, f, NextCursorId());
+  }
+
+  /**
+   * Same as above, but reads from the given cursor.
+   */
+  template <typename F>
+  void VisitMany(int n, F f, int cursor_id) const {
+    CAFFE_ENFORCE_GE(n, 0);
+    ReaderCursor& reader_cursor = GetCursor(cursor_id);
+    std::unique_lock<std::mutex> mutex_lock(reader_cursor.mutex);
+    for (int i = 0; i < n; ++i) {
+      f(i, reader_cursor.cursor->value_view());
+      Advance(&reader_cursor);
     }
   }
 
+  /**
+   * Same as VisitMany(), but f(i, cursor) is given the cursor itself, on the
+   * i-th record, for instance to decode its fields with Cursor::ReadField().
+   */
+  template <typename F>
+  void VisitManyRecords(int n, F f) const {
+    CAFFE_ENFORCE_GE(n, 0);
+    ReaderCursor& reader_cursor = GetCursor(NextCursorId());
+    std::unique_lock<std::mutex> mutex_lock(reader_cursor.mutex);
+    for (int i = 0; i < n; ++i) {
+      f(i, reader_cursor.cursor.get());
+      Advance(&reader_cursor);
+    }
+  }
+
+  /**
+   * Splits the records of the reader among num_cursors cursors, each with
+   * its own lock, so that concurrent reads mostly do not wait for each other.
+   * Reads without a cursor id take the cursors in turn.
+   *
+   * On dbs that support Seek(), each cursor reads a contiguous range of the
+   * records of the reader, in key order, and seeks back to its first key at
+   * the end of its range; finding the ranges walks the keys of the db twice.
+   * Keys are assumed to be unique. Other dbs fall back to cursor c reading
+   * every num_cursors-th record of the reader, starting from its c-th one,
+   * which makes every cursor walk the whole db.
+   *
+   * The db must support several cursors at once, which minidb does not.
+   * This restarts reading from the head of the db, and is not thread safe.
+   */
+  void SetNumCursors(int num_cursors) {
+    CAFFE_ENFORCE(db_.get(), "Reader not initialized.");
+    CAFFE_ENFORCE_GE(num_cursors, 1);
+    cursors_.clear();
+    for (int c = 0; c < num_cursors; ++c) {
+      cursors_.emplace_back(new ReaderCursor());
+      cursors_.back()->cursor = db_->NewCursor();
+      cursors_.back()->first = shard_id_ + c * num_shards_;
+    }
+    stride_ = num_shards_ * num_cursors;
+    if (num_cursors > 1 && cursors_[0]->cursor->SupportsSeek()) {
+      SplitKeyRanges();
+      stride_ = num_shards_;
+    }
+    next_cursor_ = 0;
+    SeekToFirst();
+  }
+
+  int NumCursors() const {
+    return cursors_.size();
+  }
+
   /**
    * @brief Seeks to the first key. Thread safe.
    */
   void SeekToFirst() const {
-    CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
-    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
-    MoveToBeginning();
+    CAFFE_ENFORCE(!cursors_.empty(), "Reader not initialized.");
+    for (auto& reader_cursor : cursors_) {
+      std::unique_lock<std::mutex> mutex_lock(reader_cursor->mutex);
+      MoveToBeginning(reader_cursor.get());
+    }
   }
 
   /**
-   * Returns the underlying cursor of the db reader.
+   * Returns the underlying cursor of the db reader, or its first cursor if
+   * it has several.
    *
    * Note that if you directly use the cursor, the read will not be thread
    * safe, because there is no mechanism to stop multiple threads from
@@ -270,36 +411,140 @@ class DBReader {
   inline Cursor* cursor() const {
     LOG(ERROR) << "Usually for a DBReader you should use Read() to be "
                   "thread safe. Consider refactoring your code.";
-    return cursor_.get();
+    return cursors_.empty() ? nullptr : cursors_[0]->cursor.get();
   }
 
  private:
+  // A cursor reading every stride_-th record of the db, either from its
+  // first-th, or when size > 0, from the key begin for size reads.
+  struct ReaderCursor {
+    unique_ptr<Cursor> cursor;
+    std::mutex mutex;
+    uint32_t first;
+    string begin;
+    int64_t size = 0;
+    int64_t position = 0;
+  };
+
   void InitializeCursor(const int32_t num_shards, const int32_t shard_id) {
     CAFFE_ENFORCE(num_shards >= 1);
     CAFFE_ENFORCE(shard_id >= 0);
     CAFFE_ENFORCE(shard_id < num_shards);
     num_shards_ = num_shards;
     shard_id_ = shard_id;
-    cursor_ = db_->NewCursor();
-    SeekToFirst();
+    SetNumCursors(1);
+  }
+
+  int NextCursorId() const {
+    if (cursors_.size() <= 1) {
+      return 0;
+    }
+    return next_cursor_.fetch_add(1, std::memory_order_relaxed) %
+        cursors_.size();
+  }
+
+  ReaderCursor& GetCursor(int cursor_id) const {
+    CAFFE_ENFORCE(!cursors_.empty(), "Reader not initialized.");
+    return *cursors_[cursor_id % cursors_.size()];
+  }
+
+  // Must be called with the lock of the cursor held.
+  void ReadAndAdvance(ReaderCursor* reader_cursor, string* key, string* value)
+      const {
+    Cursor* cursor = reader_cursor->cursor.get();
+    *key = cursor->key();
+    if (cursor->SupportsValueView()) {
+      // Copying from the view reuses the memory the value already has.
+      const ValueView view = cursor->value_view();
+      value->assign(view.data, view.size);
+    } else {
+      *value = cursor->value();
+    }
+    Advance(reader_cursor);
+  }
+
+  // Gives each cursor a range of consecutive records of the shard of the
+  // reader, in key order. The first walk counts the records and finds the
+  // smallest key, since SeekToFirst() does not go in key order on all dbs.
+  void SplitKeyRanges() {
+    Cursor* cursor = cursors_[0]->cursor.get();
+    int64_t num_records = 0;
+    string smallest;
+    for (cursor->SeekToFirst(); cursor->Valid(); cursor->Next()) {
+      const string key = cursor->key();
+      if (num_records == 0 || key < smallest) {
+        smallest = key;
+      }
+      ++num_records;
+    }
+    const int64_t num_cursors = cursors_.size();
+    const int64_t shard_records =
+        (num_records - shard_id_ + num_shards_ - 1) / num_shards_;
+    CAFFE_ENFORCE_GE(
+        shard_records,
+        num_cursors,
+        "Db has less rows in shard ",
+        shard_id_,
+        " than cursors");
+    int64_t record = 0;
+    cursor->Seek(smallest);
+    for (int64_t c = 0; c < num_cursors; ++c) {
+      const int64_t begin = c * shard_records / num_cursors;
+      const int64_t end = (c + 1) * shard_records / num_cursors;
+      for (; record < shard_id_ + begin * num_shards_; ++record) {
+        cursor->Next();
+      }
+      CAFFE_ENFORCE(cursor->Valid());
+      cursors_[c]->begin = cursor->key();
+      cursors_[c]->size = end - begin;
+    }
+  }
+
+  // Must be called with the lock of the cursor held.
+  void Advance(ReaderCursor* reader_cursor) const {
+    Cursor* cursor = reader_cursor->cursor.get();
+    if (reader_cursor->size > 0 &&
+        ++reader_cursor->position == reader_cursor->size) {
+      MoveToBeginning(reader_cursor);
+      return;
+    }
+    // In sharded mode, and with several cursors, each read skips stride_
+    // records
+    for (int s = 0; s < stride_; s++) {
+      cursor->Next();
+      if (!cursor->Valid()) {
+        MoveToBeginning(reader_cursor);
+        break;
+      }
+    }
   }
 
-  void MoveToBeginning() const {
-    cursor_->SeekToFirst();
-    for (auto s = 0; s < shard_id_; s++) {
-      cursor_->Next();
+  void MoveToBeginning(ReaderCursor* reader_cursor) const {
+    Cursor* cursor = reader_cursor->cursor.get();
+    if (reader_cursor->size > 0) {
+      cursor->Seek(reader_cursor->begin);
+      reader_cursor->position = 0;
+      return;
+    }
+    cursor->SeekToFirst();
+    for (auto s = 0; s < reader_cursor->first; s++) {
+      cursor->Next();
       CAFFE_ENFORCE(
-          cursor_->Valid(), "Db has less rows than shard id: ", s, shard_id_);
+          cursor->Valid(),
+          "Db has less rows than shard id: ",
+          s,
+          reader_cursor->first);
     }
   }
 
   string db_type_;
   string source_;
   unique_ptr<DB> db_;
-  unique_ptr<Cursor> cursor_;
-  mutable std::mutex reader_mutex_;
-  uint32_t num_shards_;
-  uint32_t shard_id_;
+  vector<unique_ptr<ReaderCursor>> cursors_;
+  mutable std::atomic<uint32_t> next_cursor_{0};
+  uint32_t num_shards_ = 1;
+  uint32_t shard_id_ = 0;
+  uint32_t stride_ = 1;
 
   DISABLE_COPY_AND_ASSIGN(DBReader);
 };
@@ -27,10 +27,24 @@ EventQueryFunction Event::event_querier_[MaxDeviceTypes];
 EventErrorMessageFunction Event::event_err_msg_getter_[MaxDeviceTypes];
 EventSetFinishedFunction Event::event_finished_setter_[MaxDeviceTypes];
 EventResetFunction Event::event_resetter_[MaxDeviceTypes];
+EventAddCallbackFunction Event::event_callback_adder_[MaxDeviceTypes];
 
 namespace {
 const std::string kNoError = "No error";
+
+// Called once the event has reached a terminal state, with the wrapper's lock
+// held. Callbacks may query or wait on the event, so they run unlocked.
+void RunCallbacksCPU(
+    CPUEventWrapper* wrapper,
+    std::unique_lock<std::mutex>* lock) {
+  std::vector<EventCallbackFunction> callbacks;
+  callbacks.swap(wrapper->callbacks_);
+  lock->unlock();
+  for (const auto& callback : callbacks) {
+    callback();
+  }
 }
+} // namespace
 
 void EventCreateCPU(const DeviceOption& option, Event* event) {
   event->event_ = std::make_shared<CPUEventWrapper>(option);
@@ -58,6 +72,7 @@ void EventRecordCPU(
     wrapper->err_msg_ = err_msg;
     wrapper->status_ = EventStatus::EVENT_FAILED;
     wrapper->cv_completed_.notify_all();
+    RunCallbacksCPU(wrapper, &lock);
   }
 }
 
@@ -106,6 +121,8 @@ void EventSetFinishedCPU(const Event* event, const char* err_msg) {
     wrapper->status_ = EventStatus::EVENT_FAILED;
   }
   wrapper->cv_completed_.notify_all();
+
+  RunCallbacksCPU(wrapper, &lock);
 }
 
 void EventResetCPU(Event* event) {
@@ -113,6 +130,19 @@ void EventResetCPU(Event* event) {
   std::unique_lock<std::mutex> lock(wrapper->mutex_);
   wrapper->status_ = EventStatus::EVENT_INITIALIZED;
   wrapper->err_msg_ = "";
+  wrapper->callbacks_.clear();
+}
+
+void EventAddCallbackCPU(Event* event, EventCallbackFunction callback) {
+  auto* wrapper = static_cast<CPUEventWrapper*>(event->event_.get());
+  std::unique_lock<std::mutex> lock(wrapper->mutex_);
+  if (wrapper->status_ == EventStatus::EVENT_SUCCESS ||
+      wrapper->status_ == EventStatus::EVENT_FAILED) {
+    lock.unlock();
+    callback();
+  } else {
+    wrapper->callbacks_.push_back(std::move(callback));
+  }
 }
 
 REGISTER_EVENT_CREATE_FUNCTION(CPU, EventCreateCPU);
@@ -124,5 +154,6 @@ REGISTER_EVENT_QUERY_FUNCTION(CPU, EventQueryCPU);
 REGISTER_EVENT_ERROR_MESSAGE_FUNCTION(CPU, EventErrorMessageCPU);
 REGISTER_EVENT_SET_FINISHED_FUNCTION(CPU, EventSetFinishedCPU);
 REGISTER_EVENT_RESET_FUNCTION(CPU, EventResetCPU);
+REGISTER_EVENT_ADD_CALLBACK_FUNCTION(CPU, EventAddCallbackCPU);
 
 } // namespace caffe2
@@ -17,6 +17,8 @@
 #ifndef CAFFE2_CORE_EVENT_H_
 #define CAFFE2_CORE_EVENT_H_
 
+#include <functional>
+
 #include "caffe2/core/common.h"
 #include "caffe2/core/logging.h"
 #include "caffe2/proto/caffe2.pb.h"
@@ -63,6 +65,14 @@ typedef const std::string& (*EventErrorMessageFunction)(const Event*);
 typedef void (*EventSetFinishedFunction)(const Event*, const char*);
 typedef void (*EventResetFunction)(Event*);
 
+// Adds a function to be called once the event reaches a terminal state
+// (success or failure). If the event has already finished, the callback is
+// called immediately from the calling thread, otherwise from the thread that
+// finishes the event, in the order the callbacks were added.
+// Reset drops the callbacks that have not been called yet.
+typedef std::function<void()> EventCallbackFunction;
+typedef void (*EventAddCallbackFunction)(Event*, EventCallbackFunction);
+
 class Event {
  public:
   explicit Event(const DeviceOption& option)
@@ -113,6 +123,18 @@ class Event {
     event_resetter_[type_](this);
   }
 
+  // Whether completion of this event can be observed with AddCallback
+  // instead of polling Query.
+  bool SupportsCallbacks() const {
+    return event_callback_adder_[type_] != nullptr;
+  }
+
+  void AddCallback(EventCallbackFunction callback) {
+    CAFFE_ENFORCE(
+        event_callback_adder_[type_], "Event does not support callbacks");
+    event_callback_adder_[type_](this, std::move(callback));
+  }
+
   const DeviceOption& GetDeviceOption() const {
     return option_;
   }
@@ -181,6 +203,7 @@ class Event {
   static EventErrorMessageFunction event_err_msg_getter_[MaxDeviceTypes];
   static EventSetFinishedFunction event_finished_setter_[MaxDeviceTypes];
   static EventResetFunction event_resetter_[MaxDeviceTypes];
+  static EventAddCallbackFunction event_callback_adder_[MaxDeviceTypes];
 
   template <int d>
   friend struct EventCreateFunctionRegisterer;
@@ -199,6 +222,8 @@ class Event {
   friend struct EventSetFinishedFunctionRegisterer;
   template <int d>
   friend struct EventResetFunctionRegisterer;
+  template <int d>
+  friend struct EventAddCallbackFunctionRegisterer;
 };
 
 template <int d>
@@ -298,6 +323,18 @@ struct EventResetFunctionRegisterer {
   static EventResetFunctionRegisterer<d> g_event_reset_##d(f); \
   }
 
+template <int d>
+struct EventAddCallbackFunctionRegisterer {
+  explicit EventAddCallbackFunctionRegisterer(EventAddCallbackFunction f) {
+    static_assert(d < MaxDeviceTypes, "");
+    Event::event_callback_adder_[d] = f;
+  }
+};
+#define REGISTER_EVENT_ADD_CALLBACK_FUNCTION(d, f)                          \
+  namespace {                                                               \
+  static EventAddCallbackFunctionRegisterer<d> g_event_add_callback_##d(f); \
+  }
+
 } // namespace caffe2
 
 #endif // CAFFE2_CORE_EVENT_H_
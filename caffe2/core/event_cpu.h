@@ -18,6 +18,7 @@
 #include "caffe2/core/operator.h"
 
 #include <atomic>
+#include <vector>
 
 namespace caffe2 {
 
@@ -34,6 +35,7 @@ struct CPUEventWrapper {
   std::condition_variable cv_completed_;
   std::atomic<int> status_;
   std::string err_msg_;
+  std::vector<EventCallbackFunction> callbacks_;
 };
 
 void EventCreateCPU(const DeviceOption& option, Event* event);
@@ -57,4 +59,6 @@ bool EventCanScheduleCPU(const Event*, const Event*);
 
 void EventResetCPU(Event*);
 
+void EventAddCallbackCPU(Event* event, EventCallbackFunction callback);
+
 } // namespace caffe2
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <vector>
+
 #include <gtest/gtest.h>
 #include "caffe2/core/context.h"
 #include "caffe2/core/event.h"
@@ -38,4 +40,38 @@ TEST(EventCPUTest, EventBasics) {
   event.Wait(CPU, &context);
 }
 
+TEST(EventCPUTest, EventCallbacks) {
+  DeviceOption device_option;
+  device_option.set_device_type(CPU);
+  Event event(device_option);
+  CPUContext context;
+  ASSERT_TRUE(event.SupportsCallbacks());
+
+  std::vector<int> calls;
+  event.Record(CPU, &context);
+  event.AddCallback([&calls]() { calls.push_back(1); });
+  event.AddCallback([&calls]() { calls.push_back(2); });
+  EXPECT_TRUE(calls.empty());
+  event.SetFinished();
+  EXPECT_EQ(calls, std::vector<int>({1, 2}));
+
+  // Already finished: called right away
+  event.AddCallback([&calls]() { calls.push_back(3); });
+  EXPECT_EQ(calls, std::vector<int>({1, 2, 3}));
+
+  // Reset drops callbacks that have not been called
+  calls.clear();
+  event.Reset();
+  event.AddCallback([&calls]() { calls.push_back(4); });
+  event.Reset();
+  event.SetFinished();
+  EXPECT_TRUE(calls.empty());
+
+  // Failures are terminal too
+  event.Reset();
+  event.AddCallback([&calls]() { calls.push_back(5); });
+  event.Record(CPU, &context, "error");
+  EXPECT_EQ(calls, std::vector<int>({5}));
+}
+
 } // namespace caffe2
@@ -98,6 +98,7 @@ NetBase::NetBase(
 }
 
 bool NetBase::RunAsync() {
+  PrepareArena();
   for (auto& op : GetOperators()) {
     op->ResetEvent();
   }
@@ -114,6 +115,16 @@ void SetGlobalNetObserverCreator(NetObserverCreator creator) {
   VLOG(1) << "Have set custom GlobalNetObserverCreator";
 }
 
+static std::vector<NetObserverCreator>& AdditionalNetObserverCreators() {
+  static std::vector<NetObserverCreator> creators;
+  return creators;
+}
+
+void AddGlobalNetObserverCreator(NetObserverCreator creator) {
+  AdditionalNetObserverCreators().push_back(creator);
+  VLOG(1) << "Have added a global net observer creator";
+}
+
 unique_ptr<NetBase> CreateNet(const NetDef& net_def, Workspace* ws) {
   std::shared_ptr<NetDef> tmp_net_def(new NetDef(net_def));
   return CreateNet(tmp_net_def, ws);
@@ -122,6 +133,18 @@ unique_ptr<NetBase> CreateNet(const NetDef& net_def, Workspace* ws) {
 unique_ptr<NetBase> CreateNet(
     const std::shared_ptr<const NetDef>& net_def,
     Workspace* ws) {
+  // Plan and bind the arena before the operators are created, so that they
+  // pick up the arena-backed tensors when they first access their outputs.
+  std::unique_ptr<NetArenaPlanner> arena_planner;
+  if (ArgumentHelper(*net_def).GetSingleArgument<bool>(
+          kNetArenaAllocationArg, false)) {
+    arena_planner.reset(new NetArenaPlanner(*net_def, ws));
+    arena_planner->Prepare();
+    if (!arena_planner->arena()) {
+      LOG(WARNING) << "Arena allocation requested for net " << net_def->name()
+                   << " but none of its blobs could be planned yet.";
+    }
+  }
   // In default, we will return a simple network that just runs all operators
   // sequentially.
   unique_ptr<NetBase> net;
@@ -133,6 +156,10 @@ unique_ptr<NetBase> CreateNet(
   VLOG(1) << "Adding a global observer to a net";
   if (net) {
     net->AttachObserver(GlobalNetObserverCreator(net.get()));
+    for (const auto& creator : AdditionalNetObserverCreators()) {
+      net->AttachObserver(creator(net.get()));
+    }
+    net->set_arena_planner(std::move(arena_planner));
   }
   return net;
 }
@@ -28,6 +28,7 @@
 #include "caffe2/core/blob.h"
 #include "caffe2/core/common.h"
 #include "caffe2/core/logging.h"
+#include "caffe2/core/net_arena.h"
 #include "caffe2/core/observer.h"
 #include "caffe2/core/operator_schema.h"
 #include "caffe2/core/registry.h"
@@ -126,16 +127,40 @@ class NetBase : public Observable<NetBase> {
     return net_def_ != nullptr;
   }
 
+  // The arena holding the net's intermediate tensors for the current shapes
+  // of its inputs, or nullptr if the net was not created with the
+  // arena_allocation argument.
+  inline const NetArena* arena() const {
+    return arena_planner_ ? arena_planner_->arena() : nullptr;
+  }
+
+  inline const NetArenaPlanner* arena_planner() const {
+    return arena_planner_.get();
+  }
+
+  inline void set_arena_planner(std::unique_ptr<NetArenaPlanner> planner) {
+    arena_planner_ = std::move(planner);
+  }
+
  protected:
   virtual bool DoRunAsync() {
     CAFFE_THROW("Not implemented");
   };
 
+  // Binds the arena planned for the current shapes of the inputs, if the net
+  // uses one. Nets call it before running their operators.
+  inline void PrepareArena() {
+    if (arena_planner_) {
+      arena_planner_->Prepare();
+    }
+  }
+
   vector<string> external_input_;
   vector<string> external_output_;
   string name_;
   vector<const Event*> events_;
   std::shared_ptr<const NetDef> net_def_;
+  std::unique_ptr<NetArenaPlanner> arena_planner_;
   DISABLE_COPY_AND_ASSIGN(NetBase);
 };
 
@@ -163,6 +188,11 @@ unique_ptr<NetBase> CreateNet(
 
 void SetGlobalNetObserverCreator(NetObserverCreator creator);
 
+// Adds a creator of observers attached to every net created from now on, on
+// top of the one set by SetGlobalNetObserverCreator. Meant to be called
+// during initialization, before nets are created.
+void AddGlobalNetObserverCreator(NetObserverCreator creator);
+
 } // namespace caffe2
 
 #endif // CAFFE2_CORE_NET_H_
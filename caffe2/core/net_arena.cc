@@ -0,0 +1,345 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/net_arena.h"
+
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/types.h"
+#include "caffe2/core/workspace.h"
+
+CAFFE2_DEFINE_int(
+    caffe2_net_arena_max_plans,
+    8,
+    "Maximum number of arena plans, one per signature of the input shapes, "
+    "that a net with arena allocation caches");
+
+namespace caffe2 {
+
+namespace {
+
+size_t AlignUp(size_t nbytes) {
+  return (nbytes + gCaffe2Alignment - 1) / gCaffe2Alignment * gCaffe2Alignment;
+}
+
+bool LifetimesOverlap(const NetArena::Slot& a, const NetArena::Slot& b) {
+  return a.first_op <= b.last_op && b.first_op <= a.last_op;
+}
+
+// Operators whose outputs share the storage of their inputs, so that the
+// input must stay alive as long as the output does.
+bool IsAliasingOp(const OperatorDef& op) {
+  return op.type() == "Alias";
+}
+
+// Operators that run nested nets may touch blobs that are not listed as
+// their inputs, so live ranges cannot be trusted when they are present.
+bool HasNestedNets(const OperatorDef& op) {
+  if (op.type() == "RecurrentNetwork") {
+    return true;
+  }
+  for (const auto& arg : op.arg()) {
+    if (arg.has_n() || arg.nets_size() > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+std::unique_ptr<NetArena> NetArena::Create(
+    const NetDef& net_def,
+    Workspace* ws) {
+  return NetArenaPlanner(net_def, ws).Plan(ws);
+}
+
+NetArenaPlanner::NetArenaPlanner(const NetDef& net_def, Workspace* ws)
+    : net_def_(net_def), ws_(ws) {
+  sequential_ = !net_def.has_type() || net_def.type().empty() ||
+      net_def.type() == "simple";
+
+  excluded_.insert(
+      net_def.external_input().begin(), net_def.external_input().end());
+  excluded_.insert(
+      net_def.external_output().begin(), net_def.external_output().end());
+  std::unordered_map<string, string> alias_of;
+  auto root = [&alias_of](const string& name) -> const string& {
+    auto it = alias_of.find(name);
+    return it == alias_of.end() ? name : it->second;
+  };
+  std::unordered_set<string> inputs;
+  auto addInput = [&](const string& name) {
+    if (inputs.insert(name).second) {
+      inputs_.push_back(name);
+    }
+  };
+  for (const auto& name : net_def.external_input()) {
+    addInput(name);
+  }
+
+  // Live range of every blob created by the net, in operator order.
+  for (int i = 0; i < net_def.op_size(); ++i) {
+    const auto& op = net_def.op(i);
+    if (HasNestedNets(op)) {
+      sequential_ = false;
+    }
+    const auto* schema = OpSchemaRegistry::Schema(op.type());
+    if (!schema || !schema->HasTensorInferenceFunction()) {
+      LOG(WARNING) << "Operator " << op.type() << " has no shape inference "
+                   << "function, the outputs of it and of the operators "
+                   << "depending on it are not planned in net "
+                   << net_def.name();
+    }
+    for (const auto& in : op.input()) {
+      auto it = ranges_.find(root(in));
+      if (it != ranges_.end()) {
+        it->second.second = i;
+      } else {
+        // Read before the net writes it: not ours to place.
+        excluded_.insert(in);
+        addInput(in);
+      }
+    }
+    const auto& device = op.has_device_option() ? op.device_option()
+                                                : net_def.device_option();
+    for (const auto& out : op.output()) {
+      if (IsAliasingOp(op) || device.device_type() != CPU) {
+        excluded_.insert(out);
+      }
+      if (excluded_.count(out) || ws->HasBlob(out)) {
+        continue;
+      }
+      auto it = ranges_.find(out);
+      if (it == ranges_.end()) {
+        ranges_[out] = std::make_pair(i, i);
+      } else {
+        it->second.second = i;
+      }
+    }
+    if (IsAliasingOp(op) && op.input_size() > 0) {
+      for (const auto& out : op.output()) {
+        alias_of[out] = root(op.input(0));
+      }
+    }
+  }
+}
+
+std::unique_ptr<NetArena> NetArenaPlanner::Plan(const Workspace* ws) const {
+  if (ranges_.empty()) {
+    return nullptr;
+  }
+
+  // Static shapes and types of the candidate blobs, inferred from the inputs
+  // only: the intermediate blobs of the workspace may hold the shapes of a
+  // previous run.
+  CaffeMap<string, TensorShape> blob_desc;
+  for (const auto& name : inputs_) {
+    const auto* blob = ws->GetBlob(name);
+    if (blob) {
+      blob_desc[name] = GetTensorShapeOfBlob(blob);
+    }
+  }
+  vector<std::unique_ptr<NetDef>> nets;
+  nets.emplace_back(new NetDef(net_def_));
+  TensorShapes shapes;
+  try {
+    shapes = InferBlobShapesAndTypes(blob_desc, nets);
+  } catch (const EnforceNotMet& e) {
+    LOG(WARNING) << "Shape inference failed for net " << net_def_.name()
+                 << ", not using an arena: " << e.msg();
+    return nullptr;
+  }
+
+  vector<NetArena::Slot> slots;
+  for (const auto& shape : shapes.shapes()) {
+    auto it = ranges_.find(shape.name());
+    if (it == ranges_.end() || excluded_.count(shape.name()) ||
+        shape.unknown_shape() || !shape.has_data_type() ||
+        shape.data_type() == TensorProto_DataType_UNDEFINED) {
+      continue;
+    }
+    TypeMeta meta;
+    try {
+      meta = DataTypeToTypeMeta(shape.data_type());
+    } catch (const std::runtime_error&) {
+      continue;
+    }
+    if (meta.ctor()) {
+      continue;
+    }
+    vector<TIndex> dims(shape.dims().begin(), shape.dims().end());
+    TIndex size = 1;
+    for (auto d : dims) {
+      size *= d;
+    }
+    if (size <= 0) {
+      continue;
+    }
+    NetArena::Slot slot;
+    slot.blob = shape.name();
+    slot.meta = meta;
+    slot.dims = dims;
+    slot.offset = 0;
+    slot.nbytes = size * meta.itemsize();
+    slot.first_op = sequential_ ? it->second.first : 0;
+    slot.last_op = sequential_ ? it->second.second : INT_MAX;
+    slots.push_back(slot);
+  }
+  if (slots.empty()) {
+    return nullptr;
+  }
+  return std::unique_ptr<NetArena>(new NetArena(std::move(slots)));
+}
+
+vector<int64_t> NetArenaPlanner::Signature(const Workspace* ws) const {
+  vector<int64_t> signature;
+  for (const auto& name : inputs_) {
+    const auto* blob = ws->GetBlob(name);
+    if (!blob) {
+      signature.push_back(-1);
+      continue;
+    }
+    signature.push_back(blob->meta().id());
+    if (blob->IsType<TensorCPU>()) {
+      const auto& tensor = blob->Get<TensorCPU>();
+      signature.push_back(tensor.meta().id());
+      signature.push_back(tensor.ndim());
+      signature.insert(
+          signature.end(), tensor.dims().begin(), tensor.dims().end());
+    }
+  }
+  return signature;
+}
+
+void NetArenaPlanner::Prepare() {
+  auto* ws = ws_;
+  auto signature = Signature(ws);
+  if (prepared_ && signature == signature_) {
+    return;
+  }
+  auto it = plans_.find(signature);
+  if (it == plans_.end()) {
+    if (plans_.size() >= FLAGS_caffe2_net_arena_max_plans) {
+      if (arena_) {
+        arena_->Unbind(ws);
+        arena_ = nullptr;
+      }
+      // The tensors still bound to the dropped plans keep their memory alive
+      plans_.clear();
+    }
+    it = plans_.emplace(signature, Plan(ws)).first;
+  }
+  if (arena_ && arena_ != it->second.get()) {
+    arena_->Unbind(ws);
+  }
+  arena_ = it->second.get();
+  if (arena_) {
+    arena_->Bind(ws);
+  }
+  signature_ = std::move(signature);
+  prepared_ = true;
+}
+
+NetArena::NetArena(vector<Slot>&& slots) : slots_(std::move(slots)) {
+  // Greedy by size: place the largest blobs first, each one at the lowest
+  // offset that does not collide with an already placed blob whose live range
+  // overlaps with its own.
+  std::sort(slots_.begin(), slots_.end(), [](const Slot& a, const Slot& b) {
+    return a.nbytes != b.nbytes ? a.nbytes > b.nbytes : a.blob < b.blob;
+  });
+  vector<const Slot*> placed;
+  for (auto& slot : slots_) {
+    vector<const Slot*> conflicts;
+    for (const Slot* other : placed) {
+      if (LifetimesOverlap(slot, *other)) {
+        conflicts.push_back(other);
+      }
+    }
+    std::sort(
+        conflicts.begin(), conflicts.end(), [](const Slot* a, const Slot* b) {
+          return a->offset < b->offset;
+        });
+    size_t offset = 0;
+    for (const Slot* other : conflicts) {
+      if (offset + slot.nbytes <= other->offset) {
+        break;
+      }
+      offset = std::max(offset, AlignUp(other->offset + other->nbytes));
+    }
+    slot.offset = offset;
+    placed.push_back(&slot);
+    peak_bytes_ = std::max(peak_bytes_, AlignUp(offset + slot.nbytes));
+    total_bytes_ += slot.nbytes;
+  }
+
+  auto data_and_deleter = CPUContext::New(peak_bytes_);
+  buffer_ = std::shared_ptr<void>(
+      data_and_deleter.first, data_and_deleter.second);
+  VLOG(1) << "Planned " << slots_.size() << " blobs in a " << peak_bytes_
+          << " byte arena (" << total_bytes_ << " bytes without sharing).";
+}
+
+void NetArena::Bind(Workspace* ws) {
+  auto buffer = buffer_;
+  for (const auto& slot : slots_) {
+    auto* tensor = ws->CreateBlob(slot.blob)->GetMutable<TensorCPU>();
+    tensor->Resize(slot.dims);
+    // The deleter keeps the arena alive for as long as any tensor uses it,
+    // which may be longer than the net itself.
+    tensor->ShareExternalPointer(
+        static_cast<char*>(buffer.get()) + slot.offset,
+        slot.meta,
+        slot.nbytes,
+        [buffer](void*) {});
+  }
+}
+
+void NetArena::Unbind(Workspace* ws) {
+  for (const auto& slot : slots_) {
+    auto* blob = ws->GetBlob(slot.blob);
+    if (blob && blob->IsType<TensorCPU>() &&
+        blob->Get<TensorCPU>().raw_data() ==
+            static_cast<const char*>(buffer_.get()) + slot.offset) {
+      blob->GetMutable<TensorCPU>()->FreeMemory();
+    }
+  }
+}
+
+int NetArena::CountFallbacks(const Workspace* ws) const {
+  int fallbacks = 0;
+  for (const auto& slot : slots_) {
+    const auto* blob = ws->GetBlob(slot.blob);
+    if (!blob || !blob->IsType<TensorCPU>()) {
+      ++fallbacks;
+      continue;
+    }
+    const auto& tensor = blob->Get<TensorCPU>();
+    if (tensor.capacity_nbytes() == 0 ||
+        tensor.raw_data() !=
+            static_cast<const char*>(buffer_.get()) + slot.offset) {
+      ++fallbacks;
+    }
+  }
+  return fallbacks;
+}
+
+} // namespace caffe2
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_CORE_NET_ARENA_H_
+#define CAFFE2_CORE_NET_ARENA_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/flags.h"
+#include "caffe2/core/typeid.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+CAFFE2_DECLARE_int(caffe2_net_arena_max_plans);
+
+namespace caffe2 {
+
+class Workspace;
+
+// Name of the boolean NetDef argument that turns on arena allocation.
+constexpr char kNetArenaAllocationArg[] = "arena_allocation";
+
+/**
+ * @brief Places the intermediate CPU tensors of a net in one contiguous
+ * buffer.
+ *
+ * The plan is computed from the shapes that static shape inference derives
+ * from the blobs that the net reads, and from the live range of every blob in
+ * operator order. Only blobs that the net itself creates are
+ * planned: external inputs and outputs, blobs that already exist in the
+ * workspace and blobs whose shape or type cannot be inferred keep the usual
+ * lazy allocation.
+ *
+ * For nets that run their operators sequentially ("simple" nets), blobs whose
+ * live ranges do not overlap share the same bytes of the arena, like
+ * memonger does with blob names. Other net types give every planned blob its
+ * own region. Note that, as with memonger, intermediate blobs that are not
+ * declared as external outputs are not guaranteed to hold their value after
+ * the run.
+ *
+ * Each planned tensor is bound to its region with ShareExternalPointer, so
+ * that a steady-state run does not allocate. If an operator resizes a tensor
+ * beyond its planned size, Tensor::Resize drops the binding and the tensor
+ * falls back to a regular allocation.
+ */
+class NetArena {
+ public:
+  struct Slot {
+    string blob;
+    TypeMeta meta;
+    vector<TIndex> dims;
+    size_t offset;
+    size_t nbytes;
+    // Range of operator indices during which the blob is alive.
+    int first_op;
+    int last_op;
+  };
+
+  // Plans the arena for the given net. Returns nullptr if nothing in the net
+  // can be planned.
+  static std::unique_ptr<NetArena> Create(const NetDef& net_def, Workspace* ws);
+
+  // Binds every planned tensor in the workspace to its region of the arena.
+  void Bind(Workspace* ws);
+
+  // Frees the planned tensors that are still bound to the arena.
+  void Unbind(Workspace* ws);
+
+  // Number of planned blobs whose tensor no longer lives in its region,
+  // because its shape or type changed since the arena was bound.
+  int CountFallbacks(const Workspace* ws) const;
+
+  // Size of the arena, i.e. the peak memory used by the planned blobs.
+  size_t peak_bytes() const {
+    return peak_bytes_;
+  }
+
+  // Sum of the sizes of the planned blobs, i.e. what they would use without
+  // sharing.
+  size_t total_bytes() const {
+    return total_bytes_;
+  }
+
+  const vector<Slot>& slots() const {
+    return slots_;
+  }
+
+ private:
+  friend class NetArenaPlanner;
+  NetArena(vector<Slot>&& slots);
+
+  vector<Slot> slots_;
+  size_t peak_bytes_{0};
+  size_t total_bytes_{0};
+  std::shared_ptr<void> buffer_;
+};
+
+/**
+ * @brief Plans the arenas of a net, and caches them per signature of its
+ * input shapes.
+ *
+ * The planned shapes depend on the shapes of the blobs that the net reads,
+ * which change whenever the caller feeds inputs of another shape, e.g. of
+ * another batch size. Before every run, Prepare computes the signature of
+ * these blobs (their types and dims) and binds the arena planned for it,
+ * planning it on first use. Switching between a few batch sizes then binds
+ * existing arenas instead of reallocating every intermediate tensor.
+ *
+ * Operators without a tensor inference function are reported when the
+ * planner is created, as their outputs can't be planned.
+ */
+class NetArenaPlanner {
+ public:
+  // Computes the live ranges of the blobs of the net. Must be called before
+  // the net creates its blobs in `ws`.
+  NetArenaPlanner(const NetDef& net_def, Workspace* ws);
+
+  // Plans an arena for the current shapes of the inputs. Returns nullptr if
+  // nothing in the net can be planned.
+  std::unique_ptr<NetArena> Plan(const Workspace* ws) const;
+
+  // Binds the arena planned for the current shapes of the inputs, if any.
+  // At most caffe2_net_arena_max_plans plans are cached.
+  void Prepare();
+
+  // The arena bound by the last call to Prepare, or nullptr.
+  const NetArena* arena() const {
+    return arena_;
+  }
+
+  size_t num_plans() const {
+    return plans_.size();
+  }
+
+ private:
+  vector<int64_t> Signature(const Workspace* ws) const;
+
+  NetDef net_def_;
+  Workspace* ws_;
+  bool sequential_;
+  std::unordered_set<string> excluded_;
+  std::unordered_map<string, std::pair<int, int>> ranges_;
+  // Blobs read by the net before it writes them
+  vector<string> inputs_;
+
+  std::map<vector<int64_t>, std::unique_ptr<NetArena>> plans_;
+  vector<int64_t> signature_;
+  NetArena* arena_ = nullptr;
+  bool prepared_ = false;
+
+  DISABLE_COPY_AND_ASSIGN(NetArenaPlanner);
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_CORE_NET_ARENA_H_
@@ -0,0 +1,257 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <google/protobuf/text_format.h>
+#include <gtest/gtest.h>
+#include "caffe2/core/net.h"
+#include "caffe2/core/net_arena.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+namespace {
+
+// Produces a float tensor of the shape given by the "shape" argument. The
+// "run_shape" argument, if present, overrides the shape at run time only, so
+// that the statically inferred shape is wrong.
+class ArenaTestFillOp final : public Operator<CPUContext> {
+ public:
+  ArenaTestFillOp(const OperatorDef& def, Workspace* ws)
+      : Operator<CPUContext>(def, ws),
+        shape_(OperatorBase::GetRepeatedArgument<TIndex>(
+            OperatorBase::HasArgument("run_shape") ? "run_shape" : "shape")) {}
+
+  bool RunOnDevice() override {
+    auto* output = Output(0);
+    output->Resize(shape_);
+    math::Set<float, CPUContext>(
+        output->size(), 1, output->mutable_data<float>(), &context_);
+    return true;
+  }
+
+ private:
+  vector<TIndex> shape_;
+};
+
+// Adds one to every element of its input.
+class ArenaTestIncrementOp final : public Operator<CPUContext> {
+ public:
+  ArenaTestIncrementOp(const OperatorDef& def, Workspace* ws)
+      : Operator<CPUContext>(def, ws) {}
+
+  bool RunOnDevice() override {
+    const auto& input = Input(0);
+    auto* output = Output(0);
+    output->ResizeLike(input);
+    const float* in = input.data<float>();
+    float* out = output->mutable_data<float>();
+    for (int i = 0; i < input.size(); ++i) {
+      out[i] = in[i] + 1;
+    }
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(ArenaTestFill, ArenaTestFillOp);
+REGISTER_CPU_OPERATOR(ArenaTestIncrement, ArenaTestIncrementOp);
+
+OPERATOR_SCHEMA(ArenaTestFill)
+    .NumInputs(0)
+    .NumOutputs(1)
+    .TensorInferenceFunction([](const OperatorDef& def,
+                                const vector<TensorShape>&) {
+      vector<TensorShape> out(1);
+      for (auto d : ArgumentHelper(def).GetRepeatedArgument<int>("shape")) {
+        out[0].add_dims(d);
+      }
+      out[0].set_data_type(TensorProto::FLOAT);
+      return out;
+    });
+OPERATOR_SCHEMA(ArenaTestIncrement)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .IdenticalTypeAndShape();
+OPERATOR_SCHEMA(ArenaTestNoInference).NumInputs(1).NumOutputs(1);
+
+// A chain of three equally sized intermediate blobs, where "a" is dead by
+// the time "c" is produced.
+const char kChainNet[] = R"DOC(
+  name: "chain"
+  arg { name: "arena_allocation" i: 1 }
+  op { type: "ArenaTestFill" output: "a"
+       arg { name: "shape" ints: 16 ints: 16 } }
+  op { type: "ArenaTestIncrement" input: "a" output: "b" }
+  op { type: "ArenaTestIncrement" input: "b" output: "c" }
+  op { type: "ArenaTestIncrement" input: "c" output: "out" }
+  external_output: "out"
+)DOC";
+
+// Same chain, on an input fed by the caller.
+const char kInputChainNet[] = R"DOC(
+  name: "input_chain"
+  arg { name: "arena_allocation" i: 1 }
+  op { type: "ArenaTestIncrement" input: "x" output: "a" }
+  op { type: "ArenaTestIncrement" input: "a" output: "b" }
+  op { type: "ArenaTestIncrement" input: "b" output: "out" }
+  external_input: "x"
+  external_output: "out"
+)DOC";
+
+NetDef ParseNet(const char* text) {
+  NetDef net_def;
+  CAFFE_ENFORCE(google::protobuf::TextFormat::ParseFromString(text, &net_def));
+  return net_def;
+}
+
+void ExpectAllEqual(const TensorCPU& tensor, float value) {
+  for (int i = 0; i < tensor.size(); ++i) {
+    EXPECT_EQ(tensor.data<float>()[i], value);
+  }
+}
+
+void FeedInput(Workspace* ws, TIndex batch_size) {
+  auto* x = ws->CreateBlob("x")->GetMutable<TensorCPU>();
+  x->Resize(batch_size, 8);
+  CPUContext context;
+  math::Set<float, CPUContext>(
+      x->size(), 1, x->mutable_data<float>(), &context);
+}
+
+} // namespace
+
+TEST(NetArenaTest, SharesMemoryAcrossLifetimes) {
+  Workspace ws;
+  auto net = CreateNet(ParseNet(kChainNet), &ws);
+  ASSERT_TRUE(net->arena() != nullptr);
+  const NetArena& arena = *net->arena();
+  // "out" is an external output and is not planned.
+  EXPECT_EQ(arena.slots().size(), 3);
+  EXPECT_EQ(arena.total_bytes(), 3 * 16 * 16 * sizeof(float));
+  // "a" and "c" never live at the same time.
+  EXPECT_EQ(arena.peak_bytes(), 2 * 16 * 16 * sizeof(float));
+
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(net->Run());
+    EXPECT_EQ(arena.CountFallbacks(&ws), 0);
+    ExpectAllEqual(ws.GetBlob("out")->Get<TensorCPU>(), 4);
+  }
+}
+
+TEST(NetArenaTest, FallsBackWhenShapeChanges) {
+  Workspace ws;
+  NetDef net_def = ParseNet(kChainNet);
+  auto* arg = net_def.mutable_op(0)->add_arg();
+  arg->set_name("run_shape");
+  arg->add_ints(32);
+  arg->add_ints(32);
+  auto net = CreateNet(net_def, &ws);
+  ASSERT_TRUE(net->arena() != nullptr);
+
+  ASSERT_TRUE(net->Run());
+  EXPECT_EQ(net->arena()->CountFallbacks(&ws), 3);
+  const auto& out = ws.GetBlob("out")->Get<TensorCPU>();
+  EXPECT_EQ(out.size(), 32 * 32);
+  ExpectAllEqual(out, 4);
+}
+
+TEST(NetArenaTest, NoSharingForConcurrentNets) {
+  Workspace ws;
+  NetDef net_def = ParseNet(kChainNet);
+  net_def.set_type("dag");
+  auto net = CreateNet(net_def, &ws);
+  ASSERT_TRUE(net->arena() != nullptr);
+  EXPECT_EQ(net->arena()->peak_bytes(), net->arena()->total_bytes());
+  ASSERT_TRUE(net->Run());
+  ExpectAllEqual(ws.GetBlob("out")->Get<TensorCPU>(), 4);
+}
+
+TEST(NetArenaTest, DisabledByDefault) {
+  Workspace ws;
+  NetDef net_def = ParseNet(kChainNet);
+  net_def.clear_arg();
+  auto net = CreateNet(net_def, &ws);
+  EXPECT_TRUE(net->arena() == nullptr);
+}
+
+TEST(NetArenaTest, ArenaOutlivesNet) {
+  Workspace ws;
+  {
+    auto net = CreateNet(ParseNet(kChainNet), &ws);
+    ASSERT_TRUE(net->Run());
+  }
+  // The intermediate blobs still reference the arena after the net is gone.
+  ExpectAllEqual(ws.GetBlob("c")->Get<TensorCPU>(), 3);
+}
+
+TEST(NetArenaTest, PlansPerInputShape) {
+  Workspace ws;
+  FeedInput(&ws, 4);
+  auto net = CreateNet(ParseNet(kInputChainNet), &ws);
+  ASSERT_TRUE(net->arena() != nullptr);
+  const auto* first = net->arena();
+  EXPECT_EQ(first->total_bytes(), 2 * 4 * 8 * sizeof(float));
+
+  ASSERT_TRUE(net->Run());
+  EXPECT_EQ(net->arena(), first);
+  EXPECT_EQ(net->arena()->CountFallbacks(&ws), 0);
+  ExpectAllEqual(ws.GetBlob("out")->Get<TensorCPU>(), 4);
+
+  // Another batch size gets its own plan...
+  FeedInput(&ws, 16);
+  ASSERT_TRUE(net->Run());
+  EXPECT_NE(net->arena(), first);
+  EXPECT_EQ(net->arena()->total_bytes(), 2 * 16 * 8 * sizeof(float));
+  EXPECT_EQ(net->arena()->CountFallbacks(&ws), 0);
+  EXPECT_EQ(ws.GetBlob("out")->Get<TensorCPU>().dim(0), 16);
+  ExpectAllEqual(ws.GetBlob("out")->Get<TensorCPU>(), 4);
+  EXPECT_EQ(net->arena_planner()->num_plans(), 2);
+
+  // ...and switching back reuses the first one
+  FeedInput(&ws, 4);
+  ASSERT_TRUE(net->Run());
+  EXPECT_EQ(net->arena(), first);
+  EXPECT_EQ(net->arena()->CountFallbacks(&ws), 0);
+  ExpectAllEqual(ws.GetBlob("out")->Get<TensorCPU>(), 4);
+  EXPECT_EQ(net->arena_planner()->num_plans(), 2);
+}
+
+TEST(NetArenaTest, BoundedPlanCache) {
+  const int max_plans = FLAGS_caffe2_net_arena_max_plans;
+  FLAGS_caffe2_net_arena_max_plans = 2;
+  Workspace ws;
+  FeedInput(&ws, 1);
+  auto net = CreateNet(ParseNet(kInputChainNet), &ws);
+  for (TIndex batch_size : {1, 2, 3, 4, 1}) {
+    FeedInput(&ws, batch_size);
+    ASSERT_TRUE(net->Run());
+    EXPECT_LE(net->arena_planner()->num_plans(), 2);
+    EXPECT_EQ(net->arena()->CountFallbacks(&ws), 0);
+    EXPECT_EQ(ws.GetBlob("out")->Get<TensorCPU>().dim(0), batch_size);
+    ExpectAllEqual(ws.GetBlob("out")->Get<TensorCPU>(), 4);
+  }
+  FLAGS_caffe2_net_arena_max_plans = max_plans;
+}
+
+TEST(NetArenaTest, HasTensorInferenceFunction) {
+  EXPECT_TRUE(
+      OpSchemaRegistry::Schema("ArenaTestIncrement")
+          ->HasTensorInferenceFunction());
+  EXPECT_FALSE(OpSchemaRegistry::Schema("ArenaTestNoInference")
+                   ->HasTensorInferenceFunction());
+}
+
+} // namespace caffe2
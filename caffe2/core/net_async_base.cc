@@ -16,8 +16,11 @@
 
 #include "caffe2/core/net_async_polling.h"
 
+#include <algorithm>
+
 #include "caffe2/core/operator.h"
 #include "caffe2/core/timer.h"
+#include "caffe2/utils/work_stealing_thread_pool.h"
 
 CAFFE2_DEFINE_int(
     caffe2_streams_per_gpu,
@@ -56,6 +59,16 @@ CAFFE2_DEFINE_bool(
     true,
     "Select next non-busy stream");
 
+CAFFE2_DEFINE_bool(
+    caffe2_net_async_intra_op_parallelism,
+    false,
+    "Let CPU operators use the pool threads left idle by the chains");
+
+CAFFE2_DEFINE_bool(
+    caffe2_net_async_pin_threads,
+    false,
+    "Pin each thread of the CPU pools to a CPU (of its NUMA node if any)");
+
 namespace caffe2 {
 
 thread_local std::vector<int> AsyncNetBase::stream_counters_;
@@ -70,23 +83,58 @@ AsyncNetBase::AsyncNetBase(
     operators_.push_back(node.operator_.get());
   }
 
-  const auto& execution_chains = dag_utils::computeChains(operator_nodes_);
+  critical_path_scheduling_ = ArgumentHelper(*net_def).GetSingleArgument<int>(
+      kCriticalPathSchedulingArg, 0);
+  const auto min_chain_cost = dag_utils::getMinChainCost(*net_def);
+  std::vector<float> op_costs;
+  if (critical_path_scheduling_ || min_chain_cost > 0) {
+    op_costs = dag_utils::getOperatorCosts(*net_def, ws);
+  }
+
+  auto execution_chains = dag_utils::computeChains(operator_nodes_);
+  if (min_chain_cost > 0) {
+    execution_chains = dag_utils::fuseChains(
+        operator_nodes_, execution_chains, op_costs, min_chain_cost);
+  }
+  dag_utils::reportChains(net_def->name(), execution_chains);
   chains_.reserve(execution_chains.size());
   for (const auto& kv : execution_chains) {
     chains_.push_back(kv.second);
   }
   chain_nodes_ = dag_utils::prepareChainGraphNodes(operator_nodes_, chains_);
 
+  if (critical_path_scheduling_) {
+    SetOperatorCosts(op_costs);
+  }
+
   events_.reserve(chains_.size());
   for (const auto& chain : chains_) {
     const auto& op = operators_[chain.back()];
     events_.push_back(&op->event());
   }
 
+  // Nets bound to a NUMA node run on the pool of that node by default
   DeviceOption cpu_option;
   cpu_option.set_device_type(CPU);
-  cpu_pool_ = ThreadPoolRegistry()->Create(
-      DeviceTypeName(cpu_option.device_type()), cpu_option);
+  if (IsNUMAEnabled() && net_def->device_option().has_numa_node_id()) {
+    cpu_option.set_numa_node_id(net_def->device_option().numa_node_id());
+  }
+  cpu_pool_key_ = ArgumentHelper(*net_def).GetSingleArgument<string>(
+      kCPUThreadPoolArg, DeviceTypeName(cpu_option.device_type()));
+  cpu_pool_ = ThreadPoolRegistry()->Create(cpu_pool_key_, cpu_option);
+  CAFFE_ENFORCE(cpu_pool_, "Unknown CPU thread pool: ", cpu_pool_key_);
+  if (IsNUMAEnabled()) {
+    cpu_pools_.resize(GetNumNUMANodes());
+  }
+  if (ArgumentHelper(*net_def).GetSingleArgument<int>(
+          kIntraOpParallelismArg,
+          FLAGS_caffe2_net_async_intra_op_parallelism)) {
+    const auto inter_op_threads = std::max<size_t>(
+        std::min(cpu_pool_->size(), maxConcurrentChains()), 1);
+    intra_op_threads_ =
+        std::max<size_t>(cpu_pool_->size() / inter_op_threads, 1);
+    intra_op_parallel_for_ = PoolParallelFor(cpu_pool_, intra_op_threads_);
+  }
   gpu_pools_.resize(FLAGS_caffe2_net_async_max_gpus);
   if (FLAGS_caffe2_net_async_use_single_gpu_pool) {
     DeviceOption gpu_option;
@@ -97,11 +145,28 @@ AsyncNetBase::AsyncNetBase(
   }
 }
 
-std::shared_ptr<TaskThreadPool> AsyncNetBase::pool(
+std::shared_ptr<TaskThreadPoolBase> AsyncNetBase::pool(
     const DeviceOption& device_option) {
   if (FLAGS_caffe2_net_async_use_single_pool ||
       device_option.device_type() == CPU) {
-    return cpu_pool_;
+    if (cpu_pools_.empty() || !device_option.has_numa_node_id() ||
+        device_option.device_type() != CPU) {
+      return cpu_pool_;
+    }
+    auto numa_node_id = device_option.numa_node_id();
+    CAFFE_ENFORCE(
+        numa_node_id >= 0 && numa_node_id < cpu_pools_.size(),
+        "Invalid NUMA node id: " + caffe2::to_string(numa_node_id));
+    auto pool = cpu_pools_[numa_node_id];
+    if (!pool) {
+      std::unique_lock<std::mutex> pools_lock(pools_mutex_);
+      pool = cpu_pools_[numa_node_id];
+      if (!pool) {
+        pool = ThreadPoolRegistry()->Create(cpu_pool_key_, device_option);
+        cpu_pools_[numa_node_id] = pool;
+      }
+    }
+    return pool;
   } else if (device_option.device_type() == CUDA) {
     if (FLAGS_caffe2_net_async_use_single_gpu_pool) {
       return gpu_pool_;
@@ -129,6 +194,66 @@ std::shared_ptr<TaskThreadPool> AsyncNetBase::pool(
   }
 }
 
+void AsyncNetBase::dispatch(int task_id, const std::function<void()>& func) {
+  const auto& device_option = event(task_id).GetDeviceOption();
+  auto task_pool = pool(device_option);
+  if (!critical_path_scheduling_) {
+    task_pool->run(func);
+    return;
+  }
+
+  // One pool task per ready chain, each running the highest priority chain
+  // queued when the pool gets to it
+  std::priority_queue<ReadyTask>* ready;
+  {
+    std::lock_guard<std::mutex> lock(ready_mutex_);
+    ready = &ready_tasks_[task_pool.get()];
+    ready->push({chain_priorities_[task_id], task_id, func});
+  }
+  task_pool->run([this, ready]() {
+    std::function<void()> next;
+    {
+      std::lock_guard<std::mutex> lock(ready_mutex_);
+      next = ready->top().func;
+      ready->pop();
+    }
+    next();
+  });
+}
+
+void AsyncNetBase::SetOperatorCosts(const std::vector<float>& costs) {
+  CAFFE_ENFORCE_EQ(costs.size(), operators_.size());
+  // Children before parents
+  chain_priorities_.assign(chains_.size(), 0);
+  std::vector<int> pending_children(chains_.size());
+  std::vector<int> done;
+  for (auto task_id = 0; task_id < tasksNum(); ++task_id) {
+    pending_children[task_id] = children(task_id).size();
+    if (pending_children[task_id] == 0) {
+      done.push_back(task_id);
+    }
+  }
+  while (!done.empty()) {
+    auto task_id = done.back();
+    done.pop_back();
+    float longest_child_path = 0;
+    for (auto child_id : children(task_id)) {
+      longest_child_path =
+          std::max(longest_child_path, chain_priorities_[child_id]);
+    }
+    float chain_cost = 0;
+    for (auto op_id : chains_[task_id]) {
+      chain_cost += costs[op_id];
+    }
+    chain_priorities_[task_id] = chain_cost + longest_child_path;
+    for (auto parent_id : parents(task_id)) {
+      if (--pending_children[parent_id] == 0) {
+        done.push_back(parent_id);
+      }
+    }
+  }
+}
+
 int AsyncNetBase::stream(int task_id) {
   const auto& device_option = event(task_id).GetDeviceOption();
   int stream_id = 0;
@@ -153,6 +278,35 @@ bool AsyncNetBase::isStreamFree(int task_id, int stream_id) const {
   return last_task_op->IsStreamFree(stream_id);
 }
 
+size_t AsyncNetBase::maxConcurrentChains() const {
+  // Depth of each chain, parents before children
+  std::vector<int> depth(tasksNum(), 0);
+  std::vector<int> pending_parents(tasksNum());
+  std::vector<int> ready;
+  for (auto task_id = 0; task_id < tasksNum(); ++task_id) {
+    pending_parents[task_id] = parents(task_id).size();
+    if (pending_parents[task_id] == 0) {
+      ready.push_back(task_id);
+    }
+  }
+  std::vector<size_t> width;
+  while (!ready.empty()) {
+    auto task_id = ready.back();
+    ready.pop_back();
+    if (depth[task_id] >= width.size()) {
+      width.resize(depth[task_id] + 1, 0);
+    }
+    ++width[depth[task_id]];
+    for (auto child_id : children(task_id)) {
+      depth[child_id] = std::max(depth[child_id], depth[task_id] + 1);
+      if (--pending_parents[child_id] == 0) {
+        ready.push_back(child_id);
+      }
+    }
+  }
+  return width.empty() ? 0 : *std::max_element(width.begin(), width.end());
+}
+
 bool AsyncNetBase::canSchedule(
     int task_id,
     const std::vector<EventStatus>* status) {
@@ -219,6 +373,9 @@ void AsyncNetBase::asyncWait(
 bool AsyncNetBase::run(int task_id, int stream_id) {
   bool failed = false;
   std::string err_msg;
+  IntraOpParallelismGuard intra_op_guard(
+      intra_op_threads_ > 1 ? &intra_op_parallel_for_ : nullptr,
+      intra_op_threads_);
   for (auto& op_id : chains_[task_id]) {
     auto& op = operators_[op_id];
     try {
@@ -267,39 +424,89 @@ AsyncNetBase::~AsyncNetBase() {}
 
 CAFFE_DEFINE_SHARED_REGISTRY(
     ThreadPoolRegistry,
-    TaskThreadPool,
+    TaskThreadPoolBase,
     const DeviceOption&);
 
 namespace {
-std::shared_ptr<TaskThreadPool> AsyncNetCPUThreadPoolCreator(
+int NUMANodeId(const DeviceOption& device_option) {
+  return IsNUMAEnabled() && device_option.has_numa_node_id()
+      ? device_option.numa_node_id()
+      : -1;
+}
+
+std::shared_ptr<TaskThreadPoolBase> AsyncNetCPUThreadPoolCreator(
+    const DeviceOption& device_option) {
+  CAFFE_ENFORCE_EQ(
+      device_option.device_type(),
+      CPU,
+      "Unexpected device type for CPU thread pool");
+  return GetAsyncNetCPUThreadPool(NUMANodeId(device_option));
+}
+
+std::shared_ptr<TaskThreadPoolBase> AsyncNetCPUWorkStealingThreadPoolCreator(
     const DeviceOption& device_option) {
   CAFFE_ENFORCE_EQ(
       device_option.device_type(),
       CPU,
       "Unexpected device type for CPU thread pool");
-  return GetAsyncNetCPUThreadPool();
+  return GetAsyncNetCPUWorkStealingThreadPool(NUMANodeId(device_option));
+}
+
+int AsyncNetCPUPoolSize(int numa_node_id) {
+  auto pool_size = FLAGS_caffe2_net_async_cpu_pool_size;
+  if (pool_size <= 0) {
+    auto num_cores = std::thread::hardware_concurrency();
+    CAFFE_ENFORCE(num_cores > 0, "Failed to get number of CPU cores");
+    pool_size = num_cores;
+    // The cores of a single node
+    if (numa_node_id >= 0 && GetNumNUMANodes() > 1) {
+      pool_size = std::max<int>(pool_size / GetNumNUMANodes(), 1);
+    }
+  }
+  return pool_size;
 }
 } // namespace
 
 CAFFE_REGISTER_CREATOR(ThreadPoolRegistry, CPU, AsyncNetCPUThreadPoolCreator);
+CAFFE_REGISTER_CREATOR(
+    ThreadPoolRegistry,
+    CPU_WORK_STEALING,
+    AsyncNetCPUWorkStealingThreadPoolCreator);
 
 /* static */
-std::shared_ptr<TaskThreadPool> GetAsyncNetCPUThreadPool() {
-  static std::weak_ptr<TaskThreadPool> pool;
+std::shared_ptr<TaskThreadPoolBase> GetAsyncNetCPUThreadPool(
+    int numa_node_id) {
+  static std::unordered_map<int, std::weak_ptr<TaskThreadPool>> pools;
   static std::mutex pool_mutex;
   std::lock_guard<std::mutex> lock(pool_mutex);
 
-  auto shared_pool = pool.lock();
+  auto shared_pool = pools[numa_node_id].lock();
   if (!shared_pool) {
-    auto pool_size = FLAGS_caffe2_net_async_cpu_pool_size;
-    if (pool_size <= 0) {
-      auto num_cores = std::thread::hardware_concurrency();
-      CAFFE_ENFORCE(num_cores > 0, "Failed to get number of CPU cores");
-      pool_size = num_cores;
-    }
-    LOG(INFO) << "Using cpu pool size: " << pool_size;
-    shared_pool = std::make_shared<TaskThreadPool>(pool_size);
-    pool = shared_pool;
+    auto pool_size = AsyncNetCPUPoolSize(numa_node_id);
+    LOG(INFO) << "Using cpu pool size: " << pool_size
+              << ", NUMA node: " << numa_node_id;
+    shared_pool = std::make_shared<TaskThreadPool>(
+        pool_size, numa_node_id, FLAGS_caffe2_net_async_pin_threads);
+    pools[numa_node_id] = shared_pool;
+  }
+  return shared_pool;
+}
+
+/* static */
+std::shared_ptr<TaskThreadPoolBase> GetAsyncNetCPUWorkStealingThreadPool(
+    int numa_node_id) {
+  static std::unordered_map<int, std::weak_ptr<WorkStealingThreadPool>> pools;
+  static std::mutex pool_mutex;
+  std::lock_guard<std::mutex> lock(pool_mutex);
+
+  auto shared_pool = pools[numa_node_id].lock();
+  if (!shared_pool) {
+    auto pool_size = AsyncNetCPUPoolSize(numa_node_id);
+    LOG(INFO) << "Using work stealing cpu pool size: " << pool_size
+              << ", NUMA node: " << numa_node_id;
+    shared_pool = std::make_shared<WorkStealingThreadPool>(
+        pool_size, numa_node_id, FLAGS_caffe2_net_async_pin_threads);
+    pools[numa_node_id] = shared_pool;
   }
   return shared_pool;
 }
@@ -17,14 +17,19 @@
 #ifndef CAFFE2_CORE_NET_ASYNC_BASE_H_
 #define CAFFE2_CORE_NET_ASYNC_BASE_H_
 
+#include <queue>
+#include <unordered_map>
+
 #include "caffe2/core/common.h"
 #include "caffe2/core/net.h"
 #include "caffe2/core/net_dag_utils.h"
+#include "caffe2/core/numa.h"
 #include "caffe2/core/registry.h"
 #include "caffe2/core/stats.h"
 #include "caffe2/core/timer.h"
 #include "caffe2/core/workspace.h"
 #include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/parallel_for.h"
 #include "caffe2/utils/proto_utils.h"
 #include "caffe2/utils/thread_pool.h"
 
@@ -43,6 +48,28 @@ class AsyncNetBase : public NetBase {
     return operators_;
   }
 
+  // Operator ids of each chain, in net order
+  const std::vector<std::vector<int>>& chains() const {
+    return chains_;
+  }
+
+  // Replaces the operator cost estimates used by critical path scheduling,
+  // e.g. with the run times measured in a profiling run: one cost per
+  // operator, in net order. Must not be called while the net runs.
+  void SetOperatorCosts(const std::vector<float>& costs);
+
+  // Per chain, estimated cost of the longest path from the start of the
+  // chain to the end of the net
+  const std::vector<float>& chain_priorities() const {
+    return chain_priorities_;
+  }
+
+  // Number of threads each CPU operator may use for its own work, 1 unless
+  // intra-op parallelism is on
+  size_t intra_op_threads() const {
+    return intra_op_threads_;
+  }
+
  protected:
   bool canSchedule(
       int chain_id,
@@ -59,12 +86,19 @@ class AsyncNetBase : public NetBase {
       const std::vector<int>& wait_task_ids) const;
   bool run(int task_id, int stream_id);
   int stream(int task_id);
-  std::shared_ptr<TaskThreadPool> pool(const DeviceOption& device_option);
+  std::shared_ptr<TaskThreadPoolBase> pool(const DeviceOption& device_option);
+  // Runs `func` for the chain `task_id` on the pool of its device. With
+  // critical path scheduling, the chains waiting for the same pool run by
+  // decreasing priority rather than in the order they were dispatched.
+  void dispatch(int task_id, const std::function<void()>& func);
 
   void finishTasks(const std::unordered_set<int>& task_ids);
   void finalizeEvents();
 
   bool isStreamFree(int task_id, int stream_id) const;
+  // Maximum number of chains at the same depth of the chain graph, i.e. an
+  // estimate of the number of chains that can run concurrently
+  size_t maxConcurrentChains() const;
 
   // Operator/task graph
   std::vector<OperatorBase*> operators_;
@@ -72,22 +106,72 @@ class AsyncNetBase : public NetBase {
   std::vector<std::vector<int>> chains_;
   std::vector<dag_utils::OpGraphNode> chain_nodes_; // chains' parents/children
 
+  // Critical path scheduling
+  struct ReadyTask {
+    float priority;
+    int task_id;
+    std::function<void()> func;
+
+    bool operator<(const ReadyTask& other) const {
+      // Ties go to the chain that comes first in the net
+      return priority < other.priority ||
+          (priority == other.priority && task_id > other.task_id);
+    }
+  };
+  bool critical_path_scheduling_;
+  std::vector<float> chain_priorities_;
+  std::mutex ready_mutex_;
+  std::unordered_map<TaskThreadPoolBase*, std::priority_queue<ReadyTask>>
+      ready_tasks_;
+
+  // Intra-op parallelism: the CPU pool threads the chains leave idle are
+  // handed to the operators
+  ParallelFor intra_op_parallel_for_;
+  size_t intra_op_threads_ = 1;
+
   // Pools and streams
   std::mutex pools_mutex_;
-  std::vector<std::shared_ptr<TaskThreadPool>> gpu_pools_;
-  std::shared_ptr<TaskThreadPool> cpu_pool_;
-  std::shared_ptr<TaskThreadPool> gpu_pool_;
+  std::vector<std::shared_ptr<TaskThreadPoolBase>> gpu_pools_;
+  // Per NUMA node, when NUMA is enabled
+  std::vector<std::shared_ptr<TaskThreadPoolBase>> cpu_pools_;
+  std::string cpu_pool_key_;
+  std::shared_ptr<TaskThreadPoolBase> cpu_pool_;
+  std::shared_ptr<TaskThreadPoolBase> gpu_pool_;
   static thread_local std::vector<int> stream_counters_;
 
   DISABLE_COPY_AND_ASSIGN(AsyncNetBase);
 };
 
+// Name of the string NetDef argument that selects the ThreadPoolRegistry
+// entry used for the CPU chains of a net, e.g. "CPU_WORK_STEALING". Defaults
+// to "CPU".
+constexpr char kCPUThreadPoolArg[] = "cpu_thread_pool";
+
+// Name of the int NetDef argument that turns on critical path scheduling:
+// each chain gets as priority the estimated cost of the longest path from it
+// to the end of the net, and ready chains run by decreasing priority. Costs
+// come from dag_utils::getOperatorCosts, unless set with
+// AsyncNetBase::SetOperatorCosts.
+constexpr char kCriticalPathSchedulingArg[] = "critical_path_scheduling";
+
+// Name of the int NetDef argument that turns on intra-op parallelism,
+// overriding --caffe2_net_async_intra_op_parallelism: the threads of the CPU
+// pool are split between the chains that can run concurrently, and the
+// operators of a chain split their work (see caffe2/utils/parallel_for.h)
+// over their share, on the same pool.
+constexpr char kIntraOpParallelismArg[] = "intra_op_parallelism";
+
 CAFFE_DECLARE_SHARED_REGISTRY(
     ThreadPoolRegistry,
-    TaskThreadPool,
+    TaskThreadPoolBase,
     const DeviceOption&);
 
-std::shared_ptr<TaskThreadPool> GetAsyncNetCPUThreadPool();
+// Pools shared by the nets, one per NUMA node, plus one for the nets that are
+// not bound to a node (negative `numa_node_id`)
+std::shared_ptr<TaskThreadPoolBase> GetAsyncNetCPUThreadPool(
+    int numa_node_id = -1);
+std::shared_ptr<TaskThreadPoolBase> GetAsyncNetCPUWorkStealingThreadPool(
+    int numa_node_id = -1);
 
 } // namespace caffe2
 
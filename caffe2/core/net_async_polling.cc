@@ -70,7 +70,7 @@ void AsyncPollingNet::schedule(int task_id) {
     task_timers_[task_id]->Start();
   }
   const auto& device_option = event(task_id).GetDeviceOption();
-  pool(device_option)->run([this, task_id, device_option]() {
+  dispatch(task_id, [this, task_id, device_option]() {
     int stream_id = stream(task_id);
 
     if (FLAGS_caffe2_dag_net_collect_stats) {
@@ -16,11 +16,20 @@
 
 #include "caffe2/core/net_async_scheduling.h"
 
+#include "caffe2/core/operator.h"
+
 CAFFE2_DEFINE_bool(
     caffe2_net_async_always_schedule_child,
     false,
     "Always schedule child chains from parent chain");
 
+CAFFE2_DEFINE_bool(
+    caffe2_net_async_event_callbacks,
+    true,
+    "Schedule chains whose parents have not finished yet from the parents' "
+    "event callbacks, instead of the polling threads, when the events "
+    "support callbacks");
+
 CAFFE2_DEFINE_int(
     caffe2_net_async_polling_threads_num,
     1,
@@ -31,7 +40,9 @@ namespace caffe2 {
 AsyncSchedulingNet::AsyncSchedulingNet(
     const std::shared_ptr<const NetDef>& net_def,
     Workspace* ws)
-    : AsyncNetBase(net_def, ws), running_(false) {
+    : AsyncNetBase(net_def, ws),
+      running_(false),
+      pending_parent_events_(tasksNum()) {
   pending_tasks_.reserve(FLAGS_caffe2_net_async_polling_threads_num);
   for (auto thread_num = 0;
        thread_num < FLAGS_caffe2_net_async_polling_threads_num;
@@ -71,8 +82,7 @@ void AsyncSchedulingNet::Wait() {
 }
 
 void AsyncSchedulingNet::schedule(int task_id) {
-  const auto& device_option = event(task_id).GetDeviceOption();
-  pool(device_option)->run([this, task_id]() {
+  dispatch(task_id, [this, task_id]() {
     if (success_) {
       int stream_id = stream(task_id);
       asyncWait(task_id, stream_id, parents(task_id));
@@ -80,6 +90,11 @@ void AsyncSchedulingNet::schedule(int task_id) {
         success_ = false;
       }
     }
+    if (!success_) {
+      // Errors are not recoverable: the remaining tasks are pushed through
+      // without running so that every task is processed and the run ends
+      cleanup_ = true;
+    }
 
     auto task_count = ++processed_tasks_num_;
 
@@ -89,7 +104,7 @@ void AsyncSchedulingNet::schedule(int task_id) {
         if (cleanup_ || FLAGS_caffe2_net_async_always_schedule_child ||
             canSchedule(child_id)) {
           schedule(child_id);
-        } else {
+        } else if (!scheduleOnParentEvents(child_id)) {
           auto polling_thread_id = next_polling_thread_counter_++;
           polling_thread_id %= FLAGS_caffe2_net_async_polling_threads_num;
           pending_tasks_[polling_thread_id]->Push(child_id);
@@ -97,42 +112,54 @@ void AsyncSchedulingNet::schedule(int task_id) {
       }
     }
 
-    if (success_) {
-      if (task_count == tasksNum()) {
-        // All tasks are finished, polling thread is sleeping;
-        // only one thread enters here
-        finalizeEvents();
-        finishRun();
-        return;
-      }
-    } else {
-      // Before setting running_ to false and notifying waiters we need to
-      // 1. Ensure that only one thread does the cleanup
-      // 2. Ensure that all other pending tasks in workers and polling threads
-      //    are finished and
-      // 3. Ensure that all tasks that were not scheduled have their events set
-      {
-        std::unique_lock<std::mutex> cleanup_lock(cleanup_mutex_);
-        if (cleanup_) {
-          return;
-        }
-        cleanup_ = true;
-      }
-
-      // Errors are not recoverable and happen in exceptional cases,
-      // ok to busy wait
-      while (processed_tasks_num_ != tasksNum()) {
-      }
-
-      // Make sure all events are set, wait for scheduled events
+    if (task_count == tasksNum()) {
+      // All tasks are processed, either successfully or skipped after an
+      // error; only one thread enters here
       finalizeEvents();
-
-      // Notify observers and waiters
       finishRun();
     }
   });
 }
 
+bool AsyncSchedulingNet::scheduleOnParentEvents(int task_id) {
+  if (!FLAGS_caffe2_net_async_event_callbacks) {
+    return false;
+  }
+  const auto& first_op = operators_[chains_[task_id].front()];
+  std::vector<Event*> blocking_events;
+  for (auto parent_id : parents(task_id)) {
+    auto& parent_event = event(parent_id);
+    if (!parent_event.CanSchedule(
+            first_op->event(), first_op->SupportsAsyncScheduling())) {
+      if (!parent_event.SupportsCallbacks()) {
+        return false;
+      }
+      blocking_events.push_back(&parent_event);
+    }
+  }
+
+  // The extra count keeps callbacks of events that are already finished
+  // from scheduling the task before all the callbacks are added
+  pending_parent_events_[task_id] = blocking_events.size() + 1;
+  auto on_parent_finished = [this, task_id]() {
+    if (--pending_parent_events_[task_id] == 0) {
+      schedule(task_id);
+    }
+  };
+  for (auto* parent_event : blocking_events) {
+    parent_event->AddCallback([this, parent_event, on_parent_finished]() {
+      if (parent_event->Query() == EventStatus::EVENT_FAILED) {
+        // The parent failed in its async part, so the child would otherwise
+        // run on the parent's incomplete output
+        success_ = false;
+      }
+      on_parent_finished();
+    });
+  }
+  on_parent_finished();
+  return true;
+}
+
 void AsyncSchedulingNet::pollAndSchedule(int thread_id) {
   int task_id;
   while (pending_tasks_[thread_id]->Pop(&task_id)) {
@@ -156,7 +183,12 @@ int AsyncSchedulingNet::updateParentCount(int child_id) {
 void AsyncSchedulingNet::finishRun() {
   // notify observers and waiters
   StopAllObservers();
-  running_ = false;
+  {
+    // Wait() checks running_ under the mutex, so set it under the mutex too
+    // to not lose the notification
+    std::lock_guard<std::mutex> lock(running_mutex_);
+    running_ = false;
+  }
   running_cv_.notify_all();
 }
 
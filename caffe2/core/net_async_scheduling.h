@@ -35,6 +35,7 @@ class AsyncSchedulingNet : public AsyncNetBase {
 
   void pollAndSchedule(int thread_id);
   void schedule(int task_id);
+  bool scheduleOnParentEvents(int task_id);
   void reset();
   void finishRun();
   int updateParentCount(int child_id);
@@ -44,11 +45,14 @@ class AsyncSchedulingNet : public AsyncNetBase {
   std::atomic<bool> running_;
   std::atomic<bool> success_;
 
-  std::mutex cleanup_mutex_;
   std::atomic<bool> cleanup_;
 
   std::atomic<int> processed_tasks_num_;
 
+  // Per task, number of parent events that still have to finish before the
+  // task can be scheduled, when waiting through event callbacks
+  std::vector<std::atomic<int>> pending_parent_events_;
+
   std::vector<std::unique_ptr<SimpleQueue<int>>> pending_tasks_;
   std::vector<std::thread> polling_threads_;
   std::atomic<int> next_polling_thread_counter_;
@@ -52,6 +52,15 @@ DAGNetBase::DAGNetBase(
       (FLAGS_caffe2_disable_chaining
            ? dag_utils::singleChains(operator_nodes_)
            : dag_utils::computeChains(operator_nodes_));
+  const auto min_chain_cost = dag_utils::getMinChainCost(*net_def);
+  if (!FLAGS_caffe2_disable_chaining && min_chain_cost > 0) {
+    execution_chains_ = dag_utils::fuseChains(
+        operator_nodes_,
+        execution_chains_,
+        dag_utils::getOperatorCosts(*net_def, ws),
+        min_chain_cost);
+  }
+  dag_utils::reportChains(net_def->name(), execution_chains_);
 
   operators_.reserve(operator_nodes_.size());
   for (const auto& node : operator_nodes_) {
@@ -60,6 +60,11 @@ class DAGNetBase : public NetBase {
     return execution_chains_;
   }
 
+  // Operator ids of each chain, keyed by the id of its first operator
+  const dag_utils::ExecutionChains& execution_chains() const {
+    return execution_chains_;
+  }
+
   vector<OperatorBase*> GetOperators() const override {
     return operators_;
   }
@@ -16,6 +16,8 @@
 
 #include "caffe2/core/net_dag_utils.h"
 
+#include <algorithm>
+#include <numeric>
 #include <set>
 #include <stack>
 #include <unordered_map>
@@ -23,10 +25,18 @@
 
 #include "caffe2/core/operator.h"
 #include "caffe2/core/static_tracepoint.h"
+#include "caffe2/core/stats.h"
 #include "caffe2/core/timer.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/utils/proto_utils.h"
 
+CAFFE2_DEFINE_double(
+    caffe2_net_min_chain_cost,
+    0,
+    "Merge the execution chains that cost less than this into their parent "
+    "chain, in the units of the operator costs (see "
+    "dag_utils::getOperatorCosts). 0 to disable");
+
 namespace caffe2 {
 namespace dag_utils {
 
@@ -120,6 +130,93 @@ std::vector<OpGraphNode> pruneOpNodeGraph(
   return pruned;
 }
 
+// Cost of the operators whose schema has no cost function, or whose input
+// shapes are unknown
+const float kDefaultOperatorCost = 1;
+
+std::vector<float> estimateOperatorCosts(const NetDef& net_def, Workspace* ws) {
+  vector<std::unique_ptr<NetDef>> nets;
+  nets.emplace_back(new NetDef(net_def));
+  const auto inferred = InferBlobShapesAndTypesFromWorkspace(ws, nets);
+  CaffeMap<string, TensorShape> shapes;
+  for (const auto& shape : inferred.shapes()) {
+    shapes[shape.name()] = shape;
+  }
+
+  std::vector<float> costs(net_def.op_size(), kDefaultOperatorCost);
+  for (auto op_id = 0; op_id < net_def.op_size(); ++op_id) {
+    const auto& op = net_def.op(op_id);
+    const auto* schema = OpSchemaRegistry::Schema(op.type());
+    if (!schema || !schema->HasCostInferenceFunction()) {
+      continue;
+    }
+    vector<TensorShape> input_shapes;
+    for (const auto& input : op.input()) {
+      auto it = shapes.find(input);
+      if (it == shapes.end() || it->second.unknown_shape()) {
+        break;
+      }
+      input_shapes.push_back(it->second);
+    }
+    if (input_shapes.size() != op.input_size()) {
+      continue;
+    }
+    try {
+      const auto cost = schema->InferCost(op, input_shapes);
+      costs[op_id] += cost.flops + cost.bytes_moved;
+    } catch (const std::exception& e) {
+      VLOG(1) << "Cost inference failed for " << op.type() << ": " << e.what();
+    }
+  }
+  return costs;
+}
+
+// Whether the operators of `child` can run right after the ones of `parent`
+// in a single chain, on the same stream.
+bool canFuse(
+    const std::vector<OperatorNode>& nodes,
+    const std::vector<int>& parent,
+    const std::vector<int>& child) {
+  bool has_async_part = false;
+  for (const auto* chain : {&parent, &child}) {
+    for (auto idx : *chain) {
+      has_async_part |= nodes[idx].operator_->HasAsyncPart();
+    }
+  }
+  if (!has_async_part) {
+    return true;
+  }
+  const auto& device_option = nodes[parent.front()].operator_->device_option();
+  for (const auto* chain : {&parent, &child}) {
+    for (auto idx : *chain) {
+      const auto& op = nodes[idx].operator_;
+      if (!IsSameDevice(op->device_option(), device_option) ||
+          (chain == &child && !op->SupportsAsyncScheduling())) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Index of the power of two bucket of a chain of `size` operators: 1, 2, 3-4,
+// 5-8, ...
+size_t chainSizeBucket(size_t size) {
+  size_t bucket = 0;
+  while ((size_t(1) << bucket) < size) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+struct ChainStats {
+  CAFFE_STAT_CTOR(ChainStats);
+  CAFFE_AVG_EXPORTED_STAT(num_chains);
+  CAFFE_AVG_EXPORTED_STAT(chain_size);
+  // Number of chains per chain size, in power of two buckets
+  CAFFE_DETAILED_EXPORTED_STAT(chain_size_histogram);
+};
+
 void updateOperatorNodes(
     std::vector<OperatorNode>& nodes,
     const ExecutionChains& chains) {
@@ -294,6 +391,148 @@ ExecutionChains computeChains(std::vector<OperatorNode>& orig_nodes) {
   return chains;
 }
 
+std::vector<float> getOperatorCosts(const NetDef& net_def, Workspace* ws) {
+  ArgumentHelper helper(net_def);
+  if (!helper.HasArgument(kOperatorCostsArg)) {
+    return estimateOperatorCosts(net_def, ws);
+  }
+  auto costs = helper.GetRepeatedArgument<float>(kOperatorCostsArg);
+  CAFFE_ENFORCE_EQ(
+      costs.size(),
+      net_def.op_size(),
+      "Argument ",
+      kOperatorCostsArg,
+      " needs one cost per operator");
+  return costs;
+}
+
+float getMinChainCost(const NetDef& net_def) {
+  return ArgumentHelper(net_def).GetSingleArgument<float>(
+      kMinChainCostArg, FLAGS_caffe2_net_min_chain_cost);
+}
+
+ExecutionChains fuseChains(
+    std::vector<OperatorNode>& nodes,
+    const ExecutionChains& chains,
+    const std::vector<float>& op_costs,
+    float min_chain_cost) {
+  CAFFE_ENFORCE_EQ(op_costs.size(), nodes.size());
+  // Sorted by first operator, so that the result doesn't depend on the
+  // iteration order of `chains`
+  std::vector<std::vector<int>> fused;
+  fused.reserve(chains.size());
+  for (const auto& kv : chains) {
+    fused.push_back(kv.second);
+  }
+  std::sort(fused.begin(), fused.end());
+  const auto graph = prepareChainGraphNodes(nodes, fused);
+
+  const int num_chains = fused.size();
+  std::vector<float> costs(num_chains, 0);
+  std::vector<std::unordered_set<int>> children(num_chains);
+  for (auto chain_id = 0; chain_id < num_chains; ++chain_id) {
+    for (auto idx : fused[chain_id]) {
+      costs[chain_id] += op_costs[idx];
+    }
+    children[chain_id].insert(
+        graph[chain_id].children_.begin(), graph[chain_id].children_.end());
+  }
+  // Chain each chain was merged into, a chain merged into itself is still
+  // standing
+  std::vector<int> merged_into(num_chains);
+  std::iota(merged_into.begin(), merged_into.end(), 0);
+  auto find = [&](int chain_id) {
+    while (merged_into[chain_id] != chain_id) {
+      chain_id = merged_into[chain_id] = merged_into[merged_into[chain_id]];
+    }
+    return chain_id;
+  };
+
+  // Parents before children: a chain can only be merged into a chain that
+  // already has all its own merges
+  std::vector<int> order;
+  std::vector<int> pending_parents(num_chains);
+  for (auto chain_id = 0; chain_id < num_chains; ++chain_id) {
+    pending_parents[chain_id] = graph[chain_id].parents_.size();
+    if (pending_parents[chain_id] == 0) {
+      order.push_back(chain_id);
+    }
+  }
+  for (auto i = 0; i < order.size(); ++i) {
+    for (auto child_id : graph[order[i]].children_) {
+      if (--pending_parents[child_id] == 0) {
+        order.push_back(child_id);
+      }
+    }
+  }
+  CAFFE_ENFORCE_EQ(order.size(), num_chains, "Chain graph has a cycle");
+
+  for (auto chain_id : order) {
+    std::unordered_set<int> parents;
+    for (auto parent_id : graph[chain_id].parents_) {
+      parents.insert(find(parent_id));
+    }
+    if (parents.size() != 1) {
+      continue;
+    }
+    const auto parent_id = *parents.begin();
+    bool only_child = true;
+    for (auto child_id : children[parent_id]) {
+      const auto root = find(child_id);
+      only_child &= root == chain_id || root == parent_id;
+    }
+    if (!(costs[chain_id] < min_chain_cost ||
+          (only_child && costs[parent_id] < min_chain_cost)) ||
+        !canFuse(nodes, fused[parent_id], fused[chain_id])) {
+      continue;
+    }
+    // Merging along the only edge into the chain can't create a cycle
+    auto& parent = fused[parent_id];
+    parent.insert(
+        parent.end(), fused[chain_id].begin(), fused[chain_id].end());
+    fused[chain_id].clear();
+    costs[parent_id] += costs[chain_id];
+    children[parent_id].erase(chain_id);
+    children[parent_id].insert(
+        children[chain_id].begin(), children[chain_id].end());
+    merged_into[chain_id] = parent_id;
+  }
+
+  ExecutionChains result;
+  for (const auto& chain : fused) {
+    if (!chain.empty()) {
+      result[chain.front()] = chain;
+    }
+  }
+  VLOG(1) << "Fused " << chains.size() << " chains into " << result.size()
+          << " with a minimum chain cost of " << min_chain_cost;
+  updateOperatorNodes(nodes, result);
+  return result;
+}
+
+void reportChains(const std::string& net_name, const ExecutionChains& chains) {
+  ChainStats stats("dag_net/chains/" + net_name);
+  size_t max_size = 1;
+  for (const auto& kv : chains) {
+    max_size = std::max(max_size, kv.second.size());
+  }
+  std::vector<std::string> bucket_names;
+  for (size_t bucket = 0; bucket <= chainSizeBucket(max_size); ++bucket) {
+    const size_t high = size_t(1) << bucket;
+    const size_t low = high / 2 + 1;
+    bucket_names.push_back(
+        low == high ? MakeString(high) : MakeString(low, "_", high));
+  }
+  stats.chain_size_histogram.setDetails(bucket_names);
+
+  CAFFE_EVENT(stats, num_chains, chains.size());
+  for (const auto& kv : chains) {
+    CAFFE_EVENT(stats, chain_size, kv.second.size());
+    CAFFE_EVENT(
+        stats, chain_size_histogram, 1, chainSizeBucket(kv.second.size()));
+  }
+}
+
 ExecutionChains singleChains(std::vector<OperatorNode>& nodes) {
   ExecutionChains chains;
   for (auto i = 0; i < nodes.size(); ++i) {
@@ -62,6 +62,40 @@ ExecutionChains computeChains(std::vector<OperatorNode>& orig_nodes);
 
 ExecutionChains singleChains(std::vector<OperatorNode>& nodes);
 
+// Name of the floats NetDef argument holding measured operator costs, e.g.
+// run times from a profiling run: one cost per operator, in net order.
+constexpr char kOperatorCostsArg[] = "operator_costs";
+
+// Name of the float NetDef argument that overrides
+// --caffe2_net_min_chain_cost for a net.
+constexpr char kMinChainCostArg[] = "min_chain_cost";
+
+// Costs of the operators of `net_def`: the ones of its operator_costs
+// argument if it has one, otherwise estimates from the OpSchema cost
+// functions (flops plus bytes moved, plus 1) on the shapes inferred from the
+// blobs of `ws`. Operators whose cost can't be inferred cost 1.
+std::vector<float> getOperatorCosts(const NetDef& net_def, Workspace* ws);
+
+// Minimum cost of a chain of `net_def`, chains below it are fused by
+// fuseChains. 0 when fusion is off.
+float getMinChainCost(const NetDef& net_def);
+
+// Merges cheap chains into their parent chain, so that they don't pay the
+// scheduling overhead of a chain of their own. A chain is merged when its
+// parent is its only parent chain, and either it costs less than
+// `min_chain_cost`, or the parent does and has no other child. The merged
+// operators run sequentially, after the ones of the parent; chains with
+// async operators are only merged on the same device.
+ExecutionChains fuseChains(
+    std::vector<OperatorNode>& nodes,
+    const ExecutionChains& chains,
+    const std::vector<float>& op_costs,
+    float min_chain_cost);
+
+// Exports the number of chains of a net and their sizes to the
+// StatRegistry, under dag_net/chains/<net_name>.
+void reportChains(const std::string& net_name, const ExecutionChains& chains);
+
 std::vector<OperatorNode> prepareOperatorNodes(
     const std::shared_ptr<const NetDef>& net_def,
     Workspace* ws);
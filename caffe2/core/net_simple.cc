@@ -58,6 +58,7 @@ SimpleNet::SimpleNet(
 }
 
 bool SimpleNet::Run() {
+  PrepareArena();
   StartAllObservers();
   VLOG(1) << "Running net " << name_;
   for (auto& op : operators_) {
@@ -169,7 +170,9 @@ vector<float> SimpleNet::TEST_Benchmark(
       std::stringstream flops_str;
       if (flops_per_op[idx]) {
         flops_str << " ("
-                  << to_string(1.0e-6 * flops_per_op[idx] / time_per_op[idx])
+                  << to_string(
+                         1.0e-6 * flops_per_op[idx] * main_runs /
+                         time_per_op[idx])
                   << " GFLOPS)";
       }
       LOG(INFO) << "Operator #" << idx << " (" << print_name << ", " << op_type
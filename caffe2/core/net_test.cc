@@ -14,14 +14,24 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
 #include <google/protobuf/text_format.h>
 #include <gtest/gtest.h>
 #include "caffe2/core/net.h"
+#include "caffe2/core/net_async_base.h"
 #include "caffe2/core/net_dag.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/core/scope_guard.h"
+#include "caffe2/core/stats.h"
+#include "caffe2/utils/parallel_for.h"
+#include "caffe2/utils/thread_pool.h"
 
 CAFFE2_DECLARE_bool(caffe2_disable_chaining);
+CAFFE2_DECLARE_bool(caffe2_net_async_event_callbacks);
 
 namespace caffe2 {
 
@@ -66,6 +76,67 @@ REGISTER_CUDA_OPERATOR(NetTestDummy, NetTestDummyOp);
 REGISTER_CPU_OPERATOR(NetTestDummy2, NetTestDummyOp);
 REGISTER_CUDA_OPERATOR(NetTestDummy2, NetTestDummyOp);
 
+// Counts its runs like NetTestDummyOp, but goes through Operator<CPUContext>
+// so that its event is finished and the async executors can schedule past it.
+class NetTestCountOp final : public Operator<CPUContext> {
+ public:
+  NetTestCountOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws),
+        fail_(OperatorBase::GetSingleArgument<bool>("fail", false)) {}
+
+  bool RunOnDevice() override {
+    if (fail_) {
+      return false;
+    }
+    counter.fetch_add(1);
+    return true;
+  }
+
+ private:
+  const bool fail_;
+};
+
+REGISTER_CPU_OPERATOR(NetTestCount, NetTestCountOp);
+
+// Async CPU operator: its event is finished from another thread some time
+// after RunAsync returns, so that children have to wait for it.
+class NetTestAsyncCountOp final : public Operator<CPUContext> {
+ public:
+  NetTestAsyncCountOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws) {}
+
+  ~NetTestAsyncCountOp() {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  bool RunOnDevice() override {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    thread_ = std::thread([this]() {
+      // RunAsync records the event after RunOnDevice returns
+      while (!event().IsScheduled()) {
+        std::this_thread::yield();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      counter.fetch_add(1);
+      event().SetFinished();
+    });
+    return true;
+  }
+
+  bool HasAsyncPart() const override {
+    return true;
+  }
+
+ private:
+  std::thread thread_;
+};
+
+REGISTER_CPU_OPERATOR(NetTestAsyncCount, NetTestAsyncCountOp);
+
 OPERATOR_SCHEMA(NetTestDummy)
     .NumInputs(0, INT_MAX)
     .NumOutputs(0, INT_MAX)
@@ -74,6 +145,81 @@ OPERATOR_SCHEMA(NetTestDummy2)
     .NumInputs(0, INT_MAX)
     .NumOutputs(0, INT_MAX)
     .AllowInplace({{1, 0}});
+OPERATOR_SCHEMA(NetTestCount).NumInputs(0, INT_MAX).NumOutputs(0, INT_MAX);
+OPERATOR_SCHEMA(NetTestAsyncCount)
+    .NumInputs(0, INT_MAX)
+    .NumOutputs(0, INT_MAX);
+
+// Records the order in which it runs, by output name; its "cost" argument
+// is what its cost function reports.
+std::mutex run_order_mutex;
+std::vector<string> run_order;
+
+class NetTestRecordOp final : public Operator<CPUContext> {
+ public:
+  NetTestRecordOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws) {}
+
+  bool RunOnDevice() override {
+    std::lock_guard<std::mutex> lock(run_order_mutex);
+    run_order.push_back(debug_def().output(0));
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(NetTestRecord, NetTestRecordOp);
+
+OPERATOR_SCHEMA(NetTestRecord)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .IdenticalTypeAndShape()
+    .CostInferenceFunction(
+        [](const OperatorDef& def, const vector<TensorShape>&) {
+          struct OpSchema::Cost c;
+          c.flops = ArgumentHelper(def).GetSingleArgument<int>("cost", 0);
+          c.bytes_moved = 0;
+          return c;
+        });
+
+// Single thread, so that chains run one at a time in the order the pool
+// picks them
+std::shared_ptr<TaskThreadPoolBase> NetTestSingleThreadPoolCreator(
+    const DeviceOption& /* unused */) {
+  static auto pool = std::make_shared<TaskThreadPool>(1);
+  return pool;
+}
+
+CAFFE_REGISTER_CREATOR(
+    ThreadPoolRegistry,
+    NET_TEST_SINGLE_THREAD,
+    NetTestSingleThreadPoolCreator);
+
+std::shared_ptr<TaskThreadPoolBase> NetTestFourThreadsPoolCreator(
+    const DeviceOption& /* unused */) {
+  static auto pool = std::make_shared<TaskThreadPool>(4);
+  return pool;
+}
+
+CAFFE_REGISTER_CREATOR(
+    ThreadPoolRegistry,
+    NET_TEST_FOUR_THREADS,
+    NetTestFourThreadsPoolCreator);
+
+// Outputs the number of intra-op threads it was given
+class NetTestIntraOpThreadsOp final : public Operator<CPUContext> {
+ public:
+  using Operator<CPUContext>::Operator;
+
+  bool RunOnDevice() override {
+    auto* output = Output(0);
+    output->Resize(1);
+    output->mutable_data<int>()[0] = IntraOpThreads();
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(NetTestIntraOpThreads, NetTestIntraOpThreadsOp);
+OPERATOR_SCHEMA(NetTestIntraOpThreads).NumInputs(0, 2).NumOutputs(1);
 
 unique_ptr<NetBase> CreateNetTestHelper(
     Workspace* ws,
@@ -346,6 +492,92 @@ TEST(NetTest, ChainingForForkJoin) {
   checkChainingAndRun(spec, {{0, {0}}, {1, {1}}, {2, {2, 3}}});
 }
 
+// Fork and join of NetTestDummy ops, which all cost 1
+const char kForkJoinNet[] = R"DOC(
+        name: "fork_join"
+        type: "dag"
+        external_input: "in"
+        op {
+          input: "in"
+          output: "hidden"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "hidden"
+          output: "out1"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "hidden"
+          output: "out2"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "out1"
+          input: "out2"
+          output: "out"
+          type: "NetTestDummy"
+        }
+)DOC";
+
+std::string withChainCosts(
+    const std::string& spec,
+    float min_chain_cost,
+    const std::vector<float>& op_costs = {}) {
+  std::string args = MakeString(
+      "arg { name: \"", dag_utils::kMinChainCostArg, "\" f: ", min_chain_cost,
+      " }");
+  if (!op_costs.empty()) {
+    args += MakeString(" arg { name: \"", dag_utils::kOperatorCostsArg, "\"");
+    for (auto cost : op_costs) {
+      args += MakeString(" floats: ", cost);
+    }
+    args += " }";
+  }
+  return spec + args;
+}
+
+TEST(NetTest, ChainFusion) {
+  checkChainingAndRun(
+      kForkJoinNet, {{0, {0}}, {1, {1}}, {2, {2}}, {3, {3}}});
+  // Everything is cheap enough to be merged
+  checkChainingAndRun(
+      withChainCosts(kForkJoinNet, 2).c_str(), {{0, {0, 1, 2, 3}}});
+  checkChainingAndRun(
+      withChainCosts(kForkJoinNet, 1).c_str(),
+      {{0, {0}}, {1, {1}}, {2, {2}}, {3, {3}}});
+  // With measured costs, the expensive branch stays on its own, and so does
+  // the join, which has two parents
+  checkChainingAndRun(
+      withChainCosts(kForkJoinNet, 5, {1, 1, 10, 1}).c_str(),
+      {{0, {0, 1}}, {2, {2}}, {3, {3}}});
+  checkChainingAndRun(
+      withChainCosts(kForkJoinNet, 5, {1, 10, 10, 1}).c_str(),
+      {{0, {0}}, {1, {1}}, {2, {2}}, {3, {3}}});
+}
+
+TEST(NetTest, ChainFusionAsyncScheduling) {
+  auto spec = withChainCosts(kForkJoinNet, 2);
+  NetDef net_def;
+  CAFFE_ENFORCE(google::protobuf::TextFormat::ParseFromString(spec, &net_def));
+  net_def.set_name("fork_join_async");
+  net_def.set_type("async_scheduling");
+  for (auto& op : *net_def.mutable_op()) {
+    op.set_type("NetTestCount");
+  }
+  Workspace ws;
+  ws.CreateBlob("in");
+
+  auto chains = [](const std::string& name) {
+    auto stats = toMap(StatRegistry::get().publish());
+    return stats["dag_net/chains/" + name + "/num_chains/sum"];
+  };
+  const auto num_chains = chains(net_def.name());
+  std::unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  EXPECT_EQ(chains(net_def.name()) - num_chains, 1);
+  testExecution(net, net_def.op().size());
+}
+
 TEST(NetTest, ChainingForwardBackward) {
   const auto spec = R"DOC(
   name: "gpu_0"
@@ -638,4 +870,259 @@ TEST(NetTest, FailingOperator) {
   }
 }
 
+TEST(NetTest, AsyncSchedulingWorkStealingPool) {
+  const auto spec = R"DOC(
+        name: "example"
+        type: "async_scheduling"
+        external_input: "in"
+        arg {
+          name: "cpu_thread_pool"
+          s: "CPU_WORK_STEALING"
+        }
+        op {
+          input: "in"
+          output: "hidden1"
+          type: "NetTestCount"
+        }
+        op {
+          input: "in"
+          output: "hidden2"
+          type: "NetTestCount"
+        }
+        op {
+          input: "hidden1"
+          input: "hidden2"
+          output: "out"
+          type: "NetTestCount"
+        }
+)DOC";
+
+  Workspace ws;
+  ws.CreateBlob("in");
+
+  NetDef net_def;
+  CAFFE_ENFORCE(google::protobuf::TextFormat::ParseFromString(spec, &net_def));
+  std::unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  testExecution(net, net_def.op().size());
+}
+
+TEST(NetTest, AsyncSchedulingWaitsOnAsyncParents) {
+  const auto spec = R"DOC(
+        name: "example"
+        type: "async_scheduling"
+        external_input: "in"
+        op {
+          input: "in"
+          output: "hidden1"
+          type: "NetTestAsyncCount"
+        }
+        op {
+          input: "in"
+          output: "hidden2"
+          type: "NetTestAsyncCount"
+        }
+        op {
+          input: "hidden1"
+          input: "hidden2"
+          output: "out"
+          type: "NetTestCount"
+        }
+)DOC";
+
+  for (bool use_callbacks : {true, false}) {
+    auto old = FLAGS_caffe2_net_async_event_callbacks;
+    auto g = MakeGuard([&]() { FLAGS_caffe2_net_async_event_callbacks = old; });
+    FLAGS_caffe2_net_async_event_callbacks = use_callbacks;
+
+    Workspace ws;
+    ws.CreateBlob("in");
+    NetDef net_def;
+    CAFFE_ENFORCE(
+        google::protobuf::TextFormat::ParseFromString(spec, &net_def));
+    std::unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+    testExecution(net, net_def.op().size());
+  }
+}
+
+TEST(NetTest, AsyncSchedulingFailingOperator) {
+  const auto spec = R"DOC(
+        name: "example"
+        type: "async_scheduling"
+        external_input: "in"
+        op {
+          input: "in"
+          output: "hidden"
+          type: "NetTestAsyncCount"
+        }
+        op {
+          input: "hidden"
+          output: "out"
+          type: "NetTestCount"
+        }
+        op {
+          input: "in"
+          output: "hidden2"
+          type: "NetTestCount"
+          arg {
+            name: "fail"
+            i: 1
+          }
+        }
+)DOC";
+
+  Workspace ws;
+  ws.CreateBlob("in");
+  NetDef net_def;
+  CAFFE_ENFORCE(google::protobuf::TextFormat::ParseFromString(spec, &net_def));
+  std::unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  for (int i = 0; i < 10; i++) {
+    ASSERT_THROW(net->Run(), EnforceNotMet);
+  }
+}
+
+TEST(NetTest, AsyncSchedulingCriticalPath) {
+  // "root" forks into a cheap chain and an expensive one
+  const auto spec = R"DOC(
+        name: "example"
+        type: "async_scheduling"
+        external_input: "in"
+        arg {
+          name: "cpu_thread_pool"
+          s: "NET_TEST_SINGLE_THREAD"
+        }
+        op {
+          input: "in"
+          output: "root"
+          type: "NetTestRecord"
+        }
+        op {
+          input: "root"
+          output: "short"
+          type: "NetTestRecord"
+        }
+        op {
+          input: "root"
+          output: "long1"
+          type: "NetTestRecord"
+          arg {
+            name: "cost"
+            i: 10
+          }
+        }
+        op {
+          input: "long1"
+          output: "long2"
+          type: "NetTestRecord"
+          arg {
+            name: "cost"
+            i: 10
+          }
+        }
+)DOC";
+
+  auto runOrder = [](NetBase* net) {
+    run_order.clear();
+    EXPECT_TRUE(net->Run());
+    std::lock_guard<std::mutex> lock(run_order_mutex);
+    return run_order;
+  };
+
+  Workspace ws;
+  ws.CreateBlob("in")->GetMutable<TensorCPU>()->Resize(1);
+  NetDef net_def;
+  CAFFE_ENFORCE(google::protobuf::TextFormat::ParseFromString(spec, &net_def));
+
+  {
+    // Chains run in the order they become ready
+    auto net = CreateNet(net_def, &ws);
+    EXPECT_EQ(
+        runOrder(net.get()),
+        (std::vector<string>{"root", "short", "long1", "long2"}));
+  }
+
+  auto* arg = net_def.add_arg();
+  arg->set_name(kCriticalPathSchedulingArg);
+  arg->set_i(1);
+  auto net = CreateNet(net_def, &ws);
+  auto* async_net = dynamic_cast<AsyncNetBase*>(net.get());
+  ASSERT_TRUE(async_net);
+  // Every op costs 1 on top of its cost function: the chains are "short",
+  // "long1" and "long2", and "root" with the longest path below it
+  auto priorities = async_net->chain_priorities();
+  std::sort(priorities.begin(), priorities.end());
+  EXPECT_EQ(priorities, (std::vector<float>{1, 22, 23}));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(
+        runOrder(net.get()),
+        (std::vector<string>{"root", "long1", "long2", "short"}));
+  }
+
+  // Measured costs take over the estimates
+  async_net->SetOperatorCosts({1, 100, 1, 1});
+  EXPECT_EQ(
+      runOrder(net.get()),
+      (std::vector<string>{"root", "short", "long1", "long2"}));
+}
+
+TEST(NetTest, AsyncSchedulingIntraOpParallelism) {
+  // Two branches can run at the same time, so each gets half of the pool
+  const auto spec = R"DOC(
+        name: "example"
+        type: "async_scheduling"
+        arg {
+          name: "cpu_thread_pool"
+          s: "NET_TEST_FOUR_THREADS"
+        }
+        op {
+          output: "root"
+          type: "NetTestIntraOpThreads"
+        }
+        op {
+          input: "root"
+          output: "left"
+          type: "NetTestIntraOpThreads"
+        }
+        op {
+          input: "root"
+          output: "right"
+          type: "NetTestIntraOpThreads"
+        }
+        op {
+          input: "left"
+          input: "right"
+          output: "join"
+          type: "NetTestIntraOpThreads"
+        }
+)DOC";
+
+  auto intraOpThreads = [](const NetDef& net_def) {
+    Workspace ws;
+    auto net = CreateNet(net_def, &ws);
+    EXPECT_TRUE(net->Run());
+    std::vector<int> threads;
+    for (const auto& op : net_def.op()) {
+      threads.push_back(
+          ws.GetBlob(op.output(0))->Get<TensorCPU>().data<int>()[0]);
+    }
+    EXPECT_EQ(
+        dynamic_cast<AsyncNetBase*>(net.get())->intra_op_threads(),
+        threads[0]);
+    return threads;
+  };
+
+  NetDef net_def;
+  CAFFE_ENFORCE(google::protobuf::TextFormat::ParseFromString(spec, &net_def));
+  EXPECT_EQ(intraOpThreads(net_def), (std::vector<int>{1, 1, 1, 1}));
+
+  auto* arg = net_def.add_arg();
+  arg->set_name(kIntraOpParallelismArg);
+  arg->set_i(1);
+  EXPECT_EQ(intraOpThreads(net_def), (std::vector<int>{2, 2, 2, 2}));
+
+  // A single chain gets the whole pool
+  net_def.mutable_op()->RemoveLast();
+  net_def.mutable_op()->RemoveLast();
+  EXPECT_EQ(intraOpThreads(net_def), (std::vector<int>{4, 4}));
+}
+
 } // namespace caffe2
@@ -0,0 +1,265 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/numa.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "caffe2/core/common.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#if defined(CAFFE2_USE_NUMA) && defined(__linux__) && !CAFFE2_MOBILE
+#include <numa.h>
+#include <numaif.h>
+#define CAFFE2_NUMA_ENABLED
+#endif
+
+CAFFE2_DEFINE_bool(
+    caffe2_cpu_numa_enabled,
+    false,
+    "Place CPU threads and memory on NUMA nodes when requested");
+
+namespace caffe2 {
+
+#ifdef CAFFE2_NUMA_ENABLED
+
+bool IsNUMAEnabled() {
+  return FLAGS_caffe2_cpu_numa_enabled && numa_available() >= 0;
+}
+
+int GetNumNUMANodes() {
+  if (!IsNUMAEnabled()) {
+    return -1;
+  }
+  return numa_num_configured_nodes();
+}
+
+void NUMABind(int numa_node_id) {
+  if (numa_node_id < 0 || !IsNUMAEnabled()) {
+    return;
+  }
+  CAFFE_ENFORCE_LE(
+      numa_node_id, numa_max_node(), "NUMA node is not available");
+  auto* mask = numa_allocate_nodemask();
+  numa_bitmask_setbit(mask, numa_node_id);
+  numa_bind(mask);
+  numa_bitmask_free(mask);
+}
+
+int GetNUMANode(const void* ptr) {
+  if (!IsNUMAEnabled()) {
+    return -1;
+  }
+  CAFFE_ENFORCE(ptr);
+  int numa_node = -1;
+  CAFFE_ENFORCE_EQ(
+      get_mempolicy(
+          &numa_node,
+          nullptr,
+          0,
+          const_cast<void*>(ptr),
+          MPOL_F_NODE | MPOL_F_ADDR),
+      0,
+      "Unable to get the memory policy");
+  return numa_node;
+}
+
+namespace {
+
+// Returns the errno of mbind, 0 on success
+int moveToNode(void* ptr, size_t size, int numa_node_id) {
+  CAFFE_ENFORCE(ptr);
+  CAFFE_ENFORCE_LT(numa_node_id, sizeof(unsigned long) * 8);
+  const auto page_size = GetNUMAPageSize();
+  const auto address = reinterpret_cast<size_t>(ptr);
+  const auto page_start = address & ~(page_size - 1);
+  unsigned long mask = 1UL << numa_node_id;
+  if (mbind(
+          reinterpret_cast<void*>(page_start),
+          size + address - page_start,
+          MPOL_BIND,
+          &mask,
+          sizeof(mask) * 8,
+          MPOL_MF_MOVE) != 0) {
+    return errno;
+  }
+  return 0;
+}
+
+} // namespace
+
+void NUMAMove(void* ptr, size_t size, int numa_node_id) {
+  if (numa_node_id < 0 || !IsNUMAEnabled() || size == 0) {
+    return;
+  }
+  const int error = moveToNode(ptr, size, numa_node_id);
+  CAFFE_ENFORCE_EQ(
+      error,
+      0,
+      "Unable to move memory to NUMA node ",
+      numa_node_id,
+      ": ",
+      strerror(error));
+}
+
+bool TryNUMAMove(void* ptr, size_t size, int numa_node_id) {
+  if (numa_node_id < 0 || !IsNUMAEnabled() || size == 0) {
+    return true;
+  }
+  const int error = moveToNode(ptr, size, numa_node_id);
+  if (error != 0) {
+    static std::atomic<bool> warned(false);
+    if (!warned.exchange(true)) {
+      LOG(WARNING) << "Unable to move memory to NUMA node " << numa_node_id
+                   << ": " << strerror(error)
+                   << ". Memory will be left where it is allocated.";
+    }
+    return false;
+  }
+  return true;
+}
+
+size_t GetNUMAPageSize() {
+  if (!IsNUMAEnabled()) {
+    return 0;
+  }
+  return static_cast<size_t>(getpagesize());
+}
+
+int GetCurrentNUMANode() {
+  if (!IsNUMAEnabled()) {
+    return -1;
+  }
+  return numa_node_of_cpu(sched_getcpu());
+}
+
+namespace {
+
+std::vector<int> nodeCPUs(int numa_node_id) {
+  std::vector<int> cpus;
+  if (numa_node_id < 0 || !IsNUMAEnabled()) {
+    return cpus;
+  }
+  auto* mask = numa_allocate_cpumask();
+  if (numa_node_to_cpus(numa_node_id, mask) == 0) {
+    for (unsigned cpu = 0; cpu < mask->size; ++cpu) {
+      if (numa_bitmask_isbitset(mask, cpu)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  numa_bitmask_free(mask);
+  return cpus;
+}
+
+} // namespace
+
+#else // CAFFE2_NUMA_ENABLED
+
+bool IsNUMAEnabled() {
+  return false;
+}
+
+int GetNumNUMANodes() {
+  return -1;
+}
+
+void NUMABind(int numa_node_id) {
+  if (numa_node_id >= 0) {
+    VLOG(1) << "NUMA is not enabled";
+  }
+}
+
+int GetNUMANode(const void* /* unused */) {
+  return -1;
+}
+
+void NUMAMove(
+    void* /* unused */,
+    size_t /* unused */,
+    int /* unused */) {}
+
+bool TryNUMAMove(
+    void* /* unused */,
+    size_t /* unused */,
+    int /* unused */) {
+  return true;
+}
+
+size_t GetNUMAPageSize() {
+  return 0;
+}
+
+int GetCurrentNUMANode() {
+  return -1;
+}
+
+#if defined(__linux__)
+namespace {
+
+std::vector<int> nodeCPUs(int /* unused */) {
+  return {};
+}
+
+} // namespace
+#endif // __linux__
+
+#endif // CAFFE2_NUMA_ENABLED
+
+#if defined(__linux__)
+
+void PinCurrentThread(int numa_node_id, size_t index) {
+  auto cpus = nodeCPUs(numa_node_id);
+  if (cpus.empty()) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    CAFFE_ENFORCE_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  if (cpus.empty()) {
+    return;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpus[index % cpus.size()], &cpu_set);
+  CAFFE_ENFORCE_EQ(
+      pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set),
+      0,
+      "Unable to pin the thread to CPU ",
+      cpus[index % cpus.size()]);
+}
+
+#else // __linux__
+
+void PinCurrentThread(int /* unused */, size_t /* unused */) {
+  VLOG(1) << "Thread pinning is not supported on this platform";
+}
+
+#endif // __linux__
+
+} // namespace caffe2
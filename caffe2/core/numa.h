@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_CORE_NUMA_H_
+#define CAFFE2_CORE_NUMA_H_
+
+#include <cstddef>
+
+#include "caffe2/core/logging.h"
+
+CAFFE2_DECLARE_bool(caffe2_cpu_numa_enabled);
+
+namespace caffe2 {
+
+// NUMA placement of threads and memory. Everything below is a no-op (or
+// returns -1) unless Caffe2 is built with NUMA support, the machine has it,
+// and --caffe2_cpu_numa_enabled is set.
+bool IsNUMAEnabled();
+
+// Number of NUMA nodes, -1 when NUMA is not enabled
+int GetNumNUMANodes();
+
+// Binds the calling thread to the CPUs of `numa_node_id`, and its future
+// memory allocations to the memory of that node. Does nothing for negative
+// ids.
+void NUMABind(int numa_node_id);
+
+// NUMA node holding the memory page of `ptr`, -1 when NUMA is not enabled
+int GetNUMANode(const void* ptr);
+
+// Moves the memory pages of [ptr, ptr + size) to `numa_node_id`. Pages that
+// were not touched yet will be allocated there on first touch. Whole pages
+// are moved, including any other data sharing the first and last ones. Does
+// nothing for negative ids.
+void NUMAMove(void* ptr, size_t size, int numa_node_id);
+
+// Same as NUMAMove, but returns false (and logs a warning the first time)
+// instead of throwing when the pages cannot be moved, e.g. when mbind is not
+// permitted.
+bool TryNUMAMove(void* ptr, size_t size, int numa_node_id);
+
+// Size of the memory pages NUMAMove works on, 0 when NUMA is not enabled
+size_t GetNUMAPageSize();
+
+// NUMA node of the CPU the calling thread runs on, -1 when NUMA is not
+// enabled
+int GetCurrentNUMANode();
+
+// Pins the calling thread to a single CPU: the `index`-th CPU (modulo their
+// number) of `numa_node_id`, or of the whole machine when `numa_node_id` is
+// negative or NUMA is not enabled. Only supported on Linux, elsewhere it
+// does nothing.
+void PinCurrentThread(int numa_node_id, size_t index);
+
+} // namespace caffe2
+
+#endif // CAFFE2_CORE_NUMA_H_
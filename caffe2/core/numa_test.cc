@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "caffe2/core/net.h"
+#include "caffe2/core/numa.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/scope_guard.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/thread_pool.h"
+#include <gtest/gtest.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace caffe2 {
+
+namespace {
+
+// Turns NUMA on for the duration of a test, returns whether it is available
+bool EnableNUMA() {
+  FLAGS_caffe2_cpu_numa_enabled = true;
+  return IsNUMAEnabled();
+}
+
+// Outputs the NUMA node it ran on
+class NUMATestNodeOp final : public Operator<CPUContext> {
+ public:
+  using Operator<CPUContext>::Operator;
+
+  bool RunOnDevice() override {
+    auto* output = Output(0);
+    output->Resize(1);
+    output->mutable_data<int>()[0] = GetCurrentNUMANode();
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(NUMATestNode, NUMATestNodeOp);
+OPERATOR_SCHEMA(NUMATestNode).NumInputs(0).NumOutputs(1);
+
+} // namespace
+
+TEST(NUMATest, DisabledByDefault) {
+  EXPECT_FALSE(FLAGS_caffe2_cpu_numa_enabled);
+  EXPECT_FALSE(IsNUMAEnabled());
+  EXPECT_EQ(GetNumNUMANodes(), -1);
+  EXPECT_EQ(GetCurrentNUMANode(), -1);
+  std::vector<char> data(1 << 16);
+  EXPECT_EQ(GetNUMANode(data.data()), -1);
+  EXPECT_EQ(GetNUMAPageSize(), 0);
+  // No-ops
+  NUMABind(0);
+  NUMAMove(data.data(), data.size(), 0);
+  EXPECT_TRUE(TryNUMAMove(data.data(), data.size(), 0));
+  // The NUMA node does not tell devices apart
+  DeviceOption a;
+  DeviceOption b;
+  b.set_numa_node_id(1);
+  EXPECT_TRUE(IsSameDevice(a, b));
+}
+
+TEST(NUMATest, MovesMemory) {
+  auto guard = MakeGuard([]() { FLAGS_caffe2_cpu_numa_enabled = false; });
+  if (!EnableNUMA()) {
+    return;
+  }
+  ASSERT_GE(GetNumNUMANodes(), 1);
+  const auto last_node = GetNumNUMANodes() - 1;
+
+  TensorCPU tensor(std::vector<TIndex>{1 << 20});
+  auto* data = tensor.mutable_data<float>();
+  NUMAMove(data, tensor.nbytes(), last_node);
+  data[0] = 1;
+  EXPECT_EQ(GetNUMANode(data), last_node);
+}
+
+TEST(NUMATest, AllocatesWholePages) {
+  auto guard = MakeGuard([]() { FLAGS_caffe2_cpu_numa_enabled = false; });
+  if (!EnableNUMA()) {
+    return;
+  }
+  // Large allocations start on their own pages, small ones are left alone
+  TensorCPU large(std::vector<TIndex>{gCaffe2NUMAMoveMinBytes});
+  const auto address = reinterpret_cast<size_t>(large.mutable_data<char>());
+  EXPECT_EQ(address % GetNUMAPageSize(), 0);
+  TensorCPU small(std::vector<TIndex>{16});
+  EXPECT_TRUE(small.mutable_data<char>());
+  DeviceOption a;
+  DeviceOption b;
+  b.set_numa_node_id(1);
+  EXPECT_FALSE(IsSameDevice(a, b));
+}
+
+TEST(NUMATest, BindsPoolThreads) {
+  auto guard = MakeGuard([]() { FLAGS_caffe2_cpu_numa_enabled = false; });
+  const bool numa = EnableNUMA();
+  const int numa_node_id = numa ? GetNumNUMANodes() - 1 : -1;
+
+  const int kNumThreads = 2;
+  std::mutex mutex;
+  std::vector<int> nodes;
+#if defined(__linux__)
+  std::vector<cpu_set_t> affinities;
+#endif
+  {
+    TaskThreadPool pool(kNumThreads, numa_node_id, true);
+    EXPECT_EQ(pool.numa_node_id(), numa_node_id);
+    for (int i = 0; i < 10; ++i) {
+      pool.run([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        nodes.push_back(GetCurrentNUMANode());
+#if defined(__linux__)
+        cpu_set_t affinity;
+        CPU_ZERO(&affinity);
+        sched_getaffinity(0, sizeof(affinity), &affinity);
+        affinities.push_back(affinity);
+#endif
+      });
+    }
+    pool.waitWorkComplete();
+  }
+  EXPECT_EQ(nodes, std::vector<int>(10, numa_node_id));
+#if defined(__linux__)
+  // Each thread is pinned to a single CPU
+  for (auto& affinity : affinities) {
+    EXPECT_EQ(CPU_COUNT(&affinity), 1);
+  }
+#endif
+}
+
+TEST(NUMATest, BindsAsyncNets) {
+  auto guard = MakeGuard([]() { FLAGS_caffe2_cpu_numa_enabled = false; });
+  if (!EnableNUMA()) {
+    return;
+  }
+  const auto numa_node_id = GetNumNUMANodes() - 1;
+
+  NetDef net_def;
+  net_def.set_type("async_scheduling");
+  net_def.mutable_device_option()->set_numa_node_id(numa_node_id);
+  for (int i = 0; i < 4; ++i) {
+    auto* op = net_def.add_op();
+    op->set_type("NUMATestNode");
+    op->add_output(MakeString("node_", i));
+  }
+  // An operator can be bound to its own node
+  net_def.mutable_op(3)->mutable_device_option()->set_numa_node_id(0);
+
+  Workspace ws;
+  auto net = CreateNet(net_def, &ws);
+  ASSERT_TRUE(net->Run());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(
+        ws.GetBlob(MakeString("node_", i))->Get<TensorCPU>().data<int>()[0],
+        i < 3 ? numa_node_id : 0);
+  }
+}
+
+} // namespace caffe2
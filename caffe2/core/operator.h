@@ -394,10 +394,18 @@ class Operator : public OperatorBase {
     }
   }
 
+  // Observers see the host side of the operator: for operators with an
+  // async part, they stop once the device work is scheduled. They stop
+  // before the event is set, after which the net may move on.
   bool RunAsync(int stream_id = 0) final {
     try {
+      StartAllObservers();
+
       context_.SwitchToDevice(stream_id);
       auto result = RunOnDevice();
+
+      StopAllObservers();
+
       if (result) {
         if (HasAsyncPart()) {
           RecordEvent();
@@ -835,6 +843,12 @@ void SetOpEnginePref(
 
 TensorShape GetTensorShapeOfBlob(const Blob* b);
 
+// Infers the shapes and types of the blobs of `nets` from the known ones in
+// `blob_desc`, which is updated with the inferred ones.
+TensorShapes InferBlobShapesAndTypes(
+    CaffeMap<string, TensorShape>& blob_desc,
+    const vector<std::unique_ptr<NetDef>>& nets);
+
 TensorShapes InferBlobShapesAndTypesFromWorkspace(
     Workspace* ws,
     const vector<std::unique_ptr<NetDef>>& nets);
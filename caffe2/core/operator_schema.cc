@@ -209,6 +209,7 @@ OpSchema& OpSchema::InputsCanCrossDevices() {
 OpSchema& OpSchema::TensorInferenceFunction(
     TensorInferenceFunctionType function) {
   tensor_inference_function_ = function;
+  has_tensor_inference_function_ = true;
   return *this;
 }
 
@@ -27,6 +27,7 @@
 #include "caffe2/core/common.h"
 #include "caffe2/core/logging.h"
 #include "caffe2/core/registry.h"
+#include "caffe2/core/types.h"
 #include "caffe2/proto/caffe2.pb.h"
 
 namespace caffe2 {
@@ -178,14 +179,19 @@ class OpSchema {
       const vector<TensorShape> input_type_shape) const {
     return tensor_inference_function_(def, input_type_shape);
   }
+  // Whether a tensor inference function was set, otherwise InferTensor
+  // returns unknown shapes.
+  bool HasTensorInferenceFunction() const {
+    return has_tensor_inference_function_;
+  }
 
   /*
    * @brief A struct to store various cost information about
    * an operator such as FLOPs and total memory use.
    */
   struct Cost {
-    uint64_t flops; // Floating point operations.
-    uint64_t bytes_moved; // Total memory used.
+    uint64_t flops{0}; // Floating point operations.
+    uint64_t bytes_moved{0}; // Total memory used.
   };
   /**
    * @brief Registers a function that takes in an OperatorDef
@@ -373,6 +379,7 @@ class OpSchema {
   std::function<bool(int, int)> inplace_enforced_ = [](int, int) {
     return false;
   };
+  bool has_tensor_inference_function_ = false;
   TensorInferenceFunctionType tensor_inference_function_ =
       [](const OperatorDef& def, const vector<TensorShape>&) {
         vector<TensorShape> out;
@@ -473,19 +480,35 @@ InferOpInputOutputDevice(const OperatorDef& op) {
   return op_schema->InferDevice(op);
 }
 
+// Helpers for cost inference functions: number of elements of a tensor
+// shape from dimension `dim` on, and its size in bytes.
+inline uint64_t nElemFromDim(const TensorShape& X, int dim = 0) {
+  uint64_t nElem = 1;
+  for (int i = dim; i < X.dims_size(); ++i) {
+    nElem *= X.dims(i);
+  }
+  return nElem;
+}
+
+inline uint64_t nBytes(const TensorShape& X) {
+  if (X.data_type() == TensorProto::UNDEFINED) {
+    return 0;
+  }
+  return nElemFromDim(X) * DataTypeToTypeMeta(X.data_type()).itemsize();
+}
+
+// Reads every input and writes an output of the size of the first one
 template <uint64_t OpsPerPoint>
 OpSchema::Cost PointwiseCostInference(
     const OperatorDef& /* unused */,
     const vector<TensorShape>& inputs) {
   struct OpSchema::Cost c;
   const TensorShape X = inputs[0];
-  uint64_t size = 1;
-
-  for (auto i = 0; i < X.dims().size(); ++i) {
-    size *= X.dims(i);
+  c.flops = nElemFromDim(X) * OpsPerPoint;
+  for (const auto& input : inputs) {
+    c.bytes_moved += nBytes(input);
   }
-
-  c.flops = size * OpsPerPoint;
+  c.bytes_moved += nBytes(X);
   return c;
 }
 
@@ -292,4 +292,20 @@ TEST(OperatorSchemaTest, TestCostInference) {
   EXPECT_EQ(2000, schema->InferCost(def, shapes).flops);
 }
 
+TEST(OperatorSchemaTest, TestPointwiseCostInference) {
+  OperatorDef def;
+  vector<TensorShape> shapes(2);
+  shapes[0].set_data_type(TensorProto::FLOAT);
+  shapes[0].add_dims(10);
+  shapes[0].add_dims(10);
+  shapes[1].set_data_type(TensorProto::DOUBLE);
+  shapes[1].add_dims(10);
+  auto cost = PointwiseCostInference<3>(def, shapes);
+  EXPECT_EQ(300, cost.flops);
+  // Both inputs read and the output written
+  EXPECT_EQ(400 + 80 + 400, cost.bytes_moved);
+  EXPECT_EQ(100, nElemFromDim(shapes[0]));
+  EXPECT_EQ(10, nElemFromDim(shapes[0], 1));
+}
+
 }  // namespace caffe2
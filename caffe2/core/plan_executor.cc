@@ -283,7 +283,7 @@ struct CompiledExecutionStep {
       // relevant for non-dynamic executions steps. This is due to the fact
       // that concurrent nets run on child workspaces, that do not needOverride.
       if (it->second.needsOverride || !workspace->GetNet(network_name)) {
-        workspace->CreateNet(*it->second.netDef, true);
+        workspace->GetOrCreateNet(*it->second.netDef);
         it->second.needsOverride = false;
       }
       auto* net = workspace->GetNet(network_name);
@@ -16,8 +16,12 @@
 
 #include "caffe2/core/predictor.h"
 
+#include <algorithm>
 #include <unordered_set>
 
+#include "caffe2/core/numa.h"
+#include "caffe2/core/scope_guard.h"
+
 namespace caffe2 {
 
 namespace {
@@ -29,26 +33,71 @@ void enforceIsTensor(Workspace* ws, const std::string& name) {
       blob->template IsType<TensorCPU>(), "Blob is not a CPU Tensor: ", name);
 }
 
-void shareInputTensor(
+TensorCPU* extractOutputTensor(Workspace* ws, const std::string& name) {
+  enforceIsTensor(ws, name);
+  auto* blob = ws->GetBlob(name);
+  CAFFE_ENFORCE(blob, "Blob: ", name, " does not exist");
+  return blob->template GetMutable<TensorCPU>();
+}
+
+// Makes the output blob `name` use the memory of `output`, without taking
+// ownership of it
+void bindOutputTensor(
     Workspace* ws,
     const std::string& name,
-    TensorCPU* input) {
-  enforceIsTensor(ws, name);
+    TensorCPU* output) {
+  CAFFE_ENFORCE(
+      output->size() == 0 || output->raw_data(),
+      "Output buffer for ",
+      name,
+      " is not allocated");
   auto* blob = ws->GetBlob(name);
   CAFFE_ENFORCE(blob, "Blob: ", name, " does not exist");
   auto* tensor = blob->template GetMutable<TensorCPU>();
-  tensor->ResizeLike(*input);
-  tensor->ShareData(*input);
+  tensor->ResizeLike(*output);
+  tensor->ShareExternalPointer(
+      output->raw_mutable_data(output->meta()),
+      output->meta(),
+      output->nbytes(),
+      [](void*) {});
 }
 
-TensorCPU* extractOutputTensor(Workspace* ws, const std::string& name) {
-  enforceIsTensor(ws, name);
+// Leaves the output blob `name` with an empty tensor if it still uses the
+// memory of `output`, which the caller may free after the run
+void unbindOutputTensor(
+    Workspace* ws,
+    const std::string& name,
+    const TensorCPU& output) {
   auto* blob = ws->GetBlob(name);
-  CAFFE_ENFORCE(blob, "Blob: ", name, " does not exist");
-  return blob->template GetMutable<TensorCPU>();
+  if (!blob || !blob->template IsType<TensorCPU>()) {
+    return;
+  }
+  auto* tensor = blob->template GetMutable<TensorCPU>();
+  if (tensor->raw_data() == output.raw_data()) {
+    TensorCPU empty;
+    tensor->swap(empty);
+  }
+}
+
+} // namespace
+
+void MoveTensorsToNUMANode(Workspace* ws, int numa_node_id) {
+  if (numa_node_id < 0 || !IsNUMAEnabled()) {
+    return;
+  }
+  for (const auto& name : ws->LocalBlobs()) {
+    auto* blob = ws->GetBlob(name);
+    if (!blob->template IsType<TensorCPU>()) {
+      continue;
+    }
+    auto* tensor = blob->template GetMutable<TensorCPU>();
+    if (tensor->size() > 0 && tensor->raw_data()) {
+      NUMAMove(tensor->raw_mutable_data(), tensor->nbytes(), numa_node_id);
+    }
+  }
 }
 
-const NetDef& getNet(const MetaNetDef& def, const std::string& name) {
+const NetDef& GetMetaNet(const MetaNetDef& def, const std::string& name) {
   for (const auto& n : def.nets()) {
     if (n.key() == name) {
       return n.value();
@@ -57,7 +106,7 @@ const NetDef& getNet(const MetaNetDef& def, const std::string& name) {
   CAFFE_THROW("Net not found: ", name);
 }
 
-const ::google::protobuf::RepeatedPtrField<::std::string>& getBlobs(
+const ::google::protobuf::RepeatedPtrField<::std::string>& GetMetaBlobs(
     const MetaNetDef& def,
     const std::string& name) {
   for (const auto& b : def.blobs()) {
@@ -67,17 +116,26 @@ const ::google::protobuf::RepeatedPtrField<::std::string>& getBlobs(
   }
   CAFFE_THROW("Blob not found: ", name);
 }
-} // namespace
+
+void ShareInputTensor(
+    Workspace* ws,
+    const std::string& name,
+    const TensorCPU& input) {
+  enforceIsTensor(ws, name);
+  auto* tensor = ws->GetBlob(name)->template GetMutable<TensorCPU>();
+  tensor->ResizeLike(input);
+  tensor->ShareData(input);
+}
 
 Predictor::Predictor(const MetaNetDef& def, Workspace* parent)
     : Predictor(
-          getNet(
+          GetMetaNet(
               def,
               PredictorConsts::default_instance().global_init_net_type()),
-          getNet(def, PredictorConsts::default_instance().predict_net_type()),
+          GetMetaNet(def, PredictorConsts::default_instance().predict_net_type()),
           parent) {
   const auto& inputs =
-      getBlobs(def, PredictorConsts::default_instance().inputs_blob_type());
+      GetMetaBlobs(def, PredictorConsts::default_instance().inputs_blob_type());
   for (const auto& input : inputs) {
     inputNames_.insert(input);
   }
@@ -89,6 +147,9 @@ Predictor::Predictor(
     Workspace* parent)
     : run_net_(run_net), ws_(parent) {
   CAFFE_ENFORCE(ws_.RunNetOnce(init_net));
+  if (run_net_.device_option().has_numa_node_id()) {
+    MoveTensorsToNUMANode(&ws_, run_net_.device_option().numa_node_id());
+  }
 
   // real model inputs can be fed later in run* functions
   const auto& initialized_vec = ws_.Blobs();
@@ -108,7 +169,7 @@ Predictor::~Predictor() {}
 bool Predictor::run(const TensorVector& inputs, TensorVector* outputs) {
   CAFFE_ENFORCE(inputs.size() <= run_net_.external_input_size());
   for (auto i = 0; i < inputs.size(); ++i) {
-    shareInputTensor(&ws_, run_net_.external_input(i), inputs[i]);
+    ShareInputTensor(&ws_, run_net_.external_input(i), *inputs[i]);
   }
 
   if (!ws_.RunNet(run_net_.name())) {
@@ -130,7 +191,7 @@ bool Predictor::run_map(const TensorMap& inputs, TensorVector* outputs) {
     if (!inputNames_.empty()) {
       CAFFE_ENFORCE_GT(inputNames_.count(input.first), 0);
     }
-    shareInputTensor(&ws_, input.first, input.second);
+    ShareInputTensor(&ws_, input.first, *input.second);
   }
 
   if (!ws_.RunNet(run_net_.name())) {
@@ -143,4 +204,68 @@ bool Predictor::run_map(const TensorMap& inputs, TensorVector* outputs) {
   }
   return true;
 }
+
+bool Predictor::run_into(
+    const TensorVector& inputs,
+    const TensorVector& outputs) {
+  CAFFE_ENFORCE(inputs.size() <= run_net_.external_input_size());
+  CAFFE_ENFORCE_EQ(outputs.size(), run_net_.external_output_size());
+  for (auto i = 0; i < inputs.size(); ++i) {
+    ShareInputTensor(&ws_, run_net_.external_input(i), *inputs[i]);
+  }
+
+  const auto& external_inputs = run_net_.external_input();
+  auto bound = 0;
+  auto guard = MakeGuard([&]() {
+    for (auto i = 0; i < bound; ++i) {
+      unbindOutputTensor(&ws_, run_net_.external_output(i), *outputs[i]);
+    }
+  });
+  for (; bound < outputs.size(); ++bound) {
+    const auto& name = run_net_.external_output(bound);
+    // Binding would overwrite a parameter or an input, not just the result
+    CAFFE_ENFORCE(
+        std::find(external_inputs.begin(), external_inputs.end(), name) ==
+            external_inputs.end(),
+        "Output ",
+        name,
+        " is an external input of the net and can't be bound");
+    bindOutputTensor(&ws_, name, outputs[bound]);
+  }
+
+  if (!ws_.RunNet(run_net_.name())) {
+    return false;
+  }
+
+  CPUContext context;
+  for (auto i = 0; i < outputs.size(); ++i) {
+    const auto& name = run_net_.external_output(i);
+    const auto* tensor = extractOutputTensor(&ws_, name);
+    auto* output = outputs[i];
+    CAFFE_ENFORCE(
+        tensor->dims() == output->dims(),
+        "Output ",
+        name,
+        " has shape ",
+        tensor->dims(),
+        " but its buffer has shape ",
+        output->dims());
+    CAFFE_ENFORCE(
+        tensor->meta() == output->meta(),
+        "Output ",
+        name,
+        " has type ",
+        tensor->meta().name(),
+        " but its buffer has type ",
+        output->meta().name());
+    if (tensor->raw_data() != output->raw_data()) {
+      context.template CopyItems<CPUContext, CPUContext>(
+          tensor->meta(),
+          tensor->size(),
+          tensor->raw_data(),
+          output->raw_mutable_data(output->meta()));
+    }
+  }
+  return true;
+}
 } // namespace caffe2
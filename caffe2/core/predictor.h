@@ -24,6 +24,27 @@
 
 namespace caffe2 {
 
+// Moves the memory of the CPU tensors local to `ws` to the NUMA node
+// `numa_node_id` (see caffe2/core/numa.h). Does nothing for negative ids or
+// when NUMA is not enabled.
+void MoveTensorsToNUMANode(Workspace* ws, int numa_node_id);
+
+// Returns the net or the blob names stored in `def` under the given key, e.g.
+// PredictorConsts::predict_net_type(). Throws if there is none.
+const NetDef& GetMetaNet(const MetaNetDef& def, const std::string& name);
+const ::google::protobuf::RepeatedPtrField<::std::string>& GetMetaBlobs(
+    const MetaNetDef& def,
+    const std::string& name);
+
+// Makes the existing CPU tensor blob `name` of `ws` share the memory of
+// `input`.
+void ShareInputTensor(
+    Workspace* ws,
+    const std::string& name,
+    const TensorCPU& input);
+
+// A run_net bound to a NUMA node, with `numa_node_id` set in its
+// device_option, gets its parameters moved to that node once init_net ran.
 class Predictor {
  public:
   using TensorVector = std::vector<TensorCPU*>;
@@ -57,6 +78,23 @@ class Predictor {
   // Similar to run, but consumes a map of name to tensor as input
   bool run_map(const TensorMap& inputs, TensorVector* outputs);
 
+  // Similar to run, but the outputs are written into caller-owned tensors
+  // instead of being returned as pointers into the workspace.
+  // Each tensor of `outputs` must already be allocated with the type and
+  // shape the corresponding external output will have: its memory is bound
+  // to the output blob before the run, so that the operator producing it
+  // writes there directly. Outputs that end up elsewhere anyway (e.g. an
+  // operator that aliases its input) are copied into the caller's memory.
+  // The buffers are unbound before returning.
+
+  // Precondition:
+  //   inputs.size() <= run_net_.external_inputs.size()
+  //   outputs.size() == run_net_.external_outputs.size()
+
+  // Throws if an output does not have the shape or type of its buffer
+  // Returns true on success
+  bool run_into(const TensorVector& inputs, const TensorVector& outputs);
+
   const NetDef& def() const {
     return run_net_;
   };
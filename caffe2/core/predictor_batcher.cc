@@ -0,0 +1,249 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/predictor_batcher.h"
+
+#include "caffe2/core/context.h"
+
+namespace caffe2 {
+
+namespace {
+
+// Index of the power of two bucket of the histogram holding `size`:
+// 1, 2, 3-4, 5-8, ...
+size_t histogramBucket(TIndex size) {
+  size_t bucket = 0;
+  while ((TIndex(1) << bucket) < size) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+std::vector<std::string> histogramBucketNames(TIndex max_size) {
+  std::vector<std::string> names;
+  for (size_t bucket = 0; bucket <= histogramBucket(max_size); ++bucket) {
+    TIndex high = TIndex(1) << bucket;
+    TIndex low = high / 2 + 1;
+    names.push_back(
+        low == high ? MakeString(high) : MakeString(low, "_", high));
+  }
+  return names;
+}
+
+template <class Duration>
+int64_t Micros(Duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+} // namespace
+
+PredictorBatcher::PredictorBatcher(
+    std::unique_ptr<Predictor> predictor,
+    TIndex max_batch_size,
+    std::chrono::microseconds max_wait)
+    : predictor_(std::move(predictor)),
+      max_batch_size_(max_batch_size),
+      max_wait_(max_wait),
+      stats_("predictor_batcher/" + predictor_->def().name()) {
+  CAFFE_ENFORCE_GT(max_batch_size_, 0);
+  stats_.batch_size_histogram.setDetails(
+      histogramBucketNames(max_batch_size_));
+  thread_ = std::thread(&PredictorBatcher::mainLoop, this);
+}
+
+PredictorBatcher::~PredictorBatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+std::future<PredictorBatcher::OutputVector> PredictorBatcher::runAsync(
+    const TensorVector& inputs) {
+  const auto& def = predictor_->def();
+  CAFFE_ENFORCE(!inputs.empty(), "Requests need at least one input");
+  CAFFE_ENFORCE_LE(inputs.size(), def.external_input_size());
+
+  std::unique_ptr<Request> request(new Request());
+  request->rows = -1;
+  request->inputs.resize(inputs.size());
+  for (auto i = 0; i < inputs.size(); ++i) {
+    const auto& input = *inputs[i];
+    CAFFE_ENFORCE_GT(
+        input.ndim(), 0, "Input ", def.external_input(i), " is a scalar");
+    if (request->rows < 0) {
+      request->rows = input.dim(0);
+    }
+    CAFFE_ENFORCE_EQ(
+        input.dim(0),
+        request->rows,
+        "All the inputs of a request must have the same first dimension");
+    request->inputs[i].ResizeLike(input);
+    request->inputs[i].ShareData(input);
+  }
+  request->enqueued = std::chrono::steady_clock::now();
+  auto future = request->promise.get_future();
+
+  CAFFE_EVENT(stats_, requests);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CAFFE_ENFORCE(!stopped_, "Batcher is stopped");
+    queued_rows_ += request->rows;
+    queue_.push_back(std::move(request));
+  }
+  cv_.notify_one();
+  return future;
+}
+
+bool PredictorBatcher::canBatch(const Request& first, const Request& next)
+    const {
+  if (first.inputs.size() != next.inputs.size()) {
+    return false;
+  }
+  for (auto i = 0; i < first.inputs.size(); ++i) {
+    const auto& a = first.inputs[i];
+    const auto& b = next.inputs[i];
+    if (a.meta() != b.meta() || a.ndim() != b.ndim()) {
+      return false;
+    }
+    for (auto d = 1; d < a.ndim(); ++d) {
+      if (a.dim(d) != b.dim(d)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void PredictorBatcher::mainLoop() {
+  std::vector<std::unique_ptr<Request>> batch;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return !queue_.empty() || stopped_; });
+      if (queue_.empty()) {
+        return;
+      }
+      cv_.wait_until(lock, queue_.front()->enqueued + max_wait_, [this]() {
+        return queued_rows_ >= max_batch_size_ || stopped_;
+      });
+
+      TIndex rows = 0;
+      while (!queue_.empty()) {
+        auto& next = queue_.front();
+        if (!batch.empty() &&
+            (rows + next->rows > max_batch_size_ ||
+             !canBatch(*batch.front(), *next))) {
+          break;
+        }
+        rows += next->rows;
+        queued_rows_ -= next->rows;
+        batch.push_back(std::move(next));
+        queue_.pop_front();
+      }
+    }
+    runBatch(&batch);
+    batch.clear();
+  }
+}
+
+void PredictorBatcher::runBatch(std::vector<std::unique_ptr<Request>>* batch) {
+  const auto start = std::chrono::steady_clock::now();
+  TIndex rows = 0;
+  for (const auto& request : *batch) {
+    CAFFE_EVENT(stats_, queue_latency_us, Micros(start - request->enqueued));
+    rows += request->rows;
+  }
+  CAFFE_EVENT(stats_, batch_size, rows);
+  CAFFE_EVENT(stats_, batch_size_histogram, 1, histogramBucket(rows));
+
+  CPUContext context;
+  std::vector<OutputVector> results(batch->size());
+  try {
+    // Concatenate the inputs along the first dimension, unless there is
+    // nothing to concatenate
+    const auto& first = batch->front()->inputs;
+    std::vector<TensorCPU> concatenated(batch->size() > 1 ? first.size() : 0);
+    TensorVector inputs(first.size());
+    for (auto i = 0; i < first.size(); ++i) {
+      if (concatenated.empty()) {
+        inputs[i] = const_cast<TensorCPU*>(&first[i]);
+        continue;
+      }
+      auto dims = first[i].dims();
+      dims[0] = rows;
+      auto& input = concatenated[i];
+      input.Resize(dims);
+      auto* dst = static_cast<char*>(input.raw_mutable_data(first[i].meta()));
+      for (const auto& request : *batch) {
+        const auto& part = request->inputs[i];
+        context.CopyItems<CPUContext, CPUContext>(
+            part.meta(), part.size(), part.raw_data(), dst);
+        dst += part.nbytes();
+      }
+      inputs[i] = &input;
+    }
+
+    TensorVector outputs;
+    CAFFE_ENFORCE(predictor_->run(inputs, &outputs), "Batched run failed");
+
+    // Split the outputs back
+    for (auto& result : results) {
+      result.resize(outputs.size());
+    }
+    for (auto o = 0; o < outputs.size(); ++o) {
+      const auto& output = *outputs[o];
+      CAFFE_ENFORCE(
+          output.ndim() > 0 && output.dim(0) == rows,
+          "Output ",
+          predictor_->def().external_output(o),
+          " does not have one row per input row, can't split it");
+      const auto row_bytes =
+          rows > 0 ? output.size() / rows * output.itemsize() : 0;
+      const auto* src = static_cast<const char*>(output.raw_data());
+      for (auto r = 0; r < batch->size(); ++r) {
+        auto dims = output.dims();
+        dims[0] = (*batch)[r]->rows;
+        auto& part = results[r][o];
+        part.Resize(dims);
+        context.CopyItems<CPUContext, CPUContext>(
+            output.meta(),
+            part.size(),
+            src,
+            part.raw_mutable_data(output.meta()));
+        src += dims[0] * row_bytes;
+      }
+    }
+  } catch (...) {
+    for (auto& request : *batch) {
+      request->promise.set_exception(std::current_exception());
+    }
+    return;
+  }
+
+  CAFFE_EVENT(
+      stats_,
+      run_latency_us,
+      Micros(std::chrono::steady_clock::now() - start));
+  for (auto r = 0; r < batch->size(); ++r) {
+    (*batch)[r]->promise.set_value(std::move(results[r]));
+  }
+}
+
+} // namespace caffe2
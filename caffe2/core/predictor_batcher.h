@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "caffe2/core/predictor.h"
+#include "caffe2/core/stats.h"
+#include "caffe2/core/tensor.h"
+
+namespace caffe2 {
+
+// Batches concurrent requests to a Predictor.
+//
+// Requests are queued, and a single thread runs them in batches: it waits
+// until the queued requests add up to `max_batch_size` rows, or until the
+// oldest one has waited for `max_wait`, whichever comes first. The inputs of
+// the batched requests are concatenated along their first dimension, the
+// predictor runs once, and its outputs are split back along the first
+// dimension into each request's result.
+//
+// All the inputs of a request must have the same first dimension, and every
+// output of the net must have one row per input row. Requests whose inputs
+// differ in type or in the other dimensions are not batched together.
+class PredictorBatcher {
+ public:
+  using TensorVector = Predictor::TensorVector;
+  using OutputVector = std::vector<TensorCPU>;
+
+  PredictorBatcher(
+      std::unique_ptr<Predictor> predictor,
+      TIndex max_batch_size,
+      std::chrono::microseconds max_wait);
+  // Runs the requests still in the queue before returning.
+  ~PredictorBatcher();
+
+  // Queues a request on the first `inputs.size()` external inputs of the
+  // net. The data of the inputs is shared, not copied, and must not be
+  // modified until the result is ready.
+  std::future<OutputVector> runAsync(const TensorVector& inputs);
+
+  // Blocking version of runAsync.
+  OutputVector run(const TensorVector& inputs) {
+    return runAsync(inputs).get();
+  }
+
+  TIndex max_batch_size() const {
+    return max_batch_size_;
+  }
+
+ private:
+  struct Request {
+    std::vector<TensorCPU> inputs;
+    TIndex rows;
+    std::promise<OutputVector> promise;
+    std::chrono::steady_clock::time_point enqueued;
+  };
+
+  void mainLoop();
+  bool canBatch(const Request& first, const Request& next) const;
+  void runBatch(std::vector<std::unique_ptr<Request>>* batch);
+
+  std::unique_ptr<Predictor> predictor_;
+  const TIndex max_batch_size_;
+  const std::chrono::microseconds max_wait_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::unique_ptr<Request>> queue_;
+  TIndex queued_rows_ = 0;
+  bool stopped_ = false;
+
+  struct PredictorBatcherStats {
+    CAFFE_STAT_CTOR(PredictorBatcherStats);
+    CAFFE_EXPORTED_STAT(requests);
+    CAFFE_AVG_EXPORTED_STAT(batch_size);
+    // Number of batches per batch size, in power of two buckets
+    CAFFE_DETAILED_EXPORTED_STAT(batch_size_histogram);
+    CAFFE_AVG_EXPORTED_STAT(queue_latency_us);
+    CAFFE_AVG_EXPORTED_STAT(run_latency_us);
+  } stats_;
+
+  // Started last, once everything it uses is initialized
+  std::thread thread_;
+};
+
+} // namespace caffe2
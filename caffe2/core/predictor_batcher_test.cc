@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <google/protobuf/text_format.h>
+#include "caffe2/core/context.h"
+#include "caffe2/core/predictor_batcher.h"
+#include "caffe2/core/stats.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/utils/math.h"
+
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// y = data * W^T + b, with W filled with 1 and b with 0: each output row
+// holds the sum of the corresponding input row 10 times.
+const char* predictSpec = R"DOC(
+        name: "batched_predict"
+        type: "simple"
+        external_input: "data"
+        external_input: "W"
+        external_input: "b"
+        external_output: "y"
+        op {
+          input: "data"
+          input: "W"
+          input: "b"
+          output: "y"
+          type: "FC"
+        }
+)DOC";
+
+const char* initSpec = R"DOC(
+        name: "init"
+        type: "simple"
+        op {
+          type: "ConstantFill"
+          output: "W"
+          arg {
+            name: "shape"
+            ints: 10
+            ints: 4
+          }
+          arg {
+            name: "value"
+            f: 1.0
+          }
+        }
+        op {
+          type: "ConstantFill"
+          output: "b"
+          arg {
+            name: "shape"
+            ints: 10
+          }
+          arg {
+            name: "value"
+            f: 0.0
+          }
+        }
+)DOC";
+
+std::unique_ptr<Predictor> createPredictor() {
+  NetDef init, run;
+  CAFFE_ENFORCE(google::protobuf::TextFormat::ParseFromString(initSpec, &init));
+  CAFFE_ENFORCE(
+      google::protobuf::TextFormat::ParseFromString(predictSpec, &run));
+  return caffe2::make_unique<Predictor>(init, run);
+}
+
+// `rows` x 4 input whose row i is filled with `value + i`
+std::unique_ptr<TensorCPU> input(TIndex rows, float value) {
+  auto t = caffe2::make_unique<TensorCPU>(std::vector<TIndex>{rows, 4});
+  auto* data = t->mutable_data<float>();
+  for (int i = 0; i < t->size(); ++i) {
+    data[i] = value + i / 4;
+  }
+  return t;
+}
+
+void expectOutput(
+    const PredictorBatcher::OutputVector& output,
+    TIndex rows,
+    float value) {
+  ASSERT_EQ(output.size(), 1);
+  ASSERT_EQ(output[0].dims(), (std::vector<TIndex>{rows, 10}));
+  for (int i = 0; i < output[0].size(); ++i) {
+    EXPECT_EQ(output[0].data<float>()[i], 4 * (value + i / 10));
+  }
+}
+
+int64_t getStat(const std::string& name) {
+  auto stats = toMap(StatRegistry::get().publish());
+  auto it = stats.find("predictor_batcher/batched_predict/" + name);
+  return it == stats.end() ? 0 : it->second;
+}
+
+} // namespace
+
+TEST(PredictorBatcherTest, BatchesConcurrentRequests) {
+  const auto batches = getStat("batch_size/count");
+  const auto full_batches = getStat("batch_size_histogram/5_8");
+  {
+    // Long enough for all the requests below to be queued
+    PredictorBatcher batcher(
+        createPredictor(), 8, std::chrono::microseconds(1000000));
+    std::vector<std::unique_ptr<TensorCPU>> inputs;
+    std::vector<std::future<PredictorBatcher::OutputVector>> futures;
+    for (int i = 0; i < 4; ++i) {
+      inputs.push_back(input(2, 10 * i));
+      futures.push_back(batcher.runAsync({inputs.back().get()}));
+    }
+    for (int i = 0; i < 4; ++i) {
+      expectOutput(futures[i].get(), 2, 10 * i);
+    }
+  }
+  EXPECT_EQ(getStat("batch_size/count") - batches, 1);
+  EXPECT_EQ(getStat("batch_size_histogram/5_8") - full_batches, 1);
+}
+
+TEST(PredictorBatcherTest, FlushesAfterMaxWait) {
+  PredictorBatcher batcher(
+      createPredictor(), 64, std::chrono::microseconds(1000));
+  auto in = input(3, 1);
+  expectOutput(batcher.run({in.get()}), 3, 1);
+}
+
+TEST(PredictorBatcherTest, SplitsBatchesAtMaxBatchSize) {
+  const auto batches = getStat("batch_size/count");
+  {
+    // The last request waits for max_wait, as it doesn't fill a batch
+    PredictorBatcher batcher(
+        createPredictor(), 4, std::chrono::microseconds(100000));
+    std::vector<std::unique_ptr<TensorCPU>> inputs;
+    std::vector<std::future<PredictorBatcher::OutputVector>> futures;
+    for (int i = 0; i < 3; ++i) {
+      inputs.push_back(input(3, i));
+      futures.push_back(batcher.runAsync({inputs.back().get()}));
+    }
+    for (int i = 0; i < 3; ++i) {
+      expectOutput(futures[i].get(), 3, i);
+    }
+  }
+  EXPECT_EQ(getStat("batch_size/count") - batches, 3);
+}
+
+TEST(PredictorBatcherTest, DoesNotBatchIncompatibleShapes) {
+  PredictorBatcher batcher(
+      createPredictor(), 8, std::chrono::microseconds(1000));
+  auto good = input(1, 1);
+  TensorCPU bad(std::vector<TIndex>{1, 5});
+  bad.mutable_data<float>();
+  auto bad_future = batcher.runAsync({&bad});
+  auto good_future = batcher.runAsync({good.get()});
+  EXPECT_THROW(bad_future.get(), EnforceNotMet);
+  expectOutput(good_future.get(), 1, 1);
+}
+
+TEST(PredictorBatcherTest, RejectsMismatchedInputRows) {
+  PredictorBatcher batcher(
+      createPredictor(), 8, std::chrono::microseconds(1000));
+  auto a = input(1, 1);
+  auto b = input(2, 1);
+  EXPECT_THROW(batcher.runAsync({a.get(), b.get()}), EnforceNotMet);
+}
+
+} // namespace caffe2
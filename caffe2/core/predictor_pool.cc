@@ -0,0 +1,207 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/predictor_pool.h"
+
+#include "caffe2/core/numa.h"
+#include "caffe2/core/scope_guard.h"
+#include "caffe2/proto/predictor_consts.pb.h"
+
+namespace caffe2 {
+
+PredictorPool::PredictorPool(
+    const MetaNetDef& def,
+    size_t max_instances,
+    Workspace* parent)
+    : run_net_(GetMetaNet(
+          def,
+          PredictorConsts::default_instance().predict_net_type())),
+      ws_(parent),
+      max_instances_(max_instances) {
+  CAFFE_ENFORCE(ws_.RunNetOnce(GetMetaNet(
+      def, PredictorConsts::default_instance().global_init_net_type())));
+  const auto& inputs = GetMetaBlobs(
+      def, PredictorConsts::default_instance().inputs_blob_type());
+  initialize({inputs.begin(), inputs.end()});
+}
+
+PredictorPool::PredictorPool(
+    const NetDef& init_net,
+    const NetDef& run_net,
+    size_t max_instances,
+    Workspace* parent)
+    : run_net_(run_net), ws_(parent), max_instances_(max_instances) {
+  CAFFE_ENFORCE(ws_.RunNetOnce(init_net));
+
+  // Without meta-info, the inputs are the external inputs that `init_net`
+  // did not create
+  std::unordered_set<std::string> input_names;
+  for (const auto& name : run_net_.external_input()) {
+    if (!ws_.HasBlob(name)) {
+      input_names.insert(name);
+    }
+  }
+  initialize(input_names);
+}
+
+PredictorPool::~PredictorPool() {}
+
+void PredictorPool::initialize(
+    const std::unordered_set<std::string>& input_names) {
+  if (run_net_.device_option().has_numa_node_id()) {
+    MoveTensorsToNUMANode(&ws_, run_net_.device_option().numa_node_id());
+  }
+  inputNames_ = input_names;
+  localNames_ = input_names;
+  const std::unordered_set<std::string> external_inputs(
+      run_net_.external_input().begin(), run_net_.external_input().end());
+  for (const auto& op : run_net_.op()) {
+    for (const auto& output : op.output()) {
+      CAFFE_ENFORCE(
+          inputNames_.count(output) || !external_inputs.count(output) ||
+              !ws_.HasBlob(output),
+          "run_net updates blob ",
+          output,
+          " in place, but it is shared by all the instances");
+      localNames_.insert(output);
+    }
+  }
+}
+
+size_t PredictorPool::num_instances() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_instances_;
+}
+
+std::unique_ptr<PredictorPool::Instance> PredictorPool::createInstance() {
+  std::unique_ptr<Instance> instance(new Instance());
+  instance->ws.reset(new Workspace(&ws_));
+  for (const auto& name : localNames_) {
+    auto* blob = instance->ws->CreateLocalBlob(name);
+    if (!inputNames_.count(name)) {
+      continue;
+    }
+    auto* tensor = blob->template GetMutable<TensorCPU>();
+    // Inputs that `init_net` filled keep their value until they are fed
+    const auto* initialized = ws_.GetBlob(name);
+    if (initialized && initialized->template IsType<TensorCPU>()) {
+      const auto& value = initialized->template Get<TensorCPU>();
+      if (value.size() == 0 || value.raw_data()) {
+        tensor->ResizeLike(value);
+        tensor->ShareData(value);
+      }
+    }
+  }
+  instance->net = instance->ws->CreateNet(run_net_);
+  CAFFE_ENFORCE(instance->net, "Failed to create net ", run_net_.name());
+  return instance;
+}
+
+PredictorPool::Instance* PredictorPool::acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  released_.wait(lock, [this]() {
+    return !idle_.empty() || max_instances_ == 0 ||
+        num_instances_ < max_instances_;
+  });
+  if (!idle_.empty()) {
+    auto* instance = idle_.back();
+    idle_.pop_back();
+    return instance;
+  }
+
+  // Instantiating the net can take a while, don't block other requests
+  ++num_instances_;
+  lock.unlock();
+  std::unique_ptr<Instance> instance;
+  try {
+    instance = createInstance();
+  } catch (...) {
+    lock.lock();
+    --num_instances_;
+    released_.notify_one();
+    throw;
+  }
+  lock.lock();
+  instances_.push_back(std::move(instance));
+  return instances_.back().get();
+}
+
+void PredictorPool::release(Instance* instance) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.push_back(instance);
+  }
+  released_.notify_one();
+}
+
+bool PredictorPool::run(const TensorVector& inputs, OutputVector* outputs) {
+  CAFFE_ENFORCE(inputs.size() <= run_net_.external_input_size());
+  auto* instance = acquire();
+  auto guard = MakeGuard([&]() { release(instance); });
+  for (auto i = 0; i < inputs.size(); ++i) {
+    const auto& name = run_net_.external_input(i);
+    CAFFE_ENFORCE(
+        inputNames_.count(name),
+        "Blob ",
+        name,
+        " is shared by all the instances and can not be fed");
+    ShareInputTensor(instance->ws.get(), name, *inputs[i]);
+  }
+  return runInstance(instance, outputs);
+}
+
+bool PredictorPool::run_map(const TensorMap& inputs, OutputVector* outputs) {
+  auto* instance = acquire();
+  auto guard = MakeGuard([&]() { release(instance); });
+  for (const auto& input : inputs) {
+    CAFFE_ENFORCE(
+        inputNames_.count(input.first),
+        "Blob ",
+        input.first,
+        " is not an input");
+    ShareInputTensor(instance->ws.get(), input.first, *input.second);
+  }
+  return runInstance(instance, outputs);
+}
+
+bool PredictorPool::runInstance(Instance* instance, OutputVector* outputs) {
+  if (!instance->net->Run()) {
+    return false;
+  }
+
+  outputs->resize(run_net_.external_output_size());
+  for (auto i = 0; i < outputs->size(); ++i) {
+    const auto& name = run_net_.external_output(i);
+    auto* blob = instance->ws->GetBlob(name);
+    CAFFE_ENFORCE(blob, "Blob: ", name, " does not exist");
+    CAFFE_ENFORCE(
+        blob->template IsType<TensorCPU>(), "Blob is not a CPU Tensor: ", name);
+    auto* tensor = blob->template GetMutable<TensorCPU>();
+    if (!localNames_.count(name)) {
+      // Shared blob, it can't be handed over
+      (*outputs)[i].CopyFrom(*tensor);
+      continue;
+    }
+    // Hand the output over to the caller, and leave the instance with an
+    // empty tensor rather than whatever the caller's tensor held
+    TensorCPU empty;
+    (*outputs)[i].swap(*tensor);
+    tensor->swap(empty);
+  }
+  return true;
+}
+
+} // namespace caffe2
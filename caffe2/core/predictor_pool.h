@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <unordered_set>
+
+#include "caffe2/core/net.h"
+#include "caffe2/core/predictor.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/proto/metanet.pb.h"
+
+namespace caffe2 {
+
+// Thread-safe counterpart of Predictor for serving concurrent requests.
+//
+// `init_net` runs once, into a parameter workspace. Each request is then run
+// by one of a set of instances, each one being a child workspace of the
+// parameter workspace with its own `run_net`: the parameters are shared by
+// all the instances, while inputs, intermediate results and outputs are local
+// to each instance. Instances are created on demand, up to `max_instances`
+// of them (no limit if 0); once that many requests are in flight, further
+// requests wait for an instance to be released.
+//
+// As with Predictor, a run_net bound to a NUMA node gets its parameters moved
+// to that node.
+class PredictorPool {
+ public:
+  using TensorVector = Predictor::TensorVector;
+  using TensorMap = Predictor::TensorMap;
+  using OutputVector = std::vector<TensorCPU>;
+
+  PredictorPool(
+      const MetaNetDef& net,
+      size_t max_instances = 0,
+      Workspace* parent = nullptr);
+
+  PredictorPool(
+      const NetDef& init_net,
+      const NetDef& run_net,
+      size_t max_instances = 0,
+      Workspace* parent = nullptr);
+  ~PredictorPool();
+
+  // Same as Predictor::run, except that the outputs are moved into tensors
+  // owned by the caller, so that they stay valid while other requests run.
+  // Can be called concurrently from multiple threads.
+  bool run(const TensorVector& inputs, OutputVector* outputs);
+
+  // Similar to run, but consumes a map of name to tensor as input
+  bool run_map(const TensorMap& inputs, OutputVector* outputs);
+
+  const NetDef& def() const {
+    return run_net_;
+  }
+
+  // Workspace holding the parameters shared by all the instances
+  Workspace* ws() {
+    return &ws_;
+  }
+
+  size_t max_instances() const {
+    return max_instances_;
+  }
+
+  // Number of instances created so far
+  size_t num_instances() const;
+
+ private:
+  struct Instance {
+    std::unique_ptr<Workspace> ws;
+    NetBase* net;
+  };
+
+  void initialize(const std::unordered_set<std::string>& input_names);
+  Instance* acquire();
+  void release(Instance* instance);
+  std::unique_ptr<Instance> createInstance();
+  bool runInstance(Instance* instance, OutputVector* outputs);
+
+  NetDef run_net_;
+  Workspace ws_;
+  const size_t max_instances_;
+  // Blobs that are local to each instance: request inputs and everything
+  // written by `run_net`
+  std::unordered_set<std::string> inputNames_;
+  std::unordered_set<std::string> localNames_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable released_;
+  size_t num_instances_ = 0;
+  std::vector<std::unique_ptr<Instance>> instances_;
+  std::vector<Instance*> idle_;
+};
+
+} // namespace caffe2
@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <thread>
+
+#include <google/protobuf/text_format.h>
+#include "caffe2/core/context.h"
+#include "caffe2/core/predictor.h"
+#include "caffe2/core/predictor_pool.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/utils/math.h"
+
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+const char* predictSpec = R"DOC(
+        name: "predict"
+        type: "simple"
+        external_input: "data"
+        external_input: "W"
+        external_input: "b"
+        external_output: "y"
+        op {
+          input: "data"
+          input: "W"
+          input: "b"
+          output: "y"
+          type: "FC"
+        }
+)DOC";
+
+const char* initSpec = R"DOC(
+        name: "init"
+        type: "simple"
+        op {
+          type: "ConstantFill"
+          output: "W"
+          arg {
+            name: "shape"
+            ints: 10
+            ints: 4
+          }
+          arg {
+            name: "value"
+            f: 2.0
+          }
+        }
+        op {
+          type: "ConstantFill"
+          output: "b"
+          arg {
+            name: "shape"
+            ints: 10
+          }
+          arg {
+            name: "value"
+            f: 1.0
+          }
+        }
+)DOC";
+
+NetDef parseNetDef(const std::string& value) {
+  NetDef def;
+  CAFFE_ENFORCE(
+      google::protobuf::TextFormat::ParseFromString(value, &def),
+      "Failed to parse NetDef with value: ",
+      value);
+  return def;
+}
+
+std::unique_ptr<Blob> constantTensor(const std::vector<TIndex>& dims, float v) {
+  auto blob = make_unique<Blob>();
+  auto* t = blob->GetMutable<TensorCPU>();
+  t->Resize(dims);
+  CPUContext ctx;
+  math::Set<float, CPUContext>(
+      t->size(), v, t->template mutable_data<float>(), &ctx);
+  return blob;
+}
+
+} // namespace
+
+TEST(PredictorPoolTest, MatchesPredictor) {
+  Predictor predictor(parseNetDef(initSpec), parseNetDef(predictSpec));
+  PredictorPool pool(parseNetDef(initSpec), parseNetDef(predictSpec));
+
+  auto data = constantTensor({2, 4}, 3.0);
+  Predictor::TensorVector input{data->GetMutable<TensorCPU>()};
+  Predictor::TensorVector expected;
+  ASSERT_TRUE(predictor.run(input, &expected));
+
+  PredictorPool::OutputVector first;
+  ASSERT_TRUE(pool.run(input, &first));
+  ASSERT_EQ(first.size(), 1);
+  EXPECT_EQ(first[0].dims(), expected[0]->dims());
+  for (int i = 0; i < first[0].size(); ++i) {
+    EXPECT_EQ(first[0].data<float>()[i], expected[0]->data<float>()[i]);
+    EXPECT_EQ(first[0].data<float>()[i], 4 * 2 * 3 + 1);
+  }
+
+  // Outputs belong to the caller and survive later runs
+  auto other = constantTensor({2, 4}, 1.0);
+  PredictorPool::OutputVector second;
+  ASSERT_TRUE(pool.run({other->GetMutable<TensorCPU>()}, &second));
+  EXPECT_EQ(first[0].data<float>()[0], 25);
+  EXPECT_EQ(second[0].data<float>()[0], 9);
+  EXPECT_EQ(pool.num_instances(), 1);
+}
+
+TEST(PredictorPoolTest, RunMap) {
+  PredictorPool pool(parseNetDef(initSpec), parseNetDef(predictSpec));
+  auto data = constantTensor({1, 4}, 1.0);
+  PredictorPool::OutputVector output;
+  ASSERT_TRUE(
+      pool.run_map({{"data", data->GetMutable<TensorCPU>()}}, &output));
+  EXPECT_EQ(output[0].data<float>()[0], 9);
+
+  auto w = constantTensor({10, 4}, 1.0);
+  EXPECT_THROW(
+      pool.run_map({{"W", w->GetMutable<TensorCPU>()}}, &output),
+      EnforceNotMet);
+}
+
+TEST(PredictorPoolTest, SharesParametersUpToMaxInstances) {
+  const int kNumThreads = 8;
+  const int kMaxInstances = 3;
+  PredictorPool pool(
+      parseNetDef(initSpec), parseNetDef(predictSpec), kMaxInstances);
+  const auto* weights = pool.ws()->GetBlob("W")->Get<TensorCPU>().raw_data();
+
+  std::atomic<int> failures(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 50; ++i) {
+        auto data = constantTensor({1, 4}, t);
+        PredictorPool::OutputVector output;
+        if (!pool.run({data->GetMutable<TensorCPU>()}, &output) ||
+            output[0].data<float>()[0] != 8 * t + 1) {
+          ++failures;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(failures, 0);
+  EXPECT_GE(pool.num_instances(), 1);
+  EXPECT_LE(pool.num_instances(), kMaxInstances);
+  // Parameters were neither copied nor reallocated
+  EXPECT_EQ(pool.ws()->GetBlob("W")->Get<TensorCPU>().raw_data(), weights);
+}
+
+TEST(PredictorPoolTest, RejectsInPlaceParameterUpdates) {
+  auto run_net = parseNetDef(predictSpec);
+  run_net.mutable_op(0)->set_output(0, "W");
+  EXPECT_THROW(PredictorPool(parseNetDef(initSpec), run_net), EnforceNotMet);
+}
+
+} // namespace caffe2
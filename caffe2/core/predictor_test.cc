@@ -214,6 +214,51 @@ TEST_F(PredictorTest, SimpleBatchSizedMapInput) {
   EXPECT_NEAR(output.front()->data<float>()[4], 0.1209, 1E-4);
 }
 
+TEST_F(PredictorTest, RunIntoCallerBuffers) {
+  auto inputData = randomTensor({1, 4}, ctx_.get());
+  Predictor::TensorVector input{inputData->template GetMutable<TensorCPU>()};
+  Predictor::TensorVector expected;
+  p_->run(input, &expected);
+  const std::vector<float> values(
+      expected[0]->data<float>(),
+      expected[0]->data<float>() + expected[0]->size());
+
+  TensorCPU buffer(std::vector<TIndex>{1, 10});
+  const auto* data = buffer.mutable_data<float>();
+  EXPECT_TRUE(p_->run_into(input, {&buffer}));
+  // The output was written in place
+  EXPECT_EQ(buffer.data<float>(), data);
+  for (int i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(buffer.data<float>()[i], values[i]);
+  }
+
+  // The buffer is not used by later runs
+  auto otherData = randomTensor({1, 4}, ctx_.get());
+  Predictor::TensorVector output;
+  p_->run({otherData->template GetMutable<TensorCPU>()}, &output);
+  EXPECT_NE(output[0]->data<float>(), data);
+  EXPECT_EQ(buffer.data<float>()[4], values[4]);
+}
+
+TEST_F(PredictorTest, RunIntoValidatesBuffers) {
+  auto inputData = randomTensor({2, 4}, ctx_.get());
+  Predictor::TensorVector input{inputData->template GetMutable<TensorCPU>()};
+  TensorCPU wrongShape(std::vector<TIndex>{1, 10});
+  wrongShape.mutable_data<float>();
+  EXPECT_THROW(p_->run_into(input, {&wrongShape}), EnforceNotMet);
+  TensorCPU wrongType(std::vector<TIndex>{2, 10});
+  wrongType.mutable_data<int>();
+  EXPECT_THROW(p_->run_into(input, {&wrongType}), EnforceNotMet);
+  TensorCPU unallocated(std::vector<TIndex>{2, 10});
+  EXPECT_THROW(p_->run_into(input, {&unallocated}), EnforceNotMet);
+  EXPECT_THROW(p_->run_into(input, {}), EnforceNotMet);
+
+  // Still usable after the failed runs
+  TensorCPU buffer(std::vector<TIndex>{2, 10});
+  buffer.mutable_data<float>();
+  EXPECT_TRUE(p_->run_into(input, {&buffer}));
+}
+
 class PredictorMetaNetDefTest : public testing::Test {
  public:
   void SetUp() override {
@@ -16,11 +16,20 @@
 
 #include "caffe2/core/stats.h"
 
+#include <algorithm>
+#include <cmath>
 #include <condition_variable>
 #include <thread>
 
 namespace caffe2 {
 
+namespace {
+
+// Keys exported per histogram
+constexpr int kHistogramKeys = 6;
+
+} // namespace
+
 ExportedStatMap toMap(const ExportedStatList& stats) {
   ExportedStatMap statMap;
   for (const auto& stat : stats) {
@@ -30,6 +39,86 @@ ExportedStatMap toMap(const ExportedStatList& stats) {
   return statMap;
 }
 
+constexpr int HistogramStatValue::kSubBucketBits;
+constexpr int HistogramStatValue::kSubBuckets;
+constexpr int HistogramStatValue::kNumBuckets;
+
+int64_t HistogramStatValue::Snapshot::percentile(double p) const {
+  if (count == 0) {
+    return 0;
+  }
+  const auto rank = std::max<int64_t>(std::ceil(p * count), 1);
+  int64_t seen = 0;
+  for (int i = 0; i < buckets.size(); ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      // Middle of the bucket
+      const auto lower = bucketLowerBound(i);
+      const auto upper = i + 1 < kNumBuckets
+          ? bucketLowerBound(i + 1) - 1
+          : std::numeric_limits<int64_t>::max();
+      return std::min(lower + (upper - lower) / 2, max);
+    }
+  }
+  return max;
+}
+
+HistogramStatValue::HistogramStatValue() {
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+int64_t HistogramStatValue::bucketLowerBound(int index) {
+  if (index < 2 * kSubBuckets) {
+    return index;
+  }
+  const int shift = index / kSubBuckets - 1;
+  return static_cast<int64_t>(index % kSubBuckets + kSubBuckets) << shift;
+}
+
+void HistogramStatValue::merge(const HistogramStatValue& other) {
+  merge(other.get());
+}
+
+void HistogramStatValue::merge(const Snapshot& snapshot) {
+  for (int i = 0; i < snapshot.buckets.size(); ++i) {
+    if (snapshot.buckets[i]) {
+      buckets_[i].fetch_add(snapshot.buckets[i], std::memory_order_relaxed);
+    }
+  }
+  sum_.fetch_add(snapshot.sum, std::memory_order_relaxed);
+  auto max = max_.load(std::memory_order_relaxed);
+  while (snapshot.max > max &&
+         !max_.compare_exchange_weak(
+             max, snapshot.max, std::memory_order_relaxed)) {
+  }
+}
+
+HistogramStatValue::Snapshot HistogramStatValue::get() const {
+  Snapshot snapshot;
+  snapshot.buckets.resize(kNumBuckets);
+  for (int i = 0; i < kNumBuckets; ++i) {
+    snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    snapshot.count += snapshot.buckets[i];
+  }
+  snapshot.sum = sum_.load(std::memory_order_relaxed);
+  snapshot.max = max_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+HistogramStatValue::Snapshot HistogramStatValue::reset() {
+  Snapshot snapshot;
+  snapshot.buckets.resize(kNumBuckets);
+  for (int i = 0; i < kNumBuckets; ++i) {
+    snapshot.buckets[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+    snapshot.count += snapshot.buckets[i];
+  }
+  snapshot.sum = sum_.exchange(0, std::memory_order_relaxed);
+  snapshot.max = max_.exchange(0, std::memory_order_relaxed);
+  return snapshot;
+}
+
 StatValue* StatRegistry::add(const std::string& name) {
   std::lock_guard<std::mutex> lg(mutex_);
   auto it = stats_.find(name);
@@ -42,9 +131,28 @@ StatValue* StatRegistry::add(const std::string& name) {
   return value;
 }
 
+HistogramStatValue* StatRegistry::addHistogram(const std::string& name) {
+  std::lock_guard<std::mutex> lg(mutex_);
+  auto& histogram = histograms_[name];
+  if (!histogram) {
+    histogram.reset(new HistogramStatValue);
+  }
+  return histogram.get();
+}
+
+StatValue* StatRegistry::addGauge(const std::string& name) {
+  std::lock_guard<std::mutex> lg(mutex_);
+  auto& gauge = gauges_[name];
+  if (!gauge) {
+    gauge.reset(new StatValue);
+  }
+  return gauge.get();
+}
+
 void StatRegistry::publish(ExportedStatList& exported, bool reset) {
   std::lock_guard<std::mutex> lg(mutex_);
-  exported.resize(stats_.size());
+  exported.resize(
+      stats_.size() + gauges_.size() + kHistogramKeys * histograms_.size());
   int i = 0;
   for (const auto& kv : stats_) {
     auto& out = exported.at(i++);
@@ -52,6 +160,30 @@ void StatRegistry::publish(ExportedStatList& exported, bool reset) {
     out.value = reset ? kv.second->reset() : kv.second->get();
     out.ts = std::chrono::high_resolution_clock::now();
   }
+  for (const auto& kv : gauges_) {
+    auto& out = exported.at(i++);
+    out.key = kv.first;
+    out.value = kv.second->get();
+    out.ts = std::chrono::high_resolution_clock::now();
+  }
+  for (const auto& kv : histograms_) {
+    const auto snapshot = reset ? kv.second->reset() : kv.second->get();
+    const auto ts = std::chrono::high_resolution_clock::now();
+    const std::pair<const char*, int64_t> values[kHistogramKeys] = {
+        {"/count", snapshot.count},
+        {"/sum", snapshot.sum},
+        {"/max", snapshot.max},
+        {"/p50", snapshot.percentile(0.5)},
+        {"/p90", snapshot.percentile(0.9)},
+        {"/p99", snapshot.percentile(0.99)},
+    };
+    for (const auto& value : values) {
+      auto& out = exported.at(i++);
+      out.key = kv.first + value.first;
+      out.value = value.second;
+      out.ts = ts;
+    }
+  }
 }
 
 void StatRegistry::update(const ExportedStatList& data) {
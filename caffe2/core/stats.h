@@ -17,6 +17,7 @@
 #pragma once
 
 #include <atomic>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -44,6 +45,92 @@ class StatValue {
   }
 };
 
+/**
+ * @brief Lock-free histogram of int64 values, e.g. latencies.
+ *
+ * Values are counted in log-linear buckets: each power of two range is split
+ * in kSubBuckets buckets, so that percentiles are within 1 / kSubBuckets of
+ * the exact value. Values below 2 * kSubBuckets are counted exactly, negative
+ * values are counted as 0. Recording a value costs two relaxed atomic
+ * increments, and histograms of the same values can be merged.
+ */
+class HistogramStatValue {
+ public:
+  static constexpr int kSubBucketBits = 4;
+  static constexpr int kSubBuckets = 1 << kSubBucketBits;
+  static constexpr int kNumBuckets = (64 - kSubBucketBits) * kSubBuckets;
+
+  struct Snapshot {
+    int64_t count = 0;
+    int64_t sum = 0;
+    int64_t max = 0;
+    std::vector<int64_t> buckets;
+
+    /**
+     * Value below which a fraction `p` of the recorded values fall, within
+     * the precision of the buckets. 0 when nothing was recorded.
+     */
+    int64_t percentile(double p) const;
+  };
+
+  HistogramStatValue();
+
+  void record(int64_t value) {
+    if (value < 0) {
+      value = 0;
+    }
+    buckets_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    auto max = max_.load(std::memory_order_relaxed);
+    while (value > max &&
+           !max_.compare_exchange_weak(
+               max, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  /**
+   * Adds the values recorded by `other`, or recorded in `snapshot`.
+   */
+  void merge(const HistogramStatValue& other);
+  void merge(const Snapshot& snapshot);
+
+  Snapshot get() const;
+
+  /**
+   * Resets the counts to zero and returns their previous values, without
+   * losing the values recorded concurrently.
+   */
+  Snapshot reset();
+
+  static int bucketIndex(int64_t value) {
+    if (value < 2 * kSubBuckets) {
+      return value;
+    }
+    const int shift = log2(value) - kSubBucketBits;
+    return (shift + 1) * kSubBuckets + (value >> shift) - kSubBuckets;
+  }
+
+  // Smallest value counted in the bucket
+  static int64_t bucketLowerBound(int index);
+
+ private:
+  static int log2(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int result = 0;
+    while (value >>= 1) {
+      ++result;
+    }
+    return result;
+#endif
+  }
+
+  std::atomic<int64_t> buckets_[kNumBuckets];
+  std::atomic<int64_t> sum_{0};
+  std::atomic<int64_t> max_{0};
+};
+
 struct ExportedStatValue {
   std::string key;
   int64_t value;
@@ -133,6 +220,9 @@ ExportedStatMap toMap(const ExportedStatList& stats);
 class StatRegistry {
   std::mutex mutex_;
   std::unordered_map<std::string, std::unique_ptr<StatValue>> stats_;
+  std::unordered_map<std::string, std::unique_ptr<HistogramStatValue>>
+      histograms_;
+  std::unordered_map<std::string, std::unique_ptr<StatValue>> gauges_;
 
  public:
   /**
@@ -147,10 +237,25 @@ class StatRegistry {
    */
   StatValue* add(const std::string& name);
 
+  /**
+   * Add a new histogram with given name. If a histogram for this name
+   * already exists, returns a pointer to it.
+   */
+  HistogramStatValue* addHistogram(const std::string& name);
+
+  /**
+   * Add a new gauge with given name. If a gauge for this name already exists,
+   * returns a pointer to it. A gauge holds the last value it was reset to,
+   * and is exported as is even when publishing with `reset`.
+   */
+  StatValue* addGauge(const std::string& name);
+
   /**
    * Populate an ExportedStatList with current counter values.
-   * If `reset` is true, resets all counters to zero. It is guaranteed that no
-   * count is lost.
+   * If `reset` is true, resets all counters to zero, but not the gauges. It is
+   * guaranteed that no count is lost.
+   * Each histogram is exported as <name>/count, <name>/sum, <name>/max and
+   * the percentiles <name>/p50, <name>/p90 and <name>/p99.
    */
   void publish(ExportedStatList& exported, bool reset = false);
 
@@ -274,6 +379,24 @@ class DetailedExportedStat : public ExportedStat {
   }
 };
 
+class HistogramExportedStat : public Stat {
+  HistogramStatValue* value_;
+
+ public:
+  HistogramExportedStat(const std::string& gn, const std::string& n)
+      : Stat(gn, n), value_(StatRegistry::get().addHistogram(gn + "/" + n)) {}
+
+  int64_t increment(int64_t value) {
+    value_->record(value);
+    return value;
+  }
+
+  template <typename T, typename Unused1, typename... Unused>
+  int64_t increment(T value, Unused1, Unused...) {
+    return increment(value);
+  }
+};
+
 namespace detail {
 
 template <class T>
@@ -327,6 +450,11 @@ _ScopeGuard<T> ScopeGuard(T f) {
     groupName, #name                       \
   }
 
+#define CAFFE_HISTOGRAM_EXPORTED_STAT(name) \
+  HistogramExportedStat name {              \
+    groupName, #name                        \
+  }
+
 #define CAFFE_STAT(name) \
   Stat name {            \
     groupName, #name     \
@@ -16,7 +16,9 @@
 
 #include <chrono>
 #include <iostream>
+#include <limits>
 #include <thread>
+#include <vector>
 
 #include "caffe2/core/stats.h"
 #include <gtest/gtest.h>
@@ -133,5 +135,101 @@ TEST(StatsTest, StatsTestSimple) {
       toMap(reg2.publish()), ExportedStatMap({{"i1/s3", 0}, {"i2/s3", 0}}));
 }
 
+TEST(StatsTest, HistogramBuckets) {
+  // Exact below 2 * kSubBuckets
+  for (int64_t v = 0; v < 2 * HistogramStatValue::kSubBuckets; ++v) {
+    EXPECT_EQ(HistogramStatValue::bucketIndex(v), v);
+    EXPECT_EQ(HistogramStatValue::bucketLowerBound(v), v);
+  }
+  // Contiguous, increasing buckets within 1 / kSubBuckets of their values
+  int last = 0;
+  for (int64_t v = 1; v > 0 && v < (int64_t(1) << 62); v = v * 5 / 4 + 1) {
+    const int index = HistogramStatValue::bucketIndex(v);
+    EXPECT_GE(index, last);
+    EXPECT_LT(index, HistogramStatValue::kNumBuckets);
+    last = index;
+    const auto lower = HistogramStatValue::bucketLowerBound(index);
+    EXPECT_LE(lower, v);
+    EXPECT_GT(HistogramStatValue::bucketLowerBound(index + 1), v);
+    EXPECT_LE(v - lower, v / HistogramStatValue::kSubBuckets);
+  }
+  EXPECT_EQ(
+      HistogramStatValue::bucketIndex(std::numeric_limits<int64_t>::max()),
+      HistogramStatValue::kNumBuckets - 1);
+}
+
+TEST(StatsTest, HistogramPercentiles) {
+  HistogramStatValue histogram;
+  for (int64_t v = 1000; v > 0; --v) {
+    histogram.record(v);
+  }
+  histogram.record(-5);
+  auto snapshot = histogram.get();
+  EXPECT_EQ(snapshot.count, 1001);
+  EXPECT_EQ(snapshot.sum, 500500);
+  EXPECT_EQ(snapshot.max, 1000);
+  EXPECT_EQ(snapshot.percentile(0), 0);
+  EXPECT_NEAR(snapshot.percentile(0.5), 500, 500 / 16);
+  EXPECT_NEAR(snapshot.percentile(0.9), 900, 900 / 16);
+  EXPECT_NEAR(snapshot.percentile(0.99), 990, 990 / 16);
+  EXPECT_EQ(snapshot.percentile(1), 1000);
+
+  // Histograms merge
+  HistogramStatValue other;
+  other.record(1 << 20);
+  histogram.merge(other);
+  snapshot = histogram.reset();
+  EXPECT_EQ(snapshot.count, 1002);
+  EXPECT_EQ(snapshot.max, 1 << 20);
+  EXPECT_EQ(histogram.get().count, 0);
+  EXPECT_EQ(histogram.get().percentile(0.5), 0);
+}
+
+TEST(StatsTest, HistogramExportedStat) {
+  struct TestStats {
+    CAFFE_STAT_CTOR(TestStats);
+    CAFFE_HISTOGRAM_EXPORTED_STAT(latency_ns);
+  };
+  TestStats stats("histogram");
+  const int kNumThreads = 4;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&stats]() {
+      for (int i = 1; i <= 100; ++i) {
+        CAFFE_EVENT(stats, latency_ns, i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  CAFFE_DURATION(stats, latency_ns) {}
+
+  auto map = toMap(StatRegistry::get().publish(true));
+  EXPECT_EQ(map["histogram/latency_ns/count"], kNumThreads * 100 + 1);
+  EXPECT_GE(map["histogram/latency_ns/sum"], kNumThreads * 5050);
+  EXPECT_GE(map["histogram/latency_ns/max"], 100);
+  EXPECT_NEAR(map["histogram/latency_ns/p50"], 50, 1);
+  EXPECT_NEAR(map["histogram/latency_ns/p90"], 90, 90 / 16);
+  EXPECT_GE(map["histogram/latency_ns/p99"], 94);
+  EXPECT_SUBSET(
+      toMap(StatRegistry::get().publish()),
+      ExportedStatMap({{"histogram/latency_ns/count", 0},
+                       {"histogram/latency_ns/p99", 0}}));
+}
+
+TEST(StatsTest, GaugesSurviveReset) {
+  StatRegistry registry;
+  registry.add("counter")->increment(3);
+  registry.addGauge("gauge")->reset(5);
+  EXPECT_EQ(registry.addGauge("gauge")->get(), 5);
+  EXPECT_SUBSET(
+      toMap(registry.publish(true)),
+      ExportedStatMap({{"counter", 3}, {"gauge", 5}}));
+  EXPECT_SUBSET(
+      toMap(registry.publish(true)),
+      ExportedStatMap({{"counter", 0}, {"gauge", 5}}));
+}
+
 } // namespace
 } // namespace caffe2
@@ -18,6 +18,7 @@
 
 #include <algorithm>
 #include <ctime>
+#include <iterator>
 #include <mutex>
 
 #include "caffe2/core/logging.h"
@@ -31,6 +32,14 @@ CAFFE2_DEFINE_bool(
     caffe2_print_blob_sizes_at_exit,
     false,
     "If true, workspace destructor will print all blob shapes");
+CAFFE2_DEFINE_int(
+    caffe2_net_cache_size,
+    0,
+    "Number of nets that Workspace::RunNetOnce keeps for reuse, instead of "
+    "creating a new net for every call. Cached nets keep the state of their "
+    "operators, such as readers or random generators, across calls. 0 "
+    "disables the cache, as well as the reuse of the nets of plan execution "
+    "steps by Workspace::GetOrCreateNet.");
 
 namespace caffe2 {
 
@@ -136,6 +145,10 @@ Blob* Workspace::CreateLocalBlob(const string& name) {
     VLOG(1) << "Blob " << name << " already exists. Skipping.";
   } else {
     VLOG(1) << "Creating blob " << name;
+    if (HasBlob(name)) {
+      // Hides the blob of the parent workspace that nets may be using
+      BlobsChanged();
+    }
     blob_map_[name] = unique_ptr<Blob>(new Blob());
   }
   return GetBlob(name);
@@ -155,6 +168,7 @@ Blob* Workspace::RenameBlob(const string& old_name, const string& new_name) {
   CAFFE_ENFORCE(
       !HasBlob(new_name), "Blob ", new_name, "is already in the workspace");
 
+  BlobsChanged();
   // First delete the old record
   auto value = std::move(it->second);
   blob_map_.erase(it);
@@ -168,6 +182,7 @@ bool Workspace::RemoveBlob(const string& name) {
   auto it = blob_map_.find(name);
   if (it != blob_map_.end()) {
     VLOG(1) << "Removing blob " << name << " from this workspace.";
+    BlobsChanged();
     blob_map_.erase(it);
     return true;
   }
@@ -255,6 +270,7 @@ NetBase* Workspace::CreateNet(
     // erase the old one before the new one can be constructed.
     net_map_.erase(net_def->name());
   }
+  net_fingerprints_.erase(net_def->name());
   // Create a new net with its name.
   VLOG(1) << "Initializing network " << net_def->name();
   net_map_[net_def->name()] =
@@ -268,6 +284,25 @@ NetBase* Workspace::CreateNet(
   return net_map_[net_def->name()].get();
 }
 
+NetBase* Workspace::GetOrCreateNet(const NetDef& net_def) {
+  if (FLAGS_caffe2_net_cache_size <= 0) {
+    return CreateNet(net_def, true);
+  }
+  const string fingerprint = net_def.SerializeAsString();
+  const auto epoch = BlobEpoch();
+  const auto it = net_fingerprints_.find(net_def.name());
+  if (it != net_fingerprints_.end() && it->second.first == fingerprint &&
+      it->second.second == epoch) {
+    VLOG(1) << "Reusing network " << net_def.name();
+    return GetNet(net_def.name());
+  }
+  auto* net = CreateNet(net_def, true);
+  if (net) {
+    net_fingerprints_[net_def.name()] = std::make_pair(fingerprint, epoch);
+  }
+  return net;
+}
+
 NetBase* Workspace::GetNet(const string& name) {
   if (!net_map_.count(name)) {
     return nullptr;
@@ -280,6 +315,7 @@ void Workspace::DeleteNet(const string& name) {
   if (net_map_.count(name)) {
     net_map_.erase(name);
   }
+  net_fingerprints_.erase(name);
 }
 
 bool Workspace::RunNet(const string& name) {
@@ -303,19 +339,102 @@ bool Workspace::RunOperatorOnce(const OperatorDef& op_def) {
   return true;
 }
 bool Workspace::RunNetOnce(const NetDef& net_def) {
-  std::unique_ptr<NetBase> net(caffe2::CreateNet(net_def, this));
+  const bool use_cache = FLAGS_caffe2_net_cache_size > 0;
+  string fingerprint;
+  uint64_t epoch = 0;
+  std::unique_ptr<NetBase> net;
+  if (use_cache) {
+    fingerprint = net_def.SerializeAsString();
+    epoch = BlobEpoch();
+    net = TakeCachedNet(fingerprint, epoch);
+  }
+  if (net == nullptr) {
+    net = caffe2::CreateNet(net_def, this);
+  }
   if (net == nullptr) {
     CAFFE_THROW(
         "Could not create net: " + net_def.name() + " of type " +
         net_def.type());
   }
   if (!net->Run()) {
+    // Not cached, as it may be left in a bad state
     LOG(ERROR) << "Error when running network " << net_def.name();
     return false;
   }
+  if (use_cache) {
+    CacheNet(fingerprint, epoch, std::move(net));
+  }
   return true;
 }
 
+void Workspace::ClearNetCache() {
+  std::list<CachedNet> cache;
+  {
+    std::lock_guard<std::mutex> guard(net_cache_mutex_);
+    cache.swap(net_cache_);
+  }
+}
+
+uint64_t Workspace::BlobEpoch() const {
+  // Sums of epochs that only grow change whenever any of them does
+  uint64_t epoch = blob_epoch_;
+  if (shared_) {
+    epoch += shared_->BlobEpoch();
+  }
+  for (const auto& forwarded : forwarded_blobs_) {
+    epoch += forwarded.second.first->BlobEpoch();
+  }
+  return epoch;
+}
+
+void Workspace::BlobsChanged() {
+  ++blob_epoch_;
+  net_fingerprints_.clear();
+  ClearNetCache();
+}
+
+unique_ptr<NetBase> Workspace::TakeCachedNet(
+    const string& fingerprint,
+    uint64_t blob_epoch) {
+  std::list<CachedNet> stale;
+  unique_ptr<NetBase> net;
+  {
+    std::lock_guard<std::mutex> guard(net_cache_mutex_);
+    for (auto it = net_cache_.begin(); it != net_cache_.end();) {
+      auto next = std::next(it);
+      if (it->blob_epoch != blob_epoch) {
+        stale.splice(stale.end(), net_cache_, it);
+      } else if (!net && it->fingerprint == fingerprint) {
+        net = std::move(it->net);
+        net_cache_.erase(it);
+      }
+      it = next;
+    }
+  }
+  // Stale nets are deleted out of the lock
+  return net;
+}
+
+void Workspace::CacheNet(
+    const string& fingerprint,
+    uint64_t blob_epoch,
+    unique_ptr<NetBase> net) {
+  if (blob_epoch != BlobEpoch()) {
+    // Blobs changed while the net was running
+    return;
+  }
+  std::list<CachedNet> evicted;
+  {
+    std::lock_guard<std::mutex> guard(net_cache_mutex_);
+    net_cache_.push_front(CachedNet{fingerprint, blob_epoch, std::move(net)});
+    const auto capacity =
+        static_cast<size_t>(std::max(FLAGS_caffe2_net_cache_size, 0));
+    while (net_cache_.size() > capacity) {
+      evicted.splice(evicted.end(), net_cache_, std::prev(net_cache_.end()));
+    }
+  }
+}
+
 bool Workspace::RunPlan(const PlanDef& plan, ShouldContinue shouldContinue) {
   return RunPlanOnWorkspace(this, plan, shouldContinue);
 }
@@ -24,8 +24,10 @@
 #error "mobile build state not defined"
 #endif
 
+#include <atomic>
 #include <climits>
 #include <cstddef>
+#include <list>
 #include <mutex>
 #include <typeinfo>
 #include <unordered_set>
@@ -41,6 +43,7 @@
 #endif // CAFFE2_MOBILE
 
 CAFFE2_DECLARE_bool(caffe2_print_blob_sizes_at_exit);
+CAFFE2_DECLARE_int(caffe2_net_cache_size);
 
 namespace caffe2 {
 
@@ -74,7 +77,7 @@ class Workspace {
   /**
    * Initializes an empty workspace.
    */
-  Workspace() : root_folder_("."), shared_(nullptr) {}
+  Workspace() : root_folder_("."), shared_(nullptr), blob_epoch_(0) {}
 
   /**
    * Initializes an empty workspace with the given root folder.
@@ -84,7 +87,7 @@ class Workspace {
    * by the workspace.
    */
   explicit Workspace(const string& root_folder)
-      : root_folder_(root_folder), shared_(nullptr) {}
+      : root_folder_(root_folder), shared_(nullptr), blob_epoch_(0) {}
 
   /**
    * Initializes a workspace with a shared workspace.
@@ -96,7 +99,7 @@ class Workspace {
    * created workspace.
    */
   explicit Workspace(const Workspace* shared)
-      : root_folder_("."), shared_(shared) {}
+      : root_folder_("."), shared_(shared), blob_epoch_(0) {}
 
   /**
    * Initializes workspace with parent workspace, blob name remapping
@@ -106,7 +109,7 @@ class Workspace {
   Workspace(
       const Workspace* shared,
       const std::unordered_map<string, string>& forwarded_blobs)
-      : root_folder_("."), shared_(nullptr) {
+      : root_folder_("."), shared_(nullptr), blob_epoch_(0) {
     CAFFE_ENFORCE(shared, "Parent workspace must be specified");
     for (const auto& forwarded : forwarded_blobs) {
       CAFFE_ENFORCE(
@@ -120,7 +123,7 @@ class Workspace {
    * Initializes a workspace with a root folder and a shared workspace.
    */
   Workspace(const string& root_folder, Workspace* shared)
-      : root_folder_(root_folder), shared_(shared) {}
+      : root_folder_(root_folder), shared_(shared), blob_epoch_(0) {}
 
   ~Workspace() {
     if (FLAGS_caffe2_print_blob_sizes_at_exit) {
@@ -162,6 +165,7 @@ class Workspace {
           "Expected blob with tensor value",
           ws_blob.second);
       forwarded_blobs_.erase(blob);
+      BlobsChanged();
       auto* to_blob = CreateBlob(blob);
       CAFFE_ENFORCE(to_blob);
       const auto& from_tensor = from_blob->template Get<Tensor<Context>>();
@@ -258,6 +262,13 @@ class Workspace {
   NetBase* CreateNet(
       const std::shared_ptr<const NetDef>& net_def,
       bool overwrite = false);
+  /**
+   * Same as CreateNet(net_def, true), except that when the net cache is
+   * enabled (see caffe2_net_cache_size), the existing net of the same name is
+   * returned as is if it was created here from an identical NetDef and no blob
+   * it may use was removed since.
+   */
+  NetBase* GetOrCreateNet(const NetDef& net_def);
   /**
    * Gets the pointer to a created net. The workspace keeps ownership of the
    * network.
@@ -305,19 +316,61 @@ class Workspace {
   // have a persistent net object, while RunNetOnce creates a net and discards
   // it on the fly - this may make things like database read and random number
   // generators repeat the same thing over multiple calls.
+  //
+  // When caffe2_net_cache_size is positive, RunNetOnce instead keeps up to
+  // that many nets for reuse, keyed by the fingerprint of their NetDef, so
+  // that running a small net many times does not construct its operators
+  // every time. Cached nets keep the state of their operators across calls,
+  // and are dropped when a blob is removed from the workspace or its parents.
   bool RunOperatorOnce(const OperatorDef& op_def);
   bool RunNetOnce(const NetDef& net_def);
 
+  /**
+   * Deletes the nets cached by RunNetOnce.
+   */
+  void ClearNetCache();
+
+  /**
+   * Changes whenever a blob that a net of this workspace may be using is
+   * removed or replaced, here or in a parent workspace.
+   */
+  uint64_t BlobEpoch() const;
+
  public:
   std::atomic<int> last_failed_op_net_position;
 
  private:
+  struct CachedNet {
+    string fingerprint;
+    uint64_t blob_epoch;
+    unique_ptr<NetBase> net;
+  };
+
+  // Drops the cached nets before blobs they may use go away
+  void BlobsChanged();
+  // Takes a net with the given fingerprint, created at the given blob epoch,
+  // out of the cache, if any
+  unique_ptr<NetBase> TakeCachedNet(
+      const string& fingerprint,
+      uint64_t blob_epoch);
+  void CacheNet(
+      const string& fingerprint,
+      uint64_t blob_epoch,
+      unique_ptr<NetBase> net);
+
   BlobMap blob_map_;
   NetMap net_map_;
   const string root_folder_;
   const Workspace* shared_;
   std::unordered_map<string, std::pair<const Workspace*, string>>
       forwarded_blobs_;
+  std::atomic<uint64_t> blob_epoch_;
+  // Fingerprint and blob epoch of the nets created by GetOrCreateNet
+  CaffeMap<string, std::pair<string, uint64_t>> net_fingerprints_;
+  // Nets of RunNetOnce, most recently used first. A net is taken out of the
+  // cache while it runs, so that concurrent calls get their own instance.
+  std::list<CachedNet> net_cache_;
+  std::mutex net_cache_mutex_;
 #if CAFFE2_MOBILE
   std::unique_ptr<ThreadPool> thread_pool_;
   std::mutex thread_pool_creation_mutex_;
@@ -131,4 +131,156 @@ TEST(WorkspaceTest, BlobMapping) {
   }
 }
 
+namespace {
+
+// Counts its instances
+class WorkspaceTestCountOp final : public OperatorBase {
+ public:
+  WorkspaceTestCountOp(const OperatorDef& def, Workspace* ws)
+      : OperatorBase(def, ws) {
+    ++created;
+  }
+
+  bool Run(int /* unused */) override {
+    return true;
+  }
+
+  static int created;
+};
+
+int WorkspaceTestCountOp::created = 0;
+
+REGISTER_CPU_OPERATOR(WorkspaceTestCount, WorkspaceTestCountOp);
+OPERATOR_SCHEMA(WorkspaceTestCount).NumInputs(0, 1).NumOutputs(0, 1);
+
+NetDef CountNetDef(const string& output) {
+  NetDef net_def;
+  net_def.set_name("count");
+  auto* op = net_def.add_op();
+  op->set_type("WorkspaceTestCount");
+  op->add_input("in");
+  op->add_output(output);
+  return net_def;
+}
+
+// Sets caffe2_net_cache_size for the scope
+class NetCacheSize {
+ public:
+  explicit NetCacheSize(int size) : saved_(FLAGS_caffe2_net_cache_size) {
+    FLAGS_caffe2_net_cache_size = size;
+  }
+  ~NetCacheSize() {
+    FLAGS_caffe2_net_cache_size = saved_;
+  }
+
+ private:
+  int saved_;
+};
+
+} // namespace
+
+TEST(WorkspaceTest, RunNetOnceCache) {
+  Workspace ws;
+  ws.CreateBlob("in");
+  ws.CreateBlob("unused");
+  const auto net_def = CountNetDef("out");
+
+  WorkspaceTestCountOp::created = 0;
+  {
+    NetCacheSize cache_size(0);
+    EXPECT_TRUE(ws.RunNetOnce(net_def));
+    EXPECT_TRUE(ws.RunNetOnce(net_def));
+    EXPECT_EQ(WorkspaceTestCountOp::created, 2);
+  }
+
+  WorkspaceTestCountOp::created = 0;
+  NetCacheSize cache_size(1);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(ws.RunNetOnce(net_def));
+  }
+  EXPECT_EQ(WorkspaceTestCountOp::created, 1);
+
+  // Different nets do not share instances, and evict each other
+  EXPECT_TRUE(ws.RunNetOnce(CountNetDef("other")));
+  EXPECT_EQ(WorkspaceTestCountOp::created, 2);
+  EXPECT_TRUE(ws.RunNetOnce(net_def));
+  EXPECT_EQ(WorkspaceTestCountOp::created, 3);
+
+  // Removing a blob invalidates the cache
+  EXPECT_TRUE(ws.RemoveBlob("unused"));
+  EXPECT_TRUE(ws.RunNetOnce(net_def));
+  EXPECT_EQ(WorkspaceTestCountOp::created, 4);
+  EXPECT_TRUE(ws.RunNetOnce(net_def));
+  EXPECT_EQ(WorkspaceTestCountOp::created, 4);
+
+  ws.ClearNetCache();
+  EXPECT_TRUE(ws.RunNetOnce(net_def));
+  EXPECT_EQ(WorkspaceTestCountOp::created, 5);
+}
+
+TEST(WorkspaceTest, RunNetOnceCacheWithParent) {
+  NetCacheSize cache_size(4);
+  Workspace parent;
+  parent.CreateBlob("in");
+  parent.CreateBlob("unused");
+  Workspace child(&parent);
+  const auto net_def = CountNetDef("out");
+
+  WorkspaceTestCountOp::created = 0;
+  EXPECT_TRUE(child.RunNetOnce(net_def));
+  EXPECT_TRUE(child.RunNetOnce(net_def));
+  EXPECT_EQ(WorkspaceTestCountOp::created, 1);
+
+  // Removals from the parent invalidate the nets of the child
+  const auto epoch = child.BlobEpoch();
+  EXPECT_TRUE(parent.RemoveBlob("unused"));
+  EXPECT_NE(child.BlobEpoch(), epoch);
+  EXPECT_TRUE(child.RunNetOnce(net_def));
+  EXPECT_EQ(WorkspaceTestCountOp::created, 2);
+
+  // As does hiding a blob of the parent
+  child.CreateLocalBlob("in");
+  EXPECT_TRUE(child.RunNetOnce(net_def));
+  EXPECT_EQ(WorkspaceTestCountOp::created, 3);
+}
+
+TEST(WorkspaceTest, GetOrCreateNet) {
+  Workspace ws;
+  ws.CreateBlob("in");
+  ws.CreateBlob("unused");
+  const auto net_def = CountNetDef("out");
+
+  {
+    NetCacheSize cache_size(0);
+    auto* net = ws.GetOrCreateNet(net_def);
+    ASSERT_NE(net, nullptr);
+    EXPECT_EQ(ws.GetNet("count"), net);
+    WorkspaceTestCountOp::created = 0;
+    ws.GetOrCreateNet(net_def);
+    EXPECT_EQ(WorkspaceTestCountOp::created, 1);
+  }
+
+  NetCacheSize cache_size(1);
+  WorkspaceTestCountOp::created = 0;
+  auto* net = ws.GetOrCreateNet(net_def);
+  EXPECT_EQ(ws.GetOrCreateNet(net_def), net);
+  EXPECT_EQ(WorkspaceTestCountOp::created, 1);
+
+  // A different definition of the net replaces it
+  ws.GetOrCreateNet(CountNetDef("other"));
+  EXPECT_EQ(WorkspaceTestCountOp::created, 2);
+
+  // As does a blob removal
+  ws.GetOrCreateNet(net_def);
+  EXPECT_EQ(WorkspaceTestCountOp::created, 3);
+  EXPECT_TRUE(ws.RemoveBlob("unused"));
+  ws.GetOrCreateNet(net_def);
+  EXPECT_EQ(WorkspaceTestCountOp::created, 4);
+
+  // Nets created with CreateNet are not reused
+  ws.CreateNet(net_def, true);
+  ws.GetOrCreateNet(net_def);
+  EXPECT_EQ(WorkspaceTestCountOp::created, 6);
+}
+
 }  // namespace caffe2
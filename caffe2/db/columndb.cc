@@ -0,0 +1,854 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/db/columndb.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/scope_guard.h"
+
+#ifdef CAFFE2_USE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace caffe2 {
+namespace db {
+
+namespace {
+
+const char kMagic[] = "C2COLDB1";
+const size_t kMagicSize = 8;
+// A block is written once it holds that many records or raw bytes.
+const uint64_t kBlockRecords = 1024;
+const size_t kBlockBytes = 4 << 20;
+#ifdef CAFFE2_USE_ZSTD
+const int kZstdLevel = 3;
+#endif
+
+// Each chunk starts with its codec and its decompressed size.
+enum Codec : uint8_t {
+  kCodecNone = 0,
+  kCodecZstd = 1,
+};
+const size_t kChunkHeaderSize = sizeof(uint8_t) + sizeof(uint64_t);
+
+// The field of the TensorProto whose content is stored as the data of an
+// encoded field. A field is encoded as
+//   i32 data type | u8 storage | u8 element width | u32 ndims | i64 dims[]
+//   | u32 extra size | extra | u64 data size | data
+// where extra is the serialized TensorProto without its dims, data type and
+// stored data, so that the encoding is lossless.
+enum Storage : uint8_t {
+  kStorageNone = 0,
+  kStorageFloat = 1,
+  kStorageDouble = 2,
+  kStorageInt32 = 3,
+  kStorageInt64 = 4,
+  kStorageByte = 5,
+  kStorageString = 6,
+};
+
+template <typename T>
+void Append(string* out, const T& value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+class Reader {
+ public:
+  Reader(const char* data, size_t size)
+      : begin_(data), data_(data), end_(data + size) {}
+
+  template <typename T>
+  T Read() {
+    T value;
+    memcpy(&value, Skip(sizeof(T)), sizeof(T));
+    return value;
+  }
+  const char* Skip(size_t size) {
+    CAFFE_ENFORCE_LE(size, size_t(end_ - data_), "Corrupted columndb data.");
+    const char* data = data_;
+    data_ += size;
+    return data;
+  }
+  size_t offset() const { return data_ - begin_; }
+  bool Done() const { return data_ == end_; }
+
+ private:
+  const char* begin_;
+  const char* data_;
+  const char* end_;
+};
+
+void SeekFile(FILE* file, uint64_t offset) {
+#ifdef _MSC_VER
+  const int ret = _fseeki64(file, offset, SEEK_SET);
+#else
+  const int ret = fseeko(file, offset, SEEK_SET);
+#endif
+  CAFFE_ENFORCE_EQ(ret, 0, "Cannot seek in columndb file.");
+}
+
+void ReadFile(FILE* file, uint64_t offset, size_t size, char* out) {
+  SeekFile(file, offset);
+  CAFFE_ENFORCE_EQ(
+      fread(out, 1, size, file), size, "Cannot read columndb file.");
+}
+
+void WriteFile(FILE* file, const string& data) {
+  CAFFE_ENFORCE_EQ(
+      fwrite(data.data(), 1, data.size(), file),
+      data.size(),
+      "Cannot write columndb file.");
+}
+
+// The int32_data of the small types is packed to their own width.
+int PackedWidth(TensorProto::DataType data_type) {
+  switch (data_type) {
+    case TensorProto_DataType_BOOL:
+    case TensorProto_DataType_UINT8:
+    case TensorProto_DataType_INT8:
+      return 1;
+    case TensorProto_DataType_UINT16:
+    case TensorProto_DataType_INT16:
+    case TensorProto_DataType_FLOAT16:
+      return 2;
+    default:
+      return 4;
+  }
+}
+
+bool IsSigned(TensorProto::DataType data_type) {
+  return data_type == TensorProto_DataType_INT8 ||
+      data_type == TensorProto_DataType_INT16;
+}
+
+bool FitsWidth(int32_t value, int width, bool is_signed) {
+  switch (width) {
+    case 1:
+      return is_signed ? value == static_cast<int8_t>(value)
+                       : value == static_cast<uint8_t>(value);
+    case 2:
+      return is_signed ? value == static_cast<int16_t>(value)
+                       : value == static_cast<uint16_t>(value);
+    default:
+      return true;
+  }
+}
+
+void PackInt32(int32_t value, int width, string* out) {
+  switch (width) {
+    case 1:
+      Append(out, static_cast<uint8_t>(value));
+      break;
+    case 2:
+      Append(out, static_cast<uint16_t>(value));
+      break;
+    default:
+      Append(out, value);
+  }
+}
+
+int32_t UnpackInt32(Reader* reader, int width, bool is_signed) {
+  switch (width) {
+    case 1: {
+      const auto value = reader->Read<uint8_t>();
+      return is_signed ? static_cast<int8_t>(value) : value;
+    }
+    case 2: {
+      const auto value = reader->Read<uint16_t>();
+      return is_signed ? static_cast<int16_t>(value) : value;
+    }
+    default:
+      return reader->Read<int32_t>();
+  }
+}
+
+template <typename T>
+void AppendRepeated(
+    const google::protobuf::RepeatedField<T>& values,
+    string* out) {
+  Append<uint64_t>(out, values.size() * sizeof(T));
+  out->append(
+      reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+void EncodeField(const TensorProto& proto, string* out) {
+  const auto data_type = proto.data_type();
+  TensorProto extra(proto);
+  extra.clear_data_type();
+  extra.clear_dims();
+  Storage storage = kStorageNone;
+  int width = 0;
+  if (proto.float_data_size() > 0) {
+    storage = kStorageFloat;
+    width = sizeof(float);
+    extra.clear_float_data();
+  } else if (proto.double_data_size() > 0) {
+    storage = kStorageDouble;
+    width = sizeof(double);
+    extra.clear_double_data();
+  } else if (proto.int64_data_size() > 0) {
+    storage = kStorageInt64;
+    width = sizeof(int64_t);
+    extra.clear_int64_data();
+  } else if (proto.int32_data_size() > 0) {
+    storage = kStorageInt32;
+    width = PackedWidth(data_type);
+    // Values out of the range of their type keep the full width.
+    const bool is_signed = IsSigned(data_type);
+    for (const auto value : proto.int32_data()) {
+      if (!FitsWidth(value, width, is_signed)) {
+        width = sizeof(int32_t);
+        break;
+      }
+    }
+    extra.clear_int32_data();
+  } else if (proto.has_byte_data()) {
+    storage = kStorageByte;
+    width = 1;
+    extra.clear_byte_data();
+  } else if (proto.string_data_size() > 0) {
+    storage = kStorageString;
+    extra.clear_string_data();
+  }
+
+  Append<int32_t>(out, data_type);
+  Append<uint8_t>(out, storage);
+  Append<uint8_t>(out, width);
+  Append<uint32_t>(out, proto.dims_size());
+  for (const auto dim : proto.dims()) {
+    Append<int64_t>(out, dim);
+  }
+  const string extra_string = extra.SerializeAsString();
+  Append<uint32_t>(out, extra_string.size());
+  out->append(extra_string);
+
+  switch (storage) {
+    case kStorageNone:
+      Append<uint64_t>(out, 0);
+      break;
+    case kStorageFloat:
+      AppendRepeated(proto.float_data(), out);
+      break;
+    case kStorageDouble:
+      AppendRepeated(proto.double_data(), out);
+      break;
+    case kStorageInt64:
+      AppendRepeated(proto.int64_data(), out);
+      break;
+    case kStorageInt32:
+      Append<uint64_t>(out, uint64_t(proto.int32_data_size()) * width);
+      for (const auto value : proto.int32_data()) {
+        PackInt32(value, width, out);
+      }
+      break;
+    case kStorageByte:
+      Append<uint64_t>(out, proto.byte_data().size());
+      out->append(proto.byte_data());
+      break;
+    case kStorageString: {
+      uint64_t size = 0;
+      for (const auto& str : proto.string_data()) {
+        size += sizeof(uint32_t) + str.size();
+      }
+      Append<uint64_t>(out, size);
+      for (const auto& str : proto.string_data()) {
+        Append<uint32_t>(out, str.size());
+        out->append(str);
+      }
+      break;
+    }
+  }
+}
+
+struct Field {
+  TensorProto::DataType data_type;
+  Storage storage;
+  int width;
+  std::vector<TIndex> dims;
+  const char* extra;
+  size_t extra_size;
+  const char* data;
+  size_t data_size;
+};
+
+Field DecodeField(Reader* reader) {
+  Field field;
+  field.data_type =
+      static_cast<TensorProto::DataType>(reader->Read<int32_t>());
+  field.storage = static_cast<Storage>(reader->Read<uint8_t>());
+  field.width = reader->Read<uint8_t>();
+  field.dims.resize(reader->Read<uint32_t>());
+  for (auto& dim : field.dims) {
+    dim = reader->Read<int64_t>();
+  }
+  field.extra_size = reader->Read<uint32_t>();
+  field.extra = reader->Skip(field.extra_size);
+  field.data_size = reader->Read<uint64_t>();
+  field.data = reader->Skip(field.data_size);
+  return field;
+}
+
+template <typename T>
+void CopyRepeated(const Field& field, google::protobuf::RepeatedField<T>* out) {
+  const int size = field.data_size / sizeof(T);
+  out->Resize(size, T());
+  if (size > 0) {
+    memcpy(out->mutable_data(), field.data, size * sizeof(T));
+  }
+}
+
+void FieldToProto(const Field& field, TensorProto* proto) {
+  if (field.extra_size > 0) {
+    CAFFE_ENFORCE(
+        proto->ParseFromArray(field.extra, field.extra_size),
+        "Corrupted columndb data.");
+  }
+  proto->set_data_type(field.data_type);
+  for (const auto dim : field.dims) {
+    proto->add_dims(dim);
+  }
+  Reader reader(field.data, field.data_size);
+  switch (field.storage) {
+    case kStorageNone:
+      break;
+    case kStorageFloat:
+      CopyRepeated(field, proto->mutable_float_data());
+      break;
+    case kStorageDouble:
+      CopyRepeated(field, proto->mutable_double_data());
+      break;
+    case kStorageInt64:
+      CopyRepeated(field, proto->mutable_int64_data());
+      break;
+    case kStorageInt32: {
+      const bool is_signed = IsSigned(field.data_type);
+      proto->mutable_int32_data()->Reserve(field.data_size / field.width);
+      while (!reader.Done()) {
+        proto->add_int32_data(UnpackInt32(&reader, field.width, is_signed));
+      }
+      break;
+    }
+    case kStorageByte:
+      proto->set_byte_data(field.data, field.data_size);
+      break;
+    case kStorageString:
+      while (!reader.Done()) {
+        const auto size = reader.Read<uint32_t>();
+        proto->add_string_data(reader.Skip(size), size);
+      }
+      break;
+    default:
+      CAFFE_THROW("Unknown columndb field storage ", field.storage);
+  }
+}
+
+void Compress(const string& raw, string* chunk) {
+  chunk->clear();
+#ifdef CAFFE2_USE_ZSTD
+  Append<uint8_t>(chunk, kCodecZstd);
+  Append<uint64_t>(chunk, raw.size());
+  const size_t bound = ZSTD_compressBound(raw.size());
+  chunk->resize(kChunkHeaderSize + bound);
+  const size_t size = ZSTD_compress(
+      &(*chunk)[kChunkHeaderSize], bound, raw.data(), raw.size(), kZstdLevel);
+  CAFFE_ENFORCE(!ZSTD_isError(size), ZSTD_getErrorName(size));
+  chunk->resize(kChunkHeaderSize + size);
+#else
+  Append<uint8_t>(chunk, kCodecNone);
+  Append<uint64_t>(chunk, raw.size());
+  chunk->append(raw);
+#endif
+}
+
+void Decompress(const string& chunk, string* raw) {
+  Reader reader(chunk.data(), chunk.size());
+  const auto codec = reader.Read<uint8_t>();
+  const auto raw_size = reader.Read<uint64_t>();
+  const size_t size = chunk.size() - kChunkHeaderSize;
+  const char* data = reader.Skip(size);
+  switch (codec) {
+    case kCodecNone:
+      CAFFE_ENFORCE_EQ(size, raw_size, "Corrupted columndb chunk.");
+      raw->assign(data, size);
+      break;
+#ifdef CAFFE2_USE_ZSTD
+    case kCodecZstd: {
+      raw->resize(raw_size);
+      const size_t ret = ZSTD_decompress(&(*raw)[0], raw_size, data, size);
+      CAFFE_ENFORCE(!ZSTD_isError(ret), ZSTD_getErrorName(ret));
+      CAFFE_ENFORCE_EQ(ret, raw_size, "Corrupted columndb chunk.");
+      break;
+    }
+#endif
+    default:
+      CAFFE_THROW(
+          "Unsupported columndb codec ",
+          int(codec),
+          ". Is caffe2 built with USE_ZSTD?");
+  }
+}
+
+// Parses the "fields=0,2" query of a source.
+std::vector<int> ParseFields(const string& query) {
+  const string prefix = "fields=";
+  CAFFE_ENFORCE(
+      query.compare(0, prefix.size(), prefix) == 0,
+      "Unknown columndb option: ",
+      query);
+  std::vector<int> fields;
+  size_t start = prefix.size();
+  while (start < query.size()) {
+    size_t end = query.find(',', start);
+    if (end == string::npos) {
+      end = query.size();
+    }
+    fields.push_back(std::stoi(query.substr(start, end - start)));
+    start = end + 1;
+  }
+  return fields;
+}
+
+} // namespace
+
+ColumnDBCursor::ColumnDBCursor(
+    const string& filename,
+    const ColumnDB* db,
+    const std::vector<int>& fields)
+    : file_(fopen(filename.c_str(), "rb")),
+      db_(db),
+      fields_(fields),
+      record_(0),
+      sorted_position_(-1),
+      block_(-1),
+      chunks_(fields.size()),
+      record_offsets_(fields.size()) {
+  CAFFE_ENFORCE(file_, "Cannot open columndb file ", filename);
+  SeekToRecord(0);
+}
+
+ColumnDBCursor::~ColumnDBCursor() {
+  fclose(file_);
+}
+
+void ColumnDBCursor::Seek(const string& key) {
+  const auto& keys = db_->index().keys;
+  const auto& sorted = db_->SortedRecords();
+  auto it = std::lower_bound(
+      sorted.begin(),
+      sorted.end(),
+      key,
+      [&keys](uint64_t record, const string& key) {
+        return keys[record] < key;
+      });
+  sorted_position_ = it - sorted.begin();
+  MoveToRecord(it == sorted.end() ? NumRecords() : *it);
+}
+
+void ColumnDBCursor::Next() {
+  if (sorted_position_ < 0) {
+    MoveToRecord(record_ + 1);
+    return;
+  }
+  const auto& sorted = db_->SortedRecords();
+  if (sorted_position_ < int64_t(sorted.size())) {
+    ++sorted_position_;
+  }
+  MoveToRecord(
+      sorted_position_ < int64_t(sorted.size()) ? sorted[sorted_position_]
+                                                : NumRecords());
+}
+
+string ColumnDBCursor::key() {
+  CAFFE_ENFORCE(Valid());
+  return db_->index().keys[record_];
+}
+
+string ColumnDBCursor::value() {
+  CAFFE_ENFORCE(Valid());
+  TensorProtos protos;
+  for (size_t i = 0; i < fields_.size(); ++i) {
+    size_t size;
+    const char* data = FieldData(i, &size);
+    Reader reader(data, size);
+    FieldToProto(DecodeField(&reader), protos.add_protos());
+  }
+  return protos.SerializeAsString();
+}
+
+bool ColumnDBCursor::Valid() {
+  return record_ < NumRecords();
+}
+
+uint64_t ColumnDBCursor::NumRecords() const {
+  return db_->index().keys.size();
+}
+
+void ColumnDBCursor::SeekToRecord(uint64_t record) {
+  sorted_position_ = -1;
+  MoveToRecord(record);
+}
+
+void ColumnDBCursor::MoveToRecord(uint64_t record) {
+  record_ = record;
+  if (!Valid()) {
+    return;
+  }
+  const auto& blocks = db_->index().blocks;
+  if (block_ >= 0) {
+    const auto& block = blocks[block_];
+    if (record >= block.first_record &&
+        record < block.first_record + block.num_records) {
+      return;
+    }
+  }
+  auto it = std::upper_bound(
+      blocks.begin(),
+      blocks.end(),
+      record,
+      [](uint64_t record, const ColumnDBIndex::Block& block) {
+        return record < block.first_record;
+      });
+  LoadBlock(it - blocks.begin() - 1);
+}
+
+void ColumnDBCursor::LoadBlock(uint64_t block_id) {
+  const auto& block = db_->index().blocks[block_id];
+  for (size_t i = 0; i < fields_.size(); ++i) {
+    const auto& chunk = block.chunks[fields_[i]];
+    chunk_buffer_.resize(chunk.size);
+    ReadFile(file_, chunk.offset, chunk.size, &chunk_buffer_[0]);
+    Decompress(chunk_buffer_, &chunks_[i]);
+    // Only the headers are parsed to find where the records start.
+    auto& offsets = record_offsets_[i];
+    offsets.clear();
+    Reader reader(chunks_[i].data(), chunks_[i].size());
+    for (uint64_t record = 0; record < block.num_records; ++record) {
+      offsets.push_back(reader.offset());
+      DecodeField(&reader);
+    }
+    CAFFE_ENFORCE(reader.Done(), "Corrupted columndb chunk.");
+    offsets.push_back(reader.offset());
+  }
+  block_ = block_id;
+}
+
+const char* ColumnDBCursor::FieldData(size_t projected_field, size_t* size) {
+  const auto& offsets = record_offsets_[projected_field];
+  const auto record = record_ - db_->index().blocks[block_].first_record;
+  *size = offsets[record + 1] - offsets[record];
+  return chunks_[projected_field].data() + offsets[record];
+}
+
+bool ColumnDBCursor::ReadField(int field, TensorCPU* tensor) {
+  CAFFE_ENFORCE(Valid());
+  CAFFE_ENFORCE(
+      field >= 0 && field < int(fields_.size()),
+      "The cursor reads no field ",
+      field);
+  size_t size;
+  const char* data = FieldData(field, &size);
+  Reader reader(data, size);
+  const Field decoded = DecodeField(&reader);
+  if (decoded.extra_size > 0) {
+    // Only the segment of the extra members changes what is deserialized.
+    TensorProto extra;
+    CAFFE_ENFORCE(
+        extra.ParseFromArray(decoded.extra, decoded.extra_size),
+        "Corrupted columndb data.");
+    if (extra.has_segment()) {
+      return false;
+    }
+  }
+
+  if (decoded.data_type == TensorProto_DataType_STRING) {
+    tensor->Resize(decoded.dims);
+    auto* out = tensor->mutable_data<string>();
+    Reader strings(decoded.data, decoded.data_size);
+    for (TIndex i = 0; i < tensor->size(); ++i) {
+      const auto size = strings.Read<uint32_t>();
+      out[i].assign(strings.Skip(size), size);
+    }
+    CAFFE_ENFORCE(strings.Done(), "Field ", field, " has extra strings.");
+    return true;
+  }
+  const TypeMeta& meta = decoded.data_type == TensorProto_DataType_BYTE
+      ? TypeMeta::Make<uint8_t>()
+      : DataTypeToTypeMeta(decoded.data_type);
+  TIndex num_items = 1;
+  for (const auto dim : decoded.dims) {
+    num_items *= dim;
+  }
+  if (decoded.data_size != num_items * meta.itemsize()) {
+    return false;
+  }
+  tensor->Resize(decoded.dims);
+  void* out = tensor->raw_mutable_data(meta);
+  if (decoded.data_size > 0) {
+    memcpy(out, decoded.data, decoded.data_size);
+  }
+  return true;
+}
+
+class ColumnDBTransaction : public Transaction {
+ public:
+  explicit ColumnDBTransaction(ColumnDB* db) : db_(db) {}
+  ~ColumnDBTransaction() {
+    try {
+      Commit();
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Failed to commit to the columndb: " << e.what();
+    }
+  }
+  void Put(const string& key, const string& value) override {
+    db_->Put(key, value);
+  }
+  void Commit() override { db_->Commit(); }
+
+ private:
+  ColumnDB* db_;
+
+  DISABLE_COPY_AND_ASSIGN(ColumnDBTransaction);
+};
+
+ColumnDB::ColumnDB(const string& source, Mode mode)
+    : DB(source, mode),
+      file_(nullptr),
+      pending_records_(0),
+      pending_bytes_(0),
+      file_end_(0) {
+  const auto query = source.find('?');
+  filename_ = source.substr(0, query);
+  if (query != string::npos) {
+    CAFFE_ENFORCE_EQ(
+        mode, READ, "Only a columndb being read can select fields.");
+    fields_ = ParseFields(source.substr(query + 1));
+  }
+  switch (mode) {
+    case NEW:
+      file_ = fopen(filename_.c_str(), "wb");
+      CAFFE_ENFORCE(file_, "Cannot open columndb file ", filename_);
+      WriteFile(file_, string(kMagic, kMagicSize));
+      file_end_ = kMagicSize;
+      break;
+    case WRITE:
+      // New blocks overwrite the index, which is written again at the end:
+      // until then, the file cannot be read.
+      file_ = fopen(filename_.c_str(), "r+b");
+      CAFFE_ENFORCE(file_, "Cannot open columndb file ", filename_);
+      ReadIndex();
+      SeekFile(file_, file_end_);
+      break;
+    case READ:
+      // Cursors read the file through their own handles.
+      file_ = fopen(filename_.c_str(), "rb");
+      CAFFE_ENFORCE(file_, "Cannot open columndb file ", filename_);
+      ReadIndex();
+      fclose(file_);
+      file_ = nullptr;
+      if (fields_.empty()) {
+        fields_.resize(index_.num_fields);
+        std::iota(fields_.begin(), fields_.end(), 0);
+      }
+      for (const int field : fields_) {
+        CAFFE_ENFORCE(
+            field >= 0 && field < int64_t(index_.num_fields),
+            "The columndb has no field ",
+            field);
+      }
+      break;
+  }
+  pending_chunks_.resize(index_.num_fields);
+  VLOG(1) << "Opened columndb " << filename_;
+}
+
+ColumnDB::~ColumnDB() {
+  try {
+    Close();
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Failed to close columndb " << filename_ << ": " << e.what();
+  }
+}
+
+void ColumnDB::Close() {
+  std::lock_guard<std::mutex> guard(write_mutex_);
+  if (file_) {
+    // The file is closed even if the last writes fail.
+    auto file_guard = MakeGuard([this]() {
+      fclose(file_);
+      file_ = nullptr;
+    });
+    WriteBlock();
+    WriteIndex();
+  }
+}
+
+unique_ptr<Cursor> ColumnDB::NewCursor() {
+  CAFFE_ENFORCE_EQ(mode_, READ, "A columndb can only be read in READ mode.");
+  return make_unique<ColumnDBCursor>(filename_, this, fields_);
+}
+
+unique_ptr<Transaction> ColumnDB::NewTransaction() {
+  CAFFE_ENFORCE_NE(mode_, READ, "A columndb opened in READ mode is sealed.");
+  return make_unique<ColumnDBTransaction>(this);
+}
+
+const std::vector<uint64_t>& ColumnDB::SortedRecords() const {
+  std::call_once(sorted_records_once_, [this]() {
+    const auto& keys = index_.keys;
+    sorted_records_.resize(keys.size());
+    std::iota(sorted_records_.begin(), sorted_records_.end(), 0);
+    std::stable_sort(
+        sorted_records_.begin(),
+        sorted_records_.end(),
+        [&keys](uint64_t a, uint64_t b) { return keys[a] < keys[b]; });
+  });
+  return sorted_records_;
+}
+
+void ColumnDB::Put(const string& key, const string& value) {
+  TensorProtos protos;
+  CAFFE_ENFORCE(
+      protos.ParseFromString(value),
+      "A columndb value has to be a serialized TensorProtos.");
+  std::lock_guard<std::mutex> guard(write_mutex_);
+  CAFFE_ENFORCE(file_, "The columndb is closed.");
+  if (index_.keys.empty()) {
+    index_.num_fields = protos.protos_size();
+    pending_chunks_.resize(index_.num_fields);
+  }
+  CAFFE_ENFORCE_EQ(
+      uint64_t(protos.protos_size()),
+      index_.num_fields,
+      "All the records of a columndb need the same number of fields.");
+  for (int i = 0; i < protos.protos_size(); ++i) {
+    const size_t size = pending_chunks_[i].size();
+    EncodeField(protos.protos(i), &pending_chunks_[i]);
+    pending_bytes_ += pending_chunks_[i].size() - size;
+  }
+  index_.keys.push_back(key);
+  if (++pending_records_ >= kBlockRecords || pending_bytes_ >= kBlockBytes) {
+    WriteBlock();
+  }
+}
+
+void ColumnDB::Commit() {
+  std::lock_guard<std::mutex> guard(write_mutex_);
+  if (file_) {
+    WriteBlock();
+    CAFFE_ENFORCE_EQ(fflush(file_), 0, "Cannot write columndb ", filename_);
+  }
+}
+
+void ColumnDB::WriteBlock() {
+  if (pending_records_ == 0) {
+    return;
+  }
+  ColumnDBIndex::Block block;
+  block.first_record = index_.keys.size() - pending_records_;
+  block.num_records = pending_records_;
+  string chunk;
+  for (auto& raw : pending_chunks_) {
+    Compress(raw, &chunk);
+    WriteFile(file_, chunk);
+    block.chunks.push_back({file_end_, chunk.size()});
+    file_end_ += chunk.size();
+    raw.clear();
+  }
+  index_.blocks.push_back(std::move(block));
+  pending_records_ = 0;
+  pending_bytes_ = 0;
+}
+
+void ColumnDB::ReadIndex() {
+  CAFFE_ENFORCE_EQ(fseek(file_, 0, SEEK_END), 0);
+#ifdef _MSC_VER
+  const uint64_t file_size = _ftelli64(file_);
+#else
+  const uint64_t file_size = ftello(file_);
+#endif
+  const size_t trailer_size = sizeof(uint64_t) + kMagicSize;
+  CAFFE_ENFORCE_GE(
+      file_size, kMagicSize + trailer_size, filename_, " is not a columndb.");
+  string magic(kMagicSize, '\0');
+  ReadFile(file_, 0, kMagicSize, &magic[0]);
+  string trailer(trailer_size, '\0');
+  ReadFile(file_, file_size - trailer_size, trailer_size, &trailer[0]);
+  CAFFE_ENFORCE(
+      magic == string(kMagic, kMagicSize) &&
+          trailer.compare(sizeof(uint64_t), kMagicSize, kMagic) == 0,
+      filename_,
+      " is not a columndb, or was not closed.");
+  Reader trailer_reader(trailer.data(), trailer.size());
+  file_end_ = trailer_reader.Read<uint64_t>();
+  CAFFE_ENFORCE_LE(file_end_, file_size - trailer_size);
+
+  string data(file_size - trailer_size - file_end_, '\0');
+  if (!data.empty()) {
+    ReadFile(file_, file_end_, data.size(), &data[0]);
+  }
+  Reader reader(data.data(), data.size());
+  index_.num_fields = reader.Read<uint64_t>();
+  index_.blocks.resize(reader.Read<uint64_t>());
+  uint64_t num_records = 0;
+  for (auto& block : index_.blocks) {
+    block.first_record = num_records;
+    block.num_records = reader.Read<uint64_t>();
+    num_records += block.num_records;
+    block.chunks.resize(index_.num_fields);
+    for (auto& chunk : block.chunks) {
+      chunk.offset = reader.Read<uint64_t>();
+      chunk.size = reader.Read<uint64_t>();
+    }
+  }
+  index_.keys.resize(reader.Read<uint64_t>());
+  CAFFE_ENFORCE_EQ(index_.keys.size(), num_records, "Corrupted columndb.");
+  for (auto& key : index_.keys) {
+    const auto size = reader.Read<uint32_t>();
+    key.assign(reader.Skip(size), size);
+  }
+  CAFFE_ENFORCE(reader.Done(), "Corrupted columndb index.");
+}
+
+void ColumnDB::WriteIndex() {
+  string data;
+  Append<uint64_t>(&data, index_.num_fields);
+  Append<uint64_t>(&data, index_.blocks.size());
+  for (const auto& block : index_.blocks) {
+    Append<uint64_t>(&data, block.num_records);
+    for (const auto& chunk : block.chunks) {
+      Append<uint64_t>(&data, chunk.offset);
+      Append<uint64_t>(&data, chunk.size);
+    }
+  }
+  Append<uint64_t>(&data, index_.keys.size());
+  for (const auto& key : index_.keys) {
+    Append<uint32_t>(&data, key.size());
+    data.append(key);
+  }
+  Append<uint64_t>(&data, file_end_);
+  data.append(kMagic, kMagicSize);
+  WriteFile(file_, data);
+}
+
+REGISTER_CAFFE2_DB(ColumnDB, ColumnDB);
+REGISTER_CAFFE2_DB(columndb, ColumnDB);
+
+} // namespace db
+} // namespace caffe2
@@ -0,0 +1,183 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_DB_COLUMNDB_H_
+#define CAFFE2_DB_COLUMNDB_H_
+
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "caffe2/core/db.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+namespace db {
+
+class ColumnDB;
+
+/**
+ * ColumnDB is an append-only file of records whose values are serialized
+ * TensorProtos, like the ones TensorProtosDBInput reads. The records are
+ * stored column by column: they are grouped into blocks, and every block
+ * stores each field (the i-th TensorProto of the records) in a separately
+ * compressed chunk:
+ *
+ *   "C2COLDB1" | block 0: field 0 chunk, field 1 chunk, ... | block 1: ...
+ *   | index | u64 index offset | "C2COLDB1"
+ *
+ * The index holds the offsets of all the chunks and the keys, so a cursor
+ * can read only the fields it needs (projection) and seek to any record by
+ * decoding a single block. The source of a reading db may select the fields
+ * with a query, e.g. "/path/to/db?fields=0,2"; the values then only contain
+ * these fields, in that order.
+ *
+ * Chunks are compressed with zstd when caffe2 is built with USE_ZSTD, and
+ * stored as is otherwise; files of both kinds can be read by any build that
+ * supports the codecs they use.
+ *
+ * A db opened in WRITE mode appends its blocks in place of the old index,
+ * which is only written again when the db is closed. A crash while appending
+ * thus leaves a file without an index, which cannot be read anymore: append
+ * to a copy of the file when the existing records must survive.
+ */
+struct ColumnDBIndex {
+  struct Chunk {
+    uint64_t offset;
+    uint64_t size;
+  };
+  struct Block {
+    uint64_t first_record;
+    uint64_t num_records;
+    // One chunk per field.
+    std::vector<Chunk> chunks;
+  };
+
+  uint64_t num_fields = 0;
+  std::vector<Block> blocks;
+  std::vector<string> keys;
+};
+
+class ColumnDBCursor : public Cursor {
+ public:
+  ColumnDBCursor(
+      const string& filename,
+      const ColumnDB* db,
+      const std::vector<int>& fields);
+  ~ColumnDBCursor();
+
+  /**
+   * Moves the cursor to the first record whose key is not less than `key`.
+   * The following calls to Next() go through the records in key order, while
+   * after SeekToFirst() or SeekToRecord() they go in insertion order, which
+   * reads each block once.
+   */
+  void Seek(const string& key) override;
+  bool SupportsSeek() override { return true; }
+  void SeekToFirst() override { SeekToRecord(0); }
+  void Next() override;
+  string key() override;
+  string value() override;
+  bool Valid() override;
+
+  /**
+   * Moves the cursor to the record-th record of the db, in insertion order.
+   * Only the block containing it is read.
+   */
+  void SeekToRecord(uint64_t record);
+  uint64_t record() const { return record_; }
+  uint64_t NumRecords() const;
+
+  /**
+   * Decodes the field-th field of the current value directly into a tensor,
+   * without building the intermediate TensorProto. Like in value(), fields
+   * are numbered among the projected ones. Fields stored with another layout
+   * than the tensor's, like segments or out of range values, are left to
+   * value() and return false.
+   */
+  bool ReadField(int field, TensorCPU* tensor) override;
+  int NumFields() override { return fields_.size(); }
+
+ private:
+  void MoveToRecord(uint64_t record);
+  void LoadBlock(uint64_t block);
+  // Returns the encoded projected_field-th field of the current record.
+  const char* FieldData(size_t projected_field, size_t* size);
+
+  FILE* file_;
+  const ColumnDB* db_;
+  std::vector<int> fields_;
+  uint64_t record_;
+  // Position of the record in SortedRecords() after a Seek(), -1 when going
+  // in insertion order
+  int64_t sorted_position_;
+  // The decompressed chunks of the projected fields of the loaded block, and
+  // the offsets of the records in them.
+  int64_t block_;
+  std::vector<string> chunks_;
+  std::vector<std::vector<size_t>> record_offsets_;
+  string chunk_buffer_;
+
+  DISABLE_COPY_AND_ASSIGN(ColumnDBCursor);
+};
+
+class ColumnDB : public DB {
+ public:
+  ColumnDB(const string& source, Mode mode);
+  ~ColumnDB();
+
+  void Close() override;
+  unique_ptr<Cursor> NewCursor() override;
+  unique_ptr<Transaction> NewTransaction() override;
+
+  const ColumnDBIndex& index() const { return index_; }
+  // The records sorted by key, computed at the first seek by key.
+  const std::vector<uint64_t>& SortedRecords() const;
+
+  // Appends a record to the pending block, which is written to the file
+  // once full, or on Commit(). The records become readable when the db is
+  // closed, which writes the index of all the records.
+  void Put(const string& key, const string& value);
+  void Commit();
+
+ private:
+  void ReadIndex();
+  void WriteBlock();
+  void WriteIndex();
+
+  string filename_;
+  std::vector<int> fields_;
+  FILE* file_;
+  ColumnDBIndex index_;
+
+  mutable std::once_flag sorted_records_once_;
+  mutable std::vector<uint64_t> sorted_records_;
+
+  // The state of the block being written.
+  std::mutex write_mutex_;
+  std::vector<string> pending_chunks_;
+  uint64_t pending_records_;
+  size_t pending_bytes_;
+  uint64_t file_end_;
+
+  DISABLE_COPY_AND_ASSIGN(ColumnDB);
+};
+
+} // namespace db
+} // namespace caffe2
+
+#endif // CAFFE2_DB_COLUMNDB_H_
@@ -0,0 +1,284 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+#include "caffe2/core/db.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/db/columndb.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+namespace db {
+
+// More than a block of records.
+constexpr int kNumRecords = 2500;
+
+static string Key(int i) {
+  std::stringstream ss;
+  ss << std::setw(5) << std::setfill('0') << i;
+  return ss.str();
+}
+
+// Each record has a float image, a uint8 label and a string field.
+static TensorProtos Record(int i) {
+  TensorProtos protos;
+  auto* image = protos.add_protos();
+  image->set_name("image");
+  image->set_data_type(TensorProto::FLOAT);
+  image->add_dims(2);
+  image->add_dims(3);
+  for (int j = 0; j < 6; ++j) {
+    image->add_float_data(i + j * 0.5f);
+  }
+  auto* label = protos.add_protos();
+  label->set_data_type(TensorProto::UINT8);
+  label->add_dims(1);
+  label->add_int32_data(i % 256);
+  auto* tag = protos.add_protos();
+  tag->set_data_type(TensorProto::STRING);
+  tag->add_dims(2);
+  tag->add_string_data("tag");
+  tag->add_string_data(Key(i));
+  return protos;
+}
+
+static void Fill(const string& name, Mode mode, int begin, int end) {
+  std::unique_ptr<DB> db(CreateDB("columndb", name, mode));
+  ASSERT_TRUE(db.get());
+  std::unique_ptr<Transaction> trans(db->NewTransaction());
+  for (int i = begin; i < end; ++i) {
+    trans->Put(Key(i), Record(i).SerializeAsString());
+  }
+  trans->Commit();
+}
+
+TEST(ColumnDBTest, ReadAll) {
+  string name = std::tmpnam(nullptr);
+  Fill(name, NEW, 0, kNumRecords);
+  std::unique_ptr<DB> db(CreateDB("columndb", name, READ));
+  std::unique_ptr<Cursor> cursor(db->NewCursor());
+  int count = 0;
+  for (cursor->SeekToFirst(); cursor->Valid(); cursor->Next()) {
+    EXPECT_EQ(cursor->key(), Key(count));
+    EXPECT_EQ(cursor->value(), Record(count).SerializeAsString());
+    ++count;
+  }
+  EXPECT_EQ(count, kNumRecords);
+  std::remove(name.c_str());
+}
+
+TEST(ColumnDBTest, Append) {
+  string name = std::tmpnam(nullptr);
+  Fill(name, NEW, 0, 100);
+  Fill(name, WRITE, 100, kNumRecords);
+  std::unique_ptr<DB> db(CreateDB("columndb", name, READ));
+  auto* cursor = static_cast<ColumnDBCursor*>(db->NewCursor().release());
+  std::unique_ptr<Cursor> cursor_owner(cursor);
+  EXPECT_EQ(cursor->NumRecords(), kNumRecords);
+  cursor->SeekToRecord(99);
+  EXPECT_EQ(cursor->value(), Record(99).SerializeAsString());
+  cursor->Next();
+  EXPECT_EQ(cursor->value(), Record(100).SerializeAsString());
+  std::remove(name.c_str());
+}
+
+TEST(ColumnDBTest, Projection) {
+  string name = std::tmpnam(nullptr);
+  Fill(name, NEW, 0, kNumRecords);
+  std::unique_ptr<DB> db(CreateDB("columndb", name + "?fields=2,0", READ));
+  std::unique_ptr<Cursor> cursor(db->NewCursor());
+  for (int i = 0; i < kNumRecords; i += 97) {
+    cursor->Seek(Key(i));
+    const auto record = Record(i);
+    TensorProtos expected;
+    *expected.add_protos() = record.protos(2);
+    *expected.add_protos() = record.protos(0);
+    EXPECT_EQ(cursor->value(), expected.SerializeAsString());
+  }
+  std::remove(name.c_str());
+}
+
+TEST(ColumnDBTest, Seek) {
+  string name = std::tmpnam(nullptr);
+  Fill(name, NEW, 0, kNumRecords);
+  std::unique_ptr<DB> db(CreateDB("columndb", name, READ));
+  std::unique_ptr<Cursor> cursor(db->NewCursor());
+  EXPECT_TRUE(cursor->SupportsSeek());
+  cursor->Seek(Key(2000));
+  EXPECT_EQ(cursor->key(), Key(2000));
+  cursor->Seek(Key(5));
+  EXPECT_EQ(cursor->value(), Record(5).SerializeAsString());
+  // Seeking to a key that does not exist gives the immediate next key.
+  cursor->Seek(Key(1030) + "a");
+  EXPECT_EQ(cursor->key(), Key(1031));
+  cursor->Seek(Key(kNumRecords));
+  EXPECT_FALSE(cursor->Valid());
+  cursor->Seek("");
+  EXPECT_EQ(cursor->key(), Key(0));
+  std::remove(name.c_str());
+}
+
+TEST(ColumnDBTest, SeekThenNextInKeyOrder) {
+  string name = std::tmpnam(nullptr);
+  {
+    std::unique_ptr<DB> db(CreateDB("columndb", name, NEW));
+    std::unique_ptr<Transaction> trans(db->NewTransaction());
+    for (int i = kNumRecords - 1; i >= 0; --i) {
+      trans->Put(Key(i), Record(i).SerializeAsString());
+    }
+  }
+  std::unique_ptr<DB> db(CreateDB("columndb", name, READ));
+  std::unique_ptr<Cursor> cursor(db->NewCursor());
+  cursor->Seek(Key(1500));
+  for (int i = 1500; i < kNumRecords; ++i) {
+    ASSERT_TRUE(cursor->Valid());
+    EXPECT_EQ(cursor->key(), Key(i));
+    EXPECT_EQ(cursor->value(), Record(i).SerializeAsString());
+    cursor->Next();
+  }
+  EXPECT_FALSE(cursor->Valid());
+  // Back to insertion order
+  cursor->SeekToFirst();
+  cursor->Next();
+  EXPECT_EQ(cursor->key(), Key(kNumRecords - 2));
+  std::remove(name.c_str());
+}
+
+TEST(ColumnDBTest, CommitWritesPendingBlock) {
+  string name = std::tmpnam(nullptr);
+  std::unique_ptr<DB> db(CreateDB("columndb", name, NEW));
+  std::unique_ptr<Transaction> trans(db->NewTransaction());
+  for (int i = 0; i < 10; ++i) {
+    trans->Put(Key(i), Record(i).SerializeAsString());
+  }
+  trans->Commit();
+  FILE* file = fopen(name.c_str(), "rb");
+  ASSERT_TRUE(file);
+  fseek(file, 0, SEEK_END);
+  // More than the magic number at the start of the file
+  EXPECT_GT(ftell(file), 8);
+  fclose(file);
+  trans.reset();
+  db.reset();
+
+  db = CreateDB("columndb", name, READ);
+  auto* cursor = static_cast<ColumnDBCursor*>(db->NewCursor().release());
+  std::unique_ptr<Cursor> cursor_owner(cursor);
+  EXPECT_EQ(cursor->NumRecords(), 10);
+  std::remove(name.c_str());
+}
+
+TEST(ColumnDBTest, ReadField) {
+  string name = std::tmpnam(nullptr);
+  Fill(name, NEW, 0, kNumRecords);
+  std::unique_ptr<DB> db(CreateDB("columndb", name + "?fields=2,0,1", READ));
+  auto* cursor = static_cast<ColumnDBCursor*>(db->NewCursor().release());
+  std::unique_ptr<Cursor> cursor_owner(cursor);
+  EXPECT_EQ(cursor_owner->NumFields(), 3);
+  for (int i : {0, 1500, 7, kNumRecords - 1}) {
+    cursor->SeekToRecord(i);
+    TensorCPU image, label, tag;
+    // Fields are numbered like in the projected values.
+    EXPECT_TRUE(cursor_owner->ReadField(0, &tag));
+    EXPECT_TRUE(cursor_owner->ReadField(1, &image));
+    EXPECT_TRUE(cursor_owner->ReadField(2, &label));
+    EXPECT_EQ(image.dims(), (vector<TIndex>{2, 3}));
+    for (int j = 0; j < 6; ++j) {
+      EXPECT_EQ(image.data<float>()[j], i + j * 0.5f);
+    }
+    EXPECT_EQ(label.size(), 1);
+    EXPECT_EQ(label.data<uint8_t>()[0], i % 256);
+    EXPECT_EQ(tag.size(), 2);
+    EXPECT_EQ(tag.data<string>()[1], Key(i));
+  }
+  EXPECT_THROW(cursor->ReadField(3, nullptr), EnforceNotMet);
+  std::remove(name.c_str());
+}
+
+TEST(ColumnDBTest, ReadFieldLeavesSegmentsToValue) {
+  string name = std::tmpnam(nullptr);
+  {
+    std::unique_ptr<DB> db(CreateDB("columndb", name, NEW));
+    std::unique_ptr<Transaction> trans(db->NewTransaction());
+    TensorProtos protos;
+    auto* proto = protos.add_protos();
+    proto->set_data_type(TensorProto::FLOAT);
+    proto->add_dims(4);
+    proto->mutable_segment()->set_begin(1);
+    proto->mutable_segment()->set_end(3);
+    proto->add_float_data(1);
+    proto->add_float_data(2);
+    trans->Put(Key(0), protos.SerializeAsString());
+    trans->Commit();
+  }
+  std::unique_ptr<DB> db(CreateDB("columndb", name, READ));
+  std::unique_ptr<Cursor> cursor(db->NewCursor());
+  cursor->SeekToFirst();
+  TensorCPU tensor;
+  EXPECT_FALSE(cursor->ReadField(0, &tensor));
+  std::remove(name.c_str());
+}
+
+TEST(ColumnDBTest, MultipleCursors) {
+  string name = std::tmpnam(nullptr);
+  Fill(name, NEW, 0, kNumRecords);
+  std::unique_ptr<DB> db(CreateDB("columndb", name, READ));
+  DBReader reader(std::move(db));
+  reader.SetNumCursors(3);
+  // Each cursor reads its own range of records, in key order.
+  for (int c = 0; c < 3; ++c) {
+    const int begin = c * kNumRecords / 3;
+    const int end = (c + 1) * kNumRecords / 3;
+    vector<string> keys, values;
+    reader.ReadMany(end - begin + 1, &keys, &values, c);
+    for (int i = begin; i < end; ++i) {
+      EXPECT_EQ(keys[i - begin], Key(i));
+      EXPECT_EQ(values[i - begin], Record(i).SerializeAsString());
+    }
+    EXPECT_EQ(keys.back(), Key(begin));
+  }
+  std::remove(name.c_str());
+}
+
+TEST(ColumnDBTest, MultipleCursorsOutOfKeyOrder) {
+  string name = std::tmpnam(nullptr);
+  Fill(name, NEW, 100, kNumRecords);
+  Fill(name, WRITE, 0, 100);
+  std::unique_ptr<DB> db(CreateDB("columndb", name, READ));
+  DBReader reader;
+  reader.Open(std::move(db), 2, 1);
+  reader.SetNumCursors(5);
+  // An epoch of the shard reads each of its records once.
+  std::set<string> keys;
+  for (int i = 0; i < kNumRecords / 2; ++i) {
+    string key, value;
+    reader.Read(&key, &value);
+    keys.insert(key);
+  }
+  EXPECT_EQ(keys.size(), kNumRecords / 2);
+  for (int i = 1; i < kNumRecords; i += 2) {
+    EXPECT_EQ(keys.count(Key(i)), 1);
+  }
+  std::remove(name.c_str());
+}
+
+} // namespace db
+} // namespace caffe2
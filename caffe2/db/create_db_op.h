@@ -35,13 +35,18 @@ class CreateDBOp final : public Operator<Context> {
         num_shards_(
             OperatorBase::template GetSingleArgument<int>("num_shards", 1)),
         shard_id_(
-            OperatorBase::template GetSingleArgument<int>("shard_id", 0)) {
+            OperatorBase::template GetSingleArgument<int>("shard_id", 0)),
+        num_cursors_(
+            OperatorBase::template GetSingleArgument<int>("num_cursors", 1)) {
     CAFFE_ENFORCE_GT(db_name_.size(), 0, "Must specify a db name.");
   }
 
   bool RunOnDevice() final {
     OperatorBase::Output<db::DBReader>(0)->Open(
         db_type_, db_name_, num_shards_, shard_id_);
+    if (num_cursors_ > 1) {
+      OperatorBase::Output<db::DBReader>(0)->SetNumCursors(num_cursors_);
+    }
     return true;
   }
 
@@ -50,6 +55,7 @@ class CreateDBOp final : public Operator<Context> {
   string db_name_;
   uint32_t num_shards_;
   uint32_t shard_id_;
+  int num_cursors_;
   DISABLE_COPY_AND_ASSIGN(CreateDBOp);
 };
 
@@ -212,5 +212,105 @@ TEST(DBReaderShardedTest, Reader) {
   EXPECT_EQ(value, "05");
 }
 
+TEST(DBReaderTest, ReadMany) {
+  std::string name = std::tmpnam(nullptr);
+  CreateAndFill("leveldb", name);
+  DBReader reader("leveldb", name);
+  vector<string> keys;
+  vector<string> values;
+  reader.ReadMany(4, &keys, &values);
+  ASSERT_EQ(keys.size(), 4);
+  ASSERT_EQ(values.size(), 4);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(keys[i], "0" + caffe2::to_string(i));
+    EXPECT_EQ(values[i], keys[i]);
+  }
+  // Reading past the end goes back to the head of the db.
+  reader.ReadMany(8, &keys, &values);
+  ASSERT_EQ(keys.size(), 8);
+  EXPECT_EQ(keys[0], "04");
+  EXPECT_EQ(keys[5], "09");
+  EXPECT_EQ(keys[6], "00");
+  EXPECT_EQ(keys[7], "01");
+}
+
+TEST(DBReaderTest, VisitMany) {
+  std::string name = std::tmpnam(nullptr);
+  CreateAndFill("leveldb", name);
+  DBReader reader("leveldb", name);
+  vector<string> values;
+  reader.VisitMany(12, [&values](int i, const ValueView& value) {
+    EXPECT_EQ(i, values.size());
+    values.push_back(value.ToString());
+  });
+  ASSERT_EQ(values.size(), 12);
+  for (int i = 0; i < kMaxItems; ++i) {
+    EXPECT_EQ(values[i], "0" + caffe2::to_string(i));
+  }
+  EXPECT_EQ(values[10], "00");
+  EXPECT_EQ(values[11], "01");
+  string key;
+  string value;
+  reader.Read(&key, &value);
+  EXPECT_EQ(value, "02");
+
+  // The views of a cursor see the same values as value().
+  Cursor* cursor = reader.cursor();
+  for (cursor->SeekToFirst(); cursor->Valid(); cursor->Next()) {
+    EXPECT_EQ(cursor->value_view().ToString(), cursor->value());
+  }
+}
+
+TEST(DBReaderTest, MultipleCursors) {
+  std::string name = std::tmpnam(nullptr);
+  CreateAndFill("leveldb", name);
+  DBReader reader("leveldb", name);
+  reader.SetNumCursors(3);
+  EXPECT_EQ(reader.NumCursors(), 3);
+  string key;
+  string value;
+  // Each cursor reads its own range of keys, 00-02, 03-05 and 06-09, and
+  // Read() takes them in turn.
+  const vector<string> expected{
+      "00", "03", "06", "01", "04", "07", "02", "05", "08", "00"};
+  for (int i = 0; i < kMaxItems; ++i) {
+    reader.Read(&key, &value);
+    EXPECT_EQ(key, expected[i]);
+  }
+  reader.SeekToFirst();
+  vector<string> keys;
+  vector<string> values;
+  reader.ReadMany(4, &keys, &values, 1);
+  EXPECT_EQ(keys, (vector<string>{"03", "04", "05", "03"}));
+
+  // Cursors compose with the sharding of the reader.
+  CreateAndFill("leveldb", name + "1");
+  DBReader sharded("leveldb", name + "1", 2, 1);
+  sharded.SetNumCursors(2);
+  sharded.ReadMany(3, &keys, &values, 0);
+  EXPECT_EQ(keys, (vector<string>{"01", "03", "01"}));
+  sharded.ReadMany(3, &keys, &values, 1);
+  EXPECT_EQ(keys, (vector<string>{"05", "07", "09"}));
+
+  // Threads reading from their own cursor read every record once.
+  reader.SeekToFirst();
+  vector<vector<string>> thread_keys(3);
+  vector<std::thread> threads;
+  for (int c = 0; c < 3; ++c) {
+    threads.emplace_back([&reader, &thread_keys, c]() {
+      vector<string> values;
+      reader.ReadMany(c == 2 ? 4 : 3, &thread_keys[c], &values, c);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::set<string> keys_set;
+  for (const auto& keys : thread_keys) {
+    keys_set.insert(keys.begin(), keys.end());
+  }
+  EXPECT_EQ(keys_set.size(), kMaxItems);
+}
+
 }  // namespace db
 }  // namespace caffe2
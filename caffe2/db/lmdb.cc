@@ -84,6 +84,15 @@ class LMDBCursor : public Cursor {
         mdb_value_.mv_size);
   }
 
+  // The view points into the memory map of the db without any copy. As for
+  // every db, it is only valid until the cursor moves.
+  ValueView value_view() override {
+    return ValueView{static_cast<const char*>(mdb_value_.mv_data),
+        mdb_value_.mv_size};
+  }
+
+  bool SupportsValueView() override { return true; }
+
   bool Valid() override { return valid_; }
 
  private:
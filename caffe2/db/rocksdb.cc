@@ -39,6 +39,10 @@ class RocksDBCursor : public Cursor {
   void Next() override { iter_->Next(); }
   string key() override { return iter_->key().ToString(); }
   string value() override { return iter_->value().ToString(); }
+  ValueView value_view() override {
+    return ValueView{iter_->value().data(), iter_->value().size()};
+  }
+  bool SupportsValueView() override { return true; }
   bool Valid() override { return iter_->Valid(); }
 
  private:
@@ -104,6 +104,8 @@ The dimension of the output image will always be cropxcrop
          " Defaults to 0. Can only be 1 in a CUDAContext")
     .Arg("decode_threads", "Number of CPU decode/transform threads."
          " Defaults to 4")
+    .Arg("prefetch_depth", "Number of batches prefetched ahead of the"
+         " operator's runs. Defaults to 1")
     .Arg("output_type", "If gpu_transform, can set to FLOAT or FLOAT16.")
     .Arg("db", "Name of the database (if not passed as input)")
     .Arg("db_type", "Type of database (if not passed as input)."
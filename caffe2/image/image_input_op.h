@@ -62,14 +62,15 @@ class ImageInputOp final
   using OperatorBase::OutputSize;
   using PrefetchOperator<Context>::context_;
   using PrefetchOperator<Context>::prefetch_thread_;
+  using PrefetchOperator<Context>::prefetch_depth_;
   explicit ImageInputOp(const OperatorDef& operator_def,
                                     Workspace* ws);
   ~ImageInputOp() {
     PrefetchOperator<Context>::Finalize();
   }
 
-  bool Prefetch() override;
-  bool CopyPrefetched() override;
+  bool Prefetch(int buffer) override;
+  bool CopyPrefetched(int buffer) override;
 
  private:
   using BoundingBox = struct {
@@ -87,25 +88,45 @@ class ImageInputOp final
     BoundingBox bounding_params;
   };
 
+  // The tensors of one prefetch buffer
+  struct PrefetchedBatch {
+    TensorCPU image;
+    TensorCPU label;
+    vector<TensorCPU> additional_outputs;
+    Tensor<Context> image_on_device;
+    Tensor<Context> label_on_device;
+    vector<Tensor<Context>> additional_outputs_on_device;
+  };
+
+  // A record of the db, copied out of the reader while it is locked, and
+  // parsed as a caffe datum or as TensorProtos, depending on use_caffe_datum_,
+  // by the decode thread that handles it. Unlike TensorProtosDBInput, which
+  // parses the views of the db directly, each value is thus copied once under
+  // the lock, so that the parsing runs in parallel. The copy is released once
+  // parsed, so that the batch does not keep the raw and parsed bytes alive.
+  struct ParsedRecord {
+    string value;
+    bool parsed = false;
+    caffe::Datum datum;
+    TensorProtos protos;
+  };
+
+  void ParseRecord(ParsedRecord* record);
   bool GetImageAndLabelAndInfoFromDBValue(
-      const string& value, cv::Mat* img, PerImageArg& info, int item_id,
-      std::mt19937* randgen);
+      const ParsedRecord& record, cv::Mat* img, PerImageArg& info,
+      int item_id, PrefetchedBatch* batch, std::mt19937* randgen);
   void DecodeAndTransform(
-      const std::string& value, float *image_data, int item_id,
-      const int channels, std::size_t thread_index);
+      ParsedRecord* record, float *image_data, int item_id,
+      PrefetchedBatch* batch, const int channels, std::size_t thread_index);
   void DecodeAndTransposeOnly(
-      const std::string& value, uint8_t *image_data, int item_id,
-      const int channels, std::size_t thread_index);
+      ParsedRecord* record, uint8_t *image_data, int item_id,
+      PrefetchedBatch* batch, const int channels, std::size_t thread_index);
 
   unique_ptr<db::DBReader> owned_reader_;
   const db::DBReader* reader_;
   CPUContext cpu_context_;
-  TensorCPU prefetched_image_;
-  TensorCPU prefetched_label_;
-  vector<TensorCPU> prefetched_additional_outputs_;
-  Tensor<Context> prefetched_image_on_device_;
-  Tensor<Context> prefetched_label_on_device_;
-  vector<Tensor<Context>> prefetched_additional_outputs_on_device_;
+  vector<PrefetchedBatch> prefetched_batches_;
+  vector<ParsedRecord> records_;
   // Default parameters for images
   PerImageArg default_arg_;
   int batch_size_;
@@ -163,8 +184,7 @@ ImageInputOp<Context>::ImageInputOp(
     Workspace* ws)
     : PrefetchOperator<Context>(operator_def, ws),
       reader_(nullptr),
-      prefetched_additional_outputs_(OutputSize() - 2),
-      prefetched_additional_outputs_on_device_(OutputSize() - 2),
+      prefetched_batches_(prefetch_depth_),
       batch_size_(
           OperatorBase::template GetSingleArgument<int>("batch_size", 0)),
       label_type_(static_cast<LABEL_TYPE>(
@@ -377,20 +397,24 @@ ImageInputOp<Context>::ImageInputOp(
   for (int i = 0; i < num_decode_threads_; ++i) {
     randgen_per_thread_.emplace_back(meta_randgen());
   }
-  prefetched_image_.Resize(
-      TIndex(batch_size_),
-      TIndex(crop_),
-      TIndex(crop_),
-      TIndex(color_ ? 3 : 1));
-  if (label_type_ != SINGLE_LABEL) {
-    prefetched_label_.Resize(TIndex(batch_size_), TIndex(num_labels_));
-  } else {
-    prefetched_label_.Resize(vector<TIndex>(1, batch_size_));
-  }
+  for (auto& batch : prefetched_batches_) {
+    batch.image.Resize(
+        TIndex(batch_size_),
+        TIndex(crop_),
+        TIndex(crop_),
+        TIndex(color_ ? 3 : 1));
+    if (label_type_ != SINGLE_LABEL) {
+      batch.label.Resize(TIndex(batch_size_), TIndex(num_labels_));
+    } else {
+      batch.label.Resize(vector<TIndex>(1, batch_size_));
+    }
 
-  for (int i = 0; i < additional_output_sizes.size(); ++i) {
-    prefetched_additional_outputs_[i].Resize(
-        TIndex(batch_size_), TIndex(additional_output_sizes[i]));
+    batch.additional_outputs.resize(additional_output_sizes.size());
+    batch.additional_outputs_on_device.resize(additional_output_sizes.size());
+    for (int i = 0; i < additional_output_sizes.size(); ++i) {
+      batch.additional_outputs[i].Resize(
+          TIndex(batch_size_), TIndex(additional_output_sizes[i]));
+    }
   }
 }
 
@@ -438,10 +462,11 @@ bool RandomSizedCropping(
 
 template <class Context>
 bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
-    const string& value,
+    const ParsedRecord& record,
     cv::Mat* img,
     PerImageArg& info,
     int item_id,
+    PrefetchedBatch* batch,
     std::mt19937* randgen) {
   //
   // recommend using --caffe2_use_fatal_for_enforce=1 when using ImageInputOp
@@ -454,10 +479,9 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
   info = default_arg_;
   if (use_caffe_datum_) {
     // The input is a caffe datum format.
-    caffe::Datum datum;
-    CAFFE_ENFORCE(datum.ParseFromString(value));
+    const caffe::Datum& datum = record.datum;
 
-    prefetched_label_.mutable_data<int>()[item_id] = datum.label();
+    batch->label.template mutable_data<int>()[item_id] = datum.label();
     if (datum.encoded()) {
       // encoded image in datum.
       src = cv::imdecode(
@@ -495,8 +519,7 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
     }
   } else {
     // The input is a caffe2 format.
-    TensorProtos protos;
-    CAFFE_ENFORCE(protos.ParseFromString(value));
+    const TensorProtos& protos = record.protos;
     const TensorProto& image_proto = protos.protos(0);
     const TensorProto& label_proto = protos.protos(1);
     vector<TensorProto> additional_output_protos;
@@ -551,10 +574,10 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
     if (label_proto.data_type() == TensorProto::FLOAT) {
       if (label_type_ == SINGLE_LABEL) {
         DCHECK_EQ(label_proto.float_data_size(), 1);
-        prefetched_label_.mutable_data<float>()[item_id] =
+        batch->label.template mutable_data<float>()[item_id] =
             label_proto.float_data(0);
       } else if (label_type_ == MULTI_LABEL_SPARSE) {
-        float* label_data = prefetched_label_.mutable_data<float>() +
+        float* label_data = batch->label.template mutable_data<float>() +
           item_id * num_labels_;
         memset(label_data, 0, sizeof(float) * num_labels_);
         for (int i = 0; i < label_proto.float_data_size(); ++i) {
@@ -563,7 +586,7 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
       } else if (label_type_ == MULTI_LABEL_WEIGHTED_SPARSE) {
         const TensorProto& weight_proto = protos.protos(2);
         float* label_data =
-            prefetched_label_.mutable_data<float>() + item_id * num_labels_;
+            batch->label.template mutable_data<float>() + item_id * num_labels_;
         memset(label_data, 0, sizeof(float) * num_labels_);
         for (int i = 0; i < label_proto.float_data_size(); ++i) {
           label_data[(int)label_proto.float_data(i)] =
@@ -571,7 +594,7 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
         }
       } else if (label_type_ == MULTI_LABEL_DENSE) {
         CAFFE_ENFORCE(label_proto.float_data_size() == num_labels_);
-        float* label_data = prefetched_label_.mutable_data<float>() +
+        float* label_data = batch->label.template mutable_data<float>() +
           item_id * num_labels_;
         for (int i = 0; i < label_proto.float_data_size(); ++i) {
           label_data[i] = label_proto.float_data(i);
@@ -582,10 +605,10 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
     } else if (label_proto.data_type() == TensorProto::INT32) {
       if (label_type_ == SINGLE_LABEL) {
         DCHECK_EQ(label_proto.int32_data_size(), 1);
-        prefetched_label_.mutable_data<int>()[item_id] =
+        batch->label.template mutable_data<int>()[item_id] =
             label_proto.int32_data(0);
       } else if (label_type_ == MULTI_LABEL_SPARSE) {
-        int* label_data = prefetched_label_.mutable_data<int>() +
+        int* label_data = batch->label.template mutable_data<int>() +
           item_id * num_labels_;
         memset(label_data, 0, sizeof(int) * num_labels_);
         for (int i = 0; i < label_proto.int32_data_size(); ++i) {
@@ -594,14 +617,14 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
       } else if (label_type_ == MULTI_LABEL_WEIGHTED_SPARSE) {
         const TensorProto& weight_proto = protos.protos(2);
         float* label_data =
-            prefetched_label_.mutable_data<float>() + item_id * num_labels_;
+            batch->label.template mutable_data<float>() + item_id * num_labels_;
         memset(label_data, 0, sizeof(float) * num_labels_);
         for (int i = 0; i < label_proto.int32_data_size(); ++i) {
           label_data[label_proto.int32_data(i)] = weight_proto.float_data(i);
         }
       } else if (label_type_ == MULTI_LABEL_DENSE) {
         CAFFE_ENFORCE(label_proto.int32_data_size() == num_labels_);
-        int* label_data = prefetched_label_.mutable_data<int>() +
+        int* label_data = batch->label.template mutable_data<int>() +
           item_id * num_labels_;
         for (int i = 0; i < label_proto.int32_data_size(); ++i) {
           label_data[i] = label_proto.int32_data(i);
@@ -618,7 +641,7 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
 
       if (additional_output_proto.data_type() == TensorProto::FLOAT) {
         float* additional_output =
-            prefetched_additional_outputs_[i].template mutable_data<float>() +
+            batch->additional_outputs[i].template mutable_data<float>() +
             item_id * additional_output_proto.float_data_size();
 
         for (int j = 0; j < additional_output_proto.float_data_size(); ++j) {
@@ -626,7 +649,7 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
         }
       } else if (additional_output_proto.data_type() == TensorProto::INT32) {
         int* additional_output =
-            prefetched_additional_outputs_[i].template mutable_data<int>() +
+            batch->additional_outputs[i].template mutable_data<int>() +
             item_id * additional_output_proto.int32_data_size();
 
         for (int j = 0; j < additional_output_proto.int32_data_size(); ++j) {
@@ -634,7 +657,7 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
         }
       } else if (additional_output_proto.data_type() == TensorProto::INT64) {
         int64_t* additional_output =
-            prefetched_additional_outputs_[i].template mutable_data<int64_t>() +
+            batch->additional_outputs[i].template mutable_data<int64_t>() +
             item_id * additional_output_proto.int64_data_size();
 
         for (int j = 0; j < additional_output_proto.int64_data_size(); ++j) {
@@ -1027,12 +1050,26 @@ void CropTransposeImage(const cv::Mat& scaled_img, const int channels,
   }
 }
 
+template <class Context>
+void ImageInputOp<Context>::ParseRecord(ParsedRecord* record) {
+  if (record->parsed) {
+    return;
+  }
+  if (use_caffe_datum_) {
+    CAFFE_ENFORCE(record->datum.ParseFromString(record->value));
+  } else {
+    CAFFE_ENFORCE(record->protos.ParseFromString(record->value));
+  }
+  string().swap(record->value);
+  record->parsed = true;
+}
+
 // Parse datum, decode image, perform transform
 // Intended as entry point for binding to thread pool
 template <class Context>
 void ImageInputOp<Context>::DecodeAndTransform(
-      const std::string& value, float *image_data, int item_id,
-      const int channels, std::size_t thread_index) {
+      ParsedRecord* record, float *image_data, int item_id,
+      PrefetchedBatch* batch, const int channels, std::size_t thread_index) {
 
   CAFFE_ENFORCE((int)thread_index < num_decode_threads_);
 
@@ -1042,8 +1079,9 @@ void ImageInputOp<Context>::DecodeAndTransform(
   cv::Mat img;
   // Decode the image
   PerImageArg info;
-  CHECK(GetImageAndLabelAndInfoFromDBValue(value, &img, info, item_id,
-    randgen));
+  ParseRecord(record);
+  CHECK(GetImageAndLabelAndInfoFromDBValue(*record, &img, info, item_id,
+    batch, randgen));
 
   // Factor out the image transformation
   TransformImage<Context>(img, channels, image_data,
@@ -1055,8 +1093,8 @@ void ImageInputOp<Context>::DecodeAndTransform(
 
 template <class Context>
 void ImageInputOp<Context>::DecodeAndTransposeOnly(
-    const std::string& value, uint8_t *image_data, int item_id,
-    const int channels, std::size_t thread_index) {
+    ParsedRecord* record, uint8_t *image_data, int item_id,
+    PrefetchedBatch* batch, const int channels, std::size_t thread_index) {
 
   CAFFE_ENFORCE((int)thread_index < num_decode_threads_);
 
@@ -1066,8 +1104,9 @@ void ImageInputOp<Context>::DecodeAndTransposeOnly(
   cv::Mat img;
   // Decode the image
   PerImageArg info;
-  CHECK(GetImageAndLabelAndInfoFromDBValue(value, &img, info, item_id,
-    randgen));
+  ParseRecord(record);
+  CHECK(GetImageAndLabelAndInfoFromDBValue(*record, &img, info, item_id,
+    batch, randgen));
 
   // Factor out the image transformation
   CropTransposeImage<Context>(img, channels, image_data, crop_, mirror_,
@@ -1076,7 +1115,7 @@ void ImageInputOp<Context>::DecodeAndTransposeOnly(
 
 
 template <class Context>
-bool ImageInputOp<Context>::Prefetch() {
+bool ImageInputOp<Context>::Prefetch(int buffer) {
   if (!owned_reader_.get()) {
     // if we are not owning the reader, we will get the reader pointer from
     // input. Otherwise the constructor should have already set the reader
@@ -1084,36 +1123,42 @@ bool ImageInputOp<Context>::Prefetch() {
     reader_ = &OperatorBase::Input<db::DBReader>(0);
   }
   const int channels = color_ ? 3 : 1;
+  PrefetchedBatch* batch = &prefetched_batches_[buffer];
   // Call mutable_data() once to allocate the underlying memory.
   if (gpu_transform_) {
     // we'll transfer up in int8, then convert later
-    prefetched_image_.mutable_data<uint8_t>();
+    batch->image.template mutable_data<uint8_t>();
   } else {
-    prefetched_image_.mutable_data<float>();
+    batch->image.template mutable_data<float>();
   }
 
-  prefetched_label_.mutable_data<int>();
+  batch->label.template mutable_data<int>();
   // Prefetching handled with a thread pool of "decode_threads" threads.
 
-  for (int item_id = 0; item_id < batch_size_; ++item_id) {
-    std::string key, value;
-    cv::Mat img;
+  // read data, taking the lock of the reader once for the whole batch and
+  // only copying the values under it; they are parsed by the decode threads
+  records_.resize(batch_size_);
+  reader_->VisitMany(
+      batch_size_, [this](int item_id, const db::ValueView& value) {
+        auto& record = records_[item_id];
+        record.value.assign(value.data, value.size);
+        record.parsed = false;
+      });
 
-    // read data
-    reader_->Read(&key, &value);
+  for (int item_id = 0; item_id < batch_size_; ++item_id) {
 
     // determine label type based on first item
     if( item_id == 0 ) {
       if( use_caffe_datum_ ) {
-        prefetched_label_.mutable_data<int>();
+        batch->label.template mutable_data<int>();
       } else {
-        TensorProtos protos;
-        CAFFE_ENFORCE(protos.ParseFromString(value));
+        ParseRecord(&records_[item_id]);
+        const TensorProtos& protos = records_[item_id].protos;
         TensorProto_DataType labeldt = protos.protos(1).data_type();
         if( labeldt == TensorProto::INT32 ) {
-          prefetched_label_.mutable_data<int>();
+          batch->label.template mutable_data<int>();
         } else if ( labeldt == TensorProto::FLOAT) {
-          prefetched_label_.mutable_data<float>();
+          batch->label.template mutable_data<float>();
         } else {
           LOG(FATAL) << "Unsupported label type.";
         }
@@ -1123,13 +1168,13 @@ bool ImageInputOp<Context>::Prefetch() {
           TensorProto additional_output_proto = protos.protos(index);
 
           if (additional_output_proto.data_type() == TensorProto::FLOAT) {
-            prefetched_additional_outputs_[i].template mutable_data<float>();
+            batch->additional_outputs[i].template mutable_data<float>();
           } else if (
               additional_output_proto.data_type() == TensorProto::INT32) {
-            prefetched_additional_outputs_[i].template mutable_data<int>();
+            batch->additional_outputs[i].template mutable_data<int>();
           } else if (
               additional_output_proto.data_type() == TensorProto::INT64) {
-            prefetched_additional_outputs_[i].template mutable_data<int64_t>();
+            batch->additional_outputs[i].template mutable_data<int64_t>();
           } else {
             LOG(FATAL) << "Unsupported output type.";
           }
@@ -1141,25 +1186,27 @@ bool ImageInputOp<Context>::Prefetch() {
     // TODO: support color jitter and color lighting in gpu_transform
     if (gpu_transform_) {
       // output of decode will still be int8
-      uint8_t* image_data = prefetched_image_.mutable_data<uint8_t>() +
+      uint8_t* image_data = batch->image.template mutable_data<uint8_t>() +
           crop_ * crop_ * channels * item_id;
       thread_pool_->runTaskWithID(std::bind(
           &ImageInputOp<Context>::DecodeAndTransposeOnly,
           this,
-          std::string(value),
+          &records_[item_id],
           image_data,
           item_id,
+          batch,
           channels,
           std::placeholders::_1));
     } else {
-      float* image_data = prefetched_image_.mutable_data<float>() +
+      float* image_data = batch->image.template mutable_data<float>() +
           crop_ * crop_ * channels * item_id;
       thread_pool_->runTaskWithID(std::bind(
           &ImageInputOp<Context>::DecodeAndTransform,
           this,
-          std::string(value),
+          &records_[item_id],
           image_data,
           item_id,
+          batch,
           channels,
           std::placeholders::_1));
     }
@@ -1169,19 +1216,20 @@ bool ImageInputOp<Context>::Prefetch() {
   // If the context is not CPUContext, we will need to do a copy in the
   // prefetch function as well.
   if (!std::is_same<Context, CPUContext>::value) {
-    prefetched_image_on_device_.CopyFrom(prefetched_image_, &context_);
-    prefetched_label_on_device_.CopyFrom(prefetched_label_, &context_);
+    batch->image_on_device.CopyFrom(batch->image, &context_);
+    batch->label_on_device.CopyFrom(batch->label, &context_);
 
-    for (int i = 0; i < prefetched_additional_outputs_on_device_.size(); ++i) {
-      prefetched_additional_outputs_on_device_[i].CopyFrom(
-          prefetched_additional_outputs_[i], &context_);
+    for (int i = 0; i < batch->additional_outputs_on_device.size(); ++i) {
+      batch->additional_outputs_on_device[i].CopyFrom(
+          batch->additional_outputs[i], &context_);
     }
   }
   return true;
 }
 
 template <class Context>
-bool ImageInputOp<Context>::CopyPrefetched() {
+bool ImageInputOp<Context>::CopyPrefetched(int buffer) {
+  PrefetchedBatch* batch = &prefetched_batches_[buffer];
   auto* image_output = OperatorBase::Output<Tensor<Context> >(0);
   auto* label_output = OperatorBase::Output<Tensor<Context> >(1);
   vector<Tensor<Context>*> additional_outputs_output;
@@ -1194,12 +1242,14 @@ bool ImageInputOp<Context>::CopyPrefetched() {
   // Note(jiayq): The if statement below should be optimized away by the
   // compiler since std::is_same is a constexpr.
   if (std::is_same<Context, CPUContext>::value) {
-    image_output->CopyFrom(prefetched_image_, &context_);
-    label_output->CopyFrom(prefetched_label_, &context_);
+    this->HandOver(&batch->image, image_output, &context_);
+    this->HandOver(&batch->label, label_output, &context_);
 
     for (int i = 0; i < additional_outputs_output.size(); ++i) {
-      additional_outputs_output[i]->CopyFrom(
-          prefetched_additional_outputs_[i], &context_);
+      this->HandOver(
+          &batch->additional_outputs[i],
+          additional_outputs_output[i],
+          &context_);
     }
   } else {
     // TODO: support color jitter and color lighting in gpu_transform
@@ -1216,24 +1266,24 @@ bool ImageInputOp<Context>::CopyPrefetched() {
       }
       // GPU transform kernel allows explicitly setting output type
       if (output_type_ == TensorProto_DataType_FLOAT) {
-        TransformOnGPU<uint8_t,float,Context>(prefetched_image_on_device_,
+        TransformOnGPU<uint8_t,float,Context>(batch->image_on_device,
                                               image_output, mean_gpu_,
                                               std_gpu_, &context_);
       } else if (output_type_ == TensorProto_DataType_FLOAT16) {
-        TransformOnGPU<uint8_t,float16,Context>(prefetched_image_on_device_,
+        TransformOnGPU<uint8_t,float16,Context>(batch->image_on_device,
                                                 image_output, mean_gpu_,
                                                 std_gpu_, &context_);
       }  else {
         return false;
       }
     } else {
-      image_output->CopyFrom(prefetched_image_on_device_, &context_);
+      image_output->CopyFrom(batch->image_on_device, &context_);
     }
-    label_output->CopyFrom(prefetched_label_on_device_, &context_);
+    label_output->CopyFrom(batch->label_on_device, &context_);
 
     for (int i = 0; i < additional_outputs_output.size(); ++i) {
       additional_outputs_output[i]->CopyFrom(
-          prefetched_additional_outputs_on_device_[i], &context_);
+          batch->additional_outputs_on_device[i], &context_);
     }
   }
   return true;
@@ -33,5 +33,6 @@ REGISTER_EVENT_QUERY_FUNCTION(MKLDNN, EventQueryCPU);
 REGISTER_EVENT_ERROR_MESSAGE_FUNCTION(MKLDNN, EventErrorMessageCPU);
 REGISTER_EVENT_SET_FINISHED_FUNCTION(MKLDNN, EventSetFinishedCPU);
 REGISTER_EVENT_RESET_FUNCTION(MKLDNN, EventResetCPU);
+REGISTER_EVENT_ADD_CALLBACK_FUNCTION(MKLDNN, EventAddCallbackCPU);
 
 } // namespace caffe2
@@ -18,6 +18,7 @@
 
 #include "caffe2/core/operator.h"
 #include "caffe2/core/tensor.h"
+#include "caffe2/utils/parallel_for.h"
 
 namespace caffe2 {
 
@@ -32,8 +33,6 @@ struct ConvArgs {
   int pad_r{0};
 };
 
-using ParallelFor = std::function<void(size_t, std::function<void(size_t)>)>;
-
 struct QConvState {
   std::vector<std::unique_ptr<TensorCPU>> XQs;
   std::vector<std::unique_ptr<TensorCPU>> YQs;
@@ -0,0 +1,432 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_observer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <set>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/net_async_base.h"
+#include "caffe2/core/net_dag.h"
+#include "caffe2/core/tensor.h"
+
+CAFFE2_DEFINE_bool(
+    caffe2_trace_observer,
+    false,
+    "Record a trace of the runs of every net and operator");
+CAFFE2_DEFINE_int(
+    caffe2_trace_capacity,
+    1 << 16,
+    "Number of net and operator runs the trace keeps");
+CAFFE2_DEFINE_string(
+    caffe2_trace_dump_path,
+    "",
+    "If set, the trace is written to this file, in the Chrome trace event "
+    "format, when the process exits");
+
+namespace caffe2 {
+
+namespace {
+
+uint64_t roundUpToPowerOfTwo(size_t n) {
+  uint64_t result = 1;
+  while (result < n) {
+    result <<= 1;
+  }
+  return result;
+}
+
+void writeJSONString(std::ostream& os, const std::string& str) {
+  os << '"';
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        os << "\\\"";
+        break;
+      case '\\':
+        os << "\\\\";
+        break;
+      case '\n':
+        os << "\\n";
+        break;
+      case '\t':
+        os << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          os << escaped;
+        } else {
+          os << c;
+        }
+    }
+  }
+  os << '"';
+}
+
+// Microseconds, the unit of the Chrome trace event format
+void writeMicroseconds(std::ostream& os, int64_t ns) {
+  os << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000;
+}
+
+// Chain id of each operator of `net`, -1 for the nets without chains
+std::vector<int> operatorChains(NetBase* net) {
+  std::vector<int> chains(net->GetOperators().size(), -1);
+  if (auto* async_net = dynamic_cast_if_rtti<AsyncNetBase*>(net)) {
+    const auto& net_chains = async_net->chains();
+    for (int chain_id = 0; chain_id < net_chains.size(); ++chain_id) {
+      for (auto op_id : net_chains[chain_id]) {
+        chains[op_id] = chain_id;
+      }
+    }
+  } else if (auto* dag_net = dynamic_cast_if_rtti<DAGNetBase*>(net)) {
+    // Numbered in the same order as the chains of async nets
+    int chain_id = 0;
+    for (const auto& kv : dag_net->execution_chains()) {
+      for (auto op_id : kv.second) {
+        chains[op_id] = chain_id;
+      }
+      ++chain_id;
+    }
+  }
+  return chains;
+}
+
+std::string operatorName(const OperatorBase* op) {
+  if (!op->has_debug_def()) {
+    return "NO_DEF";
+  }
+  const auto& def = op->debug_def();
+  return def.type() + "/" +
+      (def.name().size() ? def.name()
+                         : def.output_size() ? def.output(0) : "NO_OUTPUT");
+}
+
+} // namespace
+
+TraceRecorder::TraceRecorder(size_t capacity)
+    : slots_(roundUpToPowerOfTwo(std::max<size_t>(capacity, 1))),
+      mask_(slots_.size() - 1) {}
+
+TraceRecorder& TraceRecorder::get() {
+  static TraceRecorder recorder(FLAGS_caffe2_trace_capacity);
+  return recorder;
+}
+
+uint32_t TraceRecorder::threadId() {
+  static std::atomic<uint32_t> next_thread_id(0);
+  static thread_local uint32_t thread_id = next_thread_id++;
+  return thread_id;
+}
+
+uint32_t TraceRecorder::intern(const std::string& name) {
+  std::lock_guard<std::mutex> lock(names_mutex_);
+  auto it = name_ids_.find(name);
+  if (it != name_ids_.end()) {
+    return it->second;
+  }
+  uint32_t name_id = names_.size();
+  names_.push_back(name);
+  name_ids_.emplace(name, name_id);
+  return name_id;
+}
+
+std::string TraceRecorder::name(uint32_t name_id) const {
+  std::lock_guard<std::mutex> lock(names_mutex_);
+  CAFFE_ENFORCE_LT(name_id, names_.size());
+  return names_[name_id];
+}
+
+void TraceRecorder::record(const TraceEvent& event) {
+  const auto index = next_.fetch_add(1, std::memory_order_relaxed);
+  auto& slot = slots_[index & mask_];
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name_id.store(event.name_id, std::memory_order_relaxed);
+  slot.net_id.store(event.net_id, std::memory_order_relaxed);
+  slot.op_id.store(event.op_id, std::memory_order_relaxed);
+  slot.chain_id.store(event.chain_id, std::memory_order_relaxed);
+  slot.thread_id.store(event.thread_id, std::memory_order_relaxed);
+  slot.start_ns.store(event.start_ns, std::memory_order_relaxed);
+  slot.end_ns.store(event.end_ns, std::memory_order_relaxed);
+  slot.bytes.store(event.bytes, std::memory_order_relaxed);
+  slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+bool TraceRecorder::read(uint64_t index, TraceEvent* event) const {
+  const auto& slot = slots_[index & mask_];
+  const auto sequence = slot.sequence.load(std::memory_order_acquire);
+  if (sequence != 2 * index + 2) {
+    return false;
+  }
+  event->name_id = slot.name_id.load(std::memory_order_relaxed);
+  event->net_id = slot.net_id.load(std::memory_order_relaxed);
+  event->op_id = slot.op_id.load(std::memory_order_relaxed);
+  event->chain_id = slot.chain_id.load(std::memory_order_relaxed);
+  event->thread_id = slot.thread_id.load(std::memory_order_relaxed);
+  event->start_ns = slot.start_ns.load(std::memory_order_relaxed);
+  event->end_ns = slot.end_ns.load(std::memory_order_relaxed);
+  event->bytes = slot.bytes.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  // Overwritten while it was read
+  return slot.sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+void TraceRecorder::clear() {
+  begin_.store(next_.load(std::memory_order_relaxed));
+}
+
+std::vector<TraceEvent> TraceRecorder::events() const {
+  const auto end = next_.load(std::memory_order_relaxed);
+  const auto begin = std::max<uint64_t>(
+      begin_.load(std::memory_order_relaxed),
+      end > capacity() ? end - capacity() : 0);
+  std::vector<TraceEvent> events;
+  events.reserve(end - begin);
+  for (auto index = begin; index < end; ++index) {
+    TraceEvent event;
+    if (read(index, &event)) {
+      events.push_back(event);
+    }
+  }
+  return events;
+}
+
+uint64_t TraceRecorder::dropped() const {
+  const auto end = next_.load(std::memory_order_relaxed);
+  const auto begin = begin_.load(std::memory_order_relaxed);
+  return end - begin > capacity() ? end - begin - capacity() : 0;
+}
+
+void TraceRecorder::dumpChromeTrace(std::ostream& os) const {
+  const auto trace = events();
+  std::vector<std::string> names;
+  {
+    std::lock_guard<std::mutex> lock(names_mutex_);
+    names = names_;
+  }
+  // Events are in the order they ended
+  int64_t origin = trace.empty() ? 0 : trace.front().start_ns;
+  for (const auto& event : trace) {
+    origin = std::min(origin, event.start_ns);
+  }
+
+  os << "{\"traceEvents\":[";
+  std::set<uint32_t> threads;
+  bool first = true;
+  for (const auto& event : trace) {
+    threads.insert(event.thread_id);
+    os << (first ? "\n" : ",\n") << "{\"name\":";
+    first = false;
+    writeJSONString(os, names[event.name_id]);
+    os << ",\"cat\":\"" << (event.op_id < 0 ? "net" : "operator")
+       << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread_id
+       << ",\"ts\":";
+    writeMicroseconds(os, event.start_ns - origin);
+    os << ",\"dur\":";
+    writeMicroseconds(os, event.end_ns - event.start_ns);
+    os << ",\"args\":{\"net\":";
+    writeJSONString(os, names[event.net_id]);
+    if (event.op_id >= 0) {
+      os << ",\"op\":" << event.op_id << ",\"chain\":" << event.chain_id
+         << ",\"bytes\":" << event.bytes;
+    }
+    os << "}}";
+  }
+  for (auto thread_id : threads) {
+    os << (first ? "\n" : ",\n")
+       << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+       << thread_id << ",\"args\":{\"name\":\"thread " << thread_id
+       << "\"}}";
+    first = false;
+  }
+  os << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":"
+     << dropped() << "}}\n";
+}
+
+bool TraceRecorder::dumpChromeTrace(const std::string& path) const {
+  std::ofstream file(path);
+  if (!file) {
+    LOG(ERROR) << "Unable to open " << path << " to write the trace";
+    return false;
+  }
+  dumpChromeTrace(file);
+  file.close();
+  if (!file) {
+    LOG(ERROR) << "Unable to write the trace to " << path;
+    return false;
+  }
+  return true;
+}
+
+TraceObserver<OperatorBase>::TraceObserver(
+    OperatorBase* subject,
+    TraceRecorder* recorder,
+    uint32_t net_id,
+    int op_id,
+    int chain_id,
+    std::shared_ptr<std::atomic<bool>> active,
+    std::shared_ptr<std::atomic<bool>> attached)
+    : ObserverBase<OperatorBase>(subject),
+      recorder_(recorder),
+      name_id_(recorder->intern(operatorName(subject))),
+      net_id_(net_id),
+      op_id_(op_id),
+      chain_id_(chain_id),
+      active_(std::move(active)),
+      attached_(std::move(attached)) {}
+
+TraceObserver<OperatorBase>::~TraceObserver() {
+  if (attached_) {
+    attached_->store(false);
+  }
+}
+
+void TraceObserver<OperatorBase>::Start() {
+  if (!recorder_->enabled() || !active_->load(std::memory_order_relaxed)) {
+    start_ns_ = -1;
+    return;
+  }
+  start_ns_ = TraceRecorder::now();
+}
+
+void TraceObserver<OperatorBase>::Stop() {
+  if (start_ns_ < 0) {
+    return;
+  }
+  TraceEvent event;
+  event.end_ns = TraceRecorder::now();
+  event.start_ns = start_ns_;
+  event.name_id = name_id_;
+  event.net_id = net_id_;
+  event.op_id = op_id_;
+  event.chain_id = chain_id_;
+  event.thread_id = TraceRecorder::threadId();
+  event.bytes = 0;
+  for (const auto* output : subject_->Outputs()) {
+    if (output->IsType<TensorCPU>()) {
+      event.bytes += output->Get<TensorCPU>().nbytes();
+    }
+  }
+  recorder_->record(event);
+  start_ns_ = -1;
+}
+
+std::unique_ptr<ObserverBase<OperatorBase>> TraceObserver<OperatorBase>::copy(
+    OperatorBase* subject) {
+  return std::unique_ptr<ObserverBase<OperatorBase>>(
+      new TraceObserver<OperatorBase>(
+          subject, recorder_, net_id_, op_id_, chain_id_, active_));
+}
+
+TraceObserver<NetBase>::TraceObserver(
+    NetBase* subject,
+    TraceRecorder* recorder)
+    : ObserverBase<NetBase>(subject),
+      recorder_(recorder),
+      net_id_(recorder->intern(
+          subject->Name().empty() ? "NO_NAME" : subject->Name())),
+      active_(std::make_shared<std::atomic<bool>>(true)) {
+  const auto operators = subject->GetOperators();
+  const auto chains = operatorChains(subject);
+  op_observers_.reserve(operators.size());
+  for (int op_id = 0; op_id < operators.size(); ++op_id) {
+    auto* op = operators[op_id];
+    auto attached = std::make_shared<std::atomic<bool>>(true);
+    const auto* observer =
+        op->AttachObserver(caffe2::make_unique<TraceObserver<OperatorBase>>(
+            op, recorder_, net_id_, op_id, chains[op_id], active_, attached));
+    op_observers_.push_back({op, observer, std::move(attached)});
+  }
+}
+
+TraceObserver<NetBase>::~TraceObserver() {
+  active_->store(false);
+  // When the net is destroyed, its operators and their observers are already
+  // gone; otherwise, e.g. when detached from the net, detach from them too
+  for (const auto& op_observer : op_observers_) {
+    if (op_observer.attached->load()) {
+      op_observer.op->DetachObserver(op_observer.observer);
+    }
+  }
+}
+
+void TraceObserver<NetBase>::Start() {
+  ++runs_;
+  if (!recorder_->enabled()) {
+    start_ns_ = -1;
+    return;
+  }
+  thread_id_ = TraceRecorder::threadId();
+  start_ns_ = TraceRecorder::now();
+}
+
+void TraceObserver<NetBase>::Stop() {
+  if (start_ns_ < 0) {
+    return;
+  }
+  TraceEvent event;
+  event.end_ns = TraceRecorder::now();
+  event.start_ns = start_ns_;
+  event.name_id = net_id_;
+  event.net_id = net_id_;
+  event.op_id = -1;
+  event.chain_id = -1;
+  // Async nets finish on a worker thread, the span belongs to the caller
+  event.thread_id = thread_id_;
+  event.bytes = 0;
+  recorder_->record(event);
+  start_ns_ = -1;
+}
+
+std::string TraceObserver<NetBase>::debugInfo() {
+  return "Traced " + caffe2::to_string(runs_.load()) + " runs.";
+}
+
+namespace {
+
+bool registerGlobalTraceObserverCreator(int* /*pargc*/, char*** /*pargv*/) {
+  if (FLAGS_caffe2_trace_observer) {
+    AddGlobalNetObserverCreator([](NetBase* subject) {
+      return caffe2::make_unique<TraceObserver<NetBase>>(subject);
+    });
+  }
+  if (!FLAGS_caffe2_trace_dump_path.empty()) {
+    // Created first so that it is destroyed after the trace is dumped
+    TraceRecorder::get();
+    std::atexit([]() {
+      TraceRecorder::get().dumpChromeTrace(FLAGS_caffe2_trace_dump_path);
+    });
+  }
+  return true;
+}
+
+} // namespace
+
+REGISTER_CAFFE2_INIT_FUNCTION(
+    registerGlobalTraceObserverCreator,
+    &registerGlobalTraceObserverCreator,
+    "Attach trace observers to all nets");
+
+} // namespace caffe2
@@ -0,0 +1,215 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_CONTRIB_OBSERVERS_TRACE_OBSERVER_H_
+#define CAFFE2_CONTRIB_OBSERVERS_TRACE_OBSERVER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/observer.h"
+#include "caffe2/core/operator.h"
+
+CAFFE2_DECLARE_bool(caffe2_trace_observer);
+CAFFE2_DECLARE_int(caffe2_trace_capacity);
+CAFFE2_DECLARE_string(caffe2_trace_dump_path);
+
+namespace caffe2 {
+
+// A span of time spent by a net or an operator
+struct TraceEvent {
+  uint32_t name_id; // interned "<op type>/<first output>" or net name
+  uint32_t net_id; // interned net name
+  int32_t op_id; // position of the operator in its net, -1 for nets
+  int32_t chain_id; // execution chain of the operator, -1 if none
+  uint32_t thread_id; // small per-thread id, see TraceRecorder::threadId()
+  int64_t start_ns;
+  int64_t end_ns;
+  uint64_t bytes; // total size of the operator's CPU tensor outputs
+};
+
+// Fixed size ring buffer of trace events, written concurrently without
+// locks: once full, new events overwrite the oldest ones. Recording an
+// event costs an atomic increment and a few stores. Dumping reads the
+// buffer while it is written, skipping the events that are being
+// overwritten.
+class TraceRecorder {
+ public:
+  // `capacity` is rounded up to a power of two
+  explicit TraceRecorder(size_t capacity);
+
+  // The recorder the trace observers write to, of
+  // --caffe2_trace_capacity events
+  static TraceRecorder& get();
+
+  // Nanoseconds since an arbitrary, process wide, epoch
+  static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Id of the calling thread, numbered from 0 in order of first use
+  static uint32_t threadId();
+
+  // Observers record nothing while the recorder is disabled
+  bool enabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+  void setEnabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  size_t capacity() const {
+    return slots_.size();
+  }
+
+  // Id of `name` in the recorder's string table. Takes a lock, meant to be
+  // called when observers are created rather than while they record.
+  uint32_t intern(const std::string& name);
+  std::string name(uint32_t name_id) const;
+
+  void record(const TraceEvent& event);
+
+  // Drops the events recorded so far
+  void clear();
+
+  // Events recorded since the last clear() and not overwritten yet, oldest
+  // first
+  std::vector<TraceEvent> events() const;
+
+  // Number of events overwritten since the last clear()
+  uint64_t dropped() const;
+
+  // Writes the events in the Chrome trace event format, which Perfetto and
+  // chrome://tracing load
+  void dumpChromeTrace(std::ostream& os) const;
+  // Returns false when the file can't be written
+  bool dumpChromeTrace(const std::string& path) const;
+
+ private:
+  // Fields are atomics so that dumping while recording is well defined;
+  // relaxed accesses compile to plain loads and stores
+  struct Slot {
+    // 2 * index + 1 while the event of that index is written, then
+    // 2 * index + 2
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint32_t> name_id{0};
+    std::atomic<uint32_t> net_id{0};
+    std::atomic<int32_t> op_id{0};
+    std::atomic<int32_t> chain_id{0};
+    std::atomic<uint32_t> thread_id{0};
+    std::atomic<int64_t> start_ns{0};
+    std::atomic<int64_t> end_ns{0};
+    std::atomic<uint64_t> bytes{0};
+  };
+
+  bool read(uint64_t index, TraceEvent* event) const;
+
+  std::vector<Slot> slots_;
+  const uint64_t mask_;
+  std::atomic<uint64_t> next_{0};
+  std::atomic<uint64_t> begin_{0};
+  std::atomic<bool> enabled_{true};
+
+  mutable std::mutex names_mutex_;
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, uint32_t> name_ids_;
+};
+
+template <class T>
+class TraceObserver;
+
+// Records a span per run of its operator. Attached by TraceObserver<NetBase>.
+template <>
+class TraceObserver<OperatorBase> final : public ObserverBase<OperatorBase> {
+ public:
+  TraceObserver<OperatorBase>(
+      OperatorBase* subject,
+      TraceRecorder* recorder,
+      uint32_t net_id,
+      int op_id,
+      int chain_id,
+      std::shared_ptr<std::atomic<bool>> active,
+      std::shared_ptr<std::atomic<bool>> attached = nullptr);
+  ~TraceObserver<OperatorBase>();
+
+  void Start() override;
+  void Stop() override;
+
+  std::unique_ptr<ObserverBase<OperatorBase>> copy(
+      OperatorBase* subject) override;
+
+ private:
+  TraceRecorder* recorder_;
+  uint32_t name_id_;
+  uint32_t net_id_;
+  int op_id_;
+  int chain_id_;
+  // Cleared when the net observer goes away: the copies of the operator
+  // observers stop recording
+  std::shared_ptr<std::atomic<bool>> active_;
+  // Set while attached by the net observer, cleared when destroyed with the
+  // operator
+  std::shared_ptr<std::atomic<bool>> attached_;
+  int64_t start_ns_ = -1;
+};
+
+// Records a span per run of its net, and attaches a TraceObserver to each
+// of the net's operators, which it detaches when it goes away. Works with
+// every net type; the operators of async and DAG nets are labelled with the id
+// of their execution chain. Attached to every net with --caffe2_trace_observer.
+template <>
+class TraceObserver<NetBase> final : public ObserverBase<NetBase> {
+ public:
+  explicit TraceObserver<NetBase>(
+      NetBase* subject,
+      TraceRecorder* recorder = &TraceRecorder::get());
+  ~TraceObserver<NetBase>();
+
+  void Start() override;
+  void Stop() override;
+
+  std::string debugInfo() override;
+
+ private:
+  struct OperatorObserver {
+    OperatorBase* op;
+    const ObserverBase<OperatorBase>* observer;
+    std::shared_ptr<std::atomic<bool>> attached;
+  };
+
+  TraceRecorder* recorder_;
+  uint32_t net_id_;
+  std::shared_ptr<std::atomic<bool>> active_;
+  std::vector<OperatorObserver> op_observers_;
+  uint32_t thread_id_ = 0;
+  int64_t start_ns_ = -1;
+  std::atomic<uint64_t> runs_{0};
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_CONTRIB_OBSERVERS_TRACE_OBSERVER_H_
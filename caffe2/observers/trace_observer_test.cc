@@ -0,0 +1,235 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/observer.h"
+#include "caffe2/core/operator.h"
+#include "trace_observer.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+
+namespace caffe2 {
+
+namespace {
+
+// Outputs a tensor of 10 floats
+class TraceTestOp final : public Operator<CPUContext> {
+ public:
+  using Operator<CPUContext>::Operator;
+
+  bool RunOnDevice() override {
+    auto* output = Output(0);
+    output->Resize(10);
+    output->mutable_data<float>();
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(TraceTest, TraceTestOp);
+OPERATOR_SCHEMA(TraceTest).NumInputs(0, 1).NumOutputs(1);
+
+// in -> a -> b, in -> c
+unique_ptr<NetBase> CreateNetTestHelper(Workspace* ws, const string& type) {
+  NetDef net_def;
+  net_def.set_name("trace_test");
+  if (!type.empty()) {
+    net_def.set_type(type);
+  }
+  const std::vector<std::pair<string, string>> ops = {
+      {"in", "a"}, {"a", "b"}, {"in", "c"}};
+  for (const auto& op : ops) {
+    auto* op_def = net_def.add_op();
+    op_def->set_type("TraceTest");
+    op_def->add_input(op.first);
+    op_def->add_output(op.second);
+  }
+  net_def.add_external_input("in");
+  ws->CreateBlob("in");
+  return CreateNet(net_def, ws);
+}
+
+TraceEvent MakeEvent(int64_t start_ns, int64_t end_ns) {
+  TraceEvent event;
+  event.name_id = 0;
+  event.net_id = 0;
+  event.op_id = 0;
+  event.chain_id = -1;
+  event.thread_id = TraceRecorder::threadId();
+  event.start_ns = start_ns;
+  event.end_ns = end_ns;
+  event.bytes = 0;
+  return event;
+}
+
+} // namespace
+
+TEST(TraceObserverTest, RingBuffer) {
+  TraceRecorder recorder(3);
+  EXPECT_EQ(recorder.capacity(), 4);
+  for (int i = 0; i < 6; ++i) {
+    recorder.record(MakeEvent(i, i + 1));
+  }
+  // The oldest events are overwritten
+  auto events = recorder.events();
+  ASSERT_EQ(events.size(), 4);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(events[i].start_ns, i + 2);
+  }
+  EXPECT_EQ(recorder.dropped(), 2);
+
+  recorder.clear();
+  EXPECT_TRUE(recorder.events().empty());
+  EXPECT_EQ(recorder.dropped(), 0);
+  recorder.record(MakeEvent(10, 11));
+  EXPECT_EQ(recorder.events().size(), 1);
+}
+
+TEST(TraceObserverTest, ChromeTraceFormat) {
+  TraceRecorder recorder(16);
+  EXPECT_EQ(recorder.intern("net"), 0);
+  EXPECT_EQ(recorder.intern("Op/\"x\""), 1);
+  EXPECT_EQ(recorder.intern("net"), 0);
+  EXPECT_EQ(recorder.name(1), "Op/\"x\"");
+
+  auto net_event = MakeEvent(1000, 5000);
+  net_event.op_id = -1;
+  auto op_event = MakeEvent(2000, 3500);
+  op_event.name_id = 1;
+  op_event.chain_id = 2;
+  op_event.bytes = 40;
+  recorder.record(op_event);
+  recorder.record(net_event);
+
+  std::ostringstream os;
+  recorder.dumpChromeTrace(os);
+  const auto trace = os.str();
+  EXPECT_NE(trace.find("\"traceEvents\""), std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"Op/\\\"x\\\"\""), std::string::npos);
+  // Times are in microseconds, from the earliest start
+  EXPECT_NE(
+      trace.find("\"ts\":1.000,\"dur\":1.500,\"args\":{\"net\":\"net\","
+                 "\"op\":0,\"chain\":2,\"bytes\":40}"),
+      std::string::npos)
+      << trace;
+  EXPECT_NE(
+      trace.find("\"cat\":\"net\",\"ph\":\"X\""), std::string::npos);
+  EXPECT_NE(trace.find("\"ts\":0.000,\"dur\":4.000"), std::string::npos);
+  EXPECT_NE(trace.find("\"thread_name\""), std::string::npos);
+}
+
+TEST(TraceObserverTest, TracesAllNetTypes) {
+  for (const string type : {"", "simple", "dag", "async_scheduling"}) {
+    Workspace ws;
+    auto net = CreateNetTestHelper(&ws, type);
+    TraceRecorder recorder(64);
+    const auto* observer = net->AttachObserver(
+        caffe2::make_unique<TraceObserver<NetBase>>(net.get(), &recorder));
+    for (int i = 0; i < 2; ++i) {
+      ASSERT_TRUE(net->Run());
+    }
+    EXPECT_EQ(observer->subject(), net.get());
+
+    auto events = recorder.events();
+    ASSERT_EQ(events.size(), 8) << type;
+    const bool has_chains = type == "dag" || type == "async_scheduling";
+    std::vector<TraceEvent> net_events;
+    for (const auto& event : events) {
+      EXPECT_EQ(recorder.name(event.net_id), "trace_test");
+      EXPECT_LE(event.start_ns, event.end_ns);
+      if (event.op_id < 0) {
+        net_events.push_back(event);
+        continue;
+      }
+      ASSERT_LT(event.op_id, 3);
+      EXPECT_EQ(
+          recorder.name(event.name_id),
+          string("TraceTest/") + "abc"[event.op_id]);
+      EXPECT_EQ(event.bytes, 10 * sizeof(float));
+      if (has_chains) {
+        EXPECT_GE(event.chain_id, 0) << type;
+      } else {
+        EXPECT_EQ(event.chain_id, -1) << type;
+      }
+    }
+    ASSERT_EQ(net_events.size(), 2) << type;
+    // Operators run within their net's run
+    for (const auto& event : events) {
+      const auto& net_event =
+          event.end_ns <= net_events[0].end_ns ? net_events[0] : net_events[1];
+      EXPECT_GE(event.start_ns, net_event.start_ns) << type;
+      EXPECT_LE(event.end_ns, net_event.end_ns) << type;
+    }
+  }
+}
+
+TEST(TraceObserverTest, StopsRecording) {
+  Workspace ws;
+  auto net = CreateNetTestHelper(&ws, "async_scheduling");
+  TraceRecorder recorder(64);
+  auto* op = net->GetOperators()[0];
+  const auto num_op_observers = op->NumObservers();
+  const auto* observer = net->AttachObserver(
+      caffe2::make_unique<TraceObserver<NetBase>>(net.get(), &recorder));
+  EXPECT_EQ(op->NumObservers(), num_op_observers + 1);
+
+  recorder.setEnabled(false);
+  ASSERT_TRUE(net->Run());
+  EXPECT_TRUE(recorder.events().empty());
+
+  recorder.setEnabled(true);
+  ASSERT_TRUE(net->Run());
+  EXPECT_EQ(recorder.events().size(), 4);
+
+  // The operator observers go away with the net observer
+  net->DetachObserver(observer);
+  EXPECT_EQ(op->NumObservers(), num_op_observers);
+  ASSERT_TRUE(net->Run());
+  EXPECT_EQ(recorder.events().size(), 4);
+}
+
+TEST(TraceObserverTest, ConcurrentRecording) {
+  const int kNumThreads = 4;
+  const int kNumEvents = 10000;
+  TraceRecorder recorder(1024);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&recorder, t]() {
+      for (int i = 0; i < kNumEvents; ++i) {
+        auto event = MakeEvent(i, 2 * i);
+        event.op_id = t;
+        event.bytes = 3 * i;
+        recorder.record(event);
+      }
+    });
+  }
+  // Events read while they are written are either skipped or whole
+  for (int i = 0; i < 100; ++i) {
+    for (const auto& event : recorder.events()) {
+      EXPECT_EQ(event.end_ns, 2 * event.start_ns);
+      EXPECT_EQ(event.bytes, 3 * event.start_ns);
+    }
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(recorder.events().size(), 1024);
+  EXPECT_EQ(recorder.dropped(), kNumThreads * kNumEvents - 1024);
+}
+
+} // namespace caffe2
@@ -68,6 +68,15 @@ OPERATOR_SCHEMA(Concat)
           CreateTensorShape(out_shape, in[0].data_type()),
           CreateTensorShape(split_shape, TensorProto::INT32)};
     })
+    .CostInferenceFunction([](const OperatorDef& /*unused*/,
+                              const vector<TensorShape>& in) {
+      // Only copies
+      struct OpSchema::Cost c;
+      for (const auto& input : in) {
+        c.bytes_moved += 2 * nBytes(input);
+      }
+      return c;
+    })
     .SetDoc("Concatenate a list of tensors into a single tensor")
     .Output(0, "concat_result", "Concatenated tensor")
     .Output(1, "split_info", "The dimensions of the inputs.");
@@ -385,29 +385,57 @@ class ConvPoolOpBase : public Operator<Context> {
     ArgumentHelper helper(def);
     const auto order =
         StringToStorageOrder(helper.GetSingleArgument<string>("order", "NCHW"));
+    // W is (M, C / group, kernel...) in NCHW and (M, kernel..., C / group)
+    // in NHWC, Y is (N, M, output...) or (N, output..., M).
+    const int last = W.dims_size() - 1;
+    const bool nhwc = order == StorageOrder::NHWC;
+    const uint64_t out_channels = W.dims(0);
+    const uint64_t in_channels_per_group = W.dims(nhwc ? last : 1);
+    const uint64_t kernel_size = nElemFromDim(W, 1) / in_channels_per_group;
+    const uint64_t output_size = nElemFromDim(Y, 1) / Y.dims(nhwc ? last : 1);
+    // A multiply and an add per kernel element, input channel of the group,
+    // output channel and output point.
+    c.flops = Y.dims(0) * output_size * out_channels * kernel_size *
+        in_channels_per_group * 2;
+    c.bytes_moved = nBytes(X) + nBytes(W) + nBytes(Y);
+    if (inputs.size() > 2) {
+      c.bytes_moved += nBytes(inputs[2]);
+    }
+    return c;
+  }
 
-    unsigned long long Y_h;
-    unsigned long long Y_w;
-    unsigned long long kernel_h;
-    unsigned long long kernel_w;
-    unsigned long long in_channels;
-    unsigned long long out_channels;
-    if (order == StorageOrder::NHWC) {
-      Y_h = Y.dims(1);
-      Y_w = Y.dims(2);
-      kernel_h = W.dims(1);
-      kernel_w = W.dims(2);
-      in_channels = W.dims(3);
-      out_channels = W.dims(0);
+  static struct OpSchema::Cost CostInferenceForPool(
+      const OperatorDef& def,
+      const vector<TensorShape>& inputs) {
+    struct OpSchema::Cost c;
+    const TensorShape X = inputs[0];
+    const TensorShape Y = TensorInferenceForPool(def, inputs)[0];
+
+    ArgumentHelper helper(def);
+    const auto order =
+        StringToStorageOrder(helper.GetSingleArgument<string>("order", "NCHW"));
+    const int spatial_dims = X.dims_size() - 2;
+    uint64_t kernel_size = 1;
+    if (helper.GetSingleArgument<int>("global_pooling", 0)) {
+      kernel_size = order == StorageOrder::NHWC
+          ? nElemFromDim(X, 1) / X.dims(spatial_dims + 1)
+          : nElemFromDim(X, 2);
+    } else if (helper.HasArgument("kernel")) {
+      const uint64_t kernel = helper.GetSingleArgument<int>("kernel", 1);
+      for (int i = 0; i < spatial_dims; ++i) {
+        kernel_size *= kernel;
+      }
+    } else if (helper.HasArgument("kernels")) {
+      for (const int kernel : helper.GetRepeatedArgument<int>("kernels")) {
+        kernel_size *= kernel;
+      }
     } else {
-      Y_h = Y.dims(2);
-      Y_w = Y.dims(3);
-      kernel_h = W.dims(2);
-      kernel_w = W.dims(3);
-      in_channels = W.dims(1);
-      out_channels = W.dims(0);
+      kernel_size = helper.GetSingleArgument<int>("kernel_h", 1) *
+          helper.GetSingleArgument<int>("kernel_w", 1);
     }
-    c.flops = Y_h * Y_w * kernel_w * kernel_h * in_channels * out_channels * 2;
+    // An operation per kernel element and output point
+    c.flops = nElemFromDim(Y) * kernel_size;
+    c.bytes_moved = nBytes(X) + nBytes(Y);
     return c;
   }
 
@@ -513,7 +541,8 @@ class ConvPoolOpBase : public Operator<Context> {
    auto order =
        StringToStorageOrder(helper.GetSingleArgument<string>("order", "NCHW"));
    int num_channels =
-       (order == StorageOrder::NCHW ? in[0].dims(1) : in[0].dims(3));
+       (order == StorageOrder::NCHW ? in[0].dims(1)
+                                    : in[0].dims(in[0].dims_size() - 1));
    return TensorInferenceForSchema(def, in, num_channels);
  }
 
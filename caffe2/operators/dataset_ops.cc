@@ -23,6 +23,7 @@
 #include "caffe2/core/blob_serialization.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/core/tensor.h"
+#include "caffe2/utils/parallel_for.h"
 #include "caffe2/utils/string_utils.h"
 
 namespace caffe2 {
@@ -40,8 +41,98 @@ const char* kDatasetLengthField = "lengths";
 // how much percent to grow the dataset when needed
 const int kDatasetGrowthPct = 40;
 
+// minimum number of bytes copied by each intra-op thread when gathering rows
+const size_t kGatherGrainBytes = 1 << 16;
+
 } // namespace
 
+void appendRowRange(
+    std::vector<RowRange>& ranges,
+    TOffset offset,
+    TOffset size) {
+  if (size <= 0) {
+    return;
+  }
+  if (!ranges.empty() && ranges.back().offset + ranges.back().size == offset) {
+    ranges.back().size += size;
+  } else {
+    ranges.push_back({offset, size});
+  }
+}
+
+void gatherRowRanges(
+    const std::vector<const TensorCPU*>& inputs,
+    const std::vector<int>& levels,
+    const std::vector<std::vector<RowRange>>& ranges,
+    const std::vector<TensorCPU*>& outputs) {
+  CAFFE_ENFORCE_EQ(inputs.size(), levels.size());
+  CAFFE_ENFORCE_EQ(inputs.size(), outputs.size());
+  // Consecutive ranges of a field, copied by one thread.
+  struct CopyTask {
+    const TensorCPU* input;
+    const RowRange* begin;
+    const RowRange* end;
+    char* dst;
+  };
+  std::vector<CopyTask> tasks;
+  for (int i = 0; i < inputs.size(); ++i) {
+    const auto& in = *inputs[i];
+    const auto& fieldRanges = ranges.at(levels[i]);
+    CAFFE_ENFORCE_GE(in.ndim(), 1);
+    std::vector<TIndex> outDim = in.dims();
+    outDim[0] = 0;
+    for (const auto& range : fieldRanges) {
+      CAFFE_ENFORCE_LE(
+          range.offset + range.size,
+          in.dim(0),
+          "Out of bound when trying to gather rows of field ",
+          i);
+      outDim[0] += range.size;
+    }
+    auto* out = outputs[i];
+    out->Resize(outDim);
+    auto* dst = static_cast<char*>(out->raw_mutable_data(in.meta()));
+    if (out->size() == 0) {
+      continue;
+    }
+    const size_t rowBytes = in.size_from_dim(1) * in.meta().itemsize();
+    CopyTask task{&in, fieldRanges.data(), fieldRanges.data(), dst};
+    size_t taskBytes = 0;
+    for (const auto& range : fieldRanges) {
+      ++task.end;
+      taskBytes += range.size * rowBytes;
+      dst += range.size * rowBytes;
+      if (taskBytes >= kGatherGrainBytes) {
+        tasks.push_back(task);
+        task = CopyTask{&in, task.end, task.end, dst};
+        taskBytes = 0;
+      }
+    }
+    if (task.begin != task.end) {
+      tasks.push_back(task);
+    }
+  }
+  IntraOpParallelFor(tasks.size(), 1, [&tasks](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      const auto& task = tasks[t];
+      const auto& meta = task.input->meta();
+      const auto rowSize = task.input->size_from_dim(1);
+      const auto* src = static_cast<const char*>(task.input->raw_data());
+      char* dst = task.dst;
+      for (const auto* range = task.begin; range != task.end; ++range) {
+        const auto bytes = range->size * rowSize * meta.itemsize();
+        const char* rangeSrc = src + range->offset * rowSize * meta.itemsize();
+        if (meta.copy()) {
+          meta.copy()(rangeSrc, dst, range->size * rowSize);
+        } else {
+          memcpy(dst, rangeSrc, bytes);
+        }
+        dst += bytes;
+      }
+    }
+  });
+}
+
 TreeIterator::TreeIterator(const std::vector<std::string>& fields) {
   // populate field vector and split field names
   fields_.resize(fields.size());
@@ -499,27 +590,20 @@ class ReadNextBatchOp : public Operator<CPUContext> {
         sizes.assign(sizes.size(), 0);
       }
     }
-    // gather data
-    std::vector<TIndex> outDim;
+    // gather data, one range of rows per level
+    std::vector<std::vector<RowRange>> ranges(sizes.size());
+    for (int i = 0; i < sizes.size(); ++i) {
+      appendRowRange(ranges[i], offsets[i], sizes[i]);
+    }
+    std::vector<const TensorCPU*> inputs;
+    std::vector<int> levels;
+    std::vector<TensorCPU*> outputs;
     for (int i = 0; i < cursor->it.fields().size(); ++i) {
-      auto lengthIdx = cursor->it.fields()[i].lengthFieldId + 1;
-      auto size = sizes[lengthIdx];
-      auto offset = offsets[lengthIdx];
-      auto& in = Input(i + 1);
-      auto innerSize = in.size_from_dim(1);
-      outDim = in.dims();
-      outDim[0] = size;
-      auto* out = Output(i);
-      out->Resize(outDim);
-      void* src =
-          (char*)in.raw_data() + offset * innerSize * in.meta().itemsize();
-      void* dst = out->raw_mutable_data(in.meta()); // create the tensor
-      if (out->size() == 0) {
-        continue;
-      }
-      context_.template CopyItems<CPUContext, CPUContext>(
-          in.meta(), out->size(), src, dst);
+      inputs.push_back(&Input(i + 1));
+      levels.push_back(cursor->it.fields()[i].lengthFieldId + 1);
+      outputs.push_back(Output(i));
     }
+    gatherRowRanges(inputs, levels, ranges, outputs);
     return true;
   }
   int batchSize_;
@@ -675,8 +759,6 @@ class ReadRandomBatchOp : public Operator<CPUContext> {
     CAFFE_ENFORCE(InputSize() == cursor->it.fields().size() + 3);
     auto idxvec = idxblob.template data<int64_t>();
     auto& offsetdim = offsetsmat.dims();
-    // gather data
-    std::vector<TIndex> outDim;
     int64_t idx;
     {
       std::lock_guard<std::mutex> lock(cursor->mutex_);
@@ -694,57 +776,35 @@ class ReadRandomBatchOp : public Operator<CPUContext> {
       cursor->offsets.at(0) += batchSize_;
     }
 
-    for (int i = 0; i < cursor->it.fields().size(); ++i) {
-      auto lengthIdx = cursor->it.fields()[i].lengthFieldId + 1;
-      auto& in = Input(i + 3);
-      outDim = in.dims();
-      outDim.at(0) = 0;
-      auto idxbegin = idx;
-      for (int j = 0; j < batchSize_; ++j) {
-        if (idx >= idxblob.size()) {
-          break;
-        }
-        CAFFE_ENFORCE(
-            (idxvec[idx] + 1) * offsetdim[1] + lengthIdx < offsetsmat.size(),
-            "Out of bound when trying to get elem from offsetsmat");
-        auto offsetptr = offsetsmat.template data<TOffset>() +
-            idxvec[idx] * offsetdim[1] + lengthIdx;
-        auto offset = *offsetptr;
-        auto size = *(offsetptr + offsetdim[1]) - offset;
-        outDim.at(0) += size; // accumulate over the batch
-        idx++;
-      }
-      idx = idxbegin; // reSet
-      auto* out = Output(i);
-      out->Resize(outDim);
-      if (out->size() == 0) {
-        continue;
-      }
-      auto dst = static_cast<char*>(out->raw_mutable_data(in.meta()));
-      int block_size = in.size() / in.dim(0);
-      auto block_bytesize = in.size_from_dim(1) * in.meta().itemsize();
+    // compute the ranges of rows of the batch once per level, merging the
+    // ones of consecutive records
+    const int numLevels = cursor->it.numOffsetFields();
+    CAFFE_ENFORCE_GE(offsetdim[1], numLevels);
+    std::vector<std::vector<RowRange>> ranges(numLevels);
+    const auto* offsetsData = offsetsmat.template data<TOffset>();
+    const auto idxend = std::min<int64_t>(idx + batchSize_, idxblob.size());
+    for (; idx < idxend; ++idx) {
       CAFFE_ENFORCE(
-          block_bytesize == in.nbytes() / in.dim(0),
-          "block_bytesize should be consistent with data dim");
-      auto src_base = static_cast<const char*>(in.raw_data());
-      int start = 0;
-      for (int j = 0; j < batchSize_; ++j) {
-        if (idx >= idxblob.size()) {
-          break;
-        }
-        auto offsetptr = offsetsmat.template data<TOffset>() +
-            idxvec[idx] * offsetdim[1] + lengthIdx;
-        auto offset = *offsetptr;
-        auto size = *(offsetptr + offsetdim[1]) - offset;
-        // copy data
-        auto src = src_base + offset * block_bytesize;
-        context_.template CopyItems<CPUContext, CPUContext>(
-            in.meta(), size * block_size, src, dst + start * block_bytesize);
-        start += size;
-        idx++;
+          (idxvec[idx] + 1) * offsetdim[1] + numLevels - 1 <
+              offsetsmat.size(),
+          "Out of bound when trying to get elem from offsetsmat");
+      const auto* offsetptr = offsetsData + idxvec[idx] * offsetdim[1];
+      for (int level = 0; level < numLevels; ++level) {
+        appendRowRange(
+            ranges[level],
+            offsetptr[level],
+            offsetptr[level + offsetdim[1]] - offsetptr[level]);
       }
-      idx = idxbegin; // reSet
     }
+    std::vector<const TensorCPU*> inputs;
+    std::vector<int> levels;
+    std::vector<TensorCPU*> outputs;
+    for (int i = 0; i < cursor->it.fields().size(); ++i) {
+      inputs.push_back(&Input(i + 3));
+      levels.push_back(cursor->it.fields()[i].lengthFieldId + 1);
+      outputs.push_back(Output(i));
+    }
+    gatherRowRanges(inputs, levels, ranges, outputs);
     return true;
   }
   int batchSize_;
@@ -1199,6 +1259,9 @@ Input(2) is a blob pointing to the offset matrix and
 [Input(3),... Input(num_fields)] a list of tensors containing the data for
 each field of the dataset.
 
+The rows of consecutive records that are contiguous in the dataset are copied
+at once, and the copies are split over the intra-op threads of the net.
+
 ReadRandomBatch is thread safe.
 )DOC")
     .Input(0, "cursor", "A blob containing a pointer to the cursor.")
@@ -205,6 +205,28 @@ class TreeWalker {
   std::vector<TOffset> prevOffsets_;
 };
 
+// A range of rows [offset, offset + size) of the fields of a level.
+struct RowRange {
+  TOffset offset;
+  TOffset size;
+};
+
+// Appends a range of rows, merging it into the last one if they are
+// contiguous.
+void appendRowRange(
+    std::vector<RowRange>& ranges,
+    TOffset offset,
+    TOffset size);
+
+// Copies the rows of each input given by the ranges of its level (as in
+// TreeCursor offsets) into the corresponding output, resized to hold them.
+// The copies are split over the intra-op threads of the caller.
+void gatherRowRanges(
+    const std::vector<const TensorCPU*>& inputs,
+    const std::vector<int>& levels,
+    const std::vector<std::vector<RowRange>>& ranges,
+    const std::vector<TensorCPU*>& outputs);
+
 using SharedTensorVectorPtr = std::shared_ptr<std::vector<TensorCPU>>;
 
 template <class Context>
@@ -26,6 +26,16 @@ OPERATOR_SCHEMA(Sum)
     .AllowInplace({{0, 0}})
     .InputsCanCrossDevices()
     .IdenticalTypeAndShapeOfInput(0)
+    .CostInferenceFunction([](const OperatorDef& /*unused*/,
+                              const vector<TensorShape>& in) {
+      struct OpSchema::Cost c;
+      c.flops = nElemFromDim(in[0]) * (in.size() - 1);
+      for (const auto& input : in) {
+        c.bytes_moved += nBytes(input);
+      }
+      c.bytes_moved += nBytes(in[0]);
+      return c;
+    })
     .SetDoc(R"DOC(
 Element-wise sum of each of the input tensors. The first input tensor can be
 used in-place as the output tensor, in which case the sum will be done in
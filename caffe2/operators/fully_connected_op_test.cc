@@ -85,4 +85,24 @@ TEST(FullyConnectedTest, FCTransposedTest) {
   }
 }
 
+TEST(FullyConnectedTest, CostInference) {
+  Workspace ws;
+  OperatorDef def;
+  def.set_type("FC");
+  def.add_input("X");
+  def.add_input("W");
+  def.add_input("B");
+  def.add_output("Y");
+  AddConstInput(vector<TIndex>{5, 2, 5}, 1., "X", &ws);
+  AddConstInput(vector<TIndex>{6, 10}, 1., "W", &ws);
+  AddConstInput(vector<TIndex>{6}, 0.1, "B", &ws);
+  unique_ptr<OperatorBase> op(CreateOperator(def, &ws));
+  ASSERT_NE(nullptr, op.get());
+  const auto* schema = OpSchemaRegistry::Schema("FC");
+  ASSERT_TRUE(schema->HasCostInferenceFunction());
+  const auto cost = schema->InferCost(def, op->InputTensorShapes());
+  EXPECT_EQ(2 * 5 * 10 * 6, cost.flops);
+  EXPECT_EQ((50 + 60 + 6 + 30) * sizeof(float), cost.bytes_moved);
+}
+
 }  // namespace caffe2
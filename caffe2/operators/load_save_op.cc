@@ -31,6 +31,8 @@ REGISTER_CPU_OPERATOR(Save, SaveOp<CPUContext>);
 REGISTER_CPU_OPERATOR(Checkpoint, CheckpointOp<CPUContext>);
 // CPU Operator old name: do NOT use, we may deprecate this later.
 REGISTER_CPU_OPERATOR(Snapshot, CheckpointOp<CPUContext>);
+REGISTER_CPU_OPERATOR(SaveModelContainer, SaveModelContainerOp);
+REGISTER_CPU_OPERATOR(LoadModelContainer, LoadModelContainerOp);
 
 OPERATOR_SCHEMA(DBExists)
     .NumInputs(0)
@@ -152,9 +154,57 @@ counter). This is determined whether we need to do checkpointing.
 
 OPERATOR_SCHEMA(Snapshot);
 
+OPERATOR_SCHEMA(SaveModelContainer)
+    .NumInputs(1, INT_MAX)
+    .NumOutputs(0)
+    .SetDoc(R"DOC(
+The SaveModelContainer operator saves a set of blobs to a model container, a
+single file from which LoadModelContainer can load them without parsing or
+copying the data of CPU tensors. The data of the CPU tensors of fixed-size
+types is stored raw and page-aligned, the other blobs are serialized.
+)DOC")
+    .Arg(
+        "absolute_path",
+        "(int, default 0) if set, use the db path directly and do not prepend "
+        "the current root folder of the workspace.")
+    .Arg(
+        "blob_name_overrides",
+        "(list of strings) if set, used instead of original "
+        "blob names. Must be the same length as number of blobs.")
+    .Arg("db", "(string) the path to the model container to write.");
+
+OPERATOR_SCHEMA(LoadModelContainer)
+    .NumInputs(0)
+    .NumOutputs(0, INT_MAX)
+    .SetDoc(R"DOC(
+The LoadModelContainer operator loads a set of blobs from a model container
+written by SaveModelContainer, using the blob names to match them with the
+outputs.
+
+The CPU tensors stored raw are not copied: they alias a private memory mapping
+of the file, whose pages are shared by all the processes loading it. Writing to
+them only modifies the copy of the process. The other blobs are deserialized
+in parallel, on CPU.
+)DOC")
+    .Arg(
+        "absolute_path",
+        "(int, default 0) if set, use the db path directly and do not prepend "
+        "the current root folder of the workspace.")
+    .Arg("db", "(string) the path to the model container to load.")
+    .Arg(
+        "load_all",
+        "(int, default 0) if nonzero, will load all blobs of the container "
+        "to the workspace overwriting/creating blobs as needed.")
+    .Arg(
+        "allow_incomplete",
+        "(bool, default false) if true, will allow not loading all the output "
+        "blobs specified in the outputs");
+
 NO_GRADIENT(Load);
 SHOULD_NOT_DO_GRADIENT(DBExists);
 SHOULD_NOT_DO_GRADIENT(Save);
 SHOULD_NOT_DO_GRADIENT(Checkpoint);
 SHOULD_NOT_DO_GRADIENT(Snapshot);
+SHOULD_NOT_DO_GRADIENT(SaveModelContainer);
+NO_GRADIENT(LoadModelContainer);
 }  // namespace caffe2
@@ -17,8 +17,12 @@
 #ifndef CAFFE2_OPERATORS_LOAD_SAVE_OP_H_
 #define CAFFE2_OPERATORS_LOAD_SAVE_OP_H_
 
+#include <condition_variable>
 #include <cstdio>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <thread>
 #include <unordered_set>
 
 #include "caffe2/core/blob_serialization.h"
@@ -26,6 +30,7 @@
 #include "caffe2/core/db.h"
 #include "caffe2/core/logging.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/core/scope_guard.h"
 #include "caffe2/utils/math.h"
 #include "caffe2/utils/proto_utils.h"
 
@@ -221,27 +226,13 @@ class LoadOp final : public Operator<Context> {
       std::unordered_map<string, BlobState>* blob_states,
       int* total_loaded_blobs) {
     CAFFE_ENFORCE(cursor, "cursor is not valid");
-    int loaded_blobs = 0;
-    for (; cursor->Valid(); cursor->Next()) {
-      const auto key = buildBlobNameFromDbKey(cursor->key());
-      if (key_to_dbid_.count(key) && key_to_dbid_[key] != db_id) {
-        CAFFE_THROW("Duplicate Key ", key, " is found!\n");
-      } else {
-        key_to_dbid_[key] = db_id;
-      }
-
-      BlobProto proto;
-      CAFFE_ENFORCE(
-          proto.ParseFromString(cursor->value()), "Couldn't parse Proto");
-      if (!keep_device_) {
-        // If we are not keeping the device as the one specified in the
-        // proto, we will set the current device.
-        SetCurrentDevice(&proto);
-      }
-      Blob* blob = ws_->CreateBlob(key);
-      ProcessBlob(blob, proto, blob_states, key, &loaded_blobs);
-    }
-    *total_loaded_blobs += loaded_blobs;
+    extractRecords(
+        db_id,
+        cursor,
+        [this](const string& key) { return ws_->CreateBlob(key); },
+        false /* stop_when_complete */,
+        blob_states,
+        total_loaded_blobs);
   }
 
   void extractFrom(
@@ -251,36 +242,148 @@ class LoadOp final : public Operator<Context> {
       std::unordered_map<string, BlobState>* blob_states,
       int* total_loaded_blobs) {
     CAFFE_ENFORCE(cursor);
+    extractRecords(
+        db_id,
+        cursor,
+        [&](const string& key) -> Blob* {
+          if (!output_indices_.count(key)) {
+            VLOG(1) << "Key " << key << " not used. Skipping.";
+            return nullptr;
+          }
+          return outputs.at(output_indices_[key]);
+        },
+        true /* stop_when_complete */,
+        blob_states,
+        total_loaded_blobs);
+  }
+
+  // Reads the records of `cursor` and deserializes them into the blobs
+  // returned by `getBlob`, skipping the records it returns nullptr for.
+  //
+  // With more than one deserializer thread, the records are parsed and
+  // deserialized by a pool of workers. The blob states are still updated one
+  // record at a time, and the first chunk of a CPU tensor allocates the whole
+  // tensor, so that the workers copy the chunks into their slice of it
+  // concurrently.
+  void extractRecords(
+      int db_id,
+      Cursor* cursor,
+      std::function<Blob*(const string&)> getBlob,
+      bool stop_when_complete,
+      std::unordered_map<string, BlobState>* blob_states,
+      int* total_loaded_blobs) {
+    struct Record {
+      string key;
+      Blob* blob;
+      string value;
+    };
     int loaded_blobs = 0;
-    for (; cursor->Valid(); cursor->Next()) {
-      const auto key = buildBlobNameFromDbKey(cursor->key());
-      if (!output_indices_.count(key)) {
-        VLOG(1) << "Key " << key << " not used. Skipping.";
-      } else {
-        if (key_to_dbid_.count(key) && key_to_dbid_[key] != db_id) {
-          CAFFE_THROW("Duplicate Key ", key, " is found!\n");
-        } else {
-          key_to_dbid_[key] = db_id;
+    std::mutex mutex;
+    bool complete = false;
+    auto process = [&](const Record& record) {
+      VLOG(2) << "Deserializing blob " << record.key;
+      BlobProto proto;
+      CAFFE_ENFORCE(
+          proto.ParseFromString(record.value), "Couldn't parse Proto");
+      if (!keep_device_) {
+        // If we are not keeping the device as the one specified in the
+        // proto, we will set the current device.
+        SetCurrentDevice(&proto);
+      }
+      Tensor<Context>* slice = nullptr;
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (complete) {
+          return;
         }
+        ProcessBlob(
+            record.blob, proto, blob_states, record.key, &loaded_blobs, &slice);
+        complete = stop_when_complete &&
+            *total_loaded_blobs + loaded_blobs == OutputSize();
+      }
+      if (slice) {
+        TensorDeserializer<Context>().DeserializeChunk(proto.tensor(), slice);
+      }
+    };
 
-        VLOG(2) << "Deserializing blob " << key;
-        BlobProto proto;
-        CAFFE_ENFORCE(proto.ParseFromString(cursor->value()));
-        if (!keep_device_) {
-          // If we are not keeping the device as the one specified in the
-          // proto, we will set the current device.
-          SetCurrentDevice(&proto);
+    std::exception_ptr error;
+    {
+      const int num_threads = FLAGS_caffe2_max_tensor_deserializer_threads;
+      // Bounds the memory held by the records read but not processed yet
+      const int max_pending = 2 * num_threads;
+      int pending = 0;
+      std::condition_variable processed;
+      SimpleQueue<std::shared_ptr<Record>> records;
+      std::vector<std::thread> workers;
+#ifndef __ANDROID__
+      for (int i = 0; num_threads > 1 && i < num_threads; ++i) {
+        workers.emplace_back([&]() {
+          std::shared_ptr<Record> record;
+          while (records.Pop(&record)) {
+            try {
+              process(*record);
+            } catch (...) {
+              std::lock_guard<std::mutex> guard(mutex);
+              if (!error) {
+                error = std::current_exception();
+              }
+            }
+            record.reset();
+            {
+              std::lock_guard<std::mutex> guard(mutex);
+              --pending;
+            }
+            processed.notify_one();
+          }
+        });
+      }
+#endif
+      // Waits for the records being processed, even if reading throws
+      auto join = MakeGuard([&]() {
+        records.NoMoreJobs();
+        for (auto& worker : workers) {
+          worker.join();
+        }
+      });
+
+      for (; cursor->Valid(); cursor->Next()) {
+        auto record = std::make_shared<Record>();
+        record->key = buildBlobNameFromDbKey(cursor->key());
+        record->blob = getBlob(record->key);
+        if (!record->blob) {
+          continue;
+        }
+        if (key_to_dbid_.count(record->key) &&
+            key_to_dbid_[record->key] != db_id) {
+          CAFFE_THROW("Duplicate Key ", record->key, " is found!\n");
+        } else {
+          key_to_dbid_[record->key] = db_id;
         }
-        auto blobIndex = output_indices_[key];
-        Blob* blob = outputs.at(blobIndex);
-        ProcessBlob(blob, proto, blob_states, key, &loaded_blobs);
+        record->value = cursor->value();
 
-        if (*total_loaded_blobs + loaded_blobs == OutputSize()) {
-          break;
+        if (workers.empty()) {
+          process(*record);
+          if (complete) {
+            break;
+          }
+          continue;
+        }
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          processed.wait(lock, [&]() {
+            return pending < max_pending || error || complete;
+          });
+          if (error || complete) {
+            break;
+          }
+          ++pending;
         }
+        records.Push(record);
       }
     }
-
+    if (error) {
+      std::rethrow_exception(error);
+    }
     *total_loaded_blobs += loaded_blobs;
   }
 
@@ -299,14 +402,19 @@ class LoadOp final : public Operator<Context> {
  private:
   // We are tracking sizes of already read tensor parts while reading data
   // chunks. This way we can make sure that all chunks were loaded in the end.
+  //
+  // The data of CPU tensors is not deserialized but left to the caller, who
+  // gets the tensor to deserialize it into in `slice`.
   void ProcessBlob(
       Blob* blob,
       const BlobProto& proto,
       std::unordered_map<string, BlobState>* blob_states_ptr,
       const string& key,
-      int* loaded_blobs) {
+      int* loaded_blobs,
+      Tensor<Context>** slice) {
     auto& blob_states = *blob_states_ptr;
-    if (blob_states.count(key) == 0) {
+    const bool first = blob_states.count(key) == 0;
+    if (first) {
       // We reset the blob so that any existing content is destroyed. This
       // is to guaranee correct device placement: if we are deserializing
       // into a TensorCUDA, without explicit Reset we might be loading data
@@ -314,7 +422,11 @@ class LoadOp final : public Operator<Context> {
       // different GPU.
       blob->Reset();
     }
-    blob->Deserialize(proto);
+    if (CanDeserializeChunk(proto)) {
+      *slice = PrepareChunk(blob, proto, key, first);
+    } else {
+      blob->Deserialize(proto);
+    }
     if (proto.has_content_num_chunks()) {
       if (!blob_states.count(key)) {
         blob_states[key] = BlobState(proto.content_num_chunks());
@@ -390,6 +502,48 @@ class LoadOp final : public Operator<Context> {
     }
   }
 
+  // Whether ProcessBlob leaves the data of `proto` to its caller
+  bool CanDeserializeChunk(const BlobProto& proto) {
+    if (!std::is_same<Context, CPUContext>::value || !proto.has_tensor() ||
+        proto.tensor().device_detail().device_type() != CPU) {
+      return false;
+    }
+    switch (proto.tensor().data_type()) {
+      case TensorProto_DataType_BYTE:
+      case TensorProto_DataType_UNDEFINED:
+        return false;
+      default:
+        return true;
+    }
+  }
+
+  // Allocates the whole tensor on its first chunk, and checks that the other
+  // chunks match it
+  Tensor<Context>* PrepareChunk(
+      Blob* blob,
+      const BlobProto& proto,
+      const string& key,
+      bool first) {
+    CAFFE_ENFORCE(
+        first || blob->template IsType<Tensor<Context>>(),
+        "Must be tensor ",
+        key);
+    auto* tensor = blob->template GetMutable<Tensor<Context>>();
+    const auto& meta = DataTypeToTypeMeta(proto.tensor().data_type());
+    const vector<TIndex> dims(
+        proto.tensor().dims().begin(), proto.tensor().dims().end());
+    if (first) {
+      tensor->Resize(dims);
+      tensor->raw_mutable_data(meta);
+    }
+    CAFFE_ENFORCE(
+        tensor->dims() == dims && tensor->meta() == meta,
+        "Chunks of tensor ",
+        key,
+        " have different shapes or types");
+    return tensor;
+  }
+
   void validateBlobStates(
       const std::unordered_map<string, BlobState>& blob_states) {
     for (const auto& iter : blob_states) {
@@ -502,6 +656,107 @@ class SaveOp final : public Operator<Context> {
   std::vector<std::string> blob_names_;
 };
 
+// Saves its inputs to a model container, see SaveModelContainer in
+// blob_serialization.h.
+class SaveModelContainerOp final : public Operator<CPUContext> {
+ public:
+  USE_OPERATOR_FUNCTIONS(CPUContext);
+  SaveModelContainerOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws),
+        ws_(ws),
+        absolute_path_(
+            OperatorBase::GetSingleArgument<int>("absolute_path", false)),
+        db_name_(OperatorBase::GetSingleArgument<string>("db", "")),
+        blob_names_(
+            OperatorBase::GetRepeatedArgument<string>("blob_name_overrides")) {
+    CAFFE_ENFORCE_GT(db_name_.size(), 0, "Must specify a db name.");
+    CAFFE_ENFORCE(
+        blob_names_.empty() ||
+            blob_names_.size() == OperatorBase::Inputs().size(),
+        "Number of blobs and blob_name_overrides mismatch.");
+    if (blob_names_.empty()) {
+      blob_names_.assign(
+          operator_def.input().begin(), operator_def.input().end());
+    }
+  }
+
+  bool RunOnDevice() override {
+    string full_db_name =
+        absolute_path_ ? db_name_ : (ws_->RootFolder() + "/" + db_name_);
+    SaveModelContainer(full_db_name, blob_names_, OperatorBase::Inputs());
+    return true;
+  }
+
+ private:
+  Workspace* ws_;
+  bool absolute_path_;
+  string db_name_;
+  std::vector<std::string> blob_names_;
+};
+
+// Loads blobs from a model container, see LoadModelContainer in
+// blob_serialization.h. The outputs are matched by name with the blobs of the
+// container, unless load_all is set.
+class LoadModelContainerOp final : public Operator<CPUContext> {
+ public:
+  USE_OPERATOR_FUNCTIONS(CPUContext);
+  LoadModelContainerOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws),
+        ws_(ws),
+        absolute_path_(
+            OperatorBase::GetSingleArgument<int>("absolute_path", false)),
+        db_name_(OperatorBase::GetSingleArgument<string>("db", "")),
+        load_all_(OperatorBase::GetSingleArgument<int>("load_all", 0)),
+        allow_incomplete_(
+            OperatorBase::GetSingleArgument<bool>("allow_incomplete", false)) {
+    CAFFE_ENFORCE_GT(db_name_.size(), 0, "Must specify a db name.");
+    CAFFE_ENFORCE(
+        !load_all_ || OutputSize() == 0,
+        "load_all can't be used with outputs.");
+    for (int i = 0; i < OutputSize(); ++i) {
+      CAFFE_ENFORCE(
+          output_indices_.emplace(operator_def.output(i), i).second,
+          "Duplicated output: ",
+          operator_def.output(i));
+    }
+  }
+
+  bool RunOnDevice() override {
+    string full_db_name =
+        absolute_path_ ? db_name_ : (ws_->RootFolder() + "/" + db_name_);
+    const int loaded = LoadModelContainer(
+        full_db_name, [this](const string& name) -> Blob* {
+          if (load_all_) {
+            return ws_->CreateBlob(name);
+          }
+          auto it = output_indices_.find(name);
+          if (it == output_indices_.end()) {
+            return nullptr;
+          }
+          return OperatorBase::Outputs()[it->second];
+        });
+    CAFFE_ENFORCE(
+        load_all_ || allow_incomplete_ || loaded == OutputSize(),
+        "Expected to load ",
+        OutputSize(),
+        " blobs from ",
+        full_db_name,
+        ", got ",
+        loaded,
+        " only.");
+    VLOG(1) << "Loaded " << loaded << " blobs from " << full_db_name;
+    return true;
+  }
+
+ private:
+  Workspace* ws_;
+  bool absolute_path_;
+  string db_name_;
+  bool load_all_;
+  bool allow_incomplete_;
+  std::map<string, int> output_indices_;
+};
+
 template <typename... Ts>
 string FormatString(const string& pattern, Ts... values) {
   // Note(Yangqing): We believe that 1024 is enough, but who are we to assert
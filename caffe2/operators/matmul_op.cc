@@ -49,6 +49,32 @@ OPERATOR_SCHEMA(MatMul)
 
       return out;
     })
+    .CostInferenceFunction([](const OperatorDef& def,
+                              const vector<TensorShape>& in) {
+      struct OpSchema::Cost c;
+      ArgumentHelper arg_helper(def);
+      int axis_a = arg_helper.GetSingleArgument<int>("axis_a", 1);
+      int axis_b = arg_helper.GetSingleArgument<int>("axis_b", 1);
+      int trans_a = arg_helper.GetSingleArgument<bool>("trans_a", false);
+      int trans_b = arg_helper.GetSingleArgument<bool>("trans_b", false);
+      int canonical_axis_a = canonical_axis_index_(axis_a, in[0].dims().size());
+      int canonical_axis_b = canonical_axis_index_(axis_b, in[1].dims().size());
+
+      uint64_t M = size_to_dim_(canonical_axis_a, GetDimsVector(in[0]));
+      uint64_t K = size_from_dim_(canonical_axis_a, GetDimsVector(in[0]));
+      uint64_t N = size_from_dim_(canonical_axis_b, GetDimsVector(in[1]));
+      if (trans_a) {
+        std::swap(M, K);
+      }
+      if (trans_b) {
+        N = size_to_dim_(canonical_axis_b, GetDimsVector(in[1]));
+      }
+
+      c.flops = 2 * M * K * N;
+      c.bytes_moved = nBytes(in[0]) + nBytes(in[1]) +
+          M * N * DataTypeToTypeMeta(in[0].data_type()).itemsize();
+      return c;
+    })
     .SetDoc(R"DOC(
 Matrix multiplication Y = A * B, where A has size (M x K), B has size (K x N),
 and Y will have a size (M x N).
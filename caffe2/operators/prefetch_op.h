@@ -13,23 +13,30 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-
 #ifndef CAFFE2_OPERATORS_PREFETCH_OP_H_
 #define CAFFE2_OPERATORS_PREFETCH_OP_H_
 
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <thread> // NOLINT
 
 #include "caffe2/core/context.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/core/stats.h"
 
 namespace caffe2 {
 
-// PrefetchOperator is an operator that prefetches the next batch. It should
+// PrefetchOperator is an operator that prefetches the next batches. It should
 // almost always be used to read things from disk, so I am setting the input to
 // zero blobs.
 //
+// The prefetching thread fills a ring of "prefetch_depth" (default 1) buffers
+// ahead of the consumer, so that bursts of slow batches are absorbed by the
+// batches already prepared. Operators supporting a depth above one implement
+// the Prefetch(int) and CopyPrefetched(int) variants below, keeping one set of
+// prefetched tensors per buffer.
+//
 // For any operator that is derived from PrefetchOperator, it should
 // explicitly call the Finalize() function in its destructor, so that the
 // prefetching thread is properly destructed.
@@ -44,9 +51,15 @@ class PrefetchOperator : public OperatorBase {
   PrefetchOperator(const OperatorDef& operator_def, Workspace* ws)
       : OperatorBase(operator_def, ws),
         context_(operator_def.device_option()),
-        prefetched_(false),
-        prefetch_success_(true),
-        finalize_(false) {
+        prefetch_depth_(
+            OperatorBase::GetSingleArgument<int>("prefetch_depth", 1)),
+        prefetch_success_(std::max(prefetch_depth_, 1), true),
+        finalize_(false),
+        stats_(
+            operator_def.type() + "/" +
+            (operator_def.output_size() ? operator_def.output(0)
+                                        : operator_def.name())) {
+    CAFFE_ENFORCE_GE(prefetch_depth_, 1, "prefetch_depth must be positive");
     context_.SwitchToDevice(0);
   }
 
@@ -61,11 +74,9 @@ class PrefetchOperator : public OperatorBase {
     if (prefetch_thread_.get()) {
       {
         std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
-        while (!prefetched_)
-          consumer_.wait(lock);
         finalize_ = true;
-        prefetched_ = false;
       }
+      // The prefetching thread quits once its current batch, if any, is done.
       producer_.notify_one();
       prefetch_thread_->join();
       prefetch_thread_.reset();
@@ -85,19 +96,41 @@ class PrefetchOperator : public OperatorBase {
           new std::thread([this] { this->PrefetchWorker(); }));
     }
     context_.SwitchToDevice(0);
-    std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
-    while (!prefetched_)
-      consumer_.wait(lock);
-    if (!prefetch_success_) {
-      LOG(ERROR) << "Prefetching failed.";
-      return false;
+    int buffer;
+    {
+      std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
+      // Stats are incremented directly rather than with CAFFE_EVENT, whose
+      // static tracepoints cannot live in templates instantiated by several
+      // translation units.
+      stats_.prefetch_occupancy.increment(num_prefetched_ - num_consumed_);
+      const auto start = std::chrono::steady_clock::now();
+      if (num_prefetched_ == num_consumed_) {
+        stats_.prefetch_stalls.increment(1);
+        consumer_.wait(
+            lock, [this] { return num_prefetched_ != num_consumed_; });
+      }
+      stats_.prefetch_stall_ns.increment(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count());
+      buffer = num_consumed_ % prefetch_depth_;
+      if (!prefetch_success_[buffer]) {
+        // The failed batch is not consumed, so that later runs fail as well.
+        LOG(ERROR) << "Prefetching failed.";
+        return false;
+      }
     }
-    if (!CopyPrefetched()) {
+    // The producer does not touch a buffer until it is consumed, so it can be
+    // handed over without holding the lock.
+    if (!CopyPrefetched(buffer)) {
       LOG(ERROR) << "Error when copying prefetched data.";
       return false;
     }
-    prefetched_ = false;
     context_.FinishDeviceComputation();
+    {
+      std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
+      ++num_consumed_;
+    }
     producer_.notify_one();
     return true;
   }
@@ -105,42 +138,90 @@ class PrefetchOperator : public OperatorBase {
   void PrefetchWorker() {
     context_.SwitchToDevice();
     std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
-    while (prefetched_)
-      producer_.wait(lock);
     while (!finalize_) {
+      if (num_prefetched_ - num_consumed_ == prefetch_depth_) {
+        producer_.wait(lock);
+        continue;
+      }
+      const int buffer = num_prefetched_ % prefetch_depth_;
+      lock.unlock();
       // We will need to run a FinishDeviceComputation() call because the
       // prefetcher thread and the main thread are potentially using different
       // streams (like on GPU).
+      bool success = false;
       try {
-        prefetch_success_ = Prefetch();
+        success = Prefetch(buffer);
         context_.FinishDeviceComputation();
       } catch (const std::exception& e) {
         // TODO: propagate exception_ptr to the caller side
         LOG(ERROR) << "Prefetching error " << e.what();
-        prefetch_success_ = false;
       }
-      prefetched_ = true;
+      lock.lock();
+      prefetch_success_[buffer] = success;
+      ++num_prefetched_;
       consumer_.notify_one();
-      while (prefetched_)
-        producer_.wait(lock);
     }
   }
 
-  // You will need to implement this instead of the Run function.
-  virtual bool Prefetch() = 0;
-  virtual bool CopyPrefetched() = 0;
+  // You will need to implement these instead of the Run function: either the
+  // variants taking the buffer, out of prefetch_depth_, to fill or to hand
+  // over, or the single buffer variants if prefetch_depth > 1 is unsupported.
+  virtual bool Prefetch(int buffer) {
+    CAFFE_ENFORCE_EQ(
+        buffer, 0, type(), " does not support prefetch_depth > 1");
+    return Prefetch();
+  }
+  virtual bool CopyPrefetched(int buffer) {
+    CAFFE_ENFORCE_EQ(buffer, 0);
+    return CopyPrefetched();
+  }
+  virtual bool Prefetch() {
+    CAFFE_THROW("Prefetch is not implemented for ", type());
+  }
+  virtual bool CopyPrefetched() {
+    CAFFE_THROW("CopyPrefetched is not implemented for ", type());
+  }
 
  protected:
+  // Hands a prefetched CPU tensor over to an output. CPU outputs take the
+  // storage of the buffer, which is refilled in freshly allocated memory:
+  // the previous storage of the output may still be shared by other blobs.
+  // Other outputs are copied into.
+  static void HandOver(TensorCPU* prefetched, TensorCPU* output, CPUContext*) {
+    output->swap(*prefetched);
+    prefetched->ResizeLike(*output);
+    prefetched->FreeMemory();
+  }
+  template <class OutputContext>
+  static void HandOver(
+      TensorCPU* prefetched,
+      Tensor<OutputContext>* output,
+      OutputContext* context) {
+    output->CopyFrom(*prefetched, context);
+  }
+
   Context context_;
+  const int prefetch_depth_;
   std::mutex prefetch_access_mutex_;
   std::condition_variable producer_, consumer_;
-  // prefetched_ is used to tell the operator that it is done.
-  std::atomic<bool> prefetched_;
-  // prefetch_success_ is used to see if prefetching failed or not.
-  std::atomic<bool> prefetch_success_;
+  // Batches prefetched and consumed so far, guarded by prefetch_access_mutex_.
+  // Batch i is prefetched into buffer i % prefetch_depth_.
+  int64_t num_prefetched_ = 0;
+  int64_t num_consumed_ = 0;
+  // prefetch_success_ is used to see if prefetching each buffer failed or not.
+  std::vector<bool> prefetch_success_;
   // finalize_ is used to tell the prefetcher to quit.
   std::atomic<bool> finalize_;
   unique_ptr<std::thread> prefetch_thread_;
+
+  struct PrefetchStats {
+    CAFFE_STAT_CTOR(PrefetchStats);
+    // Prefetched batches ready when the operator runs
+    CAFFE_HISTOGRAM_EXPORTED_STAT(prefetch_occupancy);
+    // Time the operator waits for a batch, and runs finding none ready
+    CAFFE_HISTOGRAM_EXPORTED_STAT(prefetch_stall_ns);
+    CAFFE_EXPORTED_STAT(prefetch_stalls);
+  } stats_;
 };
 
 } // namespace caffe2
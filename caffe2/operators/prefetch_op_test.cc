@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <thread>
+
+#include "caffe2/operators/prefetch_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// Prefetches batches holding their index, failing at "fail_at" if given.
+class CountingPrefetchOp final : public PrefetchOperator<CPUContext> {
+ public:
+  CountingPrefetchOp(const OperatorDef& operator_def, Workspace* ws)
+      : PrefetchOperator<CPUContext>(operator_def, ws),
+        fail_at_(GetSingleArgument<int>("fail_at", -1)),
+        buffers_(prefetch_depth_) {}
+  ~CountingPrefetchOp() {
+    Finalize();
+  }
+
+  bool Prefetch(int buffer) override {
+    if (next_ == fail_at_) {
+      return false;
+    }
+    auto& tensor = buffers_[buffer];
+    tensor.Resize(4);
+    for (int i = 0; i < tensor.size(); ++i) {
+      tensor.mutable_data<int>()[i] = next_;
+    }
+    ++next_;
+    return true;
+  }
+
+  bool CopyPrefetched(int buffer) override {
+    HandOver(&buffers_[buffer], Output<TensorCPU>(0), &context_);
+    return true;
+  }
+
+  int prefetched() const {
+    return next_;
+  }
+
+ private:
+  const int fail_at_;
+  std::atomic<int> next_{0};
+  std::vector<TensorCPU> buffers_;
+};
+
+REGISTER_CPU_OPERATOR(CountingPrefetch, CountingPrefetchOp);
+OPERATOR_SCHEMA(CountingPrefetch).NumInputs(0).NumOutputs(1);
+
+OperatorDef CountingPrefetchDef(int depth) {
+  OperatorDef def;
+  def.set_type("CountingPrefetch");
+  def.add_output("batch");
+  auto* arg = def.add_arg();
+  arg->set_name("prefetch_depth");
+  arg->set_i(depth);
+  return def;
+}
+
+} // namespace
+
+TEST(PrefetchOpTest, BatchesInOrder) {
+  for (const int depth : {1, 2, 3}) {
+    Workspace ws;
+    unique_ptr<OperatorBase> op(
+        CreateOperator(CountingPrefetchDef(depth), &ws));
+    ASSERT_NE(nullptr, op.get());
+    for (int i = 0; i < 10; ++i) {
+      ASSERT_TRUE(op->Run());
+      const auto& batch = ws.GetBlob("batch")->Get<TensorCPU>();
+      ASSERT_EQ(batch.size(), 4);
+      for (int j = 0; j < batch.size(); ++j) {
+        EXPECT_EQ(batch.data<int>()[j], i);
+      }
+    }
+  }
+}
+
+TEST(PrefetchOpTest, FillsRingAhead) {
+  const int kDepth = 3;
+  Workspace ws;
+  unique_ptr<OperatorBase> op(CreateOperator(CountingPrefetchDef(kDepth), &ws));
+  auto* counting = static_cast<CountingPrefetchOp*>(op.get());
+  ASSERT_TRUE(op->Run());
+  // The prefetching thread fills every buffer and then waits
+  for (int i = 0; i < 1000 && counting->prefetched() < kDepth + 1; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(counting->prefetched(), kDepth + 1);
+
+  // Blobs sharing an output keep their data while later batches are
+  // prefetched
+  const auto& first = ws.GetBlob("batch")->Get<TensorCPU>();
+  TensorCPU shared;
+  shared.ResizeLike(first);
+  shared.ShareData(first);
+  EXPECT_EQ(shared.data<int>()[0], 0);
+  for (int i = 1; i <= 2 * kDepth; ++i) {
+    ASSERT_TRUE(op->Run());
+    const auto& batch = ws.GetBlob("batch")->Get<TensorCPU>();
+    EXPECT_EQ(batch.data<int>()[0], i);
+    EXPECT_NE(batch.raw_data(), shared.raw_data());
+  }
+  for (int i = 0; i < 1000 && counting->prefetched() < 3 * kDepth + 1; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  for (int i = 0; i < shared.size(); ++i) {
+    EXPECT_EQ(shared.data<int>()[i], 0);
+  }
+}
+
+TEST(PrefetchOpTest, FailureIsSticky) {
+  Workspace ws;
+  auto def = CountingPrefetchDef(2);
+  auto* arg = def.add_arg();
+  arg->set_name("fail_at");
+  arg->set_i(1);
+  unique_ptr<OperatorBase> op(CreateOperator(def, &ws));
+  EXPECT_TRUE(op->Run());
+  EXPECT_FALSE(op->Run());
+  EXPECT_FALSE(op->Run());
+}
+
+TEST(PrefetchOpTest, InvalidDepth) {
+  Workspace ws;
+  EXPECT_THROW(CreateOperator(CountingPrefetchDef(0), &ws), EnforceNotMet);
+}
+
+} // namespace caffe2
@@ -200,6 +200,21 @@ OPERATOR_SCHEMA(SpatialBN)
             return vector<TensorShape>{in[0]};
           }
         })
+    .CostInferenceFunction(
+        [](const OperatorDef& def, const vector<TensorShape>& in) {
+          struct OpSchema::Cost c;
+          ArgumentHelper helper(def);
+          bool is_test = helper.GetSingleArgument<int>(OpSchema::Arg_IsTest, 0);
+          // A multiply and an add per element to normalize, plus the
+          // computation of the mean and variance in training.
+          const uint64_t size = nElemFromDim(in[0]);
+          c.flops = size * (is_test ? 2 : 5);
+          for (const auto& input : in) {
+            c.bytes_moved += nBytes(input);
+          }
+          c.bytes_moved += nBytes(in[0]) * (is_test ? 1 : 2);
+          return c;
+        })
     .SetDoc(R"DOC(
 Carries out spatial batch normalization as described in the paper
 https://arxiv.org/abs/1502.03167 . Depending on the mode it is being run,
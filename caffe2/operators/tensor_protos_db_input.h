@@ -17,6 +17,7 @@
 #ifndef CAFFE2_OPERATORS_TENSOR_PROTOS_DB_INPUT_H_
 #define CAFFE2_OPERATORS_TENSOR_PROTOS_DB_INPUT_H_
 
+#include <algorithm>
 #include <iostream>
 #include <mutex>
 
@@ -30,21 +31,31 @@ class TensorProtosDBInput final : public PrefetchOperator<Context> {
  public:
   using OperatorBase::OutputSize;
   using PrefetchOperator<Context>::prefetch_thread_;
+  using PrefetchOperator<Context>::prefetch_depth_;
   explicit TensorProtosDBInput(const OperatorDef& operator_def, Workspace* ws);
   ~TensorProtosDBInput() {
     PrefetchOperator<Context>::Finalize();
   }
 
-  bool Prefetch() override;
-  bool CopyPrefetched() override;
+  bool Prefetch(int buffer) override;
+  bool CopyPrefetched(int buffer) override;
 
  private:
-  // Prefetch will always just happen on the CPU side.
-  vector<Blob> prefetched_blobs_;
+  // Prefetch will always just happen on the CPU side, into one set of blobs
+  // per prefetch buffer.
+  vector<vector<Blob>> prefetched_blobs_;
   int batch_size_;
   bool shape_inferred_ = false;
-  string key_;
-  string value_;
+  // Decodes the fields of the current record of the cursor into `fields`,
+  // for dbs that support Cursor::ReadField(). Returns false if the record
+  // has to be parsed from its value instead.
+  bool ReadFields(db::Cursor* cursor, vector<TensorCPU>* fields);
+
+  // The records of a batch, either decoded by the db into batch_fields_ or
+  // parsed straight from its storage into batch_protos_.
+  vector<TensorProtos> batch_protos_;
+  vector<vector<TensorCPU>> batch_fields_;
+  vector<bool> fields_read_;
 };
 
 template <class Context>
@@ -52,52 +63,96 @@ TensorProtosDBInput<Context>::TensorProtosDBInput(
     const OperatorDef& operator_def,
     Workspace* ws)
     : PrefetchOperator<Context>(operator_def, ws),
-      prefetched_blobs_(operator_def.output_size()),
+      prefetched_blobs_(prefetch_depth_),
       batch_size_(
-          OperatorBase::template GetSingleArgument<int>("batch_size", 0)) {}
+          OperatorBase::template GetSingleArgument<int>("batch_size", 0)) {
+  for (auto& blobs : prefetched_blobs_) {
+    blobs = vector<Blob>(operator_def.output_size());
+  }
+  batch_protos_.resize(std::max(batch_size_, 1));
+  batch_fields_.resize(std::max(batch_size_, 1));
+  for (auto& fields : batch_fields_) {
+    fields.resize(operator_def.output_size());
+  }
+  fields_read_.resize(std::max(batch_size_, 1));
+}
 
 template <class Context>
-bool TensorProtosDBInput<Context>::Prefetch() {
+bool TensorProtosDBInput<Context>::ReadFields(
+    db::Cursor* cursor,
+    vector<TensorCPU>* fields) {
+  if (cursor->NumFields() < 0) {
+    return false;
+  }
+  CAFFE_ENFORCE_EQ(cursor->NumFields(), OutputSize());
+  for (int i = 0; i < OutputSize(); ++i) {
+    if (!cursor->ReadField(i, &(*fields)[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <class Context>
+bool TensorProtosDBInput<Context>::Prefetch(int buffer) {
   const db::DBReader& reader = OperatorBase::Input<db::DBReader>(0);
+  vector<Blob>& prefetched_blobs = prefetched_blobs_[buffer];
   TensorDeserializer<CPUContext> deserializer;
+  // Read the records at once, so that other readers of the db wait for the
+  // lock once per batch rather than once per item. Dbs that can decode the
+  // fields of a record into tensors, like columndb, skip the TensorProtos;
+  // the other records are parsed straight from the storage of the db.
+  reader.VisitManyRecords(
+      std::max(batch_size_, 1), [this](int item_id, db::Cursor* cursor) {
+        fields_read_[item_id] = ReadFields(cursor, &batch_fields_[item_id]);
+        if (!fields_read_[item_id]) {
+          const db::ValueView value = cursor->value_view();
+          CAFFE_ENFORCE(
+              batch_protos_[item_id].ParseFromArray(value.data, value.size));
+        }
+      });
   if (batch_size_ == 0) {
     // We do not need to construct a batch. As a result, we will simply
     // deserialize everything into the target prefetched blob.
-    reader.Read(&key_, &value_);
-    TensorProtos protos;
-    CAFFE_ENFORCE(protos.ParseFromString(value_));
-    CAFFE_ENFORCE(protos.protos_size() == OutputSize());
-    for (int i = 0; i < protos.protos_size(); ++i) {
+    TensorProtos& protos = batch_protos_[0];
+    for (int i = 0; i < OutputSize(); ++i) {
+      TensorCPU* dst = prefetched_blobs[i].template GetMutable<TensorCPU>();
+      if (fields_read_[0]) {
+        dst->swap(batch_fields_[0][i]);
+        continue;
+      }
+      CAFFE_ENFORCE(protos.protos_size() == OutputSize());
       if (protos.protos(i).has_device_detail()) {
         protos.mutable_protos(i)->clear_device_detail();
       }
-      deserializer.Deserialize(
-          protos.protos(i),
-          prefetched_blobs_[i].template GetMutable<TensorCPU>());
+      deserializer.Deserialize(protos.protos(i), dst);
     }
   } else {
     vector<TensorCPU> temp_tensors(OutputSize());
     for (int item_id = 0; item_id < batch_size_; ++item_id) {
-      reader.Read(&key_, &value_);
-      TensorProtos protos;
-      CAFFE_ENFORCE(protos.ParseFromString(value_));
-      CAFFE_ENFORCE(protos.protos_size() == OutputSize());
+      TensorProtos& protos = batch_protos_[item_id];
+      if (!fields_read_[item_id]) {
+        CAFFE_ENFORCE(protos.protos_size() == OutputSize());
+        for (int i = 0; i < protos.protos_size(); ++i) {
+          if (protos.protos(i).has_device_detail()) {
+            protos.mutable_protos(i)->clear_device_detail();
+          }
+          deserializer.Deserialize(protos.protos(i), &temp_tensors[i]);
+        }
+      }
+      vector<TensorCPU>& fields =
+          fields_read_[item_id] ? batch_fields_[item_id] : temp_tensors;
       if (!shape_inferred_) {
         // First, set the shape of all the blobs.
-        for (int i = 0; i < protos.protos_size(); ++i) {
-          vector<int> dims(
-              protos.protos(i).dims().begin(), protos.protos(i).dims().end());
+        for (int i = 0; i < OutputSize(); ++i) {
+          vector<TIndex> dims(fields[i].dims());
           dims.insert(dims.begin(), batch_size_);
-          prefetched_blobs_[i].template GetMutable<TensorCPU>()->Resize(dims);
+          prefetched_blobs[i].template GetMutable<TensorCPU>()->Resize(dims);
         }
       }
-      for (int i = 0; i < protos.protos_size(); ++i) {
-        TensorCPU* dst = prefetched_blobs_[i].template GetMutable<TensorCPU>();
-        TensorCPU& src = temp_tensors[i];
-        if (protos.protos(i).has_device_detail()) {
-          protos.mutable_protos(i)->clear_device_detail();
-        }
-        deserializer.Deserialize(protos.protos(i), &src);
+      for (int i = 0; i < OutputSize(); ++i) {
+        TensorCPU* dst = prefetched_blobs[i].template GetMutable<TensorCPU>();
+        const TensorCPU& src = fields[i];
         DCHECK_EQ(src.size() * batch_size_, dst->size());
         this->context_.template CopyItems<CPUContext, CPUContext>(
             src.meta(),
@@ -112,10 +167,12 @@ bool TensorProtosDBInput<Context>::Prefetch() {
 }
 
 template <class Context>
-bool TensorProtosDBInput<Context>::CopyPrefetched() {
+bool TensorProtosDBInput<Context>::CopyPrefetched(int buffer) {
   for (int i = 0; i < OutputSize(); ++i) {
-    OperatorBase::Output<Tensor<Context>>(i)->CopyFrom(
-        prefetched_blobs_[i].template Get<TensorCPU>(), &this->context_);
+    this->HandOver(
+        prefetched_blobs_[buffer][i].template GetMutable<TensorCPU>(),
+        OperatorBase::Output<Tensor<Context>>(i),
+        &this->context_);
   }
   return true;
 }
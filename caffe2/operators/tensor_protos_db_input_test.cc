@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+
+#include "caffe2/core/db.h"
+#include "caffe2/core/operator.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+const int kNumRecords = 10;
+
+// Writes records holding a float image of shape 2x3 and an int label.
+void Fill(const string& db_type, const string& name) {
+  std::unique_ptr<db::DB> db(db::CreateDB(db_type, name, db::NEW));
+  ASSERT_TRUE(db.get());
+  std::unique_ptr<db::Transaction> trans(db->NewTransaction());
+  for (int i = 0; i < kNumRecords; ++i) {
+    TensorProtos protos;
+    auto* image = protos.add_protos();
+    image->set_data_type(TensorProto::FLOAT);
+    image->add_dims(2);
+    image->add_dims(3);
+    for (int j = 0; j < 6; ++j) {
+      image->add_float_data(i * 10 + j);
+    }
+    auto* label = protos.add_protos();
+    label->set_data_type(TensorProto::INT32);
+    label->add_dims(1);
+    label->add_int32_data(i);
+    trans->Put(MakeString("key", i), protos.SerializeAsString());
+  }
+  trans->Commit();
+}
+
+OperatorDef InputDef(int batch_size, const vector<string>& outputs) {
+  OperatorDef def;
+  def.set_type("TensorProtosDBInput");
+  def.add_input("reader");
+  for (const auto& output : outputs) {
+    def.add_output(output);
+  }
+  auto* arg = def.add_arg();
+  arg->set_name("batch_size");
+  arg->set_i(batch_size);
+  return def;
+}
+
+} // namespace
+
+// Columndb decodes its fields directly, and minidb goes through the
+// TensorProtos: both give the same batches.
+TEST(TensorProtosDBInputTest, Batches) {
+  const int kBatchSize = 4;
+  for (const string db_type : {"minidb", "columndb"}) {
+    const string name = std::tmpnam(nullptr);
+    Fill(db_type, name);
+    Workspace ws;
+    ws.CreateBlob("reader")->GetMutable<db::DBReader>()->Open(db_type, name);
+    unique_ptr<OperatorBase> op(
+        CreateOperator(InputDef(kBatchSize, {"image", "label"}), &ws));
+    ASSERT_NE(nullptr, op.get());
+    for (int batch = 0; batch < 3; ++batch) {
+      ASSERT_TRUE(op->Run());
+      const auto& image = ws.GetBlob("image")->Get<TensorCPU>();
+      const auto& label = ws.GetBlob("label")->Get<TensorCPU>();
+      EXPECT_EQ(image.dims(), (vector<TIndex>{kBatchSize, 2, 3}));
+      EXPECT_EQ(label.dims(), (vector<TIndex>{kBatchSize, 1}));
+      for (int item = 0; item < kBatchSize; ++item) {
+        const int record = (batch * kBatchSize + item) % kNumRecords;
+        EXPECT_EQ(label.data<int>()[item], record);
+        for (int j = 0; j < 6; ++j) {
+          EXPECT_EQ(image.data<float>()[item * 6 + j], record * 10 + j);
+        }
+      }
+    }
+    op.reset();
+    std::remove(name.c_str());
+  }
+}
+
+TEST(TensorProtosDBInputTest, ColumnDBProjection) {
+  const string name = std::tmpnam(nullptr);
+  Fill("columndb", name);
+  Workspace ws;
+  ws.CreateBlob("reader")->GetMutable<db::DBReader>()->Open(
+      "columndb", name + "?fields=1");
+  // Without a batch, the records are read one by one.
+  unique_ptr<OperatorBase> op(CreateOperator(InputDef(0, {"label"}), &ws));
+  ASSERT_NE(nullptr, op.get());
+  for (int i = 0; i < kNumRecords + 2; ++i) {
+    ASSERT_TRUE(op->Run());
+    const auto& label = ws.GetBlob("label")->Get<TensorCPU>();
+    EXPECT_EQ(label.dims(), (vector<TIndex>{1}));
+    EXPECT_EQ(label.data<int>()[0], i % kNumRecords);
+  }
+  op.reset();
+  std::remove(name.c_str());
+}
+
+} // namespace caffe2
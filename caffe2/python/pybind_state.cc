@@ -29,6 +29,7 @@
 #include "caffe2/mkl/mkl_utils.h"
 #include "caffe2/observers/runcnt_observer.h"
 #include "caffe2/observers/time_observer.h"
+#include "caffe2/observers/trace_observer.h"
 #include "caffe2/utils/cpuid.h"
 #include "caffe2/utils/string_utils.h"
 #include "google/protobuf/io/coded_stream.h"
@@ -904,6 +905,7 @@ void addGlobalMethods(py::module& m) {
   }
 
         REGISTER_PYTHON_EXPOSED_OBSERVER(TimeObserver);
+        REGISTER_PYTHON_EXPOSED_OBSERVER(TraceObserver);
 #undef REGISTER_PYTHON_EXPOSED_OBSERVER
 
         if (observer_type.compare("RunCountObserver") == 0) {
@@ -926,6 +928,14 @@ void addGlobalMethods(py::module& m) {
         NetBase* net = gWorkspace->GetNet(net_name);
         net->DetachObserver(observer);
       });
+  m.def("dump_chrome_trace", [](const std::string& path) {
+    py::gil_scoped_release g;
+    return TraceRecorder::get().dumpChromeTrace(path);
+  });
+  m.def("clear_trace", []() { TraceRecorder::get().clear(); });
+  m.def("set_trace_enabled", [](bool enabled) {
+    TraceRecorder::get().setEnabled(enabled);
+  });
   m.def("num_observers_on_net", [](const std::string& net_name) {
     CAFFE_ENFORCE(gWorkspace);
     CAFFE_ENFORCE(gWorkspace->GetNet(net_name), "Can't find net ", net_name);
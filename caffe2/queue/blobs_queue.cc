@@ -17,6 +17,7 @@
 #include "caffe2/queue/blobs_queue.h"
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -37,6 +38,12 @@ static constexpr uint64_t SDT_TIMEOUT = (uint64_t)-1;
 static constexpr uint64_t SDT_ABORT = (uint64_t)-2;
 static constexpr uint64_t SDT_CANCEL = (uint64_t)-3;
 
+static int64_t elapsedNanos(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
 BlobsQueue::BlobsQueue(
     Workspace* ws,
     const std::string& queueName,
@@ -45,6 +52,7 @@ BlobsQueue::BlobsQueue(
     bool enforceUniqueName,
     const std::vector<std::string>& fieldNames)
     : numBlobs_(numBlobs), name_(queueName), stats_(queueName) {
+  CAFFE_ENFORCE_GT(capacity, 0, "Queue capacity must be positive.");
   if (!fieldNames.empty()) {
     CAFFE_ENFORCE_EQ(
         fieldNames.size(), numBlobs, "Wrong number of fieldNames provided.");
@@ -75,12 +83,16 @@ bool BlobsQueue::blockingRead(
   auto keeper = this->shared_from_this();
   const auto& name = name_.c_str();
   CAFFE_SDT(queue_read_start, name, (void*)this, SDT_BLOCKING_OP);
+  const auto start = std::chrono::steady_clock::now();
   std::unique_lock<std::mutex> g(mutex_);
   auto canRead = [this]() {
     CAFFE_ENFORCE_LE(reader_, writer_);
     return reader_ != writer_;
   };
   CAFFE_EVENT(stats_, queue_balance, -1);
+  if (!closing_ && !canRead()) {
+    CAFFE_EVENT(stats_, queue_read_parks);
+  }
   if (timeout_secs > 0) {
     std::chrono::milliseconds timeout_ms(int(timeout_secs * 1000));
     cv_.wait_for(
@@ -98,6 +110,8 @@ bool BlobsQueue::blockingRead(
     return false;
   }
   DCHECK(canRead());
+  CAFFE_EVENT(stats_, queue_read_wait_ns, elapsedNanos(start));
+  CAFFE_EVENT(stats_, queue_depth, writer_ - reader_);
   auto& result = queue_[reader_ % queue_.size()];
   CAFFE_ENFORCE(inputs.size() >= result.size());
   for (auto i = 0; i < result.size(); ++i) {
@@ -132,14 +146,19 @@ bool BlobsQueue::blockingWrite(const std::vector<Blob*>& inputs) {
   auto keeper = this->shared_from_this();
   const auto& name = name_.c_str();
   CAFFE_SDT(queue_write_start, name, (void*)this, SDT_BLOCKING_OP);
+  const auto start = std::chrono::steady_clock::now();
   std::unique_lock<std::mutex> g(mutex_);
   CAFFE_EVENT(stats_, queue_balance, 1);
+  if (!closing_ && !canWrite()) {
+    CAFFE_EVENT(stats_, queue_write_parks);
+  }
   cv_.wait(g, [this]() { return closing_ || canWrite(); });
   if (!canWrite()) {
     CAFFE_SDT(queue_write_end, name, (void*)this, SDT_ABORT);
     return false;
   }
   DCHECK(canWrite());
+  CAFFE_EVENT(stats_, queue_write_wait_ns, elapsedNanos(start));
   doWrite(inputs);
   return true;
 }
@@ -79,6 +79,14 @@ class BlobsQueue : public std::enable_shared_from_this<BlobsQueue> {
     CAFFE_EXPORTED_STAT(queue_balance);
     CAFFE_EXPORTED_STAT(queue_dequeued_records);
     CAFFE_DETAILED_EXPORTED_STAT(queue_dequeued_bytes);
+    // Time blocking reads and writes wait for the queue
+    CAFFE_HISTOGRAM_EXPORTED_STAT(queue_read_wait_ns);
+    CAFFE_HISTOGRAM_EXPORTED_STAT(queue_write_wait_ns);
+    // Records in the queue, as seen by each read
+    CAFFE_HISTOGRAM_EXPORTED_STAT(queue_depth);
+    // Times blocking reads and writes waited on an empty or full queue
+    CAFFE_EXPORTED_STAT(queue_read_parks);
+    CAFFE_EXPORTED_STAT(queue_write_parks);
   } stats_;
 };
 } // namespace caffe2
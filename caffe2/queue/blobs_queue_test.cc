@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "caffe2/queue/blobs_queue.h"
+
+namespace caffe2 {
+
+namespace {
+
+std::shared_ptr<BlobsQueue>
+CreateQueue(Workspace* ws, const std::string& name, size_t capacity) {
+  return std::make_shared<BlobsQueue>(ws, name, capacity, 2, true);
+}
+
+} // namespace
+
+TEST(BlobsQueueTest, ReadWrite) {
+  Workspace ws;
+  auto queue = CreateQueue(&ws, "read_write", 2);
+  EXPECT_EQ(queue->getNumBlobs(), 2);
+  Blob a, b;
+  const std::vector<Blob*> blobs{&a, &b};
+
+  for (int i = 0; i < 2; ++i) {
+    *a.GetMutable<int>() = i;
+    *b.GetMutable<std::string>() = "record" + to_string(i);
+    EXPECT_TRUE(queue->tryWrite(blobs));
+  }
+  // Full
+  EXPECT_FALSE(queue->tryWrite(blobs));
+
+  // Records are read in order, with their blobs
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_TRUE(queue->blockingRead(blobs));
+    EXPECT_EQ(a.Get<int>(), i);
+    EXPECT_EQ(b.Get<std::string>(), "record" + to_string(i));
+  }
+  // Empty
+  EXPECT_FALSE(queue->blockingRead(blobs, 0.01));
+
+  // Around the ring
+  for (int i = 0; i < 5; ++i) {
+    *a.GetMutable<int>() = 10 + i;
+    ASSERT_TRUE(queue->blockingWrite(blobs));
+    ASSERT_TRUE(queue->blockingRead(blobs));
+    EXPECT_EQ(a.Get<int>(), 10 + i);
+  }
+}
+
+TEST(BlobsQueueTest, Close) {
+  Workspace ws;
+  auto queue = CreateQueue(&ws, "close", 1);
+  Blob a, b;
+  const std::vector<Blob*> blobs{&a, &b};
+  *a.GetMutable<int>() = 1;
+  ASSERT_TRUE(queue->blockingWrite(blobs));
+
+  // Blocked writers and readers are woken up by close
+  std::thread writer([&queue]() {
+    Blob c, d;
+    *c.GetMutable<int>() = 2;
+    EXPECT_FALSE(queue->blockingWrite({&c, &d}));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  queue->close();
+  writer.join();
+
+  // Remaining records can still be read
+  ASSERT_TRUE(queue->blockingRead(blobs));
+  EXPECT_EQ(a.Get<int>(), 1);
+  EXPECT_FALSE(queue->blockingRead(blobs));
+
+  auto empty = CreateQueue(&ws, "close_empty", 1);
+  std::thread reader([&empty]() {
+    Blob c, d;
+    EXPECT_FALSE(empty->blockingRead({&c, &d}));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  empty->close();
+  reader.join();
+}
+
+TEST(BlobsQueueTest, ConcurrentProducersConsumers) {
+  const int kNumProducers = 4;
+  const int kNumConsumers = 4;
+  const int kRecords = 5000;
+  Workspace ws;
+  auto queue = CreateQueue(&ws, "concurrent", 3);
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kNumProducers; ++p) {
+    threads.emplace_back([&queue, p]() {
+      Blob a, b;
+      const std::vector<Blob*> blobs{&a, &b};
+      for (int i = 0; i < kRecords; ++i) {
+        *a.GetMutable<int>() = p * kRecords + i;
+        *b.GetMutable<int>() = -(p * kRecords + i);
+        ASSERT_TRUE(queue->blockingWrite(blobs));
+      }
+    });
+  }
+  std::vector<std::vector<int>> read(kNumConsumers);
+  for (int c = 0; c < kNumConsumers; ++c) {
+    threads.emplace_back([&queue, &read, c]() {
+      Blob a, b;
+      const std::vector<Blob*> blobs{&a, &b};
+      for (int i = 0; i < kRecords * kNumProducers / kNumConsumers; ++i) {
+        ASSERT_TRUE(queue->blockingRead(blobs));
+        // Both blobs come from the same record
+        EXPECT_EQ(a.Get<int>(), -b.Get<int>());
+        read[c].push_back(a.Get<int>());
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Every record is read exactly once, and each consumer reads the records
+  // of a producer in order
+  std::vector<int> all;
+  for (const auto& records : read) {
+    for (int p = 0; p < kNumProducers; ++p) {
+      int last = -1;
+      for (const int record : records) {
+        if (record / kRecords == p) {
+          EXPECT_GT(record, last);
+          last = record;
+        }
+      }
+    }
+    all.insert(all.end(), records.begin(), records.end());
+  }
+  std::sort(all.begin(), all.end());
+  ASSERT_EQ(all.size(), kNumProducers * kRecords);
+  for (int i = 0; i < all.size(); ++i) {
+    EXPECT_EQ(all[i], i);
+  }
+}
+
+} // namespace caffe2
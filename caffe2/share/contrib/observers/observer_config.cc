@@ -8,5 +8,6 @@ int ObserverConfig::netFollowupSampleCount_ = 0;
 int ObserverConfig::operatorNetSampleRatio_ = 0;
 int ObserverConfig::skipIters_ = 0;
 unique_ptr<NetObserverReporter> ObserverConfig::reporter_ = nullptr;
+int ObserverConfig::statExportIntervalMs_ = 60000;
 int ObserverConfig::marker_ = -1;
 }
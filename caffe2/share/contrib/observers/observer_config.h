@@ -64,6 +64,13 @@ class ObserverConfig {
     CAFFE_ENFORCE(reporter_);
     return reporter_.get();
   }
+  static void setStatExportIntervalMs(int statExportIntervalMs) {
+    CAFFE_ENFORCE(statExportIntervalMs >= 0);
+    statExportIntervalMs_ = statExportIntervalMs;
+  }
+  static int getStatExportIntervalMs() {
+    return statExportIntervalMs_;
+  }
   static void setMarker(int marker) {
     marker_ = marker;
   }
@@ -91,6 +98,11 @@ class ObserverConfig {
 
   static unique_ptr<NetObserverReporter> reporter_;
 
+  /* interval between two exports of the sampled delay percentiles and
+     throughputs to the StatRegistry, 0 to not aggregate them. Must be set
+     before the first net runs */
+  static int statExportIntervalMs_;
+
   /* marker used in identifying the metrics in certain reporters */
   static int marker_;
 };
@@ -1,10 +1,12 @@
 #include "caffe2/share/contrib/observers/perf_observer.h"
 #include "caffe2/share/contrib/observers/observer_config.h"
+#include "caffe2/share/contrib/observers/perf_stats_aggregator.h"
 
 #include <random>
 #include "caffe2/core/common.h"
 #include "caffe2/core/init.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/core/operator_schema.h"
 
 namespace caffe2 {
 namespace {
@@ -70,6 +72,10 @@ void PerfNetObserver::Start() {
 
 void PerfNetObserver::Stop() {
   if (logType_ == PerfNetObserver::NONE) {
+    // The stats are exported on time, whether or not this run was sampled
+    if (ObserverConfig::getStatExportIntervalMs() > 0) {
+      PerfStatsAggregator::get().maybeExport();
+    }
     return;
   }
   auto currentRunTime = timer_.MilliSeconds();
@@ -84,14 +90,38 @@ void PerfNetObserver::Stop() {
                          ->getMilliseconds();
       delays.insert({name, delay});
     }
+  }
+  ObserverConfig::getReporter()->reportDelay(subject_, delays, "ms");
+
+  if (ObserverConfig::getStatExportIntervalMs() > 0) {
+    auto& aggregator = PerfStatsAggregator::get();
+    aggregator.addSample(subject_->Name(), "NET_DELAY", currentRunTime);
+    if (logType_ == PerfNetObserver::OPERATOR_DELAY) {
+      const auto& operators = subject_->GetOperators();
+      for (int idx = 0; idx < operators.size(); ++idx) {
+        const auto* op = operators[idx];
+        const auto* observer =
+            static_cast<const PerfOperatorObserver*>(observerMap_[op]);
+        aggregator.addSample(
+            subject_->Name(),
+            getObserverName(op, idx),
+            observer->getMilliseconds(),
+            observer->getFlops(),
+            observer->getBytes());
+      }
+    }
+    aggregator.maybeExport();
+  }
+
+  if (logType_ == PerfNetObserver::OPERATOR_DELAY) {
     /* clear all operator delay after use so that we don't spent time
        collecting the operator delay info in later runs */
+    const auto& operators = subject_->GetOperators();
     for (auto* op : operators) {
       op->DetachObserver(observerMap_[op]);
     }
     observerMap_.clear();
   }
-  ObserverConfig::getReporter()->reportDelay(subject_, delays, "ms");
 }
 
 caffe2::string PerfNetObserver::getObserverName(const OperatorBase* op, int idx)
@@ -113,13 +143,32 @@ PerfOperatorObserver::PerfOperatorObserver(
     PerfNetObserver* netObserver)
     : ObserverBase<OperatorBase>(op),
       netObserver_(netObserver),
-      milliseconds_(0) {
+      milliseconds_(0),
+      flops_(0),
+      bytes_(0) {
   CAFFE_ENFORCE(netObserver_, "Observers can't operate outside of the net");
 }
 
 PerfOperatorObserver::~PerfOperatorObserver() {}
 
 void PerfOperatorObserver::Start() {
+  /* The inputs of in-place operators are overwritten by the time they stop,
+     their cost is inferred before they run */
+  if (ObserverConfig::getStatExportIntervalMs() > 0 &&
+      subject_->has_debug_def()) {
+    const auto* schema = OpSchemaRegistry::Schema(subject_->debug_def().type());
+    if (schema && schema->HasCostInferenceFunction()) {
+      try {
+        const auto cost = schema->InferCost(
+            subject_->debug_def(), subject_->InputTensorShapes());
+        flops_ = cost.flops;
+        bytes_ = cost.bytes_moved;
+      } catch (const std::exception& e) {
+        VLOG(1) << "Cost inference failed for "
+                << subject_->debug_def().type() << ": " << e.what();
+      }
+    }
+  }
   /* Get the time from the start of the net minus the time spent
      in previous invocations. It is the time spent on other operators.
      This way, when the operator finishes, the time from the start of the net
@@ -138,6 +187,14 @@ double PerfOperatorObserver::getMilliseconds() const {
   return milliseconds_;
 }
 
+uint64_t PerfOperatorObserver::getFlops() const {
+  return flops_;
+}
+
+uint64_t PerfOperatorObserver::getBytes() const {
+  return bytes_;
+}
+
 std::unique_ptr<ObserverBase<OperatorBase>> PerfOperatorObserver::copy(
     OperatorBase* subject) {
   return std::unique_ptr<ObserverBase<OperatorBase>>(
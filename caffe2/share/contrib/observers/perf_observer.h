@@ -45,6 +45,10 @@ class PerfOperatorObserver : public ObserverBase<OperatorBase> {
   std::unique_ptr<ObserverBase<OperatorBase>> copy(
       OperatorBase* subject) override;
   double getMilliseconds() const;
+  // Cost of the run, from the operator's cost inference function. 0 when
+  // the sampled delays are not aggregated or the cost is unknown.
+  uint64_t getFlops() const;
+  uint64_t getBytes() const;
 
  private:
   void Start() override;
@@ -59,5 +63,7 @@ class PerfOperatorObserver : public ObserverBase<OperatorBase> {
   // costly here and a raw pointer is a cheapest sholution
   PerfNetObserver* netObserver_;
   double milliseconds_;
+  uint64_t flops_;
+  uint64_t bytes_;
 };
 }
@@ -0,0 +1,115 @@
+#include "caffe2/share/contrib/observers/perf_stats_aggregator.h"
+#include "caffe2/share/contrib/observers/observer_config.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace caffe2 {
+
+namespace {
+
+int64_t now() {
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+// Nearest rank percentile of sorted values
+float percentile(const std::vector<float>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  auto rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+  return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+} // namespace
+
+constexpr size_t PerfStatsAggregator::kMaxSamples;
+
+PerfStatsAggregator::PerfStatsAggregator(
+    StatRegistry* registry,
+    std::chrono::milliseconds interval)
+    : registry_(registry),
+      interval_(interval),
+      next_export_(now() + interval_.count()) {
+  CAFFE_ENFORCE(registry_);
+}
+
+PerfStatsAggregator& PerfStatsAggregator::get() {
+  static PerfStatsAggregator aggregator(
+      &StatRegistry::get(),
+      std::chrono::milliseconds(ObserverConfig::getStatExportIntervalMs()));
+  return aggregator;
+}
+
+void PerfStatsAggregator::addSample(
+    const std::string& net,
+    const std::string& name,
+    double milliseconds,
+    uint64_t flops,
+    uint64_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& stats = stats_[net + "/" + name];
+  const float latency_us = milliseconds * 1000;
+  ++stats.count;
+  if (stats.latencies_us.size() < kMaxSamples) {
+    stats.latencies_us.push_back(latency_us);
+  } else {
+    // Reservoir sampling keeps every run of the interval equally likely
+    std::uniform_int_distribution<uint64_t> index(0, stats.count - 1);
+    auto i = index(random_);
+    if (i < kMaxSamples) {
+      stats.latencies_us[i] = latency_us;
+    }
+  }
+  if (flops || bytes) {
+    stats.costed = true;
+    stats.costed_seconds += milliseconds / 1000;
+    stats.flops += flops;
+    stats.bytes += bytes;
+  }
+}
+
+void PerfStatsAggregator::maybeExport() {
+  if (now() < next_export_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Another thread may have exported since the check
+  if (now() >= next_export_.load(std::memory_order_relaxed)) {
+    exportLocked();
+  }
+}
+
+void PerfStatsAggregator::exportStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  exportLocked();
+}
+
+void PerfStatsAggregator::exportLocked() {
+  for (auto& kv : stats_) {
+    auto& stats = kv.second;
+    const auto& prefix = kv.first;
+    std::sort(stats.latencies_us.begin(), stats.latencies_us.end());
+    registry_->addGauge(prefix + "/count")->reset(stats.count);
+    registry_->addGauge(prefix + "/latency_us_p50")
+        ->reset(percentile(stats.latencies_us, 0.5));
+    registry_->addGauge(prefix + "/latency_us_p90")
+        ->reset(percentile(stats.latencies_us, 0.9));
+    registry_->addGauge(prefix + "/latency_us_p99")
+        ->reset(percentile(stats.latencies_us, 0.99));
+    if (stats.costed) {
+      const bool ran = stats.costed_seconds > 0;
+      registry_->addGauge(prefix + "/flops_per_sec")
+          ->reset(ran ? stats.flops / stats.costed_seconds : 0);
+      registry_->addGauge(prefix + "/bytes_per_sec")
+          ->reset(ran ? stats.bytes / stats.costed_seconds : 0);
+    }
+    // Keeps the keys, so that idle intervals export zeros
+    const bool costed = stats.costed;
+    stats = Stats();
+    stats.costed = costed;
+  }
+  next_export_.store(now() + interval_.count(), std::memory_order_relaxed);
+}
+
+} // namespace caffe2
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "caffe2/core/stats.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace caffe2 {
+
+/*
+  Aggregates the delays of the runs sampled by PerfNetObserver, per net and
+  per operator, and periodically exports them to a StatRegistry as:
+    <net>/<name>/count            runs sampled during the last interval
+    <net>/<name>/latency_us_p50   latency percentiles over those runs
+    <net>/<name>/latency_us_p90
+    <net>/<name>/latency_us_p99
+    <net>/<name>/flops_per_sec    achieved throughput, for the operators with
+    <net>/<name>/bytes_per_sec    a cost inference function
+  where <name> is NET_DELAY for the net itself. Every export starts a new
+  interval. The values are gauges, which keep the last export until the next
+  one even if the registry is published with reset.
+*/
+class PerfStatsAggregator {
+ public:
+  // Samples kept per net or operator and interval, beyond which they are
+  // reservoir sampled
+  static constexpr size_t kMaxSamples = 4096;
+
+  PerfStatsAggregator(
+      StatRegistry* registry,
+      std::chrono::milliseconds interval);
+
+  // Aggregator of the process, exporting to StatRegistry::get() every
+  // ObserverConfig::getStatExportIntervalMs()
+  static PerfStatsAggregator& get();
+
+  // `flops` and `bytes` are the cost of the run, 0 if unknown
+  void addSample(
+      const std::string& net,
+      const std::string& name,
+      double milliseconds,
+      uint64_t flops = 0,
+      uint64_t bytes = 0);
+
+  // Exports if the interval elapsed since the last export. Cheap enough to be
+  // called after every run: it only loads an atomic until the interval elapsed
+  void maybeExport();
+  void exportStats();
+
+ private:
+  struct Stats {
+    std::vector<float> latencies_us;
+    uint64_t count = 0;
+    // Of the runs with a known cost, in this or an earlier interval
+    bool costed = false;
+    double costed_seconds = 0;
+    double flops = 0;
+    double bytes = 0;
+  };
+
+  void exportLocked();
+
+  StatRegistry* registry_;
+  const std::chrono::steady_clock::duration interval_;
+  std::mutex mutex_;
+  // steady_clock ticks at which the next export is due
+  std::atomic<int64_t> next_export_;
+  std::map<std::string, Stats> stats_;
+  std::minstd_rand random_;
+};
+
+} // namespace caffe2
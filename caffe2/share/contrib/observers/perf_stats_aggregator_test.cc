@@ -0,0 +1,127 @@
+#include "caffe2/share/contrib/observers/perf_stats_aggregator.h"
+#include "caffe2/share/contrib/observers/net_observer_reporter_print.h"
+#include "caffe2/share/contrib/observers/observer_config.h"
+#include "caffe2/share/contrib/observers/perf_observer.h"
+
+#include <gtest/gtest.h>
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+
+namespace caffe2 {
+
+namespace {
+
+class PerfStatsTestOp final : public Operator<CPUContext> {
+ public:
+  using Operator<CPUContext>::Operator;
+
+  bool RunOnDevice() override {
+    Output(0)->CopyFrom(Input(0));
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(PerfStatsTest, PerfStatsTestOp);
+OPERATOR_SCHEMA(PerfStatsTest)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .CostInferenceFunction(
+        [](const OperatorDef& /*unused*/, const vector<TensorShape>& inputs) {
+          OpSchema::Cost cost;
+          cost.flops = inputs[0].dims(0);
+          cost.bytes_moved = 4 * inputs[0].dims(0);
+          return cost;
+        });
+
+} // namespace
+
+TEST(PerfStatsAggregatorTest, Percentiles) {
+  StatRegistry registry;
+  PerfStatsAggregator aggregator(&registry, std::chrono::hours(1));
+  // 1, 2, ..., 100 us
+  for (int i = 100; i > 0; --i) {
+    aggregator.addSample("net", "op", i / 1000.0, 1000, 2000);
+  }
+  aggregator.addSample("net", "NET_DELAY", 1);
+
+  // Not yet
+  aggregator.maybeExport();
+  EXPECT_TRUE(registry.publish().empty());
+
+  aggregator.exportStats();
+  auto stats = toMap(registry.publish(true));
+  EXPECT_EQ(stats["net/op/count"], 100);
+  EXPECT_EQ(stats["net/op/latency_us_p50"], 50);
+  EXPECT_EQ(stats["net/op/latency_us_p90"], 90);
+  EXPECT_EQ(stats["net/op/latency_us_p99"], 99);
+  // 100 runs of 1000 flops in 5050 us
+  EXPECT_EQ(stats["net/op/flops_per_sec"], int64_t(100 * 1000 / 5050e-6));
+  EXPECT_EQ(stats["net/op/bytes_per_sec"], int64_t(100 * 2000 / 5050e-6));
+  EXPECT_EQ(stats["net/NET_DELAY/count"], 1);
+  EXPECT_EQ(stats["net/NET_DELAY/latency_us_p99"], 1000);
+  EXPECT_EQ(stats.count("net/NET_DELAY/flops_per_sec"), 0);
+
+  // Publishing with reset keeps the exported values until the next export
+  stats = toMap(registry.publish(true));
+  EXPECT_EQ(stats["net/op/count"], 100);
+  EXPECT_EQ(stats["net/op/latency_us_p99"], 99);
+
+  // Every export starts a new interval
+  aggregator.exportStats();
+  stats = toMap(registry.publish());
+  EXPECT_EQ(stats["net/op/count"], 0);
+  EXPECT_EQ(stats["net/op/latency_us_p50"], 0);
+  EXPECT_EQ(stats["net/op/flops_per_sec"], 0);
+}
+
+TEST(PerfStatsAggregatorTest, BoundsSamples) {
+  StatRegistry registry;
+  PerfStatsAggregator aggregator(&registry, std::chrono::milliseconds(0));
+  const int kNumSamples = 4 * PerfStatsAggregator::kMaxSamples;
+  for (int i = 0; i < kNumSamples; ++i) {
+    aggregator.addSample("net", "op", 1);
+  }
+  aggregator.maybeExport();
+  auto stats = toMap(registry.publish());
+  EXPECT_EQ(stats["net/op/count"], kNumSamples);
+  EXPECT_EQ(stats["net/op/latency_us_p50"], 1000);
+}
+
+TEST(PerfStatsAggregatorTest, AggregatesSampledRuns) {
+  ObserverConfig::initSampleRate(1, 1, 1, 1, 0);
+  ObserverConfig::setReporter(make_unique<NetObserverReporterPrint>());
+
+  NetDef net_def;
+  net_def.set_name("perf_stats_test");
+  net_def.set_type("async_scheduling");
+  auto* op = net_def.add_op();
+  op->set_type("PerfStatsTest");
+  op->add_input("in");
+  op->add_output("out");
+  net_def.add_external_input("in");
+
+  Workspace ws;
+  auto* in = ws.CreateBlob("in")->GetMutable<TensorCPU>();
+  in->Resize(256);
+  in->mutable_data<float>();
+  auto net = CreateNet(net_def, &ws);
+  net->AttachObserver(make_unique<PerfNetObserver>(net.get()));
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(net->Run());
+  }
+  PerfStatsAggregator::get().exportStats();
+
+  auto stats = toMap(StatRegistry::get().publish());
+  EXPECT_EQ(stats["perf_stats_test/NET_DELAY/count"], 10);
+  const std::string op_prefix = "perf_stats_test/ID_0_PerfStatsTest_out";
+  EXPECT_EQ(stats[op_prefix + "/count"], 10);
+  EXPECT_LE(
+      stats[op_prefix + "/latency_us_p50"],
+      stats[op_prefix + "/latency_us_p99"]);
+  EXPECT_GT(stats[op_prefix + "/flops_per_sec"], 0);
+  EXPECT_EQ(
+      stats[op_prefix + "/bytes_per_sec"] / 4,
+      stats[op_prefix + "/flops_per_sec"]);
+}
+
+} // namespace caffe2
@@ -37,6 +37,7 @@
 
 #include "caffe2/utils/math.h"
 #include "caffe2/utils/cpu_neon.h"
+#include "caffe2/utils/parallel_for.h"
 #include "caffe2/core/context.h"
 #include "Eigen/Core"
 #include "Eigen/Dense"
@@ -56,6 +57,85 @@
 namespace caffe2 {
 namespace math {
 
+////////////////////////////////////////////////////////////////////////////////
+// Intra-op parallelism.
+// When the executor gives the operators intra-op threads (see
+// caffe2/utils/parallel_for.h), the heavier functions below split their work
+// in blocks of at least the following size over them.
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+// Multiply-adds per block of rows of a Gemm
+constexpr size_t kGemmBlockFlops = 1 << 18;
+// Items per block of an element-wise function
+constexpr size_t kElementwiseGrain = 1 << 15;
+// Values written per block of an Im2col
+constexpr size_t kIm2colGrain = 1 << 14;
+
+} // namespace
+
+template <>
+void GemmEx<float, CPUContext>(
+    const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB,
+    const int M,
+    const int N,
+    const int K,
+    const float alpha,
+    const float* A,
+    const int lda,
+    const float* B,
+    const int ldb,
+    const float beta,
+    float* C,
+    const int ldc,
+    CPUContext* context);
+
+namespace {
+
+// Runs a Gemm by blocks of rows of C on the intra-op threads. Returns false,
+// without doing anything, when the Gemm is too small to be split.
+bool ParallelGemm(
+    const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB,
+    const int M,
+    const int N,
+    const int K,
+    const float alpha,
+    const float* A,
+    const float* B,
+    const float beta,
+    float* C,
+    CPUContext* context) {
+  const size_t grain =
+      std::max<size_t>(kGemmBlockFlops / std::max(N * K, 1), 1);
+  if (IntraOpThreads() <= 1 || static_cast<size_t>(M) / 2 < grain) {
+    return false;
+  }
+  const int lda = (TransA == CblasNoTrans) ? K : M;
+  const int ldb = (TransB == CblasNoTrans) ? N : K;
+  IntraOpParallelFor(M, grain, [&](size_t begin, size_t end) {
+    GemmEx<float, CPUContext>(
+        TransA,
+        TransB,
+        end - begin,
+        N,
+        K,
+        alpha,
+        A + (TransA == CblasNoTrans ? begin * lda : begin),
+        lda,
+        B,
+        ldb,
+        beta,
+        C + begin * N,
+        N,
+        context);
+  });
+  return true;
+}
+
+} // namespace
+
 ////////////////////////////////////////////////////////////////////////////////
 // BLAS alternatives.
 // Depending on whether we have specified an external BLAS library or not, we
@@ -93,6 +173,9 @@ void Gemm<float, CPUContext>(
     float* C,
     CPUContext* context,
     TensorProto::DataType math_type) {
+  if (ParallelGemm(TransA, TransB, M, N, K, alpha, A, B, beta, C, context)) {
+    return;
+  }
   auto C_mat = EigenMatrixMap<float>(C, N, M);
   if (beta == 0) {
     C_mat.setZero();
@@ -304,8 +387,11 @@ void Gemm<float, CPUContext>(
     const float* B,
     const float beta,
     float* C,
-    CPUContext* /*context*/,
+    CPUContext* context,
     TensorProto::DataType /*math_type*/) {
+  if (ParallelGemm(TransA, TransB, M, N, K, alpha, A, B, beta, C, context)) {
+    return;
+  }
   int lda = (TransA == CblasNoTrans) ? K : M;
   int ldb = (TransB == CblasNoTrans) ? N : K;
   cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B, ldb,
@@ -521,11 +607,13 @@ DELEGATE_POWX_FUNCTION(float, vsPowx)
 DELEGATE_POWX_FUNCTION(double, vdPowx)
 #undef DELEGATE_POWX_FUNCTION
 
-#define DELEGATE_SIMPLE_BINARY_FUNCTION(T, Funcname, OriginalFunc) \
-  template <>                                                      \
-  void Funcname<T, CPUContext>(                                    \
-      const int N, const T* a, const T* b, T* y, CPUContext*) {    \
-    OriginalFunc(N, a, b, y);                                      \
+#define DELEGATE_SIMPLE_BINARY_FUNCTION(T, Funcname, OriginalFunc)          \
+  template <>                                                               \
+  void Funcname<T, CPUContext>(                                             \
+      const int N, const T* a, const T* b, T* y, CPUContext*) {             \
+    IntraOpParallelFor(N, kElementwiseGrain, [&](size_t i, size_t end) {    \
+      OriginalFunc(end - i, a + i, b + i, y + i);                           \
+    });                                                                     \
   }
 DELEGATE_SIMPLE_BINARY_FUNCTION(float,  Add, vsAdd)
 DELEGATE_SIMPLE_BINARY_FUNCTION(double, Add, vdAdd)
@@ -581,9 +669,11 @@ template <>                                                                    \
 void Funcname<T, CPUContext>(                                                  \
     const int N, const T* a, const T* b, T* y,                                 \
     CPUContext*) {                                                             \
-  EigenVectorMap<T>(y, N) =                                                    \
-      ConstEigenVectorMap<T>(a, N).array() expr                                \
-      ConstEigenVectorMap<T>(b, N).array();                                    \
+  IntraOpParallelFor(N, kElementwiseGrain, [&](size_t i, size_t end) {         \
+    EigenVectorMap<T>(y + i, end - i) =                                        \
+        ConstEigenVectorMap<T>(a + i, end - i).array() expr                    \
+        ConstEigenVectorMap<T>(b + i, end - i).array();                        \
+  });                                                                          \
 }
 
 #ifdef CAFFE2_USE_MKL
@@ -1055,34 +1145,40 @@ void Im2col<float, CPUContext, StorageOrder::NCHW>(
 
   // Fast path for zero padding and no dilation
   // From Torch, THNN_(unfolded_copy)
+  const size_t grain =
+      std::max<size_t>(kIm2colGrain / std::max(output_h * output_w, 1), 1);
   if (dilation_h == 1 && dilation_w == 1 && pad_l == 0 && pad_r == 0 &&
       pad_t == 0 && pad_b == 0) {
-    for (auto k = 0; k < channels * kernel_h * kernel_w; k++) {
-      const auto nip = k / (kernel_h * kernel_w);
-      const auto rest = k % (kernel_h * kernel_w);
-      const auto kh = rest / kernel_w;
-      const auto kw = rest % kernel_w;
-      auto* dst = data_col + nip * (kernel_h * kernel_w * output_h * output_w) +
-          kh * (kernel_w * output_h * output_w) + kw * (output_h * output_w);
-      const auto* src = data_im + nip * (height * width);
-      for (auto y = 0; y < output_h; y++) {
-        const auto iy = y * stride_h + kh;
-        const auto ix = kw;
-        if (stride_w == 1) {
-          memcpy(
-              dst + (y * output_w),
-              src + (iy * width + ix),
-              sizeof(float) * output_w);
-        } else {
-          for (auto x = 0; x < output_w; x++) {
+    IntraOpParallelFor(
+        channels * kernel_h * kernel_w, grain, [&](size_t begin, size_t end) {
+      for (auto k = begin; k < end; k++) {
+        const auto nip = k / (kernel_h * kernel_w);
+        const auto rest = k % (kernel_h * kernel_w);
+        const auto kh = rest / kernel_w;
+        const auto kw = rest % kernel_w;
+        auto* dst = data_col +
+            nip * (kernel_h * kernel_w * output_h * output_w) +
+            kh * (kernel_w * output_h * output_w) + kw * (output_h * output_w);
+        const auto* src = data_im + nip * (height * width);
+        for (auto y = 0; y < output_h; y++) {
+          const auto iy = y * stride_h + kh;
+          const auto ix = kw;
+          if (stride_w == 1) {
             memcpy(
-                dst + (y * output_w + x),
-                src + (iy * width + ix + x * stride_w),
-                sizeof(float));
+                dst + (y * output_w),
+                src + (iy * width + ix),
+                sizeof(float) * output_w);
+          } else {
+            for (auto x = 0; x < output_w; x++) {
+              memcpy(
+                  dst + (y * output_w + x),
+                  src + (iy * width + ix + x * stride_w),
+                  sizeof(float));
+            }
           }
         }
       }
-    }
+    });
     return;
   }
 
@@ -1092,31 +1188,40 @@ void Im2col<float, CPUContext, StorageOrder::NCHW>(
     const int pad_h = pad_t;
     const int pad_w = pad_l;
     const int channel_size = height * width;
-    for (int channel = channels; channel--; data_im += channel_size) {
-      for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
-        for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
-          int input_row = -pad_h + kernel_row * dilation_h;
-          for (int output_rows = output_h; output_rows; output_rows--) {
-            if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
-              for (int output_cols = output_w; output_cols; output_cols--) {
-                *(data_col++) = 0;
-              }
-            } else {
-              int input_col = -pad_w + kernel_col * dilation_w;
-              for (int output_col = output_w; output_col; output_col--) {
-                if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                  *(data_col++) = data_im[input_row * width + input_col];
-                } else {
-                  *(data_col++) = 0;
+    const int channel_col_size = kernel_h * kernel_w * output_h * output_w;
+    IntraOpParallelFor(
+        channels,
+        std::max<size_t>(grain / (kernel_h * kernel_w), 1),
+        [&](size_t begin, size_t end) {
+      for (auto channel = begin; channel < end; channel++) {
+        const float* data_im_channel = data_im + channel * channel_size;
+        float* data_col_channel = data_col + channel * channel_col_size;
+        for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
+          for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
+            int input_row = -pad_h + kernel_row * dilation_h;
+            for (int output_rows = output_h; output_rows; output_rows--) {
+              if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+                for (int output_cols = output_w; output_cols; output_cols--) {
+                  *(data_col_channel++) = 0;
+                }
+              } else {
+                int input_col = -pad_w + kernel_col * dilation_w;
+                for (int output_col = output_w; output_col; output_col--) {
+                  if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
+                    *(data_col_channel++) =
+                        data_im_channel[input_row * width + input_col];
+                  } else {
+                    *(data_col_channel++) = 0;
+                  }
+                  input_col += stride_w;
                 }
-                input_col += stride_w;
               }
+              input_row += stride_h;
             }
-            input_row += stride_h;
           }
         }
       }
-    }
+    });
     return;
   }
 
@@ -1128,22 +1233,24 @@ void Im2col<float, CPUContext, StorageOrder::NCHW>(
   int width_col = (width + pad_l + pad_r - dkernel_w) / stride_w + 1;
 
   int channels_col = channels * kernel_h * kernel_w;
-  for (int c = 0; c < channels_col; ++c) {
-    int w_offset = c % kernel_w;
-    int h_offset = (c / kernel_w) % kernel_h;
-    int c_im = c / kernel_h / kernel_w;
-    for (int h = 0; h < height_col; ++h) {
-      for (int w = 0; w < width_col; ++w) {
-        int h_pad = h * stride_h - pad_t + h_offset * dilation_h;
-        int w_pad = w * stride_w - pad_l + w_offset * dilation_w;
-        if (h_pad >= 0 && h_pad < height && w_pad >= 0 && w_pad < width)
-          data_col[(c * height_col + h) * width_col + w] =
-              data_im[(c_im * height + h_pad) * width + w_pad];
-        else
-          data_col[(c * height_col + h) * width_col + w] = 0;
+  IntraOpParallelFor(channels_col, grain, [&](size_t begin, size_t end) {
+    for (int c = begin; c < static_cast<int>(end); ++c) {
+      int w_offset = c % kernel_w;
+      int h_offset = (c / kernel_w) % kernel_h;
+      int c_im = c / kernel_h / kernel_w;
+      for (int h = 0; h < height_col; ++h) {
+        for (int w = 0; w < width_col; ++w) {
+          int h_pad = h * stride_h - pad_t + h_offset * dilation_h;
+          int w_pad = w * stride_w - pad_l + w_offset * dilation_w;
+          if (h_pad >= 0 && h_pad < height && w_pad >= 0 && w_pad < width)
+            data_col[(c * height_col + h) * width_col + w] =
+                data_im[(c_im * height + h_pad) * width + w_pad];
+          else
+            data_col[(c * height_col + h) * width_col + w] = 0;
+        }
       }
     }
-  }
+  });
 }
 
 template <>
@@ -21,6 +21,7 @@
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/utils/conversions.h"
 #include "caffe2/utils/math.h"
+#include "caffe2/utils/parallel_for.h"
 
 namespace caffe2 {
 
@@ -295,4 +296,117 @@ TEST(MathTest, TranposeTest) {
   }
 }
 
+namespace {
+
+std::vector<float> iota(int size) {
+  std::vector<float> values(size);
+  for (int i = 0; i < size; ++i) {
+    values[i] = (i % 17) - 8;
+  }
+  return values;
+}
+
+// Runs `f` sequentially, then split over 4 threads, and checks that both give
+// the same `size` values in `output`
+void expectSameWithIntraOpThreads(
+    const std::function<void()>& f,
+    const float* output,
+    int size) {
+  f();
+  std::vector<float> sequential(output, output + size);
+  auto pool = std::make_shared<TaskThreadPool>(4);
+  auto parallel_for = PoolParallelFor(pool, 4);
+  IntraOpParallelismGuard guard(&parallel_for, 4);
+  f();
+  for (int i = 0; i < size; ++i) {
+    EXPECT_FLOAT_EQ(sequential[i], output[i]) << i;
+  }
+}
+
+} // namespace
+
+TEST(MathTest, IntraOpParallelGemm) {
+  CPUContext cpu_context;
+  const int M = 256, N = 64, K = 48;
+  const auto A = iota(M * K);
+  const auto B = iota(K * N);
+  std::vector<float> C(M * N);
+  for (auto trans_a : {CblasNoTrans, CblasTrans}) {
+    for (auto trans_b : {CblasNoTrans, CblasTrans}) {
+      expectSameWithIntraOpThreads(
+          [&]() {
+            std::fill(C.begin(), C.end(), 1);
+            math::Gemm<float, CPUContext>(
+                trans_a,
+                trans_b,
+                M,
+                N,
+                K,
+                0.5,
+                A.data(),
+                B.data(),
+                2,
+                C.data(),
+                &cpu_context);
+          },
+          C.data(),
+          C.size());
+    }
+  }
+}
+
+TEST(MathTest, IntraOpParallelAdd) {
+  CPUContext cpu_context;
+  const int N = 100003;
+  const auto a = iota(N);
+  const auto b = iota(N + 5);
+  std::vector<float> y(N);
+  expectSameWithIntraOpThreads(
+      [&]() {
+        math::Add<float, CPUContext>(
+            N, a.data(), b.data() + 5, y.data(), &cpu_context);
+      },
+      y.data(),
+      y.size());
+}
+
+TEST(MathTest, IntraOpParallelIm2col) {
+  CPUContext cpu_context;
+  const int C = 16, H = 20, W = 24, kernel = 3;
+  const auto image = iota(C * H * W);
+  // No padding, equal padding, unequal padding with dilation
+  for (auto pad : {std::vector<int>{0, 0, 0, 0, 1},
+                   std::vector<int>{1, 1, 1, 1, 1},
+                   std::vector<int>{0, 1, 2, 1, 2}}) {
+    const int dilation = pad[4];
+    const int dkernel = dilation * (kernel - 1) + 1;
+    const int output_h = (H + pad[0] + pad[2] - dkernel) + 1;
+    const int output_w = (W + pad[1] + pad[3] - dkernel) + 1;
+    std::vector<float> col(C * kernel * kernel * output_h * output_w);
+    expectSameWithIntraOpThreads(
+        [&]() {
+          std::fill(col.begin(), col.end(), 42);
+          math::Im2col<float, CPUContext, StorageOrder::NCHW>(
+              image.data(),
+              C,
+              H,
+              W,
+              kernel,
+              kernel,
+              dilation,
+              dilation,
+              pad[0],
+              pad[1],
+              pad[2],
+              pad[3],
+              1,
+              1,
+              col.data(),
+              &cpu_context);
+        },
+        col.data(),
+        col.size());
+  }
+}
+
 } // namespace caffe2
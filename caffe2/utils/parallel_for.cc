@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/utils/parallel_for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+
+namespace caffe2 {
+
+namespace {
+
+thread_local const ParallelFor* intra_op_parallel_for = nullptr;
+thread_local size_t intra_op_threads = 1;
+
+struct ParallelForState {
+  std::atomic<size_t> next{0};
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t done = 0;
+  std::exception_ptr error;
+};
+
+// Claims and runs the indices left. Only touches `f` after claiming one, so
+// that helpers that start after the caller returned don't use it.
+void runIndices(
+    const std::shared_ptr<ParallelForState>& state,
+    size_t range,
+    const std::function<void(size_t)>& f) {
+  size_t ran = 0;
+  std::exception_ptr error;
+  for (size_t i; (i = state->next++) < range; ++ran) {
+    try {
+      f(i);
+    } catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+  if (ran == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->done += ran;
+  if (error && !state->error) {
+    state->error = error;
+  }
+  if (state->done == range) {
+    state->cv.notify_all();
+  }
+}
+
+} // namespace
+
+ParallelFor PoolParallelFor(
+    std::shared_ptr<TaskThreadPoolBase> pool,
+    size_t num_threads) {
+  return [pool, num_threads](size_t range, std::function<void(size_t)> f) {
+    const auto helpers = std::min(num_threads, range);
+    if (helpers <= 1) {
+      for (size_t i = 0; i < range; ++i) {
+        f(i);
+      }
+      return;
+    }
+
+    auto state = std::make_shared<ParallelForState>();
+    for (size_t h = 1; h < helpers; ++h) {
+      pool->run([state, range, &f]() { runIndices(state, range, f); });
+    }
+    runIndices(state, range, f);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&]() { return state->done == range; });
+    if (state->error) {
+      std::rethrow_exception(state->error);
+    }
+  };
+}
+
+IntraOpParallelismGuard::IntraOpParallelismGuard(
+    const ParallelFor* parallel_for,
+    size_t num_threads)
+    : prev_parallel_for_(intra_op_parallel_for),
+      prev_num_threads_(intra_op_threads) {
+  intra_op_parallel_for = parallel_for;
+  intra_op_threads = parallel_for ? std::max<size_t>(num_threads, 1) : 1;
+}
+
+IntraOpParallelismGuard::~IntraOpParallelismGuard() {
+  intra_op_parallel_for = prev_parallel_for_;
+  intra_op_threads = prev_num_threads_;
+}
+
+size_t IntraOpThreads() {
+  return intra_op_threads;
+}
+
+namespace detail {
+
+void IntraOpParallelFor(
+    size_t n,
+    size_t grain,
+    const std::function<void(size_t, size_t)>& f) {
+  auto blocks = std::min(intra_op_threads, n / std::max<size_t>(grain, 1));
+  if (blocks <= 1) {
+    if (n > 0) {
+      f(0, n);
+    }
+    return;
+  }
+  const auto block_size = (n + blocks - 1) / blocks;
+  blocks = (n + block_size - 1) / block_size;
+  (*intra_op_parallel_for)(blocks, [&](size_t block) {
+    f(block * block_size, std::min(n, (block + 1) * block_size));
+  });
+}
+
+} // namespace detail
+
+} // namespace caffe2
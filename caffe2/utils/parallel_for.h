@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_UTILS_PARALLEL_FOR_H_
+#define CAFFE2_UTILS_PARALLEL_FOR_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#include "caffe2/utils/thread_pool.h"
+
+namespace caffe2 {
+
+// Runs f(0), ..., f(range - 1), possibly in parallel, and returns once they
+// have all returned.
+using ParallelFor = std::function<void(size_t, std::function<void(size_t)>)>;
+
+// ParallelFor that runs on `pool`, with at most `num_threads` threads counting
+// the calling one. The caller takes part in the work, and only waits for the
+// indices other threads already started, so that it can be called from the
+// pool's own threads without deadlocking. Rethrows the first exception
+// thrown by f, once all the indices are done.
+ParallelFor PoolParallelFor(
+    std::shared_ptr<TaskThreadPoolBase> pool,
+    size_t num_threads);
+
+// Sets the intra-op parallelism of the calling thread until it goes out of
+// scope: the operators running on the thread meanwhile can split their work
+// over `num_threads` threads with IntraOpParallelFor. Executors set it around
+// the operators they run, so that intra-op work goes to the same pool as the
+// operators rather than to threads of its own.
+class IntraOpParallelismGuard {
+ public:
+  IntraOpParallelismGuard(const ParallelFor* parallel_for, size_t num_threads);
+  ~IntraOpParallelismGuard();
+
+ private:
+  const ParallelFor* prev_parallel_for_;
+  size_t prev_num_threads_;
+};
+
+// Number of threads the operators running on the calling thread may use, 1
+// outside of an IntraOpParallelismGuard.
+size_t IntraOpThreads();
+
+namespace detail {
+void IntraOpParallelFor(
+    size_t n,
+    size_t grain,
+    const std::function<void(size_t, size_t)>& f);
+} // namespace detail
+
+// Splits [0, n) into at most IntraOpThreads() blocks of at least `grain`
+// items, and runs f(begin, end) on each block with the intra-op ParallelFor
+// of the calling thread. Runs f(0, n) directly when there is a single block.
+template <typename F>
+void IntraOpParallelFor(size_t n, size_t grain, const F& f) {
+  if (IntraOpThreads() > 1 && n / 2 >= std::max<size_t>(grain, 1)) {
+    detail::IntraOpParallelFor(n, grain, f);
+  } else if (n > 0) {
+    f(size_t(0), n);
+  }
+}
+
+} // namespace caffe2
+
+#endif // CAFFE2_UTILS_PARALLEL_FOR_H_
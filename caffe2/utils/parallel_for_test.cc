@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "caffe2/utils/parallel_for.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+TEST(ParallelForTest, RunsEachIndexOnce) {
+  const size_t kRange = 1000;
+  auto pool = std::make_shared<TaskThreadPool>(4);
+  auto parallel_for = PoolParallelFor(pool, 4);
+  std::vector<std::atomic<int>> counts(kRange);
+  for (auto& count : counts) {
+    count = 0;
+  }
+  parallel_for(kRange, [&](size_t i) { ++counts[i]; });
+  for (size_t i = 0; i < kRange; ++i) {
+    EXPECT_EQ(counts[i], 1) << i;
+  }
+  // Empty and single index ranges
+  parallel_for(0, [](size_t) { FAIL(); });
+  int ran = 0;
+  parallel_for(1, [&](size_t i) { ran += i + 1; });
+  EXPECT_EQ(ran, 1);
+}
+
+TEST(ParallelForTest, RethrowsAfterAllIndicesRan) {
+  auto pool = std::make_shared<TaskThreadPool>(4);
+  auto parallel_for = PoolParallelFor(pool, 4);
+  std::atomic<int> ran(0);
+  EXPECT_THROW(
+      parallel_for(
+          100,
+          [&](size_t i) {
+            ++ran;
+            if (i % 10 == 0) {
+              throw std::runtime_error("failed");
+            }
+          }),
+      std::runtime_error);
+  EXPECT_EQ(ran, 100);
+}
+
+TEST(ParallelForTest, RunsFromPoolThreads) {
+  // Every pool thread is busy with a ParallelFor on the same pool: the
+  // callers do the work themselves rather than waiting for helpers
+  const int kNumThreads = 2;
+  auto pool = std::make_shared<TaskThreadPool>(kNumThreads);
+  auto parallel_for = PoolParallelFor(pool, kNumThreads);
+  std::atomic<int> sum(0);
+  std::mutex mutex;
+  std::condition_variable cv;
+  int done = 0;
+  for (int t = 0; t < kNumThreads; ++t) {
+    pool->run([&]() {
+      parallel_for(100, [&](size_t i) { sum += i; });
+      std::lock_guard<std::mutex> lock(mutex);
+      ++done;
+      cv.notify_one();
+    });
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&]() { return done == kNumThreads; });
+  EXPECT_EQ(sum, kNumThreads * 4950);
+}
+
+TEST(ParallelForTest, IntraOpParallelFor) {
+  const size_t kSize = 1000;
+  auto pool = std::make_shared<TaskThreadPool>(4);
+  auto parallel_for = PoolParallelFor(pool, 4);
+
+  // Outside of a guard, a single block
+  EXPECT_EQ(IntraOpThreads(), 1);
+  int blocks = 0;
+  IntraOpParallelFor(kSize, 1, [&](size_t begin, size_t end) {
+    EXPECT_EQ(begin, 0);
+    EXPECT_EQ(end, kSize);
+    ++blocks;
+  });
+  EXPECT_EQ(blocks, 1);
+
+  {
+    IntraOpParallelismGuard guard(&parallel_for, 4);
+    EXPECT_EQ(IntraOpThreads(), 4);
+    std::vector<std::atomic<int>> counts(kSize);
+    for (auto& count : counts) {
+      count = 0;
+    }
+    std::atomic<int> num_blocks(0);
+    IntraOpParallelFor(kSize, 100, [&](size_t begin, size_t end) {
+      EXPECT_LT(begin, end);
+      for (auto i = begin; i < end; ++i) {
+        ++counts[i];
+      }
+      ++num_blocks;
+    });
+    EXPECT_EQ(num_blocks, 4);
+    for (size_t i = 0; i < kSize; ++i) {
+      EXPECT_EQ(counts[i], 1) << i;
+    }
+
+    // Blocks are no smaller than the grain
+    num_blocks = 0;
+    IntraOpParallelFor(kSize, 400, [&](size_t begin, size_t end) {
+      EXPECT_GE(end - begin, 400);
+      ++num_blocks;
+    });
+    EXPECT_EQ(num_blocks, 2);
+
+    // Nested guards restore the outer parallelism
+    {
+      IntraOpParallelismGuard inner(nullptr, 4);
+      EXPECT_EQ(IntraOpThreads(), 1);
+    }
+    EXPECT_EQ(IntraOpThreads(), 4);
+  }
+  EXPECT_EQ(IntraOpThreads(), 1);
+}
+
+} // namespace caffe2
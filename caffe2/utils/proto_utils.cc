@@ -28,6 +28,7 @@
 #endif  // !CAFFE2_USE_LITE_PROTO
 
 #include "caffe2/core/logging.h"
+#include "caffe2/core/numa.h"
 
 using ::google::protobuf::Message;
 using ::google::protobuf::MessageLite;
@@ -63,7 +64,9 @@ bool IsSameDevice(const DeviceOption& lhs, const DeviceOption& rhs) {
   return (
       lhs.device_type() == rhs.device_type() &&
       lhs.cuda_gpu_id() == rhs.cuda_gpu_id() &&
-      lhs.node_name() == rhs.node_name());
+      lhs.node_name() == rhs.node_name() &&
+      // NUMA nodes only tell devices apart when they are used
+      (!IsNUMAEnabled() || lhs.numa_node_id() == rhs.numa_node_id()));
 }
 
 bool ReadStringFromFile(const char* filename, string* str) {
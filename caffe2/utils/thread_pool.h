@@ -24,9 +24,20 @@
 #include <thread>
 #include <utility>
 
+#include "caffe2/core/numa.h"
+
 namespace caffe2 {
 
-class TaskThreadPool {
+// Interface of the thread pools handed out by ThreadPoolRegistry to the async
+// net executors (see net_async_base.h).
+class TaskThreadPoolBase {
+ public:
+    virtual void run(const std::function<void()>& func) = 0;
+    virtual std::size_t size() const = 0;
+    virtual ~TaskThreadPoolBase() noexcept {}
+};
+
+class TaskThreadPool : public TaskThreadPoolBase {
  private:
     struct task_element_t {
         bool run_with_id;
@@ -47,12 +58,20 @@ class TaskThreadPool {
     bool complete_;
     std::size_t available_;
     std::size_t total_;
+    int numa_node_id_;
+    bool pin_threads_;
 
  public:
-    /// @brief Constructor.
-    explicit TaskThreadPool(std::size_t pool_size)
+    /// @brief Constructor. The threads are bound to `numa_node_id` unless it
+    /// is negative (see caffe2/core/numa.h), and each pinned to a CPU of
+    /// their own if `pin_threads` is set.
+    explicit TaskThreadPool(
+        std::size_t pool_size,
+        int numa_node_id = -1,
+        bool pin_threads = false)
         :  threads_(pool_size), running_(true), complete_(true),
-           available_(pool_size), total_(pool_size) {
+           available_(pool_size), total_(pool_size),
+           numa_node_id_(numa_node_id), pin_threads_(pin_threads) {
         for ( std::size_t i = 0; i < pool_size; ++i ) {
             threads_[i] = std::thread(
                 std::bind(&TaskThreadPool::main_loop, this, i));
@@ -60,7 +79,7 @@ class TaskThreadPool {
     }
 
     /// @brief Destructor.
-    ~TaskThreadPool() {
+    ~TaskThreadPool() override {
         // Set running flag to false then notify all threads.
         {
             std::unique_lock< std::mutex > lock(mutex_);
@@ -89,10 +108,18 @@ class TaskThreadPool {
         condition_.notify_one();
     }
 
-    void run(const std::function<void()>& func) {
+    void run(const std::function<void()>& func) override {
       runTask(func);
     }
 
+    std::size_t size() const override {
+      return total_;
+    }
+
+    int numa_node_id() const {
+      return numa_node_id_;
+    }
+
     template <typename Task>
     void runTaskWithID(Task task) {
       std::unique_lock<std::mutex> lock(mutex_);
@@ -115,6 +142,16 @@ class TaskThreadPool {
  private:
     /// @brief Entry point for pool threads.
     void main_loop(std::size_t index) {
+        try {
+            NUMABind(numa_node_id_);
+            if (pin_threads_) {
+                PinCurrentThread(numa_node_id_, index);
+            }
+        } catch (const std::exception& e) {
+            LOG(ERROR) << "Failed to place pool thread " << index << ": "
+                       << e.what();
+        }
+
         while (running_) {
             // Wait on condition variable while the task is empty and
             // the pool is still running.
@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/utils/work_stealing_thread_pool.h"
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+namespace {
+// The pool and worker index the current thread belongs to, if any.
+thread_local const WorkStealingThreadPool* t_pool = nullptr;
+thread_local std::size_t t_worker_index = 0;
+} // namespace
+
+WorkStealingThreadPool::WorkStealingThreadPool(
+    std::size_t pool_size,
+    int numa_node_id,
+    bool pin_threads)
+    : numa_node_id_(numa_node_id), pin_threads_(pin_threads) {
+  CAFFE_ENFORCE_GT(pool_size, 0, "Thread pool must have at least one worker");
+  workers_.reserve(pool_size);
+  for (std::size_t i = 0; i < pool_size; ++i) {
+    workers_.emplace_back(new Worker());
+  }
+  // Start the threads only once all the deques exist, since workers look at
+  // each other's deques.
+  for (std::size_t i = 0; i < pool_size; ++i) {
+    workers_[i]->thread =
+        std::thread(&WorkStealingThreadPool::mainLoop, this, i);
+  }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    running_ = false;
+  }
+  sleep_cv_.notify_all();
+  for (auto& worker : workers_) {
+    try {
+      worker->thread.join();
+    } catch (const std::exception&) {
+    }
+  }
+}
+
+void WorkStealingThreadPool::run(const std::function<void()>& func) {
+  std::size_t index;
+  if (t_pool == this) {
+    index = t_worker_index;
+  } else {
+    index = next_worker_++ % workers_.size();
+  }
+  {
+    auto& worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(func);
+  }
+  ++num_pending_;
+  // Pairs with the check of num_pending_ in mainLoop: either the sleeping
+  // worker sees the new task before waiting, or it is notified here.
+  if (num_sleeping_ > 0) {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    sleep_cv_.notify_one();
+  }
+}
+
+bool WorkStealingThreadPool::popLocal(
+    std::size_t index,
+    std::function<void()>* task) {
+  auto& worker = *workers_[index];
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  if (worker.tasks.empty()) {
+    return false;
+  }
+  *task = std::move(worker.tasks.back());
+  worker.tasks.pop_back();
+  return true;
+}
+
+bool WorkStealingThreadPool::steal(
+    std::size_t index,
+    std::function<void()>* task) {
+  const std::size_t num_workers = workers_.size();
+  for (std::size_t i = 1; i < num_workers; ++i) {
+    auto& victim = *workers_[(index + i) % num_workers];
+    std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+    if (!lock.owns_lock() || victim.tasks.empty()) {
+      continue;
+    }
+    *task = std::move(victim.tasks.front());
+    victim.tasks.pop_front();
+    ++num_stolen_;
+    return true;
+  }
+  return false;
+}
+
+void WorkStealingThreadPool::mainLoop(std::size_t index) {
+  t_pool = this;
+  t_worker_index = index;
+  try {
+    NUMABind(numa_node_id_);
+    if (pin_threads_) {
+      PinCurrentThread(numa_node_id_, index);
+    }
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Failed to place worker " << index << ": " << e.what();
+  }
+  std::function<void()> task;
+  while (running_) {
+    if (popLocal(index, &task) || steal(index, &task)) {
+      --num_pending_;
+      try {
+        task();
+      }
+      // Suppress all exceptions, as TaskThreadPool does.
+      catch (const std::exception&) {
+      }
+      // Release whatever the task captured before looking for the next one.
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    ++num_sleeping_;
+    // The try_lock in steal() may have skipped a busy deque, so only sleep
+    // when no task is pending at all.
+    sleep_cv_.wait(lock, [this]() { return num_pending_ > 0 || !running_; });
+    --num_sleeping_;
+  }
+}
+
+} // namespace caffe2
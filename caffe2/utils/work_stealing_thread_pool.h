@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_UTILS_WORK_STEALING_THREAD_POOL_H_
+#define CAFFE2_UTILS_WORK_STEALING_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "caffe2/utils/thread_pool.h"
+
+namespace caffe2 {
+
+/**
+ * @brief A thread pool with one task deque per worker.
+ *
+ * Tasks submitted from one of the pool's own workers are pushed to the back of
+ * that worker's deque and are popped from the back again, so that a chain
+ * that makes its children ready runs them next on the same thread while its
+ * outputs are still hot in cache. Tasks submitted from other threads are
+ * spread round-robin over the workers. A worker whose deque is empty steals
+ * the oldest task from the front of another worker's deque, and sleeps only
+ * when there is nothing left to steal.
+ *
+ * Each deque is guarded by its own mutex, so that, unlike TaskThreadPool,
+ * submitting and taking tasks does not serialize all the workers on a single
+ * lock.
+ */
+class WorkStealingThreadPool final : public TaskThreadPoolBase {
+ public:
+  // The workers are bound to `numa_node_id` unless it is negative, and each
+  // pinned to a CPU of their own if `pin_threads` is set, as in
+  // TaskThreadPool.
+  explicit WorkStealingThreadPool(
+      std::size_t pool_size,
+      int numa_node_id = -1,
+      bool pin_threads = false);
+  ~WorkStealingThreadPool() override;
+
+  void run(const std::function<void()>& func) override;
+
+  std::size_t size() const override {
+    return workers_.size();
+  }
+
+  // Number of tasks that were taken from another worker's deque.
+  std::size_t numStolen() const {
+    return num_stolen_;
+  }
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+    std::thread thread;
+  };
+
+  void mainLoop(std::size_t index);
+  bool popLocal(std::size_t index, std::function<void()>* task);
+  bool steal(std::size_t index, std::function<void()>* task);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  const int numa_node_id_;
+  const bool pin_threads_;
+  std::atomic<bool> running_{true};
+  std::atomic<std::size_t> next_worker_{0};
+  std::atomic<std::size_t> num_stolen_{0};
+
+  // Number of tasks sitting in the deques, and number of workers waiting
+  // for one. Both are only used to decide when to sleep and when to wake
+  // workers up; the deques themselves are the source of truth.
+  std::atomic<long> num_pending_{0};
+  std::atomic<int> num_sleeping_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_UTILS_WORK_STEALING_THREAD_POOL_H_
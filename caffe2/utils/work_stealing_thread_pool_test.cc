@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "caffe2/utils/work_stealing_thread_pool.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// wait() blocks until countDown() has been called the expected number of
+// times.
+class Latch {
+ public:
+  explicit Latch(int expected) : remaining_(expected) {}
+
+  void countDown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--remaining_ == 0) {
+      cv_.notify_all();
+    }
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return remaining_ == 0; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  int remaining_;
+};
+
+} // namespace
+
+TEST(WorkStealingThreadPoolTest, RunsExternalTasks) {
+  const int kNumTasks = 10000;
+  WorkStealingThreadPool pool(4);
+  EXPECT_EQ(pool.size(), 4);
+  std::atomic<int> counter(0);
+  Latch latch(kNumTasks);
+  for (int i = 0; i < kNumTasks; ++i) {
+    pool.run([&]() {
+      ++counter;
+      latch.countDown();
+    });
+  }
+  latch.wait();
+  EXPECT_EQ(counter, kNumTasks);
+}
+
+TEST(WorkStealingThreadPoolTest, RunsNestedTasks) {
+  // Every task spawns two children until the given depth, from within the
+  // pool, like async nets do when a chain makes its children ready.
+  const int kDepth = 12;
+  WorkStealingThreadPool pool(4);
+  Latch latch((1 << (kDepth + 1)) - 1);
+  std::function<void(int)> spawn = [&](int depth) {
+    if (depth < kDepth) {
+      pool.run([&, depth]() { spawn(depth + 1); });
+      pool.run([&, depth]() { spawn(depth + 1); });
+    }
+    latch.countDown();
+  };
+  pool.run([&]() { spawn(0); });
+  latch.wait();
+}
+
+TEST(WorkStealingThreadPoolTest, RunsLocalTasksInLifoOrder) {
+  WorkStealingThreadPool pool(1);
+  std::vector<int> order;
+  Latch latch(3);
+  pool.run([&]() {
+    pool.run([&]() {
+      order.push_back(1);
+      latch.countDown();
+    });
+    pool.run([&]() {
+      order.push_back(2);
+      latch.countDown();
+    });
+    latch.countDown();
+  });
+  latch.wait();
+  EXPECT_EQ(order, std::vector<int>({2, 1}));
+}
+
+TEST(WorkStealingThreadPoolTest, IdleWorkersSteal) {
+  WorkStealingThreadPool pool(2);
+  const int kNumTasks = 8;
+  Latch latch(kNumTasks);
+  pool.run([&]() {
+    for (int i = 0; i < kNumTasks; ++i) {
+      pool.run([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        latch.countDown();
+      });
+    }
+    // Keep this worker busy so that the other one has to steal.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  });
+  latch.wait();
+  EXPECT_GT(pool.numStolen(), 0);
+}
+
+} // namespace caffe2
@@ -151,6 +151,24 @@ if(USE_LMDB)
   endif()
 endif()
 
+# ---[ NUMA
+if(USE_NUMA)
+  if(NOT ${CMAKE_SYSTEM_NAME} STREQUAL "Linux")
+    message(WARNING "NUMA is currently only supported under Linux.")
+    set(USE_NUMA OFF)
+  else()
+    find_package(Numa)
+    if(NUMA_FOUND)
+      caffe2_include_directories(${Numa_INCLUDE_DIR})
+      list(APPEND Caffe2_DEPENDENCY_LIBS ${Numa_LIBRARIES})
+      set(CAFFE2_USE_NUMA 1)
+    else()
+      message(WARNING "Not compiling with NUMA. Suppress this warning with -DUSE_NUMA=OFF")
+      set(USE_NUMA OFF)
+    endif()
+  endif()
+endif()
+
 # ---[ LevelDB
 # ---[ Snappy
 if(USE_LEVELDB)
@@ -504,6 +522,7 @@ if (USE_ATEN)
 endif()
 
 if (USE_ZSTD)
+  set(CAFFE2_USE_ZSTD 1)
   list(APPEND Caffe2_DEPENDENCY_LIBS libzstd_static)
   caffe2_include_directories(${PROJECT_SOURCE_DIR}/third_party/zstd/lib)
   add_subdirectory(${PROJECT_SOURCE_DIR}/third_party/zstd/build/cmake)
@@ -56,6 +56,7 @@ function (caffe2_print_configuration_summary)
     message(STATUS "    NERVANA_GPU version : ${NERVANA_GPU_VERSION}")
   endif()
   message(STATUS "  USE_NNPACK            : ${USE_NNPACK}")
+  message(STATUS "  USE_NUMA              : ${USE_NUMA}")
   message(STATUS "  USE_OBSERVERS         : ${USE_OBSERVERS}")
   message(STATUS "  USE_OPENCV            : ${USE_OPENCV}")
   if(${USE_OPENCV})